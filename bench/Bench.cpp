@@ -0,0 +1,249 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Bench.cpp
+///  Description: Runs the stress, the replay and the benchmarks of the eye swapper, out of the tray
+///               application.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./StressHarness.h"
+
+#include <stdio.h>
+
+using namespace Enforcement;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// A command of the tool: args holds the arguments that follow its name, the report file first.
+struct Benchmark
+{
+    const TCHAR*    name;
+    const TCHAR*    usage;
+    int             minArgs;
+    LSTATUS         (*run)( int argc, TCHAR** args );
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// The optional number at index, or defaultValue when it is not given.
+static DWORD Arg( int argc, TCHAR** args, int index, DWORD defaultValue )
+{
+    return (index < argc) ? (DWORD)_tstoi(args[index]) : defaultValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static DWORD AtLeastOne( DWORD value )
+{
+    return (value != 0) ? value : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///     -stress <report file> [seconds] [adversaries] [rewrites/s] [burst] [fps]
+///         Runs every enforcement strategy against simulated 3D Vision services on a scratch key,
+///         and reports how many frames the driver would have seen with a wrong or mixed pattern.
+///
+///     -replay <trace file> <report file> [speed]
+///         Replays a trace recorded by the tray application with -record against every enforcement
+///         strategy on a key of a hive kept in memory, and reports their reaction latency and write
+///         count. Speed 0 (default) replays as fast as possible.
+///
+///     -hash-bench <report file> [keys]
+///         Compares a full read of a synthetic tree on a scratch key with the hashed read and diff.
+///
+///     -notify-bench <report file> [samples]
+///         Reports the wake-up latency of the notify thread for several priority, affinity and
+///         spin settings, with every CPU busy.
+///
+///     -control-bench <report file> [samples]
+///         Reports the round-trip latency of the control pipe.
+///
+///     -alloc-bench <report file> [keys] [scans]
+///         Compares the time and allocations of a full scan of a synthetic tree, with the registry
+///         buffers coming from new[], from a heap allocator and from an arena.
+///
+///     -values-bench <report file> [samples]
+///         Compares reading 2, 16 and 128 values one by one and with one batched call.
+///
+///     -sweep-bench <report file> [keys] [sweeps]
+///         Compares sweeps over the keys of a synthetic tree with and without the key cache.
+///
+///     -apply-bench <report file> [keys] [values per key]
+///         Reports the throughput of bulk writes over many keys for 1 to 16 threads.
+///
+///     -stereo-bench <report file> [frames]
+///         Reports the analysis time of synthetic 1080p interleaved frames.
+///
+///     -compose-bench <report file> [frames]
+///         Reports the composition time of a 4K frame for every kernel and thread count, and checks
+///         the frames composed with the right and the swapped pattern.
+///
+///     -attach-bench <report file> [samples]
+///         Reports the time from the creation of a missing key to the attach of the waiter, with
+///         the path created at once and level by level.
+///
+///     -reopen-bench <report file> [milliseconds]
+///         Compares reads of a key that another thread keeps reopening, with the handle published
+///         through an epoch and behind a mutex.
+///
+///     -timer-bench <report file> [timers]
+///         Reports the cost of the timer wheel operations, and the reads and rewrites of values
+///         pinned on the scheduler.
+///
+///     -flush-bench <report file> [threads] [milliseconds]
+///         Compares direct writes, with and without a flush, with the writes through a write-behind
+///         queue with every durability.
+///
+///     -filter-bench <report file> [writes]
+///         Counts the callbacks of a subscriber to every change of a key and of one filtered by value
+///         name, while other values keep changing.
+///
+///     -trace-bench <report file> [events]
+///         Reports the cost of recording a trace event, with the trace disabled and enabled.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static const Benchmark benchmarks[] =
+{
+    { _T("-stress"),        _T("<report file> [seconds] [adversaries] [rewrites/s] [burst] [fps]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          StressOptions options;
+          options.durationMs      = Arg(argc, args, 1, options.durationMs / 1000) * 1000;
+          options.adversaries     = Arg(argc, args, 2, options.adversaries);
+          options.writesPerSecond = Arg(argc, args, 3, options.writesPerSecond);
+          options.burst           = Arg(argc, args, 4, options.burst);
+          options.frameRate       = Arg(argc, args, 5, options.frameRate);
+
+          return StressHarness::RunAll(options, args[0]);
+      } },
+
+    { _T("-replay"),        _T("<trace file> <report file> [speed]"), 2,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          double speed = (argc > 2) ? _tcstod(args[2], nullptr) : 0.0;
+
+          return StressHarness::ReplayAll(args[0], args[1], speed);
+      } },
+
+    { _T("-hash-bench"),    _T("<report file> [keys]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::HashBenchmark(Arg(argc, args, 1, 50000), args[0]);
+      } },
+
+    { _T("-notify-bench"),  _T("<report file> [samples]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::NotifyLatency(Arg(argc, args, 1, 2000), args[0]);
+      } },
+
+    { _T("-control-bench"), _T("<report file> [samples]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::ControlLatency(Arg(argc, args, 1, 2000), args[0]);
+      } },
+
+    { _T("-alloc-bench"),   _T("<report file> [keys] [scans]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::AllocBenchmark(Arg(argc, args, 1, 5000), AtLeastOne(Arg(argc, args, 2, 20)), args[0]);
+      } },
+
+    { _T("-values-bench"),  _T("<report file> [samples]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::MultiValueBenchmark(Arg(argc, args, 1, 2000), args[0]);
+      } },
+
+    { _T("-sweep-bench"),   _T("<report file> [keys] [sweeps]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::SweepBenchmark(Arg(argc, args, 1, 500), AtLeastOne(Arg(argc, args, 2, 100)), args[0]);
+      } },
+
+    { _T("-apply-bench"),   _T("<report file> [keys] [values per key]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::ApplyBenchmark(Arg(argc, args, 1, 64), Arg(argc, args, 2, 16), args[0]);
+      } },
+
+    { _T("-stereo-bench"),  _T("<report file> [frames]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::StereoBenchmark(AtLeastOne(Arg(argc, args, 1, 200)), args[0]);
+      } },
+
+    { _T("-compose-bench"), _T("<report file> [frames]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::ComposeBenchmark(AtLeastOne(Arg(argc, args, 1, 100)), args[0]);
+      } },
+
+    { _T("-attach-bench"),  _T("<report file> [samples]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::AttachLatency(Arg(argc, args, 1, 200), args[0]);
+      } },
+
+    { _T("-reopen-bench"),  _T("<report file> [milliseconds]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::ReopenBenchmark(AtLeastOne(Arg(argc, args, 1, 1000)), args[0]);
+      } },
+
+    { _T("-timer-bench"),   _T("<report file> [timers]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::TimerBenchmark(AtLeastOne(Arg(argc, args, 1, 5000)), args[0]);
+      } },
+
+    { _T("-flush-bench"),   _T("<report file> [threads] [milliseconds]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::FlushBenchmark(AtLeastOne(Arg(argc, args, 1, 4)), AtLeastOne(Arg(argc, args, 2, 2000)), args[0]);
+      } },
+
+    { _T("-filter-bench"),  _T("<report file> [writes]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::FilterBenchmark(AtLeastOne(Arg(argc, args, 1, 2000)), args[0]);
+      } },
+
+    { _T("-trace-bench"),   _T("<report file> [events]"), 1,
+      [] (int argc, TCHAR** args) -> LSTATUS
+      {
+          return StressHarness::TraceBenchmark(AtLeastOne(Arg(argc, args, 1, 1000000)), args[0]);
+      } },
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Runs the command named by the first argument, and exits with its status; without a known command,
+/// prints the usage and exits with -1.
+int _tmain( int argc, TCHAR** argv )
+{
+    if(argc >= 2)
+    {
+        for(size_t i = 0; i < _countof(benchmarks); i++)
+        {
+            const Benchmark& benchmark = benchmarks[i];
+
+            if(lstrcmpi(argv[1], benchmark.name) == 0 && argc - 2 >= benchmark.minArgs)
+                return (int)benchmark.run(argc - 2, argv + 2);
+        }
+    }
+
+    _tprintf(_T("Usage:\n"));
+    for(size_t i = 0; i < _countof(benchmarks); i++)
+        _tprintf(_T("    3DVisionEyeSwapperBench %s %s\n"), benchmarks[i].name, benchmarks[i].usage);
+
+    return -1;
+}
@@ -0,0 +1,2173 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        StressHarness.cpp
+///  Description: Simulates the 3D Vision service fighting the enforcer, and measures how often the
+///               driver would latch a wrong pattern.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./StressHarness.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    const TCHAR* const StressHarness::ScratchKeyPath = _T("SOFTWARE\\3DVisionEyeSwapper\\Stress");
+
+    static const Strategy       strategies[]    = { Strategy::Immediate, Strategy::Adaptive };
+    static const TCHAR* const   strategyNames[] = { _T("Immediate"), _T("Adaptive") };
+
+    static const DWORD          replayTimeoutMs = 2000;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// CPU time used by a thread or process, in 100ns units.
+    static unsigned long long CpuTime( _In_ HANDLE handle, _In_ bool isThread )
+    {
+        FILETIME creation, exit, kernel, user;
+
+        BOOL ok = isThread ? GetThreadTimes(handle, &creation, &exit, &kernel, &user)
+                           : GetProcessTimes(handle, &creation, &exit, &kernel, &user);
+        if(!ok)
+            return 0;
+
+        return ((unsigned long long)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) +
+               ((unsigned long long)user.dwHighDateTime   << 32 | user.dwLowDateTime);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::Run( _In_  const StressOptions&    options,
+                                _In_  Strategy                strategy,
+                                _Out_ StressResult*           result )
+    {
+        memset(result, 0, sizeof(StressResult));
+        result->strategy = strategy;
+
+        LSTATUS status = ERROR_SUCCESS;
+        Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                    ScratchKeyPath,
+                                                    Registry::AccessRights::Read | Registry::AccessRights::Write,
+                                                    &status );
+        if(key == nullptr)
+            return status;
+
+        Registry::Key* driverKey = Registry::Key::Open( Registry::PredefinedKey::Current_User,
+                                                        ScratchKeyPath,
+                                                        Registry::AccessRights::Query_Value,
+                                                        &status );
+        if(driverKey == nullptr)
+        {
+            key->Close();
+            return status;
+        }
+
+        const DWORD servicePattern = Enforcer::GetPattern(false);
+        const DWORD wantedPattern  = Enforcer::GetPattern(true);
+
+        key->SetValueDWORD(Enforcer::ValuePattern0, servicePattern);
+        key->SetValueDWORD(Enforcer::ValuePattern1, servicePattern);
+
+        // Like in the tool, the delayed re-enforcements, the retries and the checks run on a scheduler.
+        Registry::Scheduler scheduler;
+        scheduler.Start();
+
+        Enforcer* enforcer = new Enforcer(key, strategy);
+        enforcer->SetScheduler(&scheduler);
+        enforcer->SetEyesSwapped(true);
+
+        status = enforcer->Start();
+        if(status != ERROR_SUCCESS)
+        {
+            delete enforcer;
+            driverKey->Close();
+            key->Close();
+            return status;
+        }
+
+        std::atomic<bool>               stop(false);
+        std::atomic<unsigned long long> adversaryWrites(0);
+        std::atomic<unsigned long long> harnessCpu(0);
+        std::vector<std::thread*>       threads;
+
+        LONG64             writesBefore = Registry::Metrics::Get(Registry::Counter::ValuesWritten);
+        unsigned long long cpuBefore    = CpuTime(GetCurrentProcess(), false);
+        unsigned long long mainBefore   = CpuTime(GetCurrentThread(), true);
+
+        // The adversaries write the values one after another, like the service does, so the driver may see them mixed.
+        for(DWORD i = 0; i < options.adversaries; i++)
+        {
+            threads.push_back( new std::thread( [&, key] ()
+                {
+                    DWORD pause = (options.writesPerSecond != 0) ? options.burst * 1000 / options.writesPerSecond : 1000;
+
+                    while(!stop)
+                    {
+                        for(DWORD b = 0; b < options.burst && !stop; b++)
+                        {
+                            if(key->SetValueDWORD(Enforcer::ValuePattern0, servicePattern) == ERROR_SUCCESS)
+                                adversaryWrites++;
+
+                            if(key->SetValueDWORD(Enforcer::ValuePattern1, servicePattern) == ERROR_SUCCESS)
+                                adversaryWrites++;
+                        }
+
+                        Sleep(pause);
+                    }
+
+                    harnessCpu += CpuTime(GetCurrentThread(), true);
+                }
+            ) );
+        }
+
+        // The driver latches the pattern once per frame.
+        threads.push_back( new std::thread( [&] ()
+            {
+                LARGE_INTEGER frequency, now;
+                QueryPerformanceFrequency(&frequency);
+                QueryPerformanceCounter(&now);
+
+                LONGLONG frameTicks = frequency.QuadPart / ((options.frameRate != 0) ? options.frameRate : 60);
+                LONGLONG nextFrame  = now.QuadPart;
+
+                while(!stop)
+                {
+                    DWORD pattern0 = 0;
+                    DWORD pattern1 = 0;
+                    driverKey->GetValueDWORD(Enforcer::ValuePattern0, &pattern0);
+                    driverKey->GetValueDWORD(Enforcer::ValuePattern1, &pattern1);
+
+                    result->frames++;
+                    if(pattern0 != pattern1)
+                        result->mixedFrames++;
+                    else if(pattern0 != wantedPattern)
+                        result->wrongFrames++;
+
+                    nextFrame += frameTicks;
+                    QueryPerformanceCounter(&now);
+                    if(nextFrame > now.QuadPart)
+                        Sleep((DWORD)((nextFrame - now.QuadPart) * 1000 / frequency.QuadPart));
+                }
+
+                harnessCpu += CpuTime(GetCurrentThread(), true);
+            }
+        ) );
+
+        Sleep(options.durationMs);
+        stop = true;
+
+        for(auto thread : threads)
+        {
+            thread->join();
+            delete thread;
+        }
+
+        unsigned long long cpuAfter  = CpuTime(GetCurrentProcess(), false);
+        unsigned long long mainAfter = CpuTime(GetCurrentThread(), true);
+        LONG64             written   = Registry::Metrics::Get(Registry::Counter::ValuesWritten) - writesBefore;
+
+        enforcer->Stop();
+        key->Close();
+        driverKey->Close();
+        delete enforcer;
+
+        scheduler.Stop();
+
+        // Whatever the process used besides the adversaries, the driver and this thread was used by the enforcer.
+        long long enforcerCpu = (long long)(cpuAfter - cpuBefore) - (long long)harnessCpu.load() - (long long)(mainAfter - mainBefore);
+        if(enforcerCpu < 0)
+            enforcerCpu = 0;
+
+        result->adversaryWrites = adversaryWrites;
+        result->enforcerWrites  = (written > (LONG64)adversaryWrites.load()) ? written - adversaryWrites.load() : 0;
+        result->enforcerCpu     = (options.durationMs != 0) ? (double)enforcerCpu / 100.0 / options.durationMs : 0.0;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::RunAll( _In_     const StressOptions&  options,
+                                   _In_z_   const TCHAR*          reportFileName )
+    {
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        _ftprintf(report, _T("%u adversaries, %u rewrites/s each in bursts of %u, driver at %u fps, %u ms per strategy.\n\n"),
+                  options.adversaries, options.writesPerSecond, options.burst, options.frameRate, options.durationMs);
+        _ftprintf(report, _T("%-10s %10s %10s %10s %12s %12s %12s\n"),
+                  _T("Strategy"), _T("Frames"), _T("Wrong %"), _T("Mixed %"), _T("Adv. writes"), _T("Enf. writes"), _T("Enf. CPU %"));
+
+        LSTATUS status = ERROR_SUCCESS;
+        for(size_t i = 0; i < _countof(strategies); i++)
+        {
+            StressResult result;
+            status = Run(options, strategies[i], &result);
+            if(status != ERROR_SUCCESS)
+                break;
+
+            double frames = (result.frames != 0) ? (double)result.frames : 1.0;
+            _ftprintf(report, _T("%-10s %10llu %10.2f %10.2f %12llu %12llu %12.2f\n"),
+                      strategyNames[i], result.frames,
+                      100.0 * result.wrongFrames / frames, 100.0 * result.mixedFrames / frames,
+                      result.adversaryWrites, result.enforcerWrites, result.enforcerCpu);
+        }
+
+        fclose(report);
+
+        Registry::Key::Delete(Registry::PredefinedKey::Current_User, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::Replay( _In_     const std::vector<Registry::ChangeRecord>&  records,
+                                   _In_     Strategy                                    strategy,
+                                   _In_     double                                      speed,
+                                   _Out_    ReplayResult*                               result )
+    {
+        memset(result, 0, sizeof(ReplayResult));
+        result->strategy    = strategy;
+        result->latencyMin  = ~0ULL;
+
+        // A new hive holds only the recorded values.
+        Registry::MemoryHive hive;
+
+        LSTATUS status = ERROR_SUCCESS;
+        Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                    ScratchKeyPath,
+                                                    Registry::AccessRights::Read | Registry::AccessRights::Write,
+                                                    &status,
+                                                    nullptr,
+                                                    &hive );
+        if(key == nullptr)
+            return status;
+
+        Registry::Key* observer = Registry::Key::Open( Registry::PredefinedKey::Current_User,
+                                                       ScratchKeyPath,
+                                                       Registry::AccessRights::Query_Value,
+                                                       &status,
+                                                       nullptr,
+                                                       &hive );
+        if(observer == nullptr)
+        {
+            key->Close();
+            return status;
+        }
+
+        const DWORD wantedPattern = Enforcer::GetPattern(true);
+
+        // The records of time 0 are the values found when the recording started.
+        size_t next = 0;
+        for(; next < records.size() && records[next].timeMicros == 0; next++)
+            Registry::ChangeTrace::Apply(*key, records[next]);
+
+        // Like in the tool, the delayed re-enforcements, the retries and the checks run on a scheduler.
+        Registry::Scheduler scheduler;
+        scheduler.Start();
+
+        Enforcer* enforcer = new Enforcer(key, strategy);
+        enforcer->SetScheduler(&scheduler);
+        enforcer->SetEyesSwapped(true);
+
+        status = enforcer->Start();
+        if(status != ERROR_SUCCESS)
+        {
+            delete enforcer;
+            observer->Close();
+            key->Close();
+            return status;
+        }
+
+        LARGE_INTEGER frequency, start, now;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+
+        LONG64             writesBefore  = Registry::Metrics::Get(Registry::Counter::ValuesWritten);
+        unsigned long long replayWrites  = 0;
+        unsigned long long latencyTotal  = 0;
+
+        for(; next < records.size(); next++)
+        {
+            const Registry::ChangeRecord& record = records[next];
+
+            if(speed > 0.0)
+            {
+                LONGLONG due = start.QuadPart + (LONGLONG)((double)record.timeMicros / speed * frequency.QuadPart / 1000000.0);
+                QueryPerformanceCounter(&now);
+                if(due > now.QuadPart)
+                    Sleep((DWORD)((due - now.QuadPart) * 1000 / frequency.QuadPart));
+            }
+
+            if(Registry::ChangeTrace::Apply(*key, record) == ERROR_SUCCESS && !record.deleted)
+                replayWrites++;
+
+            result->records++;
+
+            DWORD pattern0 = 0;
+            DWORD pattern1 = 0;
+            observer->GetValueDWORD(Enforcer::ValuePattern0, &pattern0);
+            observer->GetValueDWORD(Enforcer::ValuePattern1, &pattern1);
+            if(pattern0 == wantedPattern && pattern1 == wantedPattern)
+                continue;
+
+            // The change broke the pattern, so measure how long the enforcer takes to repair it.
+            result->breaks++;
+
+            LARGE_INTEGER broken;
+            QueryPerformanceCounter(&broken);
+
+            LONGLONG timeout = broken.QuadPart + frequency.QuadPart * replayTimeoutMs / 1000;
+            do
+            {
+                SwitchToThread();
+                observer->GetValueDWORD(Enforcer::ValuePattern0, &pattern0);
+                observer->GetValueDWORD(Enforcer::ValuePattern1, &pattern1);
+                QueryPerformanceCounter(&now);
+            } while((pattern0 != wantedPattern || pattern1 != wantedPattern) && now.QuadPart < timeout);
+
+            if(pattern0 == wantedPattern && pattern1 == wantedPattern)
+            {
+                unsigned long long latency = (now.QuadPart - broken.QuadPart) * 1000000 / frequency.QuadPart;
+
+                result->recovered++;
+                latencyTotal += latency;
+                if(latency < result->latencyMin) result->latencyMin = latency;
+                if(latency > result->latencyMax) result->latencyMax = latency;
+            }
+        }
+
+        LONG64 written = Registry::Metrics::Get(Registry::Counter::ValuesWritten) - writesBefore;
+
+        enforcer->Stop();
+        key->Close();
+        observer->Close();
+        delete enforcer;
+
+        scheduler.Stop();
+
+        result->enforcerWrites = (written > (LONG64)replayWrites) ? written - replayWrites : 0;
+        result->latencyAvg     = (result->recovered != 0) ? latencyTotal / result->recovered : 0;
+        if(result->recovered == 0)
+            result->latencyMin = 0;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::ReplayAll( _In_z_   const TCHAR*    traceFileName,
+                                      _In_z_   const TCHAR*    reportFileName,
+                                      _In_     double          speed )
+    {
+        std::vector<Registry::ChangeRecord> records;
+
+        LSTATUS status = Registry::ChangeTrace::Load(traceFileName, records);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        if(speed > 0.0)
+            _ftprintf(report, _T("%s: %u records replayed at %.2fx.\n\n"), traceFileName, (DWORD)records.size(), speed);
+        else
+            _ftprintf(report, _T("%s: %u records replayed as fast as possible.\n\n"), traceFileName, (DWORD)records.size());
+
+        _ftprintf(report, _T("%-10s %10s %10s %10s %12s %12s %12s %12s\n"),
+                  _T("Strategy"), _T("Records"), _T("Breaks"), _T("Repaired"), _T("Enf. writes"),
+                  _T("Min us"), _T("Avg us"), _T("Max us"));
+
+        for(size_t i = 0; i < _countof(strategies); i++)
+        {
+            ReplayResult result;
+            status = Replay(records, strategies[i], speed, &result);
+            if(status != ERROR_SUCCESS)
+                break;
+
+            _ftprintf(report, _T("%-10s %10llu %10llu %10llu %12llu %12llu %12llu %12llu\n"),
+                      strategyNames[i], result.records, result.breaks, result.recovered, result.enforcerWrites,
+                      result.latencyMin, result.latencyAvg, result.latencyMax);
+        }
+
+        fclose(report);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static double ElapsedMs( _In_ LONGLONG start )
+    {
+        LARGE_INTEGER frequency, now;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&now);
+
+        return (now.QuadPart - start) * 1000.0 / frequency.QuadPart;
+    }
+
+    // The synthetic tree of the benchmarks.
+    static const DWORD profiles     = 50;
+    static const DWORD blobSize     = 256;
+    static const DWORD largeSize    = 16384;    // Every 100th key holds a large blob, like the profile data.
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Creates keyCount keys under the scratch key, spread over the profiles. Leaves in blob the data
+    /// of the last key.
+    static LSTATUS CreateSyntheticTree( _In_ DWORD keyCount, _Out_ std::vector<BYTE>& blob )
+    {
+        LSTATUS status = ERROR_SUCCESS;
+        TCHAR   path[MAX_PATH];
+
+        blob.resize(largeSize);
+
+        RegDeleteTree(HKEY_CURRENT_USER, StressHarness::ScratchKeyPath);
+
+        for(DWORD i = 0; i < keyCount && status == ERROR_SUCCESS; i++)
+        {
+            _stprintf_s(path, _T("%s\\Profile%03u\\App%05u"), StressHarness::ScratchKeyPath, i % profiles, i / profiles);
+
+            Registry::Key* key = Registry::Key::Create(Registry::PredefinedKey::Current_User, path, Registry::AccessRights::Write, &status);
+            if(key == nullptr)
+                break;
+
+            for(size_t j = 0; j < blob.size(); j++)
+                blob[j] = (BYTE)(i * 31 + j);
+
+            key->SetValueDWORD(_T("Setting"), i);
+            status = key->SetValue(_T("Data"), &blob[0], (i % 100 == 0) ? largeSize : blobSize, Registry::DataType::Binary);
+            key->Close();
+        }
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::HashBenchmark( _In_     DWORD           keyCount,
+                                          _In_z_   const TCHAR*    reportFileName )
+    {
+        TCHAR               path[MAX_PATH];
+        std::vector<BYTE>   blob;
+
+        LSTATUS status = CreateSyntheticTree(keyCount, blob);
+
+        Registry::Key* root = nullptr;
+        if(status == ERROR_SUCCESS)
+            root = Registry::Key::Open(Registry::PredefinedKey::Current_User, ScratchKeyPath, Registry::AccessRights::Read, &status);
+
+        FILE* report = nullptr;
+        if(root != nullptr && (_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr))
+            status = ERROR_ACCESS_DENIED;
+
+        if(status == ERROR_SUCCESS)
+        {
+            _ftprintf(report, _T("%u keys, %u byte blobs, every 100th key with a %u byte blob.\n\n"), keyCount, blobSize, largeSize);
+
+            LARGE_INTEGER start;
+
+            // Hash throughput on a buffer in memory, without the registry reads.
+            std::vector<BYTE> buffer(16 << 20);
+            for(size_t j = 0; j < buffer.size(); j++)
+                buffer[j] = (BYTE)j;
+
+            QueryPerformanceCounter(&start);
+            volatile Registry::QWORD sum = 0;
+            for(int j = 0; j < 8; j++)
+                sum += Registry::HashTree::HashBytes(&buffer[0], buffer.size(), j);
+            double hashMs = ElapsedMs(start.QuadPart);
+
+            _ftprintf(report, _T("%-36s %10.1f MB/s\n"), _T("Hash throughput"), 8 * 16 / (hashMs / 1000.0));
+
+            QueryPerformanceCounter(&start);
+            Registry::HashTree* full = Registry::HashTree::Build(*root, true, &status);
+            _ftprintf(report, _T("%-36s %10.2f ms\n"), _T("Full read, data kept"), ElapsedMs(start.QuadPart));
+
+            QueryPerformanceCounter(&start);
+            Registry::HashTree* before = Registry::HashTree::Build(*root, false, &status);
+            _ftprintf(report, _T("%-36s %10.2f ms\n"), _T("Hashed read"), ElapsedMs(start.QuadPart));
+
+            Registry::HashTree* after = Registry::HashTree::Build(*root, false, &status);
+
+            QueryPerformanceCounter(&start);
+            Registry::Index* index = Registry::Index::Build(Registry::PredefinedKey::Current_User, ScratchKeyPath, &status);
+            _ftprintf(report, _T("%-36s %10.2f ms\n"), _T("Index build"), ElapsedMs(start.QuadPart));
+
+            DWORD changes = 0;
+            auto countChanges = [&changes] (const TCHAR*, const TCHAR*, Registry::ChangeKind) -> bool
+            {
+                changes++;
+                return true;
+            };
+
+            if(before != nullptr && after != nullptr)
+            {
+                QueryPerformanceCounter(&start);
+                Registry::HashTree::Diff(*before, *after, countChanges);
+                _ftprintf(report, _T("%-36s %10.3f ms, %u changes\n"), _T("Diff, nothing changed"), ElapsedMs(start.QuadPart), changes);
+
+                // One large blob deep in the tree.
+                _stprintf_s(path, _T("%s\\Profile%03u\\App%05u"), ScratchKeyPath, 0, keyCount / profiles / 2);
+                Registry::Key* key = Registry::Key::Open(Registry::PredefinedKey::Current_User, path, Registry::AccessRights::Write);
+                if(key != nullptr)
+                {
+                    blob[largeSize / 2] ^= 0xFF;
+                    key->SetValue(_T("Data"), &blob[0], largeSize, Registry::DataType::Binary);
+                    key->Close();
+                }
+
+                changes = 0;
+                QueryPerformanceCounter(&start);
+                after->Refresh(*root, countChanges);
+                double refreshMs = ElapsedMs(start.QuadPart);
+
+                changes = 0;
+                QueryPerformanceCounter(&start);
+                Registry::HashTree::Diff(*before, *after, countChanges);
+                double diffMs = ElapsedMs(start.QuadPart);
+
+                _ftprintf(report, _T("%-36s %10.2f ms\n"), _T("Refresh after one blob change"), refreshMs);
+                _ftprintf(report, _T("%-36s %10.3f ms, %u changes\n"), _T("Diff, one blob changed"), diffMs, changes);
+            }
+
+            if(index != nullptr)
+            {
+                QueryPerformanceCounter(&start);
+                index->Update();
+                _ftprintf(report, _T("%-36s %10.2f ms, %u keys read again\n"), _T("Index update after one blob change"),
+                          ElapsedMs(start.QuadPart), index->GetRescannedKeys());
+
+                const DWORD threshold = keyCount / 2;
+
+                QueryPerformanceCounter(&start);
+                size_t found = index->FindKeys( _T("Setting"), [threshold] (const Registry::IndexValue& value) -> bool
+                    {
+                        DWORD setting;
+                        return value.GetDWORD(&setting) && setting > threshold;
+                    }
+                ).size();
+                _ftprintf(report, _T("%-36s %10.3f ms, %u keys\n"), _T("Index query, Setting > keys / 2"),
+                          ElapsedMs(start.QuadPart), (DWORD)found);
+
+                index->Close();
+            }
+
+            if(full != nullptr)
+                full->Close();
+            if(before != nullptr)
+                before->Close();
+            if(after != nullptr)
+                after->Close();
+        }
+
+        if(report != nullptr)
+            fclose(report);
+
+        if(root != nullptr)
+            root->Close();
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::NotifyLatency( _In_     DWORD           samples,
+                                          _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD burst       = 8;        // Writes done back to back, each one after the previous wake-up.
+        const DWORD bucketCount = 22;       // Powers of 2 from 1us to ~1s, as in the exported metrics.
+
+        Registry::NotifyOptions modes[4];
+        const TCHAR* modeNames[4] = { _T("Default"), _T("Highest"), _T("Pinned"), _T("Spin") };
+
+        modes[1].priority   = THREAD_PRIORITY_HIGHEST;
+        modes[2].priority   = THREAD_PRIORITY_HIGHEST;
+        modes[2].affinity   = 1;
+        modes[3].priority   = THREAD_PRIORITY_HIGHEST;
+        modes[3].spinMicros = 500;
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        // Background load: one busy thread per CPU, at normal priority.
+        volatile bool               loadShouldStop = false;
+        std::vector<std::thread*>   load;
+        for(unsigned i = 0; i < std::thread::hardware_concurrency(); i++)
+            load.push_back(new std::thread( [&loadShouldStop] ()
+                {
+                    while(!loadShouldStop)
+                        YieldProcessor();
+                }
+            ));
+
+        _ftprintf(report, _T("%u samples in bursts of %u, %u busy background threads.\n\n"), samples, burst, (DWORD)load.size());
+        _ftprintf(report, _T("%-10s %10s %10s %10s %10s %10s\n"),
+                  _T("Mode"), _T("Samples"), _T("Min us"), _T("P50 us"), _T("P99 us"), _T("Max us"));
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        LSTATUS status = ERROR_SUCCESS;
+        for(size_t m = 0; m < _countof(modes) && status == ERROR_SUCCESS; m++)
+        {
+            Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                        ScratchKeyPath,
+                                                        Registry::AccessRights::Read | Registry::AccessRights::Write,
+                                                        &status );
+            if(key == nullptr)
+                break;
+
+            Registry::Key* writer = Registry::Key::Open( Registry::PredefinedKey::Current_User,
+                                                         ScratchKeyPath,
+                                                         Registry::AccessRights::Set_Value,
+                                                         &status );
+            if(writer == nullptr)
+            {
+                key->Close();
+                break;
+            }
+
+            HANDLE                  woken    = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+            std::atomic<LONGLONG>   wakeTime(0);
+
+            status = key->AddNotify( [&] (Registry::Key &key, void *userData) -> bool
+                {
+                    UNREFERENCED_PARAMETER(key);
+                    UNREFERENCED_PARAMETER(userData);
+
+                    wakeTime = Registry::Metrics::Now();
+                    SetEvent(woken);
+
+                    return true;
+                },
+                Registry::NotifyEvents::Change_LastSet,
+                false,
+                nullptr,
+                modes[m]
+            );
+
+            std::vector<LONGLONG> latencies;
+            LONG64                buckets[bucketCount] = { 0 };
+
+            for(DWORD i = 0; i < samples && status == ERROR_SUCCESS; i++)
+            {
+                if(i % burst == 0)
+                    Sleep(20);
+
+                LONGLONG written = Registry::Metrics::Now();
+                writer->SetValueDWORD(_T("Sample"), i);
+
+                if(WaitForSingleObject(woken, 1000) != WAIT_OBJECT_0)
+                    continue;
+
+                LONGLONG micros = (wakeTime - written) * 1000000 / frequency.QuadPart;
+                latencies.push_back(micros);
+
+                DWORD bucket = 0;
+                while(bucket < bucketCount - 1 && micros > (1LL << bucket))
+                    bucket++;
+                buckets[bucket]++;
+            }
+
+            writer->Close();
+            key->Close();
+            CloseHandle(woken);
+
+            if(status != ERROR_SUCCESS || latencies.empty())
+                continue;
+
+            std::sort(latencies.begin(), latencies.end());
+            size_t count = latencies.size();
+
+            _ftprintf(report, _T("%-10s %10u %10lld %10lld %10lld %10lld\n"),
+                      modeNames[m], (DWORD)count, latencies[0], latencies[count / 2],
+                      latencies[count * 99 / 100], latencies[count - 1]);
+
+            _ftprintf(report, _T("%-10s"), _T(""));
+            for(DWORD b = 0; b < bucketCount; b++)
+            {
+                if(buckets[b] != 0)
+                    _ftprintf(report, _T(" <=%lldus:%lld"), 1LL << b, buckets[b]);
+            }
+            _ftprintf(report, _T("\n"));
+        }
+
+        loadShouldStop = true;
+        for(auto thread : load)
+        {
+            thread->join();
+            delete thread;
+        }
+
+        fclose(report);
+
+        Registry::Key::Delete(Registry::PredefinedKey::Current_User, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sorts the latencies, in microseconds, and writes their distribution on one report line.
+    static void ReportLatencies( _In_ FILE* report, _In_z_ const TCHAR* name, _Inout_ std::vector<LONGLONG>& latencies )
+    {
+        if(latencies.empty())
+        {
+            _ftprintf(report, _T("%-24s %10u\n"), name, 0);
+            return;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        size_t count = latencies.size();
+
+        _ftprintf(report, _T("%-24s %10u %10lld %10lld %10lld %10lld\n"),
+                  name, (DWORD)count, latencies[0], latencies[count / 2],
+                  latencies[count * 99 / 100], latencies[count - 1]);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::ControlLatency( _In_     DWORD           samples,
+                                           _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD batch = 16;
+
+        TCHAR pipeName[MAX_PATH];
+        _stprintf_s(pipeName, _T("\\\\.\\pipe\\3DVisionEyeSwapper.Bench.%u"), GetCurrentProcessId());
+
+        std::atomic<bool> state(false);
+
+        ControlServer server;
+        LSTATUS status = server.Start( pipeName,
+                                       [&state] () -> bool { return state; },
+                                       [&state] (bool value) { state = value; } );
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        _ftprintf(report, _T("%u round trips per test, batches of %u commands.\n\n"), samples, batch);
+        _ftprintf(report, _T("%-24s %10s %10s %10s %10s %10s\n"),
+                  _T("Test"), _T("Samples"), _T("Min us"), _T("P50 us"), _T("P99 us"), _T("Max us"));
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        std::vector<LONGLONG> latencies;
+        BYTE                  request[batch];
+        BYTE                  reply[ControlServer::MaxMessageSize];
+        DWORD                 replied;
+
+        // Wait for the server to be listening.
+        WaitNamedPipe(pipeName, 1000);
+
+        // A new connection for every call, as a script calling the tool would do.
+        request[0] = (BYTE)ControlOp::Get;
+        for(DWORD i = 0; i < samples; i++)
+        {
+            LONGLONG start = Registry::Metrics::Now();
+            if(ControlServer::Call(pipeName, request, 1, reply, sizeof(reply), &replied) == ERROR_SUCCESS)
+                latencies.push_back((Registry::Metrics::Now() - start) * 1000000 / frequency.QuadPart);
+            else
+                WaitNamedPipe(pipeName, 1000);
+        }
+        ReportLatencies(report, _T("Call, get"), latencies);
+
+        // One connection kept open, as a launcher would do.
+        HANDLE pipe = CreateFile(pipeName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if(pipe != INVALID_HANDLE_VALUE)
+        {
+            DWORD mode = PIPE_READMODE_MESSAGE;
+            SetNamedPipeHandleState(pipe, &mode, nullptr, nullptr);
+
+            const DWORD sizes[] = { 1, batch };
+
+            for(DWORD size : sizes)
+            {
+                for(DWORD i = 0; i < size; i++)
+                    request[i] = (BYTE)ControlOp::Toggle;
+
+                latencies.clear();
+                for(DWORD i = 0; i < samples; i++)
+                {
+                    LONGLONG start = Registry::Metrics::Now();
+                    if(TransactNamedPipe(pipe, request, size, reply, sizeof(reply), &replied, nullptr))
+                        latencies.push_back((Registry::Metrics::Now() - start) * 1000000 / frequency.QuadPart);
+                }
+
+                ReportLatencies(report, (size == 1) ? _T("Kept, toggle") : _T("Kept, batch of toggles"), latencies);
+            }
+
+            CloseHandle(pipe);
+        }
+        else
+            status = GetLastError();
+
+        fclose(report);
+        server.Stop();
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Reads every value of every key under key, the buffers coming from the allocator, or from new[]
+    /// without one. Returns the number of keys read.
+    static DWORD ScanTree( _In_ Registry::Key& key, _In_opt_ Registry::Allocator* allocator )
+    {
+        DWORD keys = 1;
+
+        key.EnumValues( [] (Registry::Value&) -> bool { return true; }, allocator );
+
+        void* data = nullptr;
+        if(key.GetValue(_T("Data"), &data, nullptr, nullptr, allocator) == ERROR_SUCCESS)
+        {
+            if(allocator != nullptr)
+                allocator->Deallocate(data);
+            else
+                delete [] (BYTE*)data;
+        }
+
+        key.EnumSubKeys( [&key, &keys, allocator] (Registry::Key& subKey) -> bool
+            {
+                Registry::Key* child = key.OpenSubKey(subKey.GetSubKeyPath(), Registry::AccessRights::Read, nullptr, allocator);
+                if(child != nullptr)
+                {
+                    keys += ScanTree(*child, allocator);
+                    child->Close();
+                }
+
+                return true;
+            },
+            allocator
+        );
+
+        return keys;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::AllocBenchmark( _In_     DWORD           keyCount,
+                                           _In_     DWORD           cycles,
+                                           _In_z_   const TCHAR*    reportFileName )
+    {
+        std::vector<BYTE> blob;
+
+        LSTATUS status = CreateSyntheticTree(keyCount, blob);
+
+        Registry::Key* root = nullptr;
+        if(status == ERROR_SUCCESS)
+            root = Registry::Key::Open(Registry::PredefinedKey::Current_User, ScratchKeyPath, Registry::AccessRights::Read, &status);
+
+        FILE* report = nullptr;
+        if(root != nullptr && (_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr))
+            status = ERROR_ACCESS_DENIED;
+
+        if(status == ERROR_SUCCESS)
+        {
+            // The arena takes its blocks from a heap allocator of its own, to count them apart.
+            Registry::HeapAllocator heap;
+            Registry::HeapAllocator arenaHeap;
+            Registry::Arena         arena(64 * 1024, &arenaHeap);
+
+            Registry::Allocator* const  allocators[] = { nullptr, &heap, &arena };
+            const TCHAR* const          names[]      = { _T("new[], no allocator"), _T("Heap allocator"), _T("Arena, reset per scan") };
+
+            _ftprintf(report, _T("%u keys, %u scans of the whole tree per test.\n\n"), keyCount, cycles);
+            _ftprintf(report, _T("%-24s %10s %14s %14s\n"), _T("Test"), _T("ms/scan"), _T("allocs/scan"), _T("heap/scan"));
+
+            DWORD keys = ScanTree(*root, nullptr);
+
+            for(size_t i = 0; i < _countof(allocators); i++)
+            {
+                Registry::Allocator* allocator = allocators[i];
+
+                LONG64 allocations     = (allocator != nullptr) ? allocator->GetAllocations() : 0;
+                LONG64 heapAllocations = arenaHeap.GetAllocations() + heap.GetAllocations();
+
+                LARGE_INTEGER start;
+                QueryPerformanceCounter(&start);
+
+                for(DWORD cycle = 0; cycle < cycles; cycle++)
+                {
+                    ScanTree(*root, allocator);
+                    arena.Reset();
+                }
+
+                double scanMs = ElapsedMs(start.QuadPart) / cycles;
+
+                // Without an allocator the new[] calls are not counted.
+                if(allocator == nullptr)
+                {
+                    _ftprintf(report, _T("%-24s %10.2f %14s %14s\n"), names[i], scanMs, _T("-"), _T("-"));
+                    continue;
+                }
+
+                allocations     = allocator->GetAllocations() - allocations;
+                heapAllocations = arenaHeap.GetAllocations() + heap.GetAllocations() - heapAllocations;
+
+                _ftprintf(report, _T("%-24s %10.2f %14.1f %14.1f\n"), names[i], scanMs,
+                          (double)allocations / cycles, (double)heapAllocations / cycles);
+            }
+
+            _ftprintf(report, _T("\n%u keys read per scan, the arena holds %u blocks of 64 KB.\n"), keys, arena.GetBlockCount());
+        }
+
+        if(report != nullptr)
+            fclose(report);
+
+        if(root != nullptr)
+            root->Close();
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::MultiValueBenchmark( _In_     DWORD           samples,
+                                                _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD counts[] = { 2, 16, 128 };
+        const DWORD maxCount = 128;
+
+        LSTATUS status = ERROR_SUCCESS;
+        Registry::Key* key = Registry::Key::Create(Registry::PredefinedKey::Current_User, ScratchKeyPath,
+                                                   Registry::AccessRights::All_Access, &status);
+        if(key == nullptr)
+            return status;
+
+        std::vector<std::basic_string<TCHAR>>  names(maxCount);
+        std::vector<Registry::ValueQuery>       queries(maxCount);
+
+        for(DWORD i = 0; i < maxCount && status == ERROR_SUCCESS; i++)
+        {
+            TCHAR name[32];
+            _stprintf_s(name, _T("Value%03u"), i);
+
+            names[i]        = name;
+            queries[i].name = names[i].c_str();
+            status          = key->SetValueDWORD(name, i);
+        }
+
+        FILE* report = nullptr;
+        if(status == ERROR_SUCCESS && (_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr))
+            status = ERROR_ACCESS_DENIED;
+
+        if(status == ERROR_SUCCESS)
+        {
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+
+            _ftprintf(report, _T("%u reads of DWORD values per test.\n\n"), samples);
+            _ftprintf(report, _T("%-24s %10s %10s %10s %10s %10s\n"),
+                      _T("Test"), _T("Samples"), _T("Min us"), _T("P50 us"), _T("P99 us"), _T("Max us"));
+
+            std::vector<LONGLONG> latencies;
+            TCHAR                 test[64];
+            double                batchCalls[_countof(counts)];
+
+            for(size_t c = 0; c < _countof(counts); c++)
+            {
+                DWORD count = counts[c];
+
+                // One call per value, as the code did so far.
+                latencies.clear();
+                for(DWORD i = 0; i < samples; i++)
+                {
+                    LONGLONG start = Registry::Metrics::Now();
+                    for(DWORD j = 0; j < count; j++)
+                    {
+                        DWORD value;
+                        key->GetValueDWORD(queries[j].name, &value);
+                    }
+                    latencies.push_back((Registry::Metrics::Now() - start) * 1000000 / frequency.QuadPart);
+                }
+
+                _stprintf_s(test, _T("One by one, %u values"), count);
+                ReportLatencies(report, test, latencies);
+
+                LONG64 batches   = Registry::Metrics::Get(Registry::Counter::ValueBatches);
+                LONG64 fallbacks = Registry::Metrics::Get(Registry::Counter::ValueBatchFallbacks);
+
+                latencies.clear();
+                for(DWORD i = 0; i < samples; i++)
+                {
+                    BYTE*    buffer = nullptr;
+                    LONGLONG start  = Registry::Metrics::Now();
+                    if(key->GetValues(&queries[0], count, &buffer) == ERROR_SUCCESS)
+                        latencies.push_back((Registry::Metrics::Now() - start) * 1000000 / frequency.QuadPart);
+
+                    delete [] buffer;
+                }
+
+                _stprintf_s(test, _T("Batched, %u values"), count);
+                ReportLatencies(report, test, latencies);
+
+                // Every fallback makes two calls per value.
+                batches   = Registry::Metrics::Get(Registry::Counter::ValueBatches) - batches;
+                fallbacks = Registry::Metrics::Get(Registry::Counter::ValueBatchFallbacks) - fallbacks;
+
+                batchCalls[c] = (double)(batches + fallbacks * 2 * count) / samples;
+            }
+
+            _ftprintf(report, _T("\n%-24s %10s %10s\n"), _T("Values"), _T("One by one"), _T("Batched"));
+            for(size_t c = 0; c < _countof(counts); c++)
+                _ftprintf(report, _T("%-24u %10u %10.2f\n"), counts[c], counts[c], batchCalls[c]);
+        }
+
+        if(report != nullptr)
+            fclose(report);
+
+        key->Close();
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::SweepBenchmark( _In_     DWORD           keyCount,
+                                           _In_     DWORD           sweeps,
+                                           _In_z_   const TCHAR*    reportFileName )
+    {
+        std::vector<BYTE> blob;
+
+        LSTATUS status = CreateSyntheticTree(keyCount, blob);
+
+        Registry::Key* root = nullptr;
+        if(status == ERROR_SUCCESS)
+            root = Registry::Key::Open(Registry::PredefinedKey::Current_User, ScratchKeyPath, Registry::AccessRights::Read, &status);
+
+        // Every key of the tree, kept open as a verification sweep would.
+        std::vector<Registry::Key*> keys;
+        if(root != nullptr)
+        {
+            keys.push_back(root);
+
+            for(size_t i = 0; i < keys.size(); i++)
+            {
+                Registry::Key* parent = keys[i];
+                parent->EnumSubKeys( [parent, &keys] (Registry::Key& subKey) -> bool
+                    {
+                        Registry::Key* key = parent->OpenSubKey(subKey.GetSubKeyPath(), Registry::AccessRights::Read);
+                        if(key != nullptr)
+                            keys.push_back(key);
+
+                        return true;
+                    }
+                );
+            }
+        }
+
+        FILE* report = nullptr;
+        if(root != nullptr && (_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr))
+            status = ERROR_ACCESS_DENIED;
+
+        if(status == ERROR_SUCCESS)
+        {
+            _ftprintf(report, _T("%u keys open, %u sweeps of all their values and subkeys per test.\n\n"), (DWORD)keys.size(), sweeps);
+            _ftprintf(report, _T("%-24s %10s %14s\n"), _T("Test"), _T("ms/sweep"), _T("cached/sweep"));
+
+            // Let the last write times settle, or the cache would not keep the first scans.
+            Sleep(100);
+
+            DWORD entries = 0;
+            auto  sweep   = [&keys, &entries] ()
+            {
+                for(Registry::Key* key : keys)
+                {
+                    key->EnumValues( [&entries] (Registry::Value&) -> bool { entries++; return true; } );
+                    key->EnumSubKeys( [&entries] (Registry::Key&) -> bool { entries++; return true; } );
+                }
+            };
+
+            for(int cached = 0; cached < 2; cached++)
+            {
+                for(Registry::Key* key : keys)
+                    key->EnableCache(cached != 0);
+
+                // The first sweep fills the cache.
+                sweep();
+
+                LONG64        hits = Registry::Metrics::Get(Registry::Counter::CachedScans);
+                LARGE_INTEGER start;
+                QueryPerformanceCounter(&start);
+
+                for(DWORD i = 0; i < sweeps; i++)
+                    sweep();
+
+                double sweepMs = ElapsedMs(start.QuadPart) / sweeps;
+                hits = Registry::Metrics::Get(Registry::Counter::CachedScans) - hits;
+
+                _ftprintf(report, _T("%-24s %10.3f %14.1f\n"), cached ? _T("Cached, idle") : _T("Walked"),
+                          sweepMs, (double)hits / sweeps);
+            }
+
+            _ftprintf(report, _T("\n%u entries seen in all.\n"), entries);
+        }
+
+        if(report != nullptr)
+            fclose(report);
+
+        for(Registry::Key* key : keys)
+            key->Close();
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::ApplyBenchmark( _In_     DWORD           keyCount,
+                                           _In_     DWORD           valuesPerKey,
+                                           _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD threadCounts[] = { 1, 2, 4, 8, 16 };
+
+        if(keyCount == 0 || valuesPerKey == 0)
+            return ERROR_INVALID_PARAMETER;
+
+        DWORD count = keyCount * valuesPerKey;
+
+        std::vector<std::basic_string<TCHAR>>  paths(keyCount);
+        std::vector<std::basic_string<TCHAR>>  names(valuesPerKey);
+        std::vector<Registry::ApplyOperation>   operations(count);
+
+        for(DWORD i = 0; i < keyCount; i++)
+        {
+            TCHAR path[MAX_PATH];
+            _stprintf_s(path, _T("%s\\Apply\\Key%05u"), ScratchKeyPath, i);
+            paths[i] = path;
+        }
+
+        for(DWORD j = 0; j < valuesPerKey; j++)
+        {
+            TCHAR name[32];
+            _stprintf_s(name, _T("Value%03u"), j);
+            names[j] = name;
+        }
+
+        // Interleaved over the keys, as a configuration listed by setting would be.
+        for(DWORD i = 0; i < count; i++)
+        {
+            Registry::ApplyOperation& operation = operations[i];
+            operation.mainKey   = Registry::PredefinedKey::Current_User;
+            operation.keyPath   = paths[i % keyCount].c_str();
+            operation.valueName = names[i / keyCount].c_str();
+            operation.type      = Registry::DataType::DWord;
+            operation.data      = &threadCounts[i % _countof(threadCounts)];
+            operation.dataSize  = sizeof(DWORD);
+            operation.status    = ERROR_SUCCESS;
+        }
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        _ftprintf(report, _T("%u keys, %u DWORD values per key, the keys created by every run.\n\n"), keyCount, valuesPerKey);
+        _ftprintf(report, _T("%-24s %10s %12s %10s\n"), _T("Test"), _T("ms"), _T("values/s"), _T("speed-up"));
+
+        LSTATUS       status = ERROR_SUCCESS;
+        LARGE_INTEGER start;
+
+        // One open, write and close per value, as done so far.
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+        QueryPerformanceCounter(&start);
+
+        for(DWORD i = 0; i < count && status == ERROR_SUCCESS; i++)
+        {
+            const Registry::ApplyOperation& operation = operations[i];
+
+            Registry::Key* key = Registry::Key::Create(operation.mainKey, operation.keyPath, Registry::AccessRights::Write, &status);
+            if(key == nullptr)
+                break;
+
+            status = key->SetValue(operation.valueName, operation.data, operation.dataSize, operation.type);
+            key->Close();
+        }
+
+        double serialMs = ElapsedMs(start.QuadPart);
+        _ftprintf(report, _T("%-24s %10.2f %12.0f %10s\n"), _T("One by one"), serialMs, count / (serialMs / 1000.0), _T("-"));
+
+        double oneThreadMs = 0;
+        for(size_t t = 0; t < _countof(threadCounts) && status == ERROR_SUCCESS; t++)
+        {
+            Registry::BulkApplier applier(threadCounts[t]);
+
+            RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+            QueryPerformanceCounter(&start);
+
+            status = applier.Apply(&operations[0], count);
+
+            double applyMs = ElapsedMs(start.QuadPart);
+            if(t == 0)
+                oneThreadMs = applyMs;
+
+            TCHAR test[64];
+            _stprintf_s(test, _T("Bulk, %u threads"), threadCounts[t]);
+            _ftprintf(report, _T("%-24s %10.2f %12.0f %10.2f\n"), test, applyMs, count / (applyMs / 1000.0), oneThreadMs / applyMs);
+        }
+
+        fclose(report);
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// A 1080p interleaved frame of noise, the background 12 pixels behind the screen and a box in
+    /// the middle 6 pixels in front of it, the even rows for the left eye.
+    static void CreateStereoFrame( _Out_ StereoFrame* frame )
+    {
+        const DWORD width  = 1920;
+        const DWORD height = 1080;
+
+        frame->width  = width;
+        frame->height = height;
+        frame->luma.resize(width * height);
+
+        std::vector<BYTE> texture(width);
+        DWORD             seed = 1;
+
+        for(DWORD row = 0; row < height; row += 2)
+        {
+            // Smoothed noise, so the blocks have texture but not a single exact match.
+            for(DWORD x = 0; x < width; x++)
+            {
+                seed       = seed * 1103515245 + 12345;
+                texture[x] = (BYTE)(seed >> 16);
+            }
+            for(DWORD x = 1; x < width; x++)
+                texture[x] = (BYTE)((texture[x - 1] + texture[x]) / 2);
+
+            bool inBox     = row > height / 3 && row < height * 2 / 3;
+            BYTE* left     = &frame->luma[row * width];
+            BYTE* right    = &frame->luma[(row + 1) * width];
+
+            for(DWORD x = 0; x < width; x++)
+            {
+                int disparity = (inBox && x > width / 3 && x < width * 2 / 3) ? -6 : 12;
+                int source    = (int)x - disparity;
+
+                left[x]  = texture[x];
+                right[x] = (source >= 0 && source < (int)width) ? texture[source] : 0;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::StereoBenchmark( _In_     DWORD           frames,
+                                            _In_z_   const TCHAR*    reportFileName )
+    {
+        StereoFrame frame;
+        CreateStereoFrame(&frame);
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        _ftprintf(report, _T("%u analyses of a %ux%u frame per test.\n\n"), frames, frame.width, frame.height);
+        _ftprintf(report, _T("%-24s %10s %10s %10s %10s %10s\n"),
+                  _T("Test"), _T("Samples"), _T("Min us"), _T("P50 us"), _T("P99 us"), _T("Max us"));
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        static const TCHAR* const parallaxNames[] = { _T("unknown"), _T("normal"), _T("inverted") };
+
+        std::vector<LONGLONG> latencies;
+        StereoResult          results[2];
+
+        for(int swapped = 0; swapped < 2; swapped++)
+        {
+            DWORD pattern = Enforcer::GetPattern(swapped != 0);
+
+            latencies.clear();
+            for(DWORD i = 0; i < frames; i++)
+            {
+                LONGLONG start   = Registry::Metrics::Now();
+                results[swapped] = StereoAnalyzer::Analyze(frame, pattern, pattern);
+                latencies.push_back((Registry::Metrics::Now() - start) * 1000000 / frequency.QuadPart);
+            }
+
+            ReportLatencies(report, swapped ? _T("Swapped pattern") : _T("Right pattern"), latencies);
+        }
+
+        _ftprintf(report, _T("\n"));
+        for(int swapped = 0; swapped < 2; swapped++)
+        {
+            const StereoResult& result = results[swapped];
+
+            _ftprintf(report, _T("%-24s %s, median disparity %d, %u blocks, %u behind, %u in front\n"),
+                      swapped ? _T("Swapped pattern") : _T("Right pattern"),
+                      parallaxNames[(int)result.parallax], result.medianDisparity,
+                      result.blocks, result.behind, result.front);
+        }
+
+        fclose(report);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The pictures of the two eyes of a 4K frame, with the same depth as CreateStereoFrame. The
+    /// texture changes every second row, so the rows kept from each eye can be matched.
+    static void CreateStereoPair( _Out_ StereoImage* left, _Out_ StereoImage* right )
+    {
+        const DWORD width  = 3840;
+        const DWORD height = 2160;
+
+        left->width   = width;
+        left->height  = height;
+        left->pixels.resize(width * height);
+
+        right->width  = width;
+        right->height = height;
+        right->pixels.resize(width * height);
+
+        std::vector<BYTE> texture(width);
+        DWORD             seed = 1;
+
+        for(DWORD row = 0; row < height; row++)
+        {
+            if((row & 1) == 0)
+            {
+                for(DWORD x = 0; x < width; x++)
+                {
+                    seed       = seed * 1103515245 + 12345;
+                    texture[x] = (BYTE)(seed >> 16);
+                }
+                for(DWORD x = 1; x < width; x++)
+                    texture[x] = (BYTE)((texture[x - 1] + texture[x]) / 2);
+            }
+
+            bool   inBox     = row > height / 3 && row < height * 2 / 3;
+            DWORD* leftRow   = &left->pixels[row * width];
+            DWORD* rightRow  = &right->pixels[row * width];
+
+            for(DWORD x = 0; x < width; x++)
+            {
+                int  disparity = (inBox && x > width / 3 && x < width * 2 / 3) ? -6 : 12;
+                int  source    = (int)x - disparity;
+                BYTE value     = (source >= 0 && source < (int)width) ? texture[source] : 0;
+
+                leftRow[x]  = 0xFF000000 | (texture[x] * 0x010101);
+                rightRow[x] = 0xFF000000 | (value * 0x010101);
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::ComposeBenchmark( _In_     DWORD           frames,
+                                             _In_z_   const TCHAR*    reportFileName )
+    {
+        StereoImage left;
+        StereoImage right;
+        CreateStereoPair(&left, &right);
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        _ftprintf(report, _T("%u compositions of a %ux%u frame per test.\n\n"), frames, left.width, left.height);
+        _ftprintf(report, _T("%-24s %10s %10s %10s %10s %10s\n"),
+                  _T("Test"), _T("Samples"), _T("Min us"), _T("P50 us"), _T("P99 us"), _T("Max us"));
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        static const ComposeKernel      kernels[]       = { ComposeKernel::Scalar, ComposeKernel::SSE2, ComposeKernel::AVX2 };
+        static const TCHAR* const       kernelNames[]   = { _T("Scalar"), _T("SSE2"), _T("AVX2") };
+        static const DWORD              threadCounts[]  = { 1, 2, 4, 8, 16 };
+
+        DWORD                   pattern = Enforcer::GetPattern(false);
+        StereoImage             reference;
+        StereoImage             output;
+        std::vector<LONGLONG>   latencies;
+        LSTATUS                 status  = ERROR_SUCCESS;
+
+        // Every kernel on one thread, then the fastest one on more threads.
+        for(DWORD k = 0; k < _countof(kernels) && status == ERROR_SUCCESS; k++)
+        {
+            if(!StereoCompositor::IsSupported(kernels[k]))
+            {
+                _ftprintf(report, _T("%-24s not supported\n"), kernelNames[k]);
+                continue;
+            }
+
+            StereoCompositor compositor(1);
+
+            latencies.clear();
+            for(DWORD i = 0; i < frames && status == ERROR_SUCCESS; i++)
+            {
+                LONGLONG start = Registry::Metrics::Now();
+                status = compositor.Compose(left, right, pattern, pattern, &output, kernels[k]);
+                latencies.push_back((Registry::Metrics::Now() - start) * 1000000 / frequency.QuadPart);
+            }
+
+            TCHAR test[64];
+            _stprintf_s(test, _T("%s, 1 thread"), kernelNames[k]);
+            ReportLatencies(report, test, latencies);
+
+            // The kernels must give the same bytes.
+            if(k == 0)
+                reference.pixels.swap(output.pixels);
+            else if(output.pixels != reference.pixels)
+                _ftprintf(report, _T("%-24s differs from Scalar\n"), kernelNames[k]);
+        }
+
+        for(DWORD t = 1; t < _countof(threadCounts) && status == ERROR_SUCCESS; t++)
+        {
+            StereoCompositor compositor(threadCounts[t]);
+
+            latencies.clear();
+            for(DWORD i = 0; i < frames && status == ERROR_SUCCESS; i++)
+            {
+                LONGLONG start = Registry::Metrics::Now();
+                status = compositor.Compose(left, right, pattern, pattern, &output);
+                latencies.push_back((Registry::Metrics::Now() - start) * 1000000 / frequency.QuadPart);
+            }
+
+            TCHAR test[64];
+            _stprintf_s(test, _T("Auto, %u threads"), threadCounts[t]);
+            ReportLatencies(report, test, latencies);
+        }
+
+        // Composing with the right and the swapped pattern, and reading the result as the right
+        // pattern, must give the normal and the inverted depth.
+        static const TCHAR* const parallaxNames[] = { _T("unknown"), _T("normal"), _T("inverted") };
+
+        _ftprintf(report, _T("\n"));
+        for(int swapped = 0; swapped < 2 && status == ERROR_SUCCESS; swapped++)
+        {
+            StereoCompositor compositor;
+            DWORD            composed = Enforcer::GetPattern(swapped != 0);
+
+            status = compositor.Compose(left, right, composed, composed, &output);
+            if(status != ERROR_SUCCESS)
+                break;
+
+            StereoFrame frame;
+            frame.width  = output.width;
+            frame.height = output.height;
+            frame.luma.resize(output.pixels.size());
+
+            // Every channel holds the same value.
+            for(size_t i = 0; i < output.pixels.size(); i++)
+                frame.luma[i] = (BYTE)output.pixels[i];
+
+            StereoResult result   = StereoAnalyzer::Analyze(frame, pattern, pattern);
+            Parallax     expected = swapped ? Parallax::Inverted : Parallax::Normal;
+
+            _ftprintf(report, _T("%-24s %s, median disparity %d, %u blocks (%s)\n"),
+                      swapped ? _T("Swapped pattern") : _T("Right pattern"),
+                      parallaxNames[(int)result.parallax], result.medianDisparity, result.blocks,
+                      (result.parallax == expected) ? _T("ok") : _T("WRONG"));
+        }
+
+        fclose(report);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::AttachLatency( _In_     DWORD           samples,
+                                          _In_z_   const TCHAR*    reportFileName )
+    {
+        const TCHAR* const levels[] = { _T("NVIDIA Corporation"), _T("Global"), _T("Stereo3D") };
+        const TCHAR* const testNames[] = { _T("Whole path"), _T("Level by level"), _T("Last level") };
+
+        TCHAR paths[_countof(levels)][MAX_PATH];
+        _stprintf_s(paths[0], _T("%s\\%s"), ScratchKeyPath, levels[0]);
+        for(size_t l = 1; l < _countof(levels); l++)
+            _stprintf_s(paths[l], _T("%s\\%s"), paths[l - 1], levels[l]);
+
+        const TCHAR* target = paths[_countof(levels) - 1];
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        _ftprintf(report, _T("%u samples per test, waiting for HKCU\\%s.\n\n"), samples, target);
+        _ftprintf(report, _T("%-24s %10s %10s %10s %10s %10s\n"),
+                  _T("Test"), _T("Samples"), _T("Min us"), _T("P50 us"), _T("P99 us"), _T("Max us"));
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        HANDLE                  created = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        std::atomic<LONGLONG>   createdTime(0);
+        Registry::KeyWaiter     waiter;
+
+        LSTATUS status = ERROR_SUCCESS;
+        for(size_t t = 0; t < _countof(testNames) && status == ERROR_SUCCESS; t++)
+        {
+            std::vector<LONGLONG> latencies;
+            LONG64 wakeups = Registry::Metrics::Get(Registry::Counter::KeyWaitWakeups);
+
+            for(DWORD i = 0; i < samples && status == ERROR_SUCCESS; i++)
+            {
+                RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+                // Only the last level is missing: the waiter watches its parent from the start.
+                if(t == 2)
+                {
+                    Registry::Key* parent = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                                   paths[_countof(levels) - 2],
+                                                                   Registry::AccessRights::Read,
+                                                                   &status );
+                    if(parent == nullptr)
+                        break;
+
+                    parent->Close();
+                }
+
+                status = waiter.Start( Registry::PredefinedKey::Current_User,
+                                       target,
+                                       [&createdTime, created] ()
+                                       {
+                                           createdTime = Registry::Metrics::Now();
+                                           SetEvent(created);
+                                       }
+                );
+
+                // Let the waiter settle on the nearest ancestor.
+                Sleep(5);
+
+                size_t   first   = (t == 1) ? 0 : _countof(levels) - 1;
+                LONGLONG written = 0;
+                for(size_t l = first; l < _countof(levels) && status == ERROR_SUCCESS; l++)
+                {
+                    written = Registry::Metrics::Now();
+
+                    Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                                paths[l],
+                                                                Registry::AccessRights::Read,
+                                                                &status );
+                    if(key != nullptr)
+                        key->Close();
+
+                    // The waiter walks down between the levels.
+                    if(l + 1 < _countof(levels))
+                        Sleep(1);
+                }
+
+                if(status == ERROR_SUCCESS && WaitForSingleObject(created, 1000) == WAIT_OBJECT_0)
+                    latencies.push_back((createdTime - written) * 1000000 / frequency.QuadPart);
+
+                waiter.Stop();
+            }
+
+            wakeups = Registry::Metrics::Get(Registry::Counter::KeyWaitWakeups) - wakeups;
+
+            ReportLatencies(report, testNames[t], latencies);
+            _ftprintf(report, _T("%-24s %10lld wake-ups\n"), _T(""), wakeups);
+        }
+
+        // While the key is missing, values written in the watched ancestor must not wake the waiter.
+        if(status == ERROR_SUCCESS)
+        {
+            RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+            Registry::Key* writer = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                           ScratchKeyPath,
+                                                           Registry::AccessRights::Read | Registry::AccessRights::Write,
+                                                           &status );
+            if(writer != nullptr)
+            {
+                waiter.Start(Registry::PredefinedKey::Current_User, target, [] () {});
+                Sleep(5);
+
+                LONG64 wakeups = Registry::Metrics::Get(Registry::Counter::KeyWaitWakeups);
+                for(DWORD i = 0; i < samples; i++)
+                    writer->SetValueDWORD(_T("Sample"), i);
+                Sleep(100);
+                wakeups = Registry::Metrics::Get(Registry::Counter::KeyWaitWakeups) - wakeups;
+
+                waiter.Stop();
+                writer->Close();
+
+                _ftprintf(report, _T("\n%u value writes in the watched ancestor woke the waiter %lld times.\n"), samples, wakeups);
+            }
+        }
+
+        CloseHandle(created);
+        fclose(report);
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::ReopenBenchmark( _In_     DWORD           milliseconds,
+                                            _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD         threadCounts[]  = { 1, 2, 4, 8 };
+        const DWORD         sampleEvery     = 16;   // Reads timed one in so many, to keep the clock out of the rate.
+        const TCHAR* const  modeNames[]     = { _T("Epoch, read"), _T("Mutex, read"), _T("Epoch, handle"), _T("Mutex, handle") };
+
+        LSTATUS status = ERROR_SUCCESS;
+
+        Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                    ScratchKeyPath,
+                                                    Registry::AccessRights::Read | Registry::AccessRights::Write,
+                                                    &status );
+        if(key == nullptr)
+            return status;
+
+        key->SetValueDWORD(_T("Sample"), 1);
+
+        // The handle behind a mutex, as the simple fix would have it.
+        std::mutex  lock;
+        HKEY        lockedKey = nullptr;
+        status = RegOpenKeyEx(HKEY_CURRENT_USER, ScratchKeyPath, 0, KEY_READ, &lockedKey);
+        if(status != ERROR_SUCCESS)
+        {
+            key->Close();
+            return status;
+        }
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+        {
+            RegCloseKey(lockedKey);
+            key->Close();
+            return ERROR_ACCESS_DENIED;
+        }
+
+        _ftprintf(report, _T("%u ms per run, the handle reopened every millisecond, one read in %u timed.\n\n"), milliseconds, sampleEvery);
+        _ftprintf(report, _T("%-16s %8s %12s %10s %10s %10s %8s\n"),
+                  _T("Test"), _T("Threads"), _T("Reads/s"), _T("P50 ns"), _T("P99 ns"), _T("Max ns"), _T("Reopens"));
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        for(DWORD mode = 0; mode < _countof(modeNames); mode++)
+        {
+            bool useEpoch = (mode % 2) == 0;
+            bool readKey  = mode < 2;
+
+            for(DWORD threads : threadCounts)
+            {
+                volatile bool                       shouldStop = false;
+                std::atomic<LONG64>                 reads(0);
+                std::vector<std::vector<LONGLONG>>  samples(threads);
+                std::vector<std::thread*>           readers;
+
+                for(DWORD t = 0; t < threads; t++)
+                {
+                    std::vector<LONGLONG>* timings = &samples[t];
+
+                    readers.push_back(new std::thread( [&, timings] ()
+                        {
+                            volatile HKEY   sink;
+                            DWORD           value;
+                            DWORD           size;
+                            LONG64          count = 0;
+
+                            while(!shouldStop)
+                            {
+                                LONGLONG start = (count % sampleEvery == 0) ? Registry::Metrics::Now() : 0;
+
+                                if(useEpoch)
+                                {
+                                    Registry::Epoch::Reader handle(Registry::Key::GetHandleEpoch());
+
+                                    size = sizeof(value);
+                                    if(readKey)
+                                        RegGetValue(key->GetHKEY(), nullptr, _T("Sample"), RRF_RT_DWORD, nullptr, &value, &size);
+                                    else
+                                        sink = key->GetHKEY();
+                                }
+                                else
+                                {
+                                    std::lock_guard<std::mutex> guard(lock);
+
+                                    size = sizeof(value);
+                                    if(readKey)
+                                        RegGetValue(lockedKey, nullptr, _T("Sample"), RRF_RT_DWORD, nullptr, &value, &size);
+                                    else
+                                        sink = lockedKey;
+                                }
+
+                                if(start != 0)
+                                    timings->push_back((Registry::Metrics::Now() - start) * 1000000000 / frequency.QuadPart);
+
+                                count++;
+                            }
+
+                            reads += count;
+                        }
+                    ));
+                }
+
+                // The writer: a reopen every millisecond for the length of the run.
+                DWORD       reopens = 0;
+                ULONGLONG   end     = GetTickCount64() + milliseconds;
+                while(GetTickCount64() < end)
+                {
+                    Sleep(1);
+
+                    if(useEpoch)
+                    {
+                        if(key->Reopen() == ERROR_SUCCESS)
+                            reopens++;
+                        continue;
+                    }
+
+                    HKEY hKey = nullptr;
+                    if(RegOpenKeyEx(HKEY_CURRENT_USER, ScratchKeyPath, 0, KEY_READ, &hKey) != ERROR_SUCCESS)
+                        continue;
+
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        std::swap(hKey, lockedKey);
+                    }
+
+                    // No reader can hold the previous handle once the lock was taken.
+                    RegCloseKey(hKey);
+                    reopens++;
+                }
+
+                shouldStop = true;
+                for(auto thread : readers)
+                {
+                    thread->join();
+                    delete thread;
+                }
+
+                std::vector<LONGLONG> latencies;
+                for(auto& timings : samples)
+                    latencies.insert(latencies.end(), timings.begin(), timings.end());
+
+                if(latencies.empty())
+                    continue;
+
+                std::sort(latencies.begin(), latencies.end());
+                size_t count = latencies.size();
+
+                _ftprintf(report, _T("%-16s %8u %12.0f %10lld %10lld %10lld %8u\n"),
+                          modeNames[mode], threads, reads * 1000.0 / milliseconds,
+                          latencies[count / 2], latencies[count * 99 / 100], latencies[count - 1], reopens);
+            }
+        }
+
+        fclose(report);
+
+        RegCloseKey(lockedKey);
+        key->Close();
+
+        Registry::Key::Delete(Registry::PredefinedKey::Current_User, ScratchKeyPath);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::TimerBenchmark( _In_     DWORD           timerCount,
+                                           _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD wheelCounts[]   = { 1000, 10000, 100000 };
+        const DWORD keyCount        = 50;
+        const DWORD periodMs        = 1000;
+        const DWORD runMs           = 5000;
+        const DWORD pinnedValue     = 0xFF00FF00;
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        // The wheel alone: the cost of an operation must not grow with the number of timers.
+        _ftprintf(report, _T("Timer wheel, delays up to 10 minutes in ticks of 10 ms:\n"));
+        _ftprintf(report, _T("%10s %12s %12s %12s\n"), _T("Timers"), _T("Insert ns"), _T("Cancel ns"), _T("Expire ns"));
+
+        for(DWORD count : wheelCounts)
+        {
+            Registry::TimerWheel                wheel;
+            std::vector<Registry::TimerNode>    nodes(count);
+            std::vector<Registry::TimerNode*>   due;
+            ULONGLONG                           seed = 1;
+
+            LONGLONG start = Registry::Metrics::Now();
+            for(DWORD i = 0; i < count; i++)
+            {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                wheel.Insert(&nodes[i], 1 + (seed >> 33) % 60000);
+            }
+            LONGLONG inserted = Registry::Metrics::Now();
+
+            for(DWORD i = 0; i < count; i += 2)
+                wheel.Remove(&nodes[i]);
+            LONGLONG cancelled = Registry::Metrics::Now();
+
+            wheel.Advance(60000, due);
+            LONGLONG expired = Registry::Metrics::Now();
+
+            _ftprintf(report, _T("%10u %12.1f %12.1f %12.1f\n"), count,
+                      (inserted - start) * 1e9 / frequency.QuadPart / count,
+                      (cancelled - inserted) * 1e9 / frequency.QuadPart / ((count + 1) / 2),
+                      (expired - cancelled) * 1e9 / frequency.QuadPart / (due.empty() ? 1 : due.size()));
+        }
+
+        // The scheduler on scratch keys: the values of a key are read with one call per tick.
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        std::vector<Registry::Key*> keys;
+        std::vector<std::basic_string<TCHAR>> paths;
+        LSTATUS status = ERROR_SUCCESS;
+
+        for(DWORD k = 0; k < keyCount && status == ERROR_SUCCESS; k++)
+        {
+            TCHAR path[MAX_PATH];
+            _stprintf_s(path, _T("%s\\Pins%02u"), ScratchKeyPath, k);
+            paths.push_back(path);
+
+            Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                        path,
+                                                        Registry::AccessRights::Read | Registry::AccessRights::Write,
+                                                        &status );
+            if(key != nullptr)
+                keys.push_back(key);
+        }
+
+        Registry::Scheduler scheduler(10);
+        std::vector<std::basic_string<TCHAR>> names;
+
+        for(DWORD i = 0; i < timerCount && status == ERROR_SUCCESS; i++)
+        {
+            TCHAR name[32];
+            _stprintf_s(name, _T("Value%05u"), i / keyCount);
+
+            keys[i % keyCount]->SetValueDWORD(name, pinnedValue);
+            scheduler.Pin(Registry::PredefinedKey::Current_User, paths[i % keyCount].c_str(), name, pinnedValue, periodMs);
+        }
+
+        if(status == ERROR_SUCCESS)
+        {
+            LONG64 batchesBefore = Registry::Metrics::Get(Registry::Counter::ValueBatches);
+            LONG64 tampered      = 0;
+
+            scheduler.Start();
+
+            // Another process changing a value now and then, as the service does.
+            ULONGLONG end  = GetTickCount64() + runMs;
+            ULONGLONG seed = 7;
+            while(GetTickCount64() < end)
+            {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                DWORD i = (DWORD)((seed >> 33) % timerCount);
+
+                TCHAR name[32];
+                _stprintf_s(name, _T("Value%05u"), i / keyCount);
+                keys[i % keyCount]->SetValueDWORD(name, 0x00FF00FF);
+                tampered++;
+
+                Sleep(10);
+            }
+
+            scheduler.Stop();
+
+            Registry::SchedulerStats stats = scheduler.GetStats();
+            LONG64 batches = Registry::Metrics::Get(Registry::Counter::ValueBatches) - batchesBefore;
+
+            _ftprintf(report, _T("\n%u values pinned on %u keys, checked every %u ms for %u ms, %lld changed meanwhile:\n"),
+                      timerCount, keyCount, periodMs, runMs, tampered);
+            _ftprintf(report, _T("    ticks with work      %lld\n"), stats.ticks);
+            _ftprintf(report, _T("    timers run           %lld\n"), stats.timersRun);
+            _ftprintf(report, _T("    values checked       %lld\n"), stats.valuesChecked);
+            _ftprintf(report, _T("    key batches          %lld\n"), stats.keyBatches);
+            _ftprintf(report, _T("    batched reads        %lld\n"), batches);
+            _ftprintf(report, _T("    values rewritten     %lld\n"), stats.valuesRewritten);
+            _ftprintf(report, _T("    retries              %lld\n"), stats.retries);
+            _ftprintf(report, _T("    mean lateness        %.2f ticks\n"),
+                      stats.timersRun != 0 ? (double)stats.lateTicks / stats.timersRun : 0.0);
+        }
+
+        // The cancellation of every pin, with the scheduler idle.
+        LONGLONG start = Registry::Metrics::Now();
+        for(Registry::TimerId id = 1; id <= timerCount; id++)
+            scheduler.Cancel(id);
+        LONGLONG cancelled = Registry::Metrics::Now();
+
+        _ftprintf(report, _T("    cancel               %.1f ns per timer, %u left\n"),
+                  (cancelled - start) * 1e9 / frequency.QuadPart / (timerCount != 0 ? timerCount : 1),
+                  (DWORD)scheduler.GetCount());
+
+        for(auto key : keys)
+            key->Close();
+
+        fclose(report);
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::FlushBenchmark( _In_     DWORD           threadCount,
+                                           _In_     DWORD           milliseconds,
+                                           _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD         valueCount  = 16;
+        const DWORD         windowMs    = 20;
+        const TCHAR* const  modeNames[] = { _T("Direct"), _T("Direct, flush"), _T("Queue, none"),
+                                            _T("Queue, on idle"), _T("Queue, per batch"), _T("Queue, per write") };
+        const Registry::Durability durabilities[] = { Registry::Durability::None, Registry::Durability::OnIdle,
+                                                      Registry::Durability::PerBatch, Registry::Durability::PerWrite };
+
+        LSTATUS status = ERROR_SUCCESS;
+
+        Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                    ScratchKeyPath,
+                                                    Registry::AccessRights::Read | Registry::AccessRights::Write,
+                                                    &status );
+        if(key == nullptr)
+            return status;
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+        {
+            key->Close();
+            return ERROR_ACCESS_DENIED;
+        }
+
+        _ftprintf(report, _T("%u threads writing %u values for %u ms, batches of %u ms.\n\n"), threadCount, valueCount, milliseconds, windowMs);
+        _ftprintf(report, _T("%-18s %12s %10s %10s %10s %10s %10s %10s\n"),
+                  _T("Mode"), _T("Writes/s"), _T("Queued"), _T("Merged"), _T("Made"), _T("Batches"), _T("Flushes"), _T("Merged"));
+
+        for(DWORD mode = 0; mode < _countof(modeNames) && status == ERROR_SUCCESS; mode++)
+        {
+            Registry::WriteBehind*  queue = nullptr;
+            std::atomic<LONG64>     writes(0);
+            std::atomic<LONG64>     flushes(0);
+            volatile bool           shouldStop = false;
+            std::vector<std::thread*> producers;
+
+            if(mode >= 2)
+                queue = new Registry::WriteBehind(key, windowMs, durabilities[mode - 2]);
+
+            LONGLONG start = Registry::Metrics::Now();
+
+            for(DWORD t = 0; t < threadCount; t++)
+            {
+                producers.push_back(new std::thread( [&, t] ()
+                    {
+                        ULONGLONG seed = t + 1;
+                        while(!shouldStop)
+                        {
+                            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+                            TCHAR name[16];
+                            _stprintf_s(name, _T("Value%02u"), (DWORD)((seed >> 33) % valueCount));
+
+                            if(queue != nullptr)
+                            {
+                                queue->WriteDWORD(name, (DWORD)(seed >> 32));
+                            }
+                            else
+                            {
+                                key->SetValueDWORD(name, (DWORD)(seed >> 32));
+
+                                if(mode == 1)
+                                {
+                                    key->Flush();
+                                    flushes++;
+                                }
+                            }
+
+                            writes++;
+                        }
+                    } ));
+            }
+
+            Sleep(milliseconds);
+            shouldStop = true;
+
+            for(auto producer : producers)
+            {
+                producer->join();
+                delete producer;
+            }
+
+            Registry::WriteBehindStats stats;
+            memset(&stats, 0, sizeof(stats));
+
+            if(queue != nullptr)
+            {
+                status = queue->Drain();
+                stats  = queue->GetStats();
+                delete queue;
+            }
+            else
+            {
+                stats.writesQueued  = writes;
+                stats.writesMade    = writes;
+                stats.batches       = writes;
+                stats.flushesAsked  = flushes;
+                stats.flushesMade   = flushes;
+            }
+
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            double seconds = (double)(Registry::Metrics::Now() - start) / frequency.QuadPart;
+
+            _ftprintf(report, _T("%-18s %12.0f %10lld %10lld %10lld %10lld %10lld %10lld\n"),
+                      modeNames[mode], writes / seconds, stats.writesQueued, stats.writesCoalesced, stats.writesMade,
+                      stats.batches, stats.flushesMade, stats.flushesAsked - stats.flushesMade);
+        }
+
+        fclose(report);
+
+        key->Close();
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::FilterBenchmark( _In_     DWORD           writeCount,
+                                            _In_z_   const TCHAR*    reportFileName )
+    {
+        const DWORD         valueCount      = 32;
+        const DWORD         watchedEvery    = 16;
+        const TCHAR* const  watchedNames[]  = { _T("InterleavePattern0"), _T("InterleavePattern1") };
+        const TCHAR* const  modeNames[]     = { _T("Every change"), _T("Filtered") };
+
+        LSTATUS status = ERROR_SUCCESS;
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        _ftprintf(report, _T("%u writes to %u values, one in %u to %s or %s, 1 ms apart.\n\n"),
+                  writeCount, valueCount, watchedEvery, watchedNames[0], watchedNames[1]);
+        _ftprintf(report, _T("%-14s %14s %10s %10s %16s\n"),
+                  _T("Subscriber"), _T("Notifications"), _T("Filtered"), _T("Callbacks"), _T("Watched writes"));
+
+        for(DWORD mode = 0; mode < _countof(modeNames) && status == ERROR_SUCCESS; mode++)
+        {
+            RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+            Registry::Key* key = Registry::Key::Create( Registry::PredefinedKey::Current_User,
+                                                        ScratchKeyPath,
+                                                        Registry::AccessRights::All_Access,
+                                                        &status );
+            if(key == nullptr)
+                break;
+
+            std::atomic<LONG64> callbacks(0);
+            auto callBack = [&callbacks] (Registry::Key &key, void *userData) -> bool
+                {
+                    UNREFERENCED_PARAMETER(key);
+                    UNREFERENCED_PARAMETER(userData);
+
+                    callbacks++;
+                    return true;
+                };
+
+            if(mode == 0)
+                status = key->AddNotify(callBack, Registry::NotifyEvents::Change_LastSet, false);
+            else
+                status = key->AddValueNotify(callBack, watchedNames, _countof(watchedNames));
+
+            LONG64 notifications = Registry::Metrics::Get(Registry::Counter::NotificationsReceived);
+            LONG64 filtered      = Registry::Metrics::Get(Registry::Counter::NotificationsFiltered);
+            DWORD  watchedWrites = 0;
+
+            for(DWORD i = 0; i < writeCount && status == ERROR_SUCCESS; i++)
+            {
+                TCHAR name[32];
+
+                // The watched values get a new value every time, as the service resetting them would.
+                if(i % watchedEvery == 0)
+                {
+                    _tcscpy_s(name, watchedNames[(i / watchedEvery) % 2]);
+                    watchedWrites++;
+                }
+                else
+                {
+                    _stprintf_s(name, _T("Setting%02u"), i % valueCount);
+                }
+
+                status = key->SetValueDWORD(name, i);
+                Sleep(1);
+            }
+
+            // The last notifications are still on their way.
+            Sleep(100);
+
+            notifications = Registry::Metrics::Get(Registry::Counter::NotificationsReceived) - notifications;
+            filtered      = Registry::Metrics::Get(Registry::Counter::NotificationsFiltered) - filtered;
+
+            key->Close();
+
+            _ftprintf(report, _T("%-14s %14lld %10lld %10lld %16u\n"),
+                      modeNames[mode], notifications, filtered, (LONG64)callbacks, watchedWrites);
+        }
+
+        fclose(report);
+
+        RegDeleteTree(HKEY_CURRENT_USER, ScratchKeyPath);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StressHarness::TraceBenchmark( _In_     DWORD           eventCount,
+                                           _In_z_   const TCHAR*    reportFileName )
+    {
+        const TCHAR* const modeNames[] = { _T("Disabled"), _T("Enabled, no value"), _T("Enabled, value") };
+
+        FILE* report = nullptr;
+        if(_tfopen_s(&report, reportFileName, _T("w, ccs=UTF-8")) != 0 || report == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        DWORD pathId = Registry::Trace::RegisterPath((int)Registry::PredefinedKey::Current_User, ScratchKeyPath);
+
+        // The first event of the thread takes its ring, which is not part of the cost of an event.
+        Registry::Trace::Record(Registry::TraceOp::None, pathId, nullptr, ERROR_SUCCESS);
+
+        _ftprintf(report, _T("%u events recorded on one thread.\n\n"), eventCount);
+        _ftprintf(report, _T("%-20s %12s\n"), _T("Trace"), _T("ns/event"));
+
+        for(DWORD mode = 0; mode < _countof(modeNames); mode++)
+        {
+            Registry::Trace::Enable(mode != 0);
+
+            const TCHAR* valueName = (mode == 2) ? _T("InterleavePattern0") : nullptr;
+
+            LONGLONG start = Registry::Metrics::Now();
+            for(DWORD i = 0; i < eventCount; i++)
+                Registry::Trace::Record(Registry::TraceOp::GetValue, pathId, valueName, ERROR_SUCCESS);
+            LONGLONG end = Registry::Metrics::Now();
+
+            _ftprintf(report, _T("%-20s %12.2f\n"), modeNames[mode], (end - start) * 1e9 / frequency.QuadPart / eventCount);
+        }
+
+        Registry::Trace::Enable(true);
+
+        fclose(report);
+        return ERROR_SUCCESS;
+    }
+}
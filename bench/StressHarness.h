@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        StressHarness.h
+///  Description: Simulates the 3D Vision service fighting the enforcer, and measures how often the
+///               driver would latch a wrong pattern.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_STRESSHARNESS_H
+#define INCLUDED_STRESSHARNESS_H
+
+#include <windows.h>
+#include <tchar.h>
+
+#include "./Enforcer.h"
+#include "./ChangeTrace.h"
+#include "./MemoryHive.h"
+#include "./HashTree.h"
+#include "./Index.h"
+#include "./ControlServer.h"
+#include "./BulkApply.h"
+#include "./StereoAnalyzer.h"
+#include "./StereoCompositor.h"
+#include "./KeyWaiter.h"
+#include "./WriteBehind.h"
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct StressOptions
+    {
+        DWORD       durationMs;         /// How long each strategy is stressed.
+        DWORD       adversaries;        /// Number of threads playing the 3D Vision service.
+        DWORD       writesPerSecond;    /// Pattern rewrites per second, per adversary.
+        DWORD       burst;              /// Rewrites done back to back before an adversary sleeps.
+        DWORD       frameRate;          /// How often the simulated driver samples the pattern.
+
+        StressOptions()
+        {
+            durationMs      = 10000;
+            adversaries     = 2;
+            writesPerSecond = 50;
+            burst           = 4;
+            frameRate       = 120;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct StressResult
+    {
+        Strategy            strategy;
+        unsigned long long  frames;
+        unsigned long long  wrongFrames;    /// Both values hold the pattern written by the adversaries.
+        unsigned long long  mixedFrames;    /// The two values disagree.
+        unsigned long long  adversaryWrites;
+        unsigned long long  enforcerWrites;
+        double              enforcerCpu;    /// Percent of one CPU used by the enforcer.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct ReplayResult
+    {
+        Strategy            strategy;
+        unsigned long long  records;
+        unsigned long long  breaks;         /// Replayed changes that left a wrong pattern in place.
+        unsigned long long  recovered;      /// Breaks repaired by the enforcer within the timeout.
+        unsigned long long  enforcerWrites;
+        unsigned long long  latencyMin;     /// Reaction latency of the enforcer, in microseconds.
+        unsigned long long  latencyAvg;
+        unsigned long long  latencyMax;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs the stress on a scratch key under HKCU, so the real Stereo3D key is never touched. The
+    /// enforcer runs with a scheduler, as in the tool.
+    class StressHarness
+    {
+    public:
+
+        static LSTATUS Run( _In_  const StressOptions&    options,
+                            _In_  Strategy                strategy,
+                            _Out_ StressResult*           result );
+
+        /// Runs every strategy and writes a text report.
+        static LSTATUS RunAll( _In_     const StressOptions&  options,
+                               _In_z_   const TCHAR*          reportFileName );
+
+        /// Replays a recorded change trace against the enforcer, on a key of a new MemoryHive, so the
+        /// registry of the machine is never touched and every replay starts from the same state.
+        /// speed scales the recorded time (2 is twice as fast); 0 replays as fast as possible, waiting
+        /// only for the enforcer to repair each break, so the outcome does not depend on the machine.
+        static LSTATUS Replay( _In_     const std::vector<Registry::ChangeRecord>&  records,
+                               _In_     Strategy                                    strategy,
+                               _In_     double                                      speed,
+                               _Out_    ReplayResult*                               result );
+
+        /// Replays a trace file with every strategy and writes a text report.
+        static LSTATUS ReplayAll( _In_z_   const TCHAR*    traceFileName,
+                                  _In_z_   const TCHAR*    reportFileName,
+                                  _In_     double          speed );
+
+        /// Builds a synthetic tree of keyCount keys with binary values, and compares a full read of it
+        /// with the hashed read and diff of HashTree, and with the updates and queries of an Index.
+        /// Writes a text report.
+        static LSTATUS HashBenchmark( _In_     DWORD           keyCount,
+                                      _In_z_   const TCHAR*    reportFileName );
+
+        /// Measures the time from a value write to the wake-up of the notify callback, for several
+        /// NotifyOptions, with every CPU kept busy by background threads. Writes a text report.
+        static LSTATUS NotifyLatency( _In_     DWORD           samples,
+                                      _In_z_   const TCHAR*    reportFileName );
+
+        /// Measures the round trip of the control pipe: one connection per call, a kept connection, and
+        /// batches of commands. The server runs in this process with an in-memory state. Writes a text report.
+        static LSTATUS ControlLatency( _In_     DWORD           samples,
+                                       _In_z_   const TCHAR*    reportFileName );
+
+        /// Scans the synthetic tree of HashBenchmark cycles times, with the buffers of the Registry
+        /// API coming from new[], from a heap allocator and from an arena reset after every scan.
+        /// Writes a text report with the time and the allocations of a scan.
+        static LSTATUS AllocBenchmark( _In_     DWORD           keyCount,
+                                       _In_     DWORD           cycles,
+                                       _In_z_   const TCHAR*    reportFileName );
+
+        /// Reads 2, 16 and 128 values of a scratch key one by one and with one GetValues call.
+        /// Writes a text report with the latencies and the registry calls of a read.
+        static LSTATUS MultiValueBenchmark( _In_     DWORD           samples,
+                                            _In_z_   const TCHAR*    reportFileName );
+
+        /// Opens every key of the synthetic tree of HashBenchmark and sweeps their values and subkeys,
+        /// walking them every time and with the key cache on while nothing changes. Writes a text
+        /// report with the time of a sweep.
+        static LSTATUS SweepBenchmark( _In_     DWORD           keyCount,
+                                       _In_     DWORD           sweeps,
+                                       _In_z_   const TCHAR*    reportFileName );
+
+        /// Writes valuesPerKey values in each of keyCount scratch keys, one open per value and with a
+        /// BulkApplier of 1 to 16 threads. Writes a text report with the throughput of every run.
+        static LSTATUS ApplyBenchmark( _In_     DWORD           keyCount,
+                                       _In_     DWORD           valuesPerKey,
+                                       _In_z_   const TCHAR*    reportFileName );
+
+        /// Analyzes a synthetic 1080p interleaved frame with the right and the swapped pattern.
+        /// Writes a text report with the time of an analysis and its results.
+        static LSTATUS StereoBenchmark( _In_     DWORD           frames,
+                                        _In_z_   const TCHAR*    reportFileName );
+
+        /// Composes a synthetic 4K frame with every kernel and with 1 to 16 threads, then checks the
+        /// frames composed with the right and the swapped pattern with StereoAnalyzer. Writes a text
+        /// report with the time of a composition and the results of the checks.
+        static LSTATUS ComposeBenchmark( _In_     DWORD           frames,
+                                         _In_z_   const TCHAR*    reportFileName );
+
+        /// Measures the time from the creation of a missing key to the callback of a KeyWaiter, with
+        /// the whole path created at once, level by level, and with only the last level missing. Also
+        /// counts the wake-ups of the waiter while values are written next to the path. Writes a text report.
+        static LSTATUS AttachLatency( _In_     DWORD           samples,
+                                      _In_z_   const TCHAR*    reportFileName );
+
+        /// Reads a scratch key on 1 to 8 threads while another thread reopens it every millisecond,
+        /// with the handle published through the epoch of Key::Reopen and behind a mutex, with and
+        /// without a registry read. Writes a text report with the read rate and latencies.
+        static LSTATUS ReopenBenchmark( _In_     DWORD           milliseconds,
+                                        _In_z_   const TCHAR*    reportFileName );
+
+        /// Times the insertion, cancellation and expiry of 1000 to 100000 timers in a TimerWheel, then
+        /// pins timerCount values spread over 50 scratch keys on a Scheduler for a few seconds, while
+        /// another thread changes some of them. Writes a text report with the cost of the operations
+        /// and the reads, rewrites and lateness of the checks.
+        static LSTATUS TimerBenchmark( _In_     DWORD           timerCount,
+                                       _In_z_   const TCHAR*    reportFileName );
+
+        /// Writes 16 values of a scratch key from threadCount threads for the given time, directly,
+        /// with a flush after every write, and through a WriteBehind queue with every durability.
+        /// Writes a text report with the write rate, and the writes and flushes made and coalesced.
+        static LSTATUS FlushBenchmark( _In_     DWORD           threadCount,
+                                       _In_     DWORD           milliseconds,
+                                       _In_z_   const TCHAR*    reportFileName );
+
+        /// Writes 32 values of a scratch key, one in 16 writes going to the two watched ones, and counts
+        /// the callbacks of a subscriber to every change and of one filtered to the watched values.
+        /// Writes a text report with the notifications received, filtered and passed.
+        static LSTATUS FilterBenchmark( _In_     DWORD           writeCount,
+                                        _In_z_   const TCHAR*    reportFileName );
+
+        /// Records eventCount trace events on one thread with the trace disabled and enabled, with and
+        /// without a value name. Writes a text report with the cost of an event.
+        static LSTATUS TraceBenchmark( _In_     DWORD           eventCount,
+                                       _In_z_   const TCHAR*    reportFileName );
+
+        static const TCHAR* const ScratchKeyPath;
+    };
+}
+
+#endif // INCLUDED_STRESSHARNESS_H
@@ -30,8 +30,20 @@ HINSTANCE       hInst;								    // current instance
 HWND            hWnd;                                   // the main window handle
 HICON           hIcon;
 Registry::Key*  regStereo3D     = nullptr;              // The registry used to control the eye swapper
+Enforcement::Enforcer* enforcer = nullptr;              // Keeps the eyes swapped while the 3D Vision service fights back
 volatile bool   eyesSwapped     = true;
+std::mutex      stateLock;                              // Held to change eyesSwapped or enforcer, or to use enforcer off the window thread
 volatile bool   trayInitialized = false;
+TCHAR           metricsTarget[MAX_PATH] = { 0 };        // File or named pipe where the metrics are exported
+Enforcement::WatchMode watchMode = Enforcement::WatchMode::Notify;
+Enforcement::ControlServer* control = nullptr;          // Lets scripts and launchers change the swap state
+TCHAR           controlPipe[MAX_PATH] = { 0 };          // Named pipe of the control server
+Enforcement::SharedState sharedState;                   // The swap state and counters seen by the other instances and tools
+Registry::UndoJournal journal;                          // The values of the 3D Vision service overwritten by the tool
+Registry::KeyWaiter keyWaiter;                          // Waits for the Stereo3D key when 3D Vision is not installed yet
+DWORD           attachRetryMs   = 0;                    // Delay before the next try to attach a key that exists, 0 when none failed
+BOOL            attachJournalStarted = FALSE;           // Whether the journal started, for the next try to attach
+Registry::Scheduler scheduler;                          // Runs the delayed re-enforcements and the periodic checks
 
 static const TCHAR* szTitle             = _T("3DVisionEyeSwapper");				// The title bar text
 static const TCHAR* szWindowClass       = _T("C3DVISIONEYESWAPPER");			// the main window class name
@@ -41,13 +53,24 @@ static const TCHAR* keyStereo3D_x86_32  = _T("SOFTWARE\\NVIDIA Corporation\\Glob
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Forward declarations:
 BOOL                InitWindows(HINSTANCE hInstance, int nCmdShow);
+BOOL                RunCommand(int argc, LPWSTR *argv, int *exitCode);
+void                ReadOptions(int argc, LPWSTR *argv);
+void                StartMetrics();
+void                StartControl();
 LRESULT CALLBACK	WndProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK	About(HWND, UINT, WPARAM, LPARAM);
 BOOL                Is64BitWindows();
 LRESULT CALLBACK    OnIconMessage(WPARAM wParam, LPARAM lParam);
-void                UpdateEyes(Registry::Key &key);
 void                UpdateTray(bool showInfo);
 void                CloseTray();
+void                SaveTrace();
+BOOL                GetJournalFileName(TCHAR *fileName, DWORD processId);
+DWORD               RestoreJournals();
+BOOL                StartJournal();
+BOOL                AttachStereo3D(BOOL journalStarted);
+void                WaitForStereo3D(BOOL journalStarted);
+void                Shutdown(bool leaseLost);
+void                DetectFromScreenshot();
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 int APIENTRY _tWinMain(_In_ HINSTANCE       hInstance,
@@ -59,6 +82,32 @@ int APIENTRY _tWinMain(_In_ HINSTANCE       hInstance,
 	UNREFERENCED_PARAMETER(lpCmdLine);
     UNREFERENCED_PARAMETER(nCmdShow);
 
+    int     exitCode = 0;
+    int     argc     = 0;
+    LPWSTR* argv     = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if(argv != nullptr)
+    {
+        BOOL handled = RunCommand(argc, argv, &exitCode);
+        if(!handled)
+            ReadOptions(argc, argv);
+
+        LocalFree(argv);
+
+        if(handled)
+            return exitCode;
+    }
+
+    // Only one instance may fight over the registry key. Another one shows the tray info of the
+    // running instance and exits.
+    if(sharedState.Create() == ERROR_SUCCESS && !sharedState.Acquire())
+    {
+        HWND owner = FindWindow(szWindowClass, szTitle);
+        if(owner != NULL)
+            PostMessage(owner, IDM_TRAY_MESSAGE, 0, WM_LBUTTONUP);
+
+        return 0;
+    }
+
     if (!InitWindows(hInstance, SW_HIDE))
 		return FALSE;
 
@@ -73,6 +122,213 @@ int APIENTRY _tWinMain(_In_ HINSTANCE       hInstance,
 	return (int) msg.wParam;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// Runs the command given on the command line, if any, instead of the tray application. The stress,
+/// the replay and the benchmarks are commands of 3DVisionEyeSwapperBench.
+///
+///     -decode-trace <trace file> <timeline file>
+///         Converts a trace saved from the tray menu to a text timeline.
+///
+///     -record <trace file> <seconds>
+///         Records the changes made to the Stereo3D key, for the -replay of 3DVisionEyeSwapperBench.
+///
+///     -control <\\.\pipe\name> get|toggle|set <0|1>
+///         Sends one command to a running instance started with -control, and exits with the swap
+///         state (0 or 1), or -1 when the command failed. The command must follow the pipe name;
+///         other options after it start the tool as the server.
+///
+///     -detect <bmp file> [swapped]
+///         Analyzes a screenshot of the interleaved picture, taken with the eyes swapped or not, and
+///         exits with 1 when the depth is inverted, 0 when it is right, or -1 when it can't tell.
+///
+///     -compose <left bmp> <right bmp> <pattern0> <pattern1> <output bmp>
+///         Builds the interleaved picture the driver shows for the given InterleavePattern values
+///         (hexadecimal, like 0xFF00FF00), from the pictures of the two eyes.
+///
+///     -restore
+///         Puts back the values overwritten by an instance that crashed, and exits with the number
+///         of values written, or -1 when an instance is running or the values can't be restored.
+///
+///     -status [report file]
+///         Reads the shared state of the running instance, writes it to the report file if one is
+///         given, and exits with the swap state (0 or 1), or -1 when no instance is running.
+///
+/// @return
+///     TRUE if a command was run and the application should exit with exitCode.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL RunCommand(int argc, LPWSTR *argv, int *exitCode)
+{
+    if(argc == 4 && lstrcmpi(argv[1], _T("-decode-trace")) == 0)
+    {
+        *exitCode = Registry::Trace::Decode(argv[2], argv[3]);
+        return TRUE;
+    }
+
+    if(argc == 4 && lstrcmpi(argv[1], _T("-record")) == 0)
+    {
+        *exitCode = Registry::ChangeTrace::Record( Registry::PredefinedKey::Local_Machine,
+                                                   Is64BitWindows() ? keyStereo3D_x86_64 : keyStereo3D_x86_32,
+                                                   argv[2],
+                                                   _tstoi(argv[3]) * 1000 );
+        return TRUE;
+    }
+
+    // A command right after the pipe name makes a client; anything else is left to the server options,
+    // as in "-control \\.\pipe\name -poll".
+    if( argc >= 4 && lstrcmpi(argv[1], _T("-control")) == 0 &&
+        (lstrcmpi(argv[3], _T("get")) == 0 || lstrcmpi(argv[3], _T("toggle")) == 0 || lstrcmpi(argv[3], _T("set")) == 0) )
+    {
+        BYTE  request[2];
+        DWORD requestSize = 1;
+
+        if(lstrcmpi(argv[3], _T("get")) == 0)
+            request[0] = (BYTE)Enforcement::ControlOp::Get;
+        else if(lstrcmpi(argv[3], _T("toggle")) == 0)
+            request[0] = (BYTE)Enforcement::ControlOp::Toggle;
+        else if(argc >= 5)
+        {
+            request[0]  = (BYTE)Enforcement::ControlOp::Set;
+            request[1]  = (_tstoi(argv[4]) != 0) ? 1 : 0;
+            requestSize = 2;
+        }
+        else
+        {
+            *exitCode = -1;
+            return TRUE;
+        }
+
+        BYTE  reply[1];
+        DWORD replied;
+        if( Enforcement::ControlServer::Call(argv[2], request, requestSize, reply, sizeof(reply), &replied) == ERROR_SUCCESS &&
+            replied == 1 && reply[0] != Enforcement::ControlServer::ControlError )
+            *exitCode = reply[0];
+        else
+            *exitCode = -1;
+
+        return TRUE;
+    }
+
+    if(argc >= 3 && lstrcmpi(argv[1], _T("-detect")) == 0)
+    {
+        bool  swapped = (argc > 3) && _tstoi(argv[3]) != 0;
+        DWORD pattern = Enforcement::Enforcer::GetPattern(swapped);
+
+        Enforcement::StereoFrame frame;
+        *exitCode = -1;
+
+        if(Enforcement::StereoAnalyzer::LoadFrame(argv[2], &frame) == ERROR_SUCCESS)
+        {
+            Enforcement::Parallax parallax = Enforcement::StereoAnalyzer::Analyze(frame, pattern, pattern).parallax;
+            if(parallax != Enforcement::Parallax::Unknown)
+                *exitCode = (parallax == Enforcement::Parallax::Inverted) ? 1 : 0;
+        }
+
+        return TRUE;
+    }
+
+    if(argc == 7 && lstrcmpi(argv[1], _T("-compose")) == 0)
+    {
+        Enforcement::StereoImage left;
+        Enforcement::StereoImage right;
+        Enforcement::StereoImage output;
+
+        DWORD pattern0 = _tcstoul(argv[4], nullptr, 16);
+        DWORD pattern1 = _tcstoul(argv[5], nullptr, 16);
+
+        *exitCode = left.Load(argv[2]);
+        if(*exitCode == ERROR_SUCCESS)
+            *exitCode = right.Load(argv[3]);
+
+        if(*exitCode == ERROR_SUCCESS)
+        {
+            Enforcement::StereoCompositor compositor;
+            *exitCode = compositor.Compose(left, right, pattern0, pattern1, &output);
+        }
+
+        if(*exitCode == ERROR_SUCCESS)
+            *exitCode = output.Save(argv[6]);
+
+        return TRUE;
+    }
+
+    if(argc == 2 && lstrcmpi(argv[1], _T("-restore")) == 0)
+    {
+        Enforcement::SharedState state;
+
+        // The key belongs to the running instance, if any.
+        *exitCode = -1;
+        if(state.OpenReadOnly() == ERROR_SUCCESS && state.HasOwner())
+            return TRUE;
+
+        *exitCode = (int)RestoreJournals();
+
+        return TRUE;
+    }
+
+    if(argc >= 2 && lstrcmpi(argv[1], _T("-status")) == 0)
+    {
+        Enforcement::SharedState state;
+
+        *exitCode = -1;
+        if(state.OpenReadOnly() != ERROR_SUCCESS || !state.HasOwner())
+            return TRUE;
+
+        const Enforcement::SharedStateData* data = state.GetData();
+        *exitCode = data->eyesSwapped ? 1 : 0;
+
+        FILE* report = nullptr;
+        if(argc > 2 && _tfopen_s(&report, argv[2], _T("w, ccs=UTF-8")) == 0 && report != nullptr)
+        {
+            LONG64 counters[Enforcement::SharedStateData::MaxCounters];
+            DWORD  count = state.ReadCounters(counters, _countof(counters));
+
+            _ftprintf(report, _T("owner_process_id %ld\n"), data->ownerProcessId);
+            _ftprintf(report, _T("eyes_swapped %ld\n"), data->eyesSwapped);
+            _ftprintf(report, _T("in_storm %ld\n"), data->inStorm);
+
+            // A newer owner may publish counters this build doesn't know.
+            for(DWORD i = 0; i < count && i < (DWORD)Registry::Counter::Count; i++)
+                _ftprintf(report, _T("%hs %lld\n"), Registry::Metrics::GetName((Registry::Counter)i), counters[i]);
+
+            fclose(report);
+        }
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// Reads the options of the tray application.
+///
+///     -metrics <file or \\.\pipe\name>
+///         Exports the metrics in the Prometheus text format: to a file rewritten every 10 seconds,
+///         or to a named pipe that returns a fresh snapshot to every client.
+///
+///     -poll
+///         Polls the Stereo3D key next to the change notifications, to catch the changes whose
+///         notification was missed.
+///
+///     -control <\\.\pipe\name>
+///         Serves the control protocol (see ControlServer.h) on a local named pipe, so scripts and
+///         launchers can read and change the swap state.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ReadOptions(int argc, LPWSTR *argv)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(i + 1 < argc && lstrcmpi(argv[i], _T("-metrics")) == 0)
+            _tcscpy_s(metricsTarget, MAX_PATH, argv[++i]);
+        else if(lstrcmpi(argv[i], _T("-poll")) == 0)
+            watchMode = Enforcement::WatchMode::NotifyAndPoll;
+        else if(i + 1 < argc && lstrcmpi(argv[i], _T("-control")) == 0)
+            _tcscpy_s(controlPipe, MAX_PATH, argv[++i]);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ///
 /// Initialize the windows needed by the application
@@ -142,26 +398,21 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         {
             ::hWnd = hWnd;
 
-            regStereo3D = Registry::Key::Open( Registry::PredefinedKey::Local_Machine,
-                                               Is64BitWindows() ? keyStereo3D_x86_64 : keyStereo3D_x86_32,
-                                               Registry::AccessRights::Read | Registry::AccessRights::Write );
-
-            if(regStereo3D != nullptr)
-            {
-                regStereo3D->AddNotify( [] (Registry::Key &key, void *userData) -> bool
-                    {
-                        UNREFERENCED_PARAMETER(key);
-                        UNREFERENCED_PARAMETER(userData);
+            // Before the key is watched, so putting back the values left by a crash is not seen as a change.
+            BOOL journalStarted = StartJournal();
 
-                        UpdateEyes(key);
+            scheduler.Start();
 
-                        return true;
-                    }
-                );
+            // Until 3D Vision is installed the key doesn't exist; it is attached as soon as it appears.
+            if(!AttachStereo3D(journalStarted))
+                WaitForStereo3D(journalStarted);
 
-                UpdateEyes(*regStereo3D);
-            }
+            sharedState.SetEyesSwapped(eyesSwapped);
+            if(sharedState.IsOwner())
+                SetTimer(hWnd, IDT_LEASE_TIMER, Enforcement::SharedState::RenewMs, NULL);
 
+            StartMetrics();
+            StartControl();
             UpdateTray(true);
         }break;
 
@@ -176,25 +427,38 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                 DialogBox(hInst, MAKEINTRESOURCE(IDD_ABOUTBOX), hWnd, About);
                 break;
 
-            case IDM_EXIT:
-                {
-                    CloseTray();
+            case IDM_SAVE_TRACE:
+                SaveTrace();
+                break;
 
-                    if(regStereo3D != nullptr)
-                        regStereo3D->Close();
+            case IDM_DETECT_SWAP:
+                DetectFromScreenshot();
+                break;
 
+            case IDM_EXIT:
+                {
+                    Shutdown(false);
                     DestroyWindow(hWnd);
                 }break;
 
             case IDM_SWAP_EYES:
                 {
-                    eyesSwapped ^= true;
-                    if(regStereo3D != nullptr)
                     {
-                        UpdateTray(false);
-                        UpdateEyes(*regStereo3D);
+                        std::lock_guard<std::mutex> lock(stateLock);
+
+                        eyesSwapped ^= true;
+                        if(enforcer != nullptr)
+                            enforcer->SetEyesSwapped(eyesSwapped);
+
+                        sharedState.SetEyesSwapped(eyesSwapped);
                     }
 
+                    if(enforcer != nullptr)
+                        UpdateTray(false);
+
+                    if(control != nullptr)
+                        control->OnStateChanged();
+
                 }break;
 
             default:
@@ -207,6 +471,68 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             OnIconMessage(wParam, lParam);
         }break;
 
+    case IDM_CONTROL_MESSAGE:
+        {
+            UpdateTray(false);
+        }break;
+
+    case IDM_ATTACH_MESSAGE:
+        {
+            keyWaiter.Stop();
+
+            if(regStereo3D != nullptr)
+                break;
+
+            if(AttachStereo3D((BOOL)wParam))
+            {
+                attachRetryMs = 0;
+                KillTimer(hWnd, IDT_ATTACH_TIMER);
+                UpdateTray(true);
+                break;
+            }
+
+            // The key exists but can't be opened yet, as while the installer sets its rights: wait
+            // for it again after a delay that doubles up to 10 s while it keeps failing.
+            attachRetryMs = (attachRetryMs == 0) ? 100 : attachRetryMs * 2;
+            if(attachRetryMs > 10000)
+                attachRetryMs = 10000;
+
+            attachJournalStarted = (BOOL)wParam;
+            SetTimer(hWnd, IDT_ATTACH_TIMER, attachRetryMs, NULL);
+        }break;
+
+    case IDM_STORM_MESSAGE:
+        {
+            sharedState.SetStorm(wParam != 0);
+
+            // While the storm lasts, check every second if the service calmed down.
+            if(wParam)
+                SetTimer(hWnd, IDT_STORM_TIMER, 1000, NULL);
+            else
+                KillTimer(hWnd, IDT_STORM_TIMER);
+
+            UpdateTray(true);
+        }break;
+
+    case WM_TIMER:
+        {
+            if(wParam == IDT_STORM_TIMER && enforcer != nullptr)
+                enforcer->UpdateStorm();
+            else if(wParam == IDT_METRICS_TIMER)
+                Registry::Metrics::Export(metricsTarget);
+            else if(wParam == IDT_ATTACH_TIMER)
+            {
+                KillTimer(hWnd, IDT_ATTACH_TIMER);
+                WaitForStereo3D(attachJournalStarted);
+            }
+            else if(wParam == IDT_LEASE_TIMER && !sharedState.Renew())
+            {
+                // Another instance took over while this one was stuck; leave the key to it.
+                Shutdown(true);
+                DestroyWindow(hWnd);
+            }
+        }break;
+
 	case WM_PAINT:
         {
 	        PAINTSTRUCT ps;
@@ -260,7 +586,9 @@ LRESULT CALLBACK OnIconMessage(WPARAM wParam, LPARAM lParam)
 
         hMenu = CreatePopupMenu();
         AppendMenu(hMenu, MF_STRING | (eyesSwapped ? MF_CHECKED : 0), IDM_SWAP_EYES, _T("Swap eyes"));
+        AppendMenu(hMenu, MF_STRING, IDM_DETECT_SWAP, _T("Detect from screenshot..."));
         AppendMenu(hMenu, MF_STRING, 0, NULL);
+        AppendMenu(hMenu, MF_STRING, IDM_SAVE_TRACE, _T("Save trace"));
         AppendMenu(hMenu, MF_STRING, IDM_ABOUT, _T("About"));
         AppendMenu(hMenu, MF_STRING, IDM_EXIT, _T("Exit"));
 
@@ -277,21 +605,6 @@ LRESULT CALLBACK OnIconMessage(WPARAM wParam, LPARAM lParam)
     return 0;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void UpdateEyes(Registry::Key &key)
-{
-    if(eyesSwapped)
-    {
-        key.SetValueDWORD(_T("InterleavePattern0"), 0xFF00FF00);
-        key.SetValueDWORD(_T("InterleavePattern1"), 0xFF00FF00);
-    }
-    else
-    {
-        key.SetValueDWORD(_T("InterleavePattern0"), 0x00FF00FF);
-        key.SetValueDWORD(_T("InterleavePattern1"), 0x00FF00FF);
-    }
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 void UpdateTray(bool showInfo)
 {
@@ -310,12 +623,25 @@ void UpdateTray(bool showInfo)
     if(showInfo)
         nid.uFlags |= NIF_INFO;
 
-    if(regStereo3D == nullptr)
+    if(regStereo3D == nullptr && (keyWaiter.IsWaiting() || attachRetryMs != 0))
+    {
+        nid.dwInfoFlags = NIIF_WARNING;
+        _tcscpy_s(nid.szTip,   64, _T("Waiting for 3D Vision to be enabled."));
+        _tcscpy_s(nid.szInfo, 256, _T("3D Vision is not enabled yet. The eyes will be swapped as soon as it is."));
+    }
+    else if(regStereo3D == nullptr)
     {
         nid.dwInfoFlags = NIIF_ERROR;
         _tcscpy_s(nid.szTip,   64, _T("Can't swap eyes. 3D Vision not enabled?"));
         _tcscpy_s(nid.szInfo, 256, _T("Can't swap the eyes. Check if 3D Vision is enabled!"));
     }
+    else if(enforcer != nullptr && enforcer->IsStorm())
+    {
+        nid.dwInfoFlags = NIIF_WARNING;
+        _tcscpy_s(nid.szTip,   64, eyesSwapped ? _T("Eyes are swapped. 3D Vision keeps resetting them.")
+                                               : _T("Eyes are NOT swapped. 3D Vision keeps resetting them."));
+        _tcscpy_s(nid.szInfo, 256, _T("The 3D Vision service keeps resetting the eyes. Backing off to save CPU."));
+    }
     else if(eyesSwapped)
     {
         _tcscpy_s(nid.szTip,   64, _T("Eyes are swapped."));
@@ -349,6 +675,337 @@ void CloseTray()
     trayInitialized     = false;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void StartControl()
+{
+    if(controlPipe[0] == 0)
+        return;
+
+    control = new Enforcement::ControlServer();
+    LSTATUS status = control->Start( controlPipe,
+                    [] () -> bool
+                    {
+                        return eyesSwapped;
+                    },
+                    [] (bool swapped)
+                    {
+                        // Applied here, so the state is in place when the client gets the reply;
+                        // the tray is updated by the window thread. The lock keeps the window thread
+                        // from toggling, or creating or deleting the enforcer, meanwhile.
+                        std::lock_guard<std::mutex> lock(stateLock);
+
+                        eyesSwapped = swapped;
+                        if(enforcer != nullptr)
+                            enforcer->SetEyesSwapped(swapped);
+
+                        sharedState.SetEyesSwapped(swapped);
+
+                        PostMessage(::hWnd, IDM_CONTROL_MESSAGE, 0, 0);
+                    }
+    );
+
+    // Another process holding the name would get the commands meant for this one.
+    if(status != ERROR_SUCCESS)
+    {
+        delete control;
+        control = nullptr;
+
+        MessageBox(hWnd, _T("Can't create the control pipe; another program may be using its name."), szTitle, MB_OK | MB_ICONERROR);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void StartMetrics()
+{
+    if(metricsTarget[0] == 0)
+        return;
+
+    if(_tcsnicmp(metricsTarget, _T("\\\\.\\pipe\\"), 9) == 0)
+    {
+        if(Registry::Metrics::Serve(metricsTarget) != ERROR_SUCCESS)
+            MessageBox(hWnd, _T("Can't create the metrics pipe; another program may be using its name."), szTitle, MB_OK | MB_ICONERROR);
+    }
+    else
+    {
+        Registry::Metrics::Export(metricsTarget);
+        SetTimer(hWnd, IDT_METRICS_TIMER, 10000, NULL);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// The journals are kept next to the trace, one per instance that owned the key, named after its
+/// process, since an instance that lost the lease while stalled may still hold its own open.
+/// fileName has MAX_PATH characters.
+BOOL GetJournalFileName(TCHAR *fileName, DWORD processId)
+{
+    DWORD length = GetTempPath(MAX_PATH, fileName);
+    if(length == 0 || length >= MAX_PATH)
+        return FALSE;
+
+    TCHAR name[64];
+    _stprintf_s(name, _T("3DVisionEyeSwapper.%u.journal"), processId);
+
+    return _tcscat_s(fileName, MAX_PATH, name) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Puts back the values left in the journals of the other instances, newest first, so the oldest
+/// records, those of the service, are the ones that stay. A journal still open in its instance is
+/// skipped. Returns the number of values written.
+DWORD RestoreJournals()
+{
+    TCHAR directory[MAX_PATH];
+    TCHAR pattern[MAX_PATH];
+    TCHAR ownName[MAX_PATH];
+
+    DWORD length = GetTempPath(MAX_PATH, directory);
+    if(length == 0 || length >= MAX_PATH || !GetJournalFileName(ownName, GetCurrentProcessId()))
+        return 0;
+
+    _stprintf_s(pattern, _T("%s3DVisionEyeSwapper*.journal"), directory);
+
+    std::vector<std::pair<FILETIME, std::basic_string<TCHAR>>> files;
+
+    WIN32_FIND_DATA found;
+    HANDLE          find = FindFirstFile(pattern, &found);
+    if(find == INVALID_HANDLE_VALUE)
+        return 0;
+
+    do
+    {
+        std::basic_string<TCHAR> fileName = std::basic_string<TCHAR>(directory) + found.cFileName;
+        if(lstrcmpi(fileName.c_str(), ownName) != 0)
+            files.push_back(std::make_pair(found.ftCreationTime, fileName));
+    } while(FindNextFile(find, &found));
+
+    FindClose(find);
+
+    std::sort(files.begin(), files.end(), [] (const std::pair<FILETIME, std::basic_string<TCHAR>>& a,
+                                              const std::pair<FILETIME, std::basic_string<TCHAR>>& b)
+        {
+            return CompareFileTime(&a.first, &b.first) > 0;
+        }
+    );
+
+    DWORD total = 0;
+    for(auto& file : files)
+    {
+        Registry::UndoJournal   other;
+        DWORD                   written = 0;
+
+        if(other.Open(file.second.c_str()) != ERROR_SUCCESS)
+            continue;
+
+        bool restored = other.Restore(&written) == ERROR_SUCCESS;
+        total += written;
+
+        other.Close();
+        if(restored)
+            DeleteFile(file.second.c_str());
+    }
+
+    return total;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Opens the journal of this instance. The values left in the journals of crashed or former owners
+/// are put back only by the owner of the lease, never under the feet of a running one.
+BOOL StartJournal()
+{
+    TCHAR fileName[MAX_PATH];
+
+    if(!GetJournalFileName(fileName, GetCurrentProcessId()) || journal.Open(fileName) != ERROR_SUCCESS)
+        return FALSE;
+
+    // A crashed instance can have had the same process id.
+    if(sharedState.IsOwner())
+    {
+        journal.Restore();
+        RestoreJournals();
+    }
+
+    return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Opens the Stereo3D key and starts keeping the eyes swapped in it; fails when the key doesn't exist.
+BOOL AttachStereo3D(BOOL journalStarted)
+{
+    regStereo3D = Registry::Key::Open( Registry::PredefinedKey::Local_Machine,
+                                       Is64BitWindows() ? keyStereo3D_x86_64 : keyStereo3D_x86_32,
+                                       Registry::AccessRights::Read | Registry::AccessRights::Write );
+
+    // Without the Notify right the key can still be watched by polling.
+    if(regStereo3D == nullptr)
+    {
+        regStereo3D = Registry::Key::Open( Registry::PredefinedKey::Local_Machine,
+                                           Is64BitWindows() ? keyStereo3D_x86_64 : keyStereo3D_x86_32,
+                                           Registry::AccessRights::Query_Value | Registry::AccessRights::Set_Value );
+        if(regStereo3D != nullptr)
+            watchMode = Enforcement::WatchMode::Poll;
+    }
+
+    if(regStereo3D == nullptr)
+        return FALSE;
+
+    // The service rewrites the pattern in bursts, so the watcher polls a little after each
+    // change instead of going back to sleep at once.
+    Registry::NotifyOptions notifyOptions;
+    notifyOptions.priority   = THREAD_PRIORITY_HIGHEST;
+    notifyOptions.spinMicros = 500;
+
+    // A control client may set the state at the same time.
+    std::lock_guard<std::mutex> lock(stateLock);
+
+    enforcer = new Enforcement::Enforcer(regStereo3D);
+    if(journalStarted)
+        enforcer->SetJournal(&journal);
+    enforcer->SetScheduler(&scheduler);
+    enforcer->SetEyesSwapped(eyesSwapped);
+    enforcer->Start( [] (bool inStorm)
+        {
+            // Called from the notify thread, so let the window thread update the tray.
+            PostMessage(::hWnd, IDM_STORM_MESSAGE, inStorm ? TRUE : FALSE, 0);
+        },
+        notifyOptions,
+        watchMode
+    );
+
+    return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Attaches the Stereo3D key once it exists; at once when it already does.
+void WaitForStereo3D(BOOL journalStarted)
+{
+    keyWaiter.Start( Registry::PredefinedKey::Local_Machine,
+                     Is64BitWindows() ? keyStereo3D_x86_64 : keyStereo3D_x86_32,
+                     [journalStarted] ()
+                     {
+                         PostMessage(::hWnd, IDM_ATTACH_MESSAGE, journalStarted, 0);
+                     }
+    );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Stops watching the key, the servers and the timers. An instance that holds the lease puts back
+/// the values of the service and releases the lease; one that lost it to another instance touches
+/// neither, as the key and the journal now belong to the new owner.
+void Shutdown(bool leaseLost)
+{
+    CloseTray();
+
+    KillTimer(hWnd, IDT_METRICS_TIMER);
+    KillTimer(hWnd, IDT_LEASE_TIMER);
+    KillTimer(hWnd, IDT_STORM_TIMER);
+    KillTimer(hWnd, IDT_ATTACH_TIMER);
+    Registry::Metrics::StopServing();
+    keyWaiter.Stop();
+
+    delete control;
+    control     = nullptr;
+
+    // The control threads are gone, so only this thread uses the enforcer now.
+    if(enforcer != nullptr)
+        enforcer->Stop();
+
+    if(regStereo3D != nullptr)
+        regStereo3D->Close();
+
+    delete enforcer;
+    enforcer    = nullptr;
+    regStereo3D = nullptr;
+
+    scheduler.Stop();
+
+    if(!leaseLost)
+    {
+        // The key is not watched any more, so the values of the service can go back: those this
+        // instance overwrote, then the older ones of a former owner that let go of its journal.
+        bool restored = journal.Restore() == ERROR_SUCCESS;
+        if(sharedState.IsOwner())
+            RestoreJournals();
+
+        // The next instance can take over at once.
+        sharedState.Release();
+
+        TCHAR fileName[MAX_PATH];
+        journal.Close();
+        if(restored && GetJournalFileName(fileName, GetCurrentProcessId()))
+            DeleteFile(fileName);
+    }
+    else
+        journal.Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void SaveTrace()
+{
+    TCHAR   fileName[MAX_PATH];
+    TCHAR   message[MAX_PATH + 128];
+
+    DWORD length = GetTempPath(MAX_PATH, fileName);
+    if(length == 0 || length >= MAX_PATH)
+        return;
+
+    _tcscat_s(fileName, MAX_PATH, _T("3DVisionEyeSwapper.trace"));
+
+    if(Registry::Trace::Dump(fileName) == ERROR_SUCCESS)
+    {
+        _stprintf_s(message, _countof(message), _T("Trace saved to:\n%s\n\nUse -decode-trace <trace file> <timeline file> to read it."), fileName);
+        MessageBox(hWnd, message, szTitle, MB_OK | MB_ICONINFORMATION);
+    }
+    else
+        MessageBox(hWnd, _T("Can't save the trace."), szTitle, MB_OK | MB_ICONERROR);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Asks for a screenshot taken with the current swap setting, and swaps the eyes when the depth in
+/// it is inverted.
+void DetectFromScreenshot()
+{
+    TCHAR fileName[MAX_PATH] = { 0 };
+
+    OPENFILENAME openFile;
+    memset(&openFile, 0, sizeof(openFile));
+    openFile.lStructSize    = sizeof(openFile);
+    openFile.hwndOwner      = hWnd;
+    openFile.lpstrFilter    = _T("Bitmap files (*.bmp)\0*.bmp\0");
+    openFile.lpstrFile      = fileName;
+    openFile.nMaxFile       = MAX_PATH;
+    openFile.lpstrTitle     = _T("Screenshot of the interleaved picture");
+    openFile.Flags          = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+
+    if(!GetOpenFileName(&openFile))
+        return;
+
+    Enforcement::StereoFrame frame;
+    if(Enforcement::StereoAnalyzer::LoadFrame(fileName, &frame) != ERROR_SUCCESS)
+    {
+        MessageBox(hWnd, _T("Can't read the screenshot; only 24 and 32 bit BMP files are supported."), szTitle, MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    DWORD pattern = Enforcement::Enforcer::GetPattern(eyesSwapped);
+    Enforcement::StereoResult result = Enforcement::StereoAnalyzer::Analyze(frame, pattern, pattern);
+
+    switch(result.parallax)
+    {
+    case Enforcement::Parallax::Normal:
+        MessageBox(hWnd, _T("The eyes are in the right order."), szTitle, MB_OK | MB_ICONINFORMATION);
+        break;
+
+    case Enforcement::Parallax::Inverted:
+        SendMessage(hWnd, WM_COMMAND, IDM_SWAP_EYES, 0);
+        MessageBox(hWnd, _T("The depth was inverted; the eyes are now swapped the other way."), szTitle, MB_OK | MB_ICONINFORMATION);
+        break;
+
+    default:
+        MessageBox(hWnd, _T("Can't tell from this screenshot; try one with more depth and detail."), szTitle, MB_OK | MB_ICONWARNING);
+        break;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 BOOL Is64BitWindows()
 {
@@ -23,14 +23,27 @@
 // Windows Header Files:
 #include <windows.h>
 #include <shellapi.h>
+#include <commdlg.h>
 
 // C RunTime Header Files
 #include <stdlib.h>
 #include <malloc.h>
 #include <memory.h>
 #include <tchar.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "./resource.h"
 #include "./Registry.h"
+#include "./Enforcer.h"
+#include "./ChangeTrace.h"
+#include "./ControlServer.h"
+#include "./StereoAnalyzer.h"
+#include "./StereoCompositor.h"
+#include "./SharedState.h"
+#include "./UndoJournal.h"
+#include "./KeyWaiter.h"
 
 #endif // INCLUDED_3DVISIONEYESWAPPER_H
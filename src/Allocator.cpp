@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Allocator.cpp
+///  Description: Memory allocators that can be given to the Registry API for its internal buffers.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Allocator.h"
+
+#include <malloc.h>
+
+namespace Registry
+{
+    static HeapAllocator defaultAllocator;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Allocator* Allocator::GetDefault()
+    {
+        return &defaultAllocator;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void* HeapAllocator::DoAllocate( _In_ size_t size, _In_ size_t alignment )
+    {
+        return _aligned_malloc(size, alignment);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void HeapAllocator::DoDeallocate( _In_ void* pointer )
+    {
+        _aligned_free(pointer);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Arena::Arena( _In_opt_ size_t blockSize, _In_opt_ Allocator* upstream )
+    {
+        m_upstream      = (upstream != nullptr) ? upstream : Allocator::GetDefault();
+        m_blockSize     = blockSize;
+        m_first         = nullptr;
+        m_current       = nullptr;
+        m_offset        = 0;
+        m_blockCount    = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Arena::~Arena()
+    {
+        while(m_first != nullptr)
+        {
+            Block* next = m_first->next;
+            m_upstream->Deallocate(m_first);
+            m_first = next;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void* Arena::DoAllocate( _In_ size_t size, _In_ size_t alignment )
+    {
+        const size_t header = (sizeof(Block) + 15) & ~(size_t)15;
+
+        while(m_current != nullptr)
+        {
+            size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+            if(header + offset + size <= m_current->size)
+            {
+                m_offset = offset + size;
+                return (BYTE*)m_current + header + offset;
+            }
+
+            // Blocks kept from a previous cycle are reused before asking the upstream allocator.
+            if(m_current->next == nullptr)
+                break;
+
+            m_current   = m_current->next;
+            m_offset    = 0;
+        }
+
+        size_t blockSize = header + size + alignment;
+        if(blockSize < m_blockSize)
+            blockSize = m_blockSize;
+
+        Block* block = (Block*)m_upstream->Allocate(blockSize, 16);
+        if(block == nullptr)
+            return nullptr;
+
+        block->next = nullptr;
+        block->size = blockSize;
+        m_blockCount++;
+
+        if(m_current == nullptr)
+            m_first = block;
+        else
+            m_current->next = block;
+
+        // The blocks and their headers are 16 byte aligned, which covers every alignment used here.
+        m_current   = block;
+        m_offset    = size;
+
+        return (BYTE*)block + header;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Arena::DoDeallocate( _In_ void* pointer )
+    {
+        // Freed all at once by Reset.
+        UNREFERENCED_PARAMETER(pointer);
+    }
+}
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Allocator.h
+///  Description: Memory allocators that can be given to the Registry API for its internal buffers.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_ALLOCATOR_H
+#define INCLUDED_ALLOCATOR_H
+
+#include <windows.h>
+#include <atomic>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Base of the allocators, in the spirit of std::pmr::memory_resource (not available in VS2013).
+    /// Counts the allocations it serves.
+    class Allocator
+    {
+    public:
+        virtual ~Allocator() {}
+
+        void* Allocate( _In_ size_t size, _In_opt_ size_t alignment = sizeof(void*) )
+        {
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+            return DoAllocate(size, alignment);
+        }
+
+        void Deallocate( _In_opt_ void* pointer )
+        {
+            if(pointer != nullptr)
+                DoDeallocate(pointer);
+        }
+
+        LONG64 GetAllocations() const
+        {
+            return m_allocations.load(std::memory_order_relaxed);
+        }
+
+        /// The heap allocator, shared by everyone.
+        static Allocator* GetDefault();
+
+    protected:
+        Allocator() : m_allocations(0) {}
+
+        virtual void* DoAllocate( _In_ size_t size, _In_ size_t alignment ) = 0;
+        virtual void  DoDeallocate( _In_ void* pointer ) = 0;
+
+    private:
+        std::atomic<LONG64> m_allocations;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Allocates from the process heap.
+    class HeapAllocator : public Allocator
+    {
+    protected:
+        virtual void* DoAllocate( _In_ size_t size, _In_ size_t alignment );
+        virtual void  DoDeallocate( _In_ void* pointer );
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Monotonic arena: allocations are carved from big blocks and never freed one by one. Reset
+    /// makes all the memory available again in O(1), keeping the blocks for the next cycle.
+    /// It is not thread safe; use one arena per thread.
+    class Arena : public Allocator
+    {
+    public:
+
+        Arena( _In_opt_ size_t blockSize = 64 * 1024, _In_opt_ Allocator* upstream = nullptr );
+
+        ~Arena();
+
+        /// Frees everything allocated since the last reset.
+        void Reset()
+        {
+            m_current   = m_first;
+            m_offset    = 0;
+        }
+
+        /// Number of blocks taken from the upstream allocator.
+        DWORD GetBlockCount() const
+        {
+            return m_blockCount;
+        }
+
+    protected:
+        virtual void* DoAllocate( _In_ size_t size, _In_ size_t alignment );
+        virtual void  DoDeallocate( _In_ void* pointer );
+
+    private:
+        struct Block
+        {
+            Block*  next;
+            size_t  size;
+        };
+
+        Arena( const Arena& );
+        Arena& operator = ( const Arena& );
+
+        Allocator*  m_upstream;
+        size_t      m_blockSize;
+        Block*      m_first;
+        Block*      m_current;
+        size_t      m_offset;       /// First free byte of the current block, after its header.
+        DWORD       m_blockCount;
+    };
+}
+
+#endif // INCLUDED_ALLOCATOR_H
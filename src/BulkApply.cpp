@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        BulkApply.cpp
+///  Description: Writes a list of values over many keys, opening every key once and running the
+///               keys in parallel on a bounded thread pool.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./BulkApply.h"
+
+#include <algorithm>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    BulkApplier::BulkApplier( _In_opt_ DWORD threads )
+    {
+        if(threads == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threads = systemInfo.dwNumberOfProcessors;
+        }
+
+        m_threads       = threads;
+        m_work          = nullptr;
+        m_operations    = nullptr;
+        m_nextGroup     = 0;
+
+        InitializeThreadpoolEnvironment(&m_environment);
+
+        m_pool = CreateThreadpool(nullptr);
+        if(m_pool != nullptr)
+        {
+            SetThreadpoolThreadMaximum(m_pool, threads);
+            SetThreadpoolCallbackPool(&m_environment, m_pool);
+
+            m_work = CreateThreadpoolWork(WorkCallback, this, &m_environment);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    BulkApplier::~BulkApplier()
+    {
+        if(m_work != nullptr)
+        {
+            WaitForThreadpoolWorkCallbacks(m_work, FALSE);
+            CloseThreadpoolWork(m_work);
+        }
+
+        if(m_pool != nullptr)
+            CloseThreadpool(m_pool);
+
+        DestroyThreadpoolEnvironment(&m_environment);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS BulkApplier::Apply( _Inout_updates_(count) ApplyOperation*   operations,
+                                _In_                   DWORD             count )
+    {
+        if(operations == nullptr && count != 0)
+            return ERROR_INVALID_PARAMETER;
+
+        std::lock_guard<std::mutex> guard(m_applyLock);
+
+        m_operations = operations;
+
+        // Stable, so the values of a key are written in the order of the list.
+        m_order.resize(count);
+        for(DWORD i = 0; i < count; i++)
+            m_order[i] = i;
+
+        std::stable_sort(m_order.begin(), m_order.end(), [operations] (DWORD a, DWORD b) -> bool
+            {
+                if(operations[a].mainKey != operations[b].mainKey)
+                    return operations[a].mainKey < operations[b].mainKey;
+
+                return _tcsicmp(operations[a].keyPath, operations[b].keyPath) < 0;
+            }
+        );
+
+        m_groups.clear();
+        for(DWORD i = 0; i < count; i++)
+        {
+            const ApplyOperation& operation = operations[m_order[i]];
+            const ApplyOperation* previous  = (i > 0) ? &operations[m_order[i - 1]] : nullptr;
+
+            if( previous == nullptr || previous->mainKey != operation.mainKey ||
+                _tcsicmp(previous->keyPath, operation.keyPath) != 0 )
+                m_groups.push_back(i);
+        }
+
+        size_t groupCount = m_groups.size();
+        m_groups.push_back(count);
+
+        m_nextGroup = 0;
+
+        if(m_work != nullptr)
+        {
+            // Every work item takes keys until none is left.
+            size_t items = (groupCount < m_threads) ? groupCount : m_threads;
+            for(size_t i = 0; i < items; i++)
+                SubmitThreadpoolWork(m_work);
+
+            WaitForThreadpoolWorkCallbacks(m_work, FALSE);
+        }
+        else
+        {
+            // No pool: everything on the calling thread.
+            for(size_t group = 0; group < groupCount; group++)
+                ApplyGroup(group);
+        }
+
+        m_operations = nullptr;
+
+        for(DWORD i = 0; i < count; i++)
+        {
+            if(operations[i].status != ERROR_SUCCESS)
+                return operations[i].status;
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void CALLBACK BulkApplier::WorkCallback( _Inout_     PTP_CALLBACK_INSTANCE   instance,
+                                             _Inout_opt_ PVOID                   context,
+                                             _Inout_     PTP_WORK                work )
+    {
+        UNREFERENCED_PARAMETER(instance);
+        UNREFERENCED_PARAMETER(work);
+
+        BulkApplier* applier    = (BulkApplier*)context;
+        size_t       groupCount = applier->m_groups.size() - 1;
+
+        for(;;)
+        {
+            size_t group = applier->m_nextGroup.fetch_add(1);
+            if(group >= groupCount)
+                break;
+
+            applier->ApplyGroup(group);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void BulkApplier::ApplyGroup( _In_ size_t group )
+    {
+        size_t          first       = m_groups[group];
+        size_t          last        = m_groups[group + 1];
+        ApplyOperation& operation   = m_operations[m_order[first]];
+
+        LSTATUS status = ERROR_SUCCESS;
+        Key*    key    = Key::Create(operation.mainKey, operation.keyPath, AccessRights::Write, &status);
+
+        for(size_t i = first; i < last; i++)
+        {
+            ApplyOperation& current = m_operations[m_order[i]];
+
+            current.status = (key != nullptr) ? key->SetValue(current.valueName, current.data, current.dataSize, current.type)
+                                              : status;
+        }
+
+        if(key != nullptr)
+            key->Close();
+    }
+}
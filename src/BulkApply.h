@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        BulkApply.h
+///  Description: Writes a list of values over many keys, opening every key once and running the
+///               keys in parallel on a bounded thread pool.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_BULKAPPLY_H
+#define INCLUDED_BULKAPPLY_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// One value to write. The strings and the data must stay valid until Apply returns.
+    struct ApplyOperation
+    {
+        PredefinedKey   mainKey;
+        const TCHAR*    keyPath;        /// Created when missing.
+        const TCHAR*    valueName;
+        DataType        type;
+        const void*     data;
+        DWORD           dataSize;
+        LSTATUS         status;         /// Filled by Apply.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Applies lists of operations on a private thread pool, kept between the calls.
+    /// The operations are grouped by key; every key is opened once and its values are written in the
+    /// order of the list, while different keys are written concurrently. Calls to Apply are
+    /// serialized.
+    class BulkApplier
+    {
+    public:
+
+        /// threads is the most keys written at the same time; 0 takes the number of CPUs.
+        BulkApplier( _In_opt_ DWORD threads = 0 );
+
+        ~BulkApplier();
+
+        /// Returns ERROR_SUCCESS when every operation succeeded, else the status of the first one that
+        /// failed, in the order of the list.
+        LSTATUS Apply( _Inout_updates_(count) ApplyOperation*   operations,
+                       _In_                   DWORD             count );
+
+        DWORD GetThreads() const
+        {
+            return m_threads;
+        }
+
+    private:
+        BulkApplier( const BulkApplier& );
+        BulkApplier& operator = ( const BulkApplier& );
+
+        static void CALLBACK WorkCallback( _Inout_     PTP_CALLBACK_INSTANCE   instance,
+                                           _Inout_opt_ PVOID                   context,
+                                           _Inout_     PTP_WORK                work );
+
+        void ApplyGroup( _In_ size_t group );
+
+        DWORD                   m_threads;
+        PTP_POOL                m_pool;
+        TP_CALLBACK_ENVIRON     m_environment;
+        PTP_WORK                m_work;
+
+        std::mutex              m_applyLock;
+
+        // The call in progress.
+        ApplyOperation*         m_operations;
+        std::vector<DWORD>      m_order;            /// Indexes of the operations, sorted by key.
+        std::vector<size_t>     m_groups;           /// Start of every key in m_order, and the end.
+        std::atomic<size_t>     m_nextGroup;
+    };
+}
+
+#endif // INCLUDED_BULKAPPLY_H
@@ -0,0 +1,245 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        ChangeTrace.cpp
+///  Description: Records the changes made to the values of a key, and applies them back.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./ChangeTrace.h"
+
+#include <stdio.h>
+#include <map>
+#include <mutex>
+
+namespace Registry
+{
+    typedef std::basic_string<TCHAR>                                        ChangeString;
+    typedef std::map<ChangeString, std::pair<DataType, std::vector<BYTE>>>  ChangeSnapshot;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Layout of the trace file: header, then for every record its header, name and data.
+    struct ChangeFileHeader
+    {
+        static const DWORD  Magic   = 0x47484352;   // "RCHG"
+        static const DWORD  Version = 1;
+
+        DWORD               magic;
+        DWORD               version;
+        DWORD               recordCount;
+        DWORD               reserved;
+    };
+
+    struct ChangeFileRecord
+    {
+        unsigned long long  timeMicros;
+        BYTE                deleted;
+        BYTE                type;
+        WORD                nameLength;
+        DWORD               dataSize;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static LSTATUS TakeSnapshot( _In_ Key& key, _Out_ ChangeSnapshot& snapshot )
+    {
+        snapshot.clear();
+
+        return key.EnumValues( [&snapshot] (Value &value) -> bool
+            {
+                auto& entry  = snapshot[value.GetName()];
+                entry.first  = value.GetType();
+                entry.second.assign(value.GetData(), value.GetData() + value.GetDataSize());
+
+                return true;
+            }
+        );
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void Diff( _In_    const ChangeSnapshot&       before,
+                      _In_    const ChangeSnapshot&       after,
+                      _In_    unsigned long long          timeMicros,
+                      _Inout_ std::vector<ChangeRecord>&  records )
+    {
+        for(auto& value : after)
+        {
+            auto old = before.find(value.first);
+            if(old != before.end() && old->second == value.second)
+                continue;
+
+            ChangeRecord record;
+            record.timeMicros   = timeMicros;
+            record.deleted      = false;
+            record.type         = value.second.first;
+            record.name         = value.first;
+            record.data         = value.second.second;
+            records.push_back(record);
+        }
+
+        for(auto& value : before)
+        {
+            if(after.find(value.first) != after.end())
+                continue;
+
+            ChangeRecord record;
+            record.timeMicros   = timeMicros;
+            record.deleted      = true;
+            record.type         = DataType::None;
+            record.name         = value.first;
+            records.push_back(record);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ChangeTrace::Record( _In_     PredefinedKey   mainKey,
+                                 _In_z_   const TCHAR*    subKeyPath,
+                                 _In_z_   const TCHAR*    fileName,
+                                 _In_     DWORD           durationMs )
+    {
+        LSTATUS status = ERROR_SUCCESS;
+        Key*    key    = Key::Open(mainKey, subKeyPath, AccessRights::Read, &status);
+        if(key == nullptr)
+            return status;
+
+        LARGE_INTEGER frequency, start;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+
+        std::mutex                  lock;
+        ChangeSnapshot              last;
+        std::vector<ChangeRecord>   records;
+
+        status = TakeSnapshot(*key, last);
+        if(status == ERROR_SUCCESS)
+        {
+            Diff(ChangeSnapshot(), last, 0, records);
+
+            status = key->AddNotify( [&] (Key &key, void *userData) -> bool
+                {
+                    UNREFERENCED_PARAMETER(userData);
+
+                    LARGE_INTEGER now;
+                    QueryPerformanceCounter(&now);
+
+                    ChangeSnapshot current;
+                    if(TakeSnapshot(key, current) == ERROR_SUCCESS)
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        Diff(last, current, (now.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart, records);
+                        last.swap(current);
+                    }
+
+                    return true;
+                },
+                NotifyEvents::Change_LastSet,
+                false
+            );
+        }
+
+        if(status == ERROR_SUCCESS)
+            Sleep(durationMs);
+
+        key->Close();
+
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        FILE* file = nullptr;
+        if(_tfopen_s(&file, fileName, _T("wb")) != 0 || file == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        ChangeFileHeader header = { ChangeFileHeader::Magic, ChangeFileHeader::Version, (DWORD)records.size(), 0 };
+        fwrite(&header, sizeof(header), 1, file);
+
+        for(auto& record : records)
+        {
+            ChangeFileRecord fileRecord;
+            fileRecord.timeMicros   = record.timeMicros;
+            fileRecord.deleted      = record.deleted ? 1 : 0;
+            fileRecord.type         = (BYTE)record.type;
+            fileRecord.nameLength   = (WORD)record.name.size();
+            fileRecord.dataSize     = (DWORD)record.data.size();
+
+            fwrite(&fileRecord, sizeof(fileRecord), 1, file);
+            fwrite(record.name.c_str(), sizeof(TCHAR), record.name.size(), file);
+            if(!record.data.empty())
+                fwrite(&record.data[0], 1, record.data.size(), file);
+        }
+
+        bool failed = (ferror(file) != 0);
+        fclose(file);
+
+        return failed ? ERROR_WRITE_FAULT : ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ChangeTrace::Load( _In_z_ const TCHAR*                 fileName,
+                               _Out_  std::vector<ChangeRecord>&   records )
+    {
+        records.clear();
+
+        FILE* file = nullptr;
+        if(_tfopen_s(&file, fileName, _T("rb")) != 0 || file == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        LSTATUS          status = ERROR_SUCCESS;
+        ChangeFileHeader header;
+        if( fread(&header, sizeof(header), 1, file) != 1 ||
+            header.magic != ChangeFileHeader::Magic ||
+            header.version != ChangeFileHeader::Version )
+            status = ERROR_BAD_FORMAT;
+
+        for(DWORD i = 0; i < header.recordCount && status == ERROR_SUCCESS; i++)
+        {
+            ChangeFileRecord fileRecord;
+            if(fread(&fileRecord, sizeof(fileRecord), 1, file) != 1)
+            {
+                status = ERROR_BAD_FORMAT;
+                break;
+            }
+
+            ChangeRecord record;
+            record.timeMicros   = fileRecord.timeMicros;
+            record.deleted      = (fileRecord.deleted != 0);
+            record.type         = (DataType)fileRecord.type;
+            record.name.resize(fileRecord.nameLength);
+            record.data.resize(fileRecord.dataSize);
+
+            if( (fileRecord.nameLength != 0 && fread(&record.name[0], sizeof(TCHAR), fileRecord.nameLength, file) != fileRecord.nameLength) ||
+                (fileRecord.dataSize != 0 && fread(&record.data[0], 1, fileRecord.dataSize, file) != fileRecord.dataSize) )
+            {
+                status = ERROR_BAD_FORMAT;
+                break;
+            }
+
+            records.push_back(record);
+        }
+
+        fclose(file);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ChangeTrace::Apply( _In_ const Key&           key,
+                                _In_ const ChangeRecord&  record )
+    {
+        if(record.deleted)
+            return key.DeleteValue(record.name.c_str());
+
+        return key.SetValue( record.name.c_str(),
+                             record.data.empty() ? nullptr : &record.data[0],
+                             (DWORD)record.data.size(),
+                             record.type );
+    }
+}
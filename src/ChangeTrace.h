@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        ChangeTrace.h
+///  Description: Records the changes made to the values of a key, and applies them back.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_CHANGETRACE_H
+#define INCLUDED_CHANGETRACE_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <string>
+#include <vector>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// One value change. The first records of a trace hold the values found when the recording started.
+    struct ChangeRecord
+    {
+        unsigned long long          timeMicros;     /// Time since the recording started.
+        bool                        deleted;
+        DataType                    type;
+        std::basic_string<TCHAR>    name;
+        std::vector<BYTE>           data;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ChangeTrace
+    {
+    public:
+
+        /// Watches a key for the given time and writes every value change to a trace file.
+        /// Changes made between two notifications are seen as one.
+        static LSTATUS Record( _In_     PredefinedKey   mainKey,
+                               _In_z_   const TCHAR*    subKeyPath,
+                               _In_z_   const TCHAR*    fileName,
+                               _In_     DWORD           durationMs );
+
+        static LSTATUS Load( _In_z_ const TCHAR*                 fileName,
+                             _Out_  std::vector<ChangeRecord>&   records );
+
+        /// Makes the change described by the record on a key.
+        static LSTATUS Apply( _In_ const Key&           key,
+                              _In_ const ChangeRecord&  record );
+    };
+}
+
+#endif // INCLUDED_CHANGETRACE_H
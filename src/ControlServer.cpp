@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        ControlServer.cpp
+///  Description: Local named pipe endpoint used by scripts and launchers to read and change the
+///               swap state without going through the tray menu.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./ControlServer.h"
+
+#include <sddl.h>
+
+namespace Enforcement
+{
+    // The tool runs elevated, but the launchers driving it usually do not: interactive users can
+    // read and write the pipe, and only the system and the administrators can add instances to it.
+    // That protects the name only while an instance exists, so the first one is created with
+    // FILE_FLAG_FIRST_PIPE_INSTANCE, failing Start when another process took the name before, and
+    // the server keeps one instance from then on.
+    static const TCHAR* const controlPipeSecurity = _T("D:(A;;GA;;;SY)(A;;GA;;;BA)(A;;GRGW;;;IU)");
+
+    static const DWORD        controlCallTimeout  = 1000;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ControlServer::ControlServer()
+    {
+        m_pipeName[0]   = 0;
+        m_shouldClose   = false;
+        m_acceptor      = nullptr;
+        m_firstPipe     = INVALID_HANDLE_VALUE;
+        m_generation    = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ControlServer::~ControlServer()
+    {
+        Stop();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ControlServer::Start( _In_z_ const TCHAR*                           pipeName,
+                                  _In_   const std::function <bool ()>&           getState,
+                                  _In_   const std::function <void (_In_ bool)>&  setState )
+    {
+        if(m_acceptor != nullptr)
+            return ERROR_ALREADY_EXISTS;
+
+        _tcscpy_s(m_pipeName, MAX_PATH, pipeName);
+
+        m_firstPipe = CreateInstance(true);
+        if(m_firstPipe == INVALID_HANDLE_VALUE)
+            return GetLastError();
+
+        m_getState      = getState;
+        m_setState      = setState;
+        m_shouldClose   = false;
+        m_acceptor      = new std::thread(&ControlServer::AcceptWorker, this);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void ControlServer::Stop()
+    {
+        if(m_acceptor == nullptr)
+            return;
+
+        m_shouldClose = true;
+
+        // Unblock the pending ConnectNamedPipe.
+        HANDLE pipe = CreateFile(m_pipeName, GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if(pipe != INVALID_HANDLE_VALUE)
+            CloseHandle(pipe);
+
+        m_acceptor->join();
+        delete m_acceptor;
+        m_acceptor = nullptr;
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_changed.notify_all();
+        }
+
+        ReapClients(true);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void ControlServer::OnStateChanged()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        m_generation++;
+        m_changed.notify_all();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void ControlServer::SetState( _In_ bool state )
+    {
+        if(state == m_getState())
+            return;
+
+        m_setState(state);
+        OnStateChanged();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    DWORD ControlServer::Execute( _In_reads_bytes_(size)  const BYTE*     request,
+                                  _In_                    DWORD           size,
+                                  _Out_writes_(size)      BYTE*           reply,
+                                  _Out_                   bool*           subscribe,
+                                  _Out_                   DWORD*          generation )
+    {
+        std::lock_guard<std::mutex> guard(m_stateLock);
+
+        DWORD replySize = 0;
+
+        *subscribe  = false;
+        *generation = 0;
+
+        for(DWORD i = 0; i < size && !*subscribe; i++)
+        {
+            switch((ControlOp)request[i])
+            {
+            case ControlOp::Get:
+                break;
+
+            case ControlOp::Set:
+                if(i + 1 >= size || request[i + 1] > 1)
+                {
+                    reply[replySize++] = ControlError;
+                    return replySize;
+                }
+
+                SetState(request[++i] != 0);
+                break;
+
+            case ControlOp::Toggle:
+                SetState(!m_getState());
+                break;
+
+            case ControlOp::Subscribe:
+                {
+                    std::lock_guard<std::mutex> lock(m_lock);
+                    *generation = m_generation;
+                    *subscribe  = true;
+                }break;
+
+            default:
+                reply[replySize++] = ControlError;
+                return replySize;
+            }
+
+            reply[replySize++] = m_getState() ? 1 : 0;
+        }
+
+        return replySize;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    HANDLE ControlServer::CreateInstance( _In_ bool first )
+    {
+        SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), nullptr, FALSE };
+        if(!ConvertStringSecurityDescriptorToSecurityDescriptor( controlPipeSecurity,
+                                                                 SDDL_REVISION_1,
+                                                                 &security.lpSecurityDescriptor,
+                                                                 nullptr ))
+            return INVALID_HANDLE_VALUE;
+
+        HANDLE pipe = CreateNamedPipe( m_pipeName,
+                                       PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                                       PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                       PIPE_UNLIMITED_INSTANCES,
+                                       MaxMessageSize,
+                                       MaxMessageSize,
+                                       0,
+                                       &security );
+
+        DWORD error = GetLastError();
+        LocalFree(security.lpSecurityDescriptor);
+        SetLastError(error);
+
+        return pipe;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void ControlServer::AcceptWorker()
+    {
+        HANDLE pipe = m_firstPipe;
+        m_firstPipe = INVALID_HANDLE_VALUE;
+
+        while(!m_shouldClose)
+        {
+            // A failed connection keeps its instance, so the name is never left free.
+            if(!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+            {
+                if(!DisconnectNamedPipe(pipe))
+                    break;
+                continue;
+            }
+
+            if(m_shouldClose)
+                break;
+
+            // The next instance is made before this one goes to a client, which can close it at once.
+            HANDLE next = CreateInstance(false);
+
+            Client* client  = new Client;
+            client->pipe    = pipe;
+            client->done    = false;
+
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+
+                ReapClients(false);
+
+                client->thread = new std::thread(&ControlServer::ClientWorker, this, client);
+                m_clients.push_back(client);
+            }
+
+            pipe = next;
+            if(pipe == INVALID_HANDLE_VALUE)
+                return;
+        }
+
+        CloseHandle(pipe);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void ControlServer::ClientWorker( _In_ Client* client )
+    {
+        BYTE request[MaxMessageSize];
+        BYTE reply[MaxMessageSize];
+
+        while(!m_shouldClose)
+        {
+            DWORD read = 0;
+            if(!ReadFile(client->pipe, request, sizeof(request), &read, nullptr) || read == 0)
+                break;
+
+            bool  subscribe;
+            DWORD generation;
+            DWORD replySize = Execute(request, read, reply, &subscribe, &generation);
+
+            DWORD written = 0;
+            if(!WriteFile(client->pipe, reply, replySize, &written, nullptr))
+                break;
+
+            if(subscribe)
+            {
+                Subscribe(client, generation);
+                break;
+            }
+        }
+
+        DisconnectNamedPipe(client->pipe);
+        CloseHandle(client->pipe);
+
+        client->done = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void ControlServer::Subscribe( _In_ Client* client, _In_ DWORD generation )
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        while(!m_shouldClose)
+        {
+            m_changed.wait(lock, [&] () { return m_shouldClose || m_generation != generation; });
+            if(m_shouldClose)
+                break;
+
+            generation = m_generation;
+            lock.unlock();
+
+            BYTE  state   = m_getState() ? 1 : 0;
+            DWORD written = 0;
+            BOOL  sent    = WriteFile(client->pipe, &state, 1, &written, nullptr);
+
+            lock.lock();
+
+            // The client went away.
+            if(!sent)
+                break;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Joins the connection threads that are done; with all, makes the others finish first.
+    /// Called with m_lock held, unless all is set.
+    void ControlServer::ReapClients( _In_ bool all )
+    {
+        for(auto it = m_clients.begin(); it != m_clients.end(); )
+        {
+            Client* client = *it;
+
+            // A thread blocked in ReadFile only returns when its I/O is cancelled. It can enter ReadFile
+            // right after a cancel, so keep cancelling until it is done.
+            while(all && !client->done)
+            {
+                CancelSynchronousIo((HANDLE)client->thread->native_handle());
+                Sleep(1);
+            }
+
+            if(!client->done)
+            {
+                ++it;
+                continue;
+            }
+
+            client->thread->join();
+            delete client->thread;
+            delete client;
+
+            it = m_clients.erase(it);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ControlServer::Call( _In_z_                          const TCHAR*    pipeName,
+                                 _In_reads_bytes_(requestSize)   const BYTE*     request,
+                                 _In_                            DWORD           requestSize,
+                                 _Out_writes_bytes_(replySize)   BYTE*           reply,
+                                 _In_                            DWORD           replySize,
+                                 _Out_                           DWORD*          replied )
+    {
+        *replied = 0;
+
+        if(!CallNamedPipe(pipeName, (LPVOID)request, requestSize, reply, replySize, replied, controlCallTimeout))
+            return GetLastError();
+
+        return ERROR_SUCCESS;
+    }
+}
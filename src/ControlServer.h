@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        ControlServer.h
+///  Description: Local named pipe endpoint used by scripts and launchers to read and change the
+///               swap state without going through the tray menu.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_CONTROLSERVER_H
+#define INCLUDED_CONTROLSERVER_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The commands of the control protocol.
+    ///
+    /// The pipe works in message mode. A request message holds one or more commands, each one an
+    /// op byte; Set is followed by one more byte, 0 or 1. The reply message holds one byte per
+    /// command: the swap state after the command (0 or 1), or ControlError for a bad command, after
+    /// which the rest of the request is ignored.
+    /// After Subscribe the connection takes no more commands; the server sends a one byte message
+    /// with the new state on every change, until the client disconnects.
+    enum class ControlOp : BYTE
+    {
+        Get         = 1,
+        Set         = 2,
+        Toggle      = 3,
+        Subscribe   = 4
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class ControlServer
+    {
+    public:
+
+        static const BYTE   ControlError    = 0xFF;
+        static const DWORD  MaxMessageSize  = 256;
+
+        ControlServer();
+
+        ~ControlServer();
+
+        /// Starts serving on a local pipe ("\\.\pipe\<name>"). The callbacks run on the connection
+        /// threads; setState must apply the state before returning, as the reply tells the client it is
+        /// in place. Fails with ERROR_ACCESS_DENIED when another process already created the pipe.
+        LSTATUS Start( _In_z_ const TCHAR*                           pipeName,
+                       _In_   const std::function <bool ()>&           getState,
+                       _In_   const std::function <void (_In_ bool)>&  setState );
+
+        void Stop();
+
+        /// Tells the subscribers about a change made outside of the control pipe.
+        void OnStateChanged();
+
+        /// Sends one request and waits for the reply, connecting to the server for this call only.
+        static LSTATUS Call( _In_z_                          const TCHAR*    pipeName,
+                             _In_reads_bytes_(requestSize)   const BYTE*     request,
+                             _In_                            DWORD           requestSize,
+                             _Out_writes_bytes_(replySize)   BYTE*           reply,
+                             _In_                            DWORD           replySize,
+                             _Out_                           DWORD*          replied );
+
+    private:
+        struct Client
+        {
+            HANDLE          pipe;
+            std::thread*    thread;
+            volatile bool   done;
+        };
+
+        /// An instance of the pipe; the first one fails if the name exists. INVALID_HANDLE_VALUE on error.
+        HANDLE CreateInstance( _In_ bool first );
+
+        void AcceptWorker();
+        void ClientWorker( _In_ Client* client );
+        void Subscribe( _In_ Client* client, _In_ DWORD generation );
+        void ReapClients( _In_ bool all );
+        void SetState( _In_ bool state );
+
+        /// Runs the commands of one request, and returns the size of the reply. When the request ends
+        /// with Subscribe, generation receives the generation the reply state belongs to.
+        DWORD Execute( _In_reads_bytes_(size)  const BYTE*     request,
+                       _In_                    DWORD           size,
+                       _Out_writes_(size)      BYTE*           reply,
+                       _Out_                   bool*           subscribe,
+                       _Out_                   DWORD*          generation );
+
+        TCHAR                                   m_pipeName[MAX_PATH];
+        std::function <bool ()>                 m_getState;
+        std::function <void (_In_ bool)>        m_setState;
+
+        volatile bool                           m_shouldClose;
+        std::thread*                            m_acceptor;
+        HANDLE                                  m_firstPipe;        /// Created by Start, then connected by the acceptor.
+
+        std::mutex                              m_stateLock;        /// Serializes the commands of all the connections.
+        std::mutex                              m_lock;             /// Guards the clients and the generation.
+        std::condition_variable                 m_changed;
+        DWORD                                   m_generation;       /// Incremented on every state change.
+        std::list<Client*>                      m_clients;
+    };
+}
+
+#endif // INCLUDED_CONTROLSERVER_H
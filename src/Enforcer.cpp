@@ -0,0 +1,427 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Enforcer.cpp
+///  Description: Keeps the InterleavePattern values in place, backing off when the 3D Vision
+///               service keeps rewriting them.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Enforcer.h"
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    const TCHAR* const Enforcer::ValuePattern0 = _T("InterleavePattern0");
+    const TCHAR* const Enforcer::ValuePattern1 = _T("InterleavePattern1");
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    StormDetector::StormDetector( _In_opt_ DWORD windowMs,
+                                  _In_opt_ DWORD enterRate,
+                                  _In_opt_ DWORD leaveRate,
+                                  _In_opt_ DWORD baseDelay,
+                                  _In_opt_ DWORD maxDelay )
+    {
+        m_bucketMs  = (windowMs >= BucketCount) ? windowMs / BucketCount : 1;
+        m_enterRate = enterRate;
+        m_leaveRate = (leaveRate < enterRate) ? leaveRate : enterRate;
+        m_baseDelay = baseDelay;
+        m_maxDelay  = (maxDelay > baseDelay) ? maxDelay : baseDelay;
+
+        memset(m_buckets, 0, sizeof(m_buckets));
+        m_lastSlot  = 0;
+
+        m_storm     = false;
+        m_level     = 0;
+        m_delay     = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void StormDetector::Advance( _In_ ULONGLONG now )
+    {
+        ULONGLONG slot = now / m_bucketMs;
+
+        if(slot <= m_lastSlot)
+            return;
+
+        if(slot - m_lastSlot >= BucketCount)
+            memset(m_buckets, 0, sizeof(m_buckets));
+        else
+        {
+            for(ULONGLONG s = m_lastSlot + 1; s <= slot; s++)
+                m_buckets[s % BucketCount] = 0;
+        }
+
+        m_lastSlot = slot;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    DWORD StormDetector::GetRate() const
+    {
+        DWORD rate = 0;
+        for(DWORD i = 0; i < BucketCount; i++)
+            rate += m_buckets[i];
+
+        return rate;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    DWORD StormDetector::OnRewrite( _In_ ULONGLONG now )
+    {
+        Advance(now);
+        m_buckets[m_lastSlot % BucketCount]++;
+
+        DWORD rate = GetRate();
+
+        if(!m_storm)
+        {
+            if(rate < m_enterRate)
+                return 0;
+
+            m_storm = true;
+            m_level = 0;
+        }
+
+        // Every rewrite seen during the storm doubles the delay, up to the maximum.
+        DWORD delay = m_baseDelay;
+        for(DWORD i = 0; i < m_level && delay < m_maxDelay; i++)
+            delay *= 2;
+
+        if(delay > m_maxDelay)
+            delay = m_maxDelay;
+        else
+            m_level++;
+
+        m_delay = delay;
+
+        return delay;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool StormDetector::Update( _In_ ULONGLONG now )
+    {
+        Advance(now);
+
+        if(m_storm && GetRate() <= m_leaveRate)
+        {
+            m_storm = false;
+            m_level = 0;
+            m_delay = 0;
+        }
+
+        return m_storm;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Enforcer::Enforcer( _In_     Registry::Key*   key,
+                        _In_opt_ Strategy         strategy )
+    {
+        m_key           = key;
+        m_strategy      = strategy;
+        m_eyesSwapped   = true;
+        m_stopEvent     = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        m_poller        = nullptr;
+        m_notifyId      = 0;
+        m_journal       = nullptr;
+        m_scheduler     = nullptr;
+        m_enforcePending = 0;
+        m_enforceId     = 0;
+        m_verifyId      = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Enforcer::~Enforcer()
+    {
+        Stop();
+
+        if(m_stopEvent != nullptr)
+            CloseHandle(m_stopEvent);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Enforcer::Start( _In_opt_ const std::function <void (_In_ bool)>& onStormChanged,
+                             _In_opt_ const Registry::NotifyOptions&          notifyOptions,
+                             _In_opt_ WatchMode                               watchMode,
+                             _In_opt_ const Registry::PollOptions&            pollOptions )
+    {
+        if(m_key == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        // The delays of a storm run on the scheduler; the notify thread must never wait them out.
+        if(m_strategy == Strategy::Adaptive && m_scheduler == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        m_onStormChanged = onStormChanged;
+        ResetEvent(m_stopEvent);
+
+        LSTATUS status = ERROR_SUCCESS;
+
+        if(watchMode != WatchMode::Poll)
+        {
+            // The driver keeps updating other values of the key; only the changes to ours get here.
+            const TCHAR* const valueNames[] = { ValuePattern0, ValuePattern1 };
+
+            status = m_key->AddValueNotify( [this] (Registry::Key &key, void *userData) -> bool
+                {
+                    UNREFERENCED_PARAMETER(key);
+                    UNREFERENCED_PARAMETER(userData);
+
+                    return OnNotify();
+                },
+                valueNames,
+                _countof(valueNames),
+                nullptr,
+                notifyOptions,
+                &m_notifyId
+            );
+
+            if(status != ERROR_SUCCESS)
+                return status;
+        }
+
+        if(m_scheduler != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(m_timerLock);
+
+            // A safety net for the changes whose notifications were lost.
+            m_verifyId = m_scheduler->Schedule( m_key, VerifyMs, [this] (Registry::Key &key) -> DWORD
+                {
+                    UNREFERENCED_PARAMETER(key);
+
+                    bool rewritten = false;
+                    if(Enforce(&rewritten) == ERROR_SUCCESS && rewritten)
+                        Registry::Metrics::Increment(Registry::Counter::Rewrites);
+
+                    return VerifyMs;
+                }
+            );
+        }
+
+        if(watchMode != WatchMode::Notify)
+        {
+            delete m_poller;
+            m_poller = new Registry::Poller(m_key, pollOptions);
+
+            status = m_poller->Start( [this] (Registry::Key &key) -> bool
+                {
+                    UNREFERENCED_PARAMETER(key);
+
+                    return OnNotify();
+                }
+            );
+        }
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Enforcer::Stop()
+    {
+        SetEvent(m_stopEvent);
+
+        // Other subscribers of the key keep their notifications.
+        if(m_notifyId != 0)
+        {
+            m_key->RemoveNotify(m_notifyId);
+            m_notifyId = 0;
+        }
+
+        if(m_scheduler != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(m_timerLock);
+
+            // Waits for a timer running now, so the enforcer can be deleted after.
+            if(m_enforceId != 0)
+                m_scheduler->Cancel(m_enforceId);
+            if(m_verifyId != 0)
+                m_scheduler->Cancel(m_verifyId);
+
+            m_enforceId         = 0;
+            m_verifyId          = 0;
+            m_enforcePending    = 0;
+        }
+
+        if(m_poller != nullptr)
+        {
+            delete m_poller;
+            m_poller = nullptr;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Enforcer::SetEyesSwapped( _In_ bool eyesSwapped )
+    {
+        m_eyesSwapped = eyesSwapped;
+
+        return Enforce();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Enforcer::Enforce( _Out_opt_ bool* rewritten )
+    {
+        if(rewritten != nullptr)
+            *rewritten = false;
+
+        if(m_key == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        DWORD pattern = GetPattern(m_eyesSwapped);
+
+        // Reading is much cheaper than writing, and skipping the write avoids waking up the service.
+        if(IsInPlace(pattern))
+            return ERROR_SUCCESS;
+
+        if(rewritten != nullptr)
+            *rewritten = true;
+
+        LSTATUS status = Write(pattern);
+
+        // The driver installer can delete the key and create it again; the old handle then fails.
+        if(status == ERROR_KEY_DELETED && m_key->Reopen() == ERROR_SUCCESS)
+            status = Write(pattern);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Enforcer::IsInPlace( _In_ DWORD pattern ) const
+    {
+        const TCHAR* const names[] = { ValuePattern0, ValuePattern1 };
+
+        DWORD pattern0 = 0;
+        DWORD pattern1 = 0;
+
+        // Both patterns in one registry call.
+        bool inPlace = m_key->GetValues(names, std::tie(pattern0, pattern1)) == ERROR_SUCCESS &&
+                       pattern0 == pattern && pattern1 == pattern;
+
+        if(inPlace)
+            Registry::Metrics::Increment(Registry::Counter::ValuesSkipped, 2);
+
+        return inPlace;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Enforcer::Write( _In_ DWORD pattern ) const
+    {
+        // The values as they are now, usually as the service wrote them, can be put back later. A
+        // value that can't be recorded is enforced anyway.
+        if(m_journal != nullptr)
+        {
+            m_journal->Record(*m_key, ValuePattern0);
+            m_journal->Record(*m_key, ValuePattern1);
+        }
+
+        LSTATUS status = m_key->SetValueDWORD(ValuePattern0, pattern);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        return m_key->SetValueDWORD(ValuePattern1, pattern);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Enforcer::UpdateStorm()
+    {
+        bool wasStorm;
+        bool isStorm;
+        {
+            std::lock_guard<std::mutex> lock(m_stormLock);
+            wasStorm = m_storm.IsStorm();
+            isStorm  = m_storm.Update(GetTickCount64());
+        }
+
+        NotifyStorm(wasStorm);
+
+        return isStorm;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Enforcer::NotifyStorm( _In_ bool wasStorm )
+    {
+        bool isStorm = m_storm.IsStorm();
+
+        if(isStorm && !wasStorm)
+            Registry::Metrics::Increment(Registry::Counter::StormsEntered);
+
+        if(isStorm != wasStorm && m_onStormChanged)
+            m_onStormChanged(isStorm);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Enforcer::OnNotify()
+    {
+        DWORD pattern = GetPattern(m_eyesSwapped);
+
+        // The notification may be for any other value of the key.
+        if(IsInPlace(pattern))
+            return true;
+
+        Registry::Metrics::Increment(Registry::Counter::Rewrites);
+
+        DWORD delay = 0;
+        if(m_strategy == Strategy::Adaptive)
+        {
+            bool wasStorm;
+            {
+                std::lock_guard<std::mutex> lock(m_stormLock);
+                wasStorm = m_storm.IsStorm();
+                delay    = m_storm.OnRewrite(GetTickCount64());
+            }
+
+            NotifyStorm(wasStorm);
+        }
+
+        if(delay == 0)
+        {
+            if(Write(pattern) != ERROR_SUCCESS && m_scheduler != nullptr)
+                ScheduleEnforce(FirstRetryMs);
+
+            return true;
+        }
+
+        // During a storm let the service finish its burst, then write once. The values are checked again,
+        // so nothing is written if the service restored them by itself in the meantime.
+        ScheduleEnforce(delay);
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Enforces the values on the scheduler after delayMs, and again with a doubling delay while the
+    /// writes fail. One pending enforcement covers all the changes seen until it runs.
+    void Enforcer::ScheduleEnforce( _In_ DWORD delayMs )
+    {
+        std::lock_guard<std::mutex> lock(m_timerLock);
+
+        if(WaitForSingleObject(m_stopEvent, 0) == WAIT_OBJECT_0)
+            return;
+
+        if(InterlockedCompareExchange(&m_enforcePending, 1, 0) != 0)
+            return;
+
+        m_enforceId = m_scheduler->Schedule( m_key, delayMs, [this, delayMs] (Registry::Key &key) mutable -> DWORD
+            {
+                UNREFERENCED_PARAMETER(key);
+
+                if(Enforce() == ERROR_SUCCESS)
+                {
+                    m_enforcePending = 0;
+                    return 0;
+                }
+
+                delayMs = (delayMs * 2 < MaxRetryMs) ? delayMs * 2 : MaxRetryMs;
+                return delayMs;
+            }
+        );
+    }
+}
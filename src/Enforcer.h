@@ -0,0 +1,203 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Enforcer.h
+///  Description: Keeps the InterleavePattern values in place, backing off when the 3D Vision
+///               service keeps rewriting them.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_ENFORCER_H
+#define INCLUDED_ENFORCER_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <functional>
+#include <mutex>
+
+#include "./Registry.h"
+#include "./Poller.h"
+#include "./Scheduler.h"
+#include "./UndoJournal.h"
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// How the enforcer reacts when the values it owns get rewritten by someone else.
+    enum class Strategy
+    {
+        Immediate,      /// Always write back the values as soon as a change is seen.
+        Adaptive        /// Write back immediately, but delay and back-off exponentially during a rewrite storm.
+                        /// Needs a scheduler, which runs the delayed writes.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// How the enforcer sees the changes made to the key.
+    enum class WatchMode
+    {
+        Notify,         /// Change notifications; the key needs the Notify right.
+        Poll,           /// Polling; the key needs only the Query_Value right.
+        NotifyAndPoll   /// Both, so the changes made while a notification is handled are not missed.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Sliding window rate estimator used to detect a rewrite storm.
+    /// The window is split in buckets, so recording and querying the rate are O(1).
+    class StormDetector
+    {
+    public:
+
+        StormDetector( _In_opt_ DWORD windowMs  = 1000,
+                       _In_opt_ DWORD enterRate = 8,
+                       _In_opt_ DWORD leaveRate = 2,
+                       _In_opt_ DWORD baseDelay = 50,
+                       _In_opt_ DWORD maxDelay  = 2000 );
+
+        /// Records a rewrite and returns how long (in ms) the re-enforcement should be delayed.
+        DWORD OnRewrite( _In_ ULONGLONG now );
+
+        /// Expires old buckets and leaves the storm state when the rate dropped. Returns the storm state.
+        bool Update( _In_ ULONGLONG now );
+
+        bool IsStorm() const
+        {
+            return m_storm;
+        }
+
+        DWORD GetBackoff() const
+        {
+            return m_delay;
+        }
+
+    private:
+        static const DWORD  BucketCount = 10;
+
+        void  Advance( _In_ ULONGLONG now );
+        DWORD GetRate() const;
+
+        DWORD               m_bucketMs;
+        DWORD               m_enterRate;
+        DWORD               m_leaveRate;
+        DWORD               m_baseDelay;
+        DWORD               m_maxDelay;
+
+        DWORD               m_buckets[BucketCount];
+        ULONGLONG           m_lastSlot;
+
+        volatile bool       m_storm;
+        DWORD               m_level;
+        volatile DWORD      m_delay;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Owns the InterleavePattern0/1 values of the Stereo3D key and restores them whenever they change.
+    class Enforcer
+    {
+    public:
+
+        Enforcer( _In_     Registry::Key*   key,
+                  _In_opt_ Strategy         strategy = Strategy::Adaptive );
+
+        ~Enforcer();
+
+        /// Starts watching the key. onStormChanged is called from the watcher threads.
+        /// Fails with ERROR_INVALID_PARAMETER for the Adaptive strategy without a scheduler.
+        LSTATUS Start( _In_opt_ const std::function <void (_In_ bool)>& onStormChanged = nullptr,
+                       _In_opt_ const Registry::NotifyOptions&          notifyOptions  = Registry::NotifyOptions(),
+                       _In_opt_ WatchMode                               watchMode      = WatchMode::Notify,
+                       _In_opt_ const Registry::PollOptions&            pollOptions    = Registry::PollOptions() );
+
+        /// Aborts any pending delayed re-enforcement and stops the polling. The key must be closed
+        /// afterwards to stop the notifications.
+        void Stop();
+
+        /// Writes the values for the given state, if they are not already in place.
+        LSTATUS SetEyesSwapped( _In_ bool eyesSwapped );
+
+        /// Every value is recorded in the journal before it is overwritten; nullptr stops it.
+        /// Set it before Start.
+        void SetJournal( _In_opt_ Registry::UndoJournal* journal )
+        {
+            m_journal = journal;
+        }
+
+        /// The delayed re-enforcements of a storm and the retries of failed writes run on the scheduler,
+        /// never on the notify thread, and the values are also checked every VerifyMs. Required by the
+        /// Adaptive strategy; without one, a failed write waits for the next change. Set it before Start.
+        void SetScheduler( _In_opt_ Registry::Scheduler* scheduler )
+        {
+            m_scheduler = scheduler;
+        }
+
+        bool GetEyesSwapped() const
+        {
+            return m_eyesSwapped;
+        }
+
+        /// Re-evaluates the storm state; call it periodically while IsStorm() is true.
+        bool UpdateStorm();
+
+        bool IsStorm() const
+        {
+            return m_storm.IsStorm();
+        }
+
+        DWORD GetBackoff() const
+        {
+            return m_storm.GetBackoff();
+        }
+
+        /// Checks the values and writes them back if they are not the expected ones.
+        /// @return ERROR_SUCCESS if the values were already in place or were written.
+        LSTATUS Enforce( _Out_opt_ bool* rewritten = nullptr );
+
+        static DWORD GetPattern( _In_ bool eyesSwapped )
+        {
+            return eyesSwapped ? 0xFF00FF00 : 0x00FF00FF;
+        }
+
+        static const TCHAR* const  ValuePattern0;
+        static const TCHAR* const  ValuePattern1;
+
+        static const DWORD         VerifyMs     = 5000;    /// Period of the checks on the scheduler.
+        static const DWORD         FirstRetryMs = 50;      /// Delay of the first retry of a failed write.
+        static const DWORD         MaxRetryMs   = 2000;
+
+    private:
+        bool    OnNotify();
+        bool    IsInPlace( _In_ DWORD pattern ) const;
+        LSTATUS Write( _In_ DWORD pattern ) const;
+        void    NotifyStorm( _In_ bool wasStorm );
+        void    ScheduleEnforce( _In_ DWORD delayMs );
+
+        Registry::Key*                      m_key;
+        Strategy                            m_strategy;
+        volatile bool                       m_eyesSwapped;
+        HANDLE                              m_stopEvent;
+        Registry::Poller*                   m_poller;
+        Registry::NotifyId                  m_notifyId;     /// 0 while not subscribed to the key.
+        Registry::UndoJournal*              m_journal;
+
+        Registry::Scheduler*                m_scheduler;
+        std::mutex                          m_timerLock;    /// Keeps Stop from racing a new timer.
+        volatile LONG                       m_enforcePending;
+        Registry::TimerId                   m_enforceId;
+        Registry::TimerId                   m_verifyId;
+
+        std::mutex                          m_stormLock;
+        StormDetector                       m_storm;
+        std::function <void (_In_ bool)>    m_onStormChanged;
+    };
+}
+
+#endif // INCLUDED_ENFORCER_H
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Epoch.cpp
+///  Description: Epoch based reclamation, so readers never block on a writer replacing what they read.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Epoch.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Epoch::Epoch()
+    {
+        m_current = 0;
+
+        for(DWORD epoch = 0; epoch < 2; epoch++)
+        {
+            for(DWORD stripe = 0; stripe < Stripes; stripe++)
+                m_counters[epoch][stripe].readers = 0;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Epoch::Reader::Reader( _In_ Epoch& epoch )
+    {
+        DWORD stripe = GetCurrentProcessorNumber() % Stripes;
+
+        // A writer may flip the epoch between the read and the increment; the reader then leaves the
+        // counter it can't be sure was seen, and enters the new epoch.
+        for(;;)
+        {
+            LONG current = epoch.m_current.load();
+
+            m_counter = &epoch.m_counters[current & 1][stripe].readers;
+            m_counter->fetch_add(1);
+
+            if(((epoch.m_current.load() ^ current) & 1) == 0)
+                break;
+
+            m_counter->fetch_sub(1);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Epoch::Synchronize()
+    {
+        std::lock_guard<std::mutex> guard(m_writerLock);
+
+        // New readers go to the other counters; the ones of the previous epoch only go down.
+        LONG previous = m_current.fetch_add(1) & 1;
+
+        for(DWORD stripe = 0; stripe < Stripes; stripe++)
+        {
+            DWORD spins = 0;
+            while(m_counters[previous][stripe].readers.load() != 0)
+            {
+                if(++spins < 64)
+                    YieldProcessor();
+                else
+                    SwitchToThread();
+            }
+        }
+    }
+}
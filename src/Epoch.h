@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Epoch.h
+///  Description: Epoch based reclamation, so readers never block on a writer replacing what they read.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_EPOCH_H
+#define INCLUDED_EPOCH_H
+
+#include <windows.h>
+#include <atomic>
+#include <mutex>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// A read-copy-update scheme: readers enter the epoch, read a published pointer or handle and use
+    /// it; a writer publishes the new one with an atomic exchange, calls Synchronize, and only then
+    /// frees the old one, since every reader that could still hold it has left.
+    ///
+    /// Entering and leaving are two interlocked operations on a counter of the current CPU, so
+    /// readers don't share a cache line and never wait. Synchronize flips the epoch and waits for the
+    /// counters of the previous one to drain; it must never be called from inside a Reader.
+    class Epoch
+    {
+    public:
+        static const DWORD Stripes = 16;    // Counters per epoch; the readers pick one by CPU.
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////
+        class Reader
+        {
+        public:
+            explicit Reader( _In_ Epoch& epoch );
+
+            ~Reader()
+            {
+                m_counter->fetch_sub(1, std::memory_order_release);
+            }
+
+        private:
+            Reader( const Reader& );
+            Reader& operator = ( const Reader& );
+
+            std::atomic<LONG>*  m_counter;
+        };
+
+        Epoch();
+
+        /// Waits until every reader that entered before the call has left.
+        void Synchronize();
+
+    private:
+        Epoch( const Epoch& );
+        Epoch& operator = ( const Epoch& );
+
+        struct Counter
+        {
+            std::atomic<LONG>   readers;
+            BYTE                padding[64 - sizeof(LONG)];    // One cache line per counter.
+        };
+
+        std::atomic<LONG>   m_current;
+        Counter             m_counters[2][Stripes];
+        std::mutex          m_writerLock;           // Writers flip the epoch one at a time.
+    };
+}
+
+#endif // INCLUDED_EPOCH_H
@@ -0,0 +1,331 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        HashTree.cpp
+///  Description: Content hashes of the values and Merkle hashes of the subkeys of a registry tree,
+///               used to find what changed without comparing the whole tree.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./HashTree.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HASHTREE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Registry
+{
+    typedef std::basic_string<TCHAR> HashString;
+
+    // Every 16 byte block is mixed with a different key, so swapping two blocks changes the hash.
+    static const QWORD  hashKey0        = 0x9E3779B185EBCA87ULL;
+    static const QWORD  hashKey1        = 0xC2B2AE3D27D4EB4FULL;
+    static const QWORD  hashKeyStep0    = 0x165667B19E3779F9ULL;
+    static const QWORD  hashKeyStep1    = 0x27D4EB2F165667C5ULL;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static inline QWORD Avalanche( _In_ QWORD h )
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+
+        return h;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static inline QWORD Combine( _In_ QWORD h, _In_ QWORD value )
+    {
+        return Avalanche(h * hashKey0 + value);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// One block: each 64-bit lane adds the product of its keyed halves and the other data lane.
+    static inline void HashBlock( _Inout_ QWORD acc[2], _In_ const QWORD data[2], _In_ const QWORD key[2] )
+    {
+        QWORD k0 = data[0] ^ key[0];
+        QWORD k1 = data[1] ^ key[1];
+
+        acc[0] += (k0 & 0xFFFFFFFF) * (k0 >> 32) + data[1];
+        acc[1] += (k1 & 0xFFFFFFFF) * (k1 >> 32) + data[0];
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    QWORD HashTree::HashBytes( _In_reads_bytes_(size) const void* data, _In_ size_t size, _In_opt_ QWORD seed )
+    {
+        const BYTE* bytes   = (const BYTE*)data;
+        size_t      blocks  = size / 16;
+
+        QWORD acc[2] = { seed ^ hashKey0, seed ^ hashKey1 };
+        QWORD key[2] = { hashKey0, hashKey1 };
+
+#ifdef HASHTREE_SSE2
+        __m128i accVector   = _mm_loadu_si128((const __m128i*)acc);
+        __m128i keyVector   = _mm_loadu_si128((const __m128i*)key);
+        __m128i keyStep     = _mm_set_epi64x((long long)hashKeyStep1, (long long)hashKeyStep0);
+
+        for(size_t i = 0; i < blocks; i++, bytes += 16)
+        {
+            __m128i dataVector  = _mm_loadu_si128((const __m128i*)bytes);
+            __m128i keyed       = _mm_xor_si128(dataVector, keyVector);
+            __m128i product     = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(3, 3, 1, 1)));
+            __m128i swapped     = _mm_shuffle_epi32(dataVector, _MM_SHUFFLE(1, 0, 3, 2));
+
+            accVector = _mm_add_epi64(accVector, _mm_add_epi64(product, swapped));
+            keyVector = _mm_add_epi64(keyVector, keyStep);
+        }
+
+        _mm_storeu_si128((__m128i*)acc, accVector);
+        _mm_storeu_si128((__m128i*)key, keyVector);
+#else
+        for(size_t i = 0; i < blocks; i++, bytes += 16)
+        {
+            QWORD block[2];
+            memcpy(block, bytes, 16);
+            HashBlock(acc, block, key);
+
+            key[0] += hashKeyStep0;
+            key[1] += hashKeyStep1;
+        }
+#endif
+
+        size_t tail = size % 16;
+        if(tail != 0)
+        {
+            QWORD block[2] = { 0, 0 };
+            memcpy(block, bytes, tail);
+            HashBlock(acc, block, key);
+        }
+
+        return Avalanche((QWORD)size * hashKeyStep0 + acc[0] + Avalanche(acc[1]));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool HashTree::Equal( _In_reads_bytes_(size) const void* a, _In_reads_bytes_(size) const void* b, _In_ size_t size )
+    {
+        const BYTE* bytesA = (const BYTE*)a;
+        const BYTE* bytesB = (const BYTE*)b;
+
+#ifdef HASHTREE_SSE2
+        for(; size >= 16; size -= 16, bytesA += 16, bytesB += 16)
+        {
+            __m128i equal = _mm_cmpeq_epi8( _mm_loadu_si128((const __m128i*)bytesA),
+                                            _mm_loadu_si128((const __m128i*)bytesB) );
+            if(_mm_movemask_epi8(equal) != 0xFFFF)
+                return false;
+        }
+#endif
+
+        return memcmp(bytesA, bytesB, size) == 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static inline QWORD HashName( _In_ const HashString& name )
+    {
+        return HashTree::HashBytes(name.c_str(), name.size() * sizeof(TCHAR));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS HashTree::BuildNode( _In_ Key& key, _In_ bool keepData, _Out_ HashNode& node )
+    {
+        node.values.clear();
+        node.children.clear();
+
+        LSTATUS status = key.EnumValues( [&node, keepData] (Value &value) -> bool
+            {
+                HashValue& entry = node.values[value.GetName()];
+                entry.type      = value.GetType();
+                entry.dataSize  = value.GetDataSize();
+                entry.hash      = HashBytes(value.GetData(), value.GetDataSize(), (QWORD)value.GetType());
+
+                if(keepData)
+                    entry.data.assign(value.GetData(), value.GetData() + value.GetDataSize());
+
+                return true;
+            }
+        );
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        std::vector<HashString> names;
+        status = key.EnumSubKeys( [&names] (Key &subKey) -> bool
+            {
+                names.push_back(subKey.GetSubKeyPath());
+                return true;
+            }
+        );
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        node.valuesHash = 0;
+        for(auto& value : node.values)
+            node.valuesHash = Combine(Combine(node.valuesHash, HashName(value.first)), value.second.hash);
+
+        for(auto& name : names)
+        {
+            // Subkeys deleted since the enumeration, or that cannot be read, are left out.
+            Key* subKey = key.OpenSubKey(name.c_str(), AccessRights::Read);
+            if(subKey == nullptr)
+                continue;
+
+            HashNode& child = node.children[name];
+            if(BuildNode(*subKey, keepData, child) != ERROR_SUCCESS)
+                node.children.erase(name);
+
+            subKey->Close();
+        }
+
+        node.hash = node.valuesHash;
+        for(auto& child : node.children)
+            node.hash = Combine(Combine(node.hash, HashName(child.first)), child.second.hash);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    HashTree* HashTree::Build( _In_        Key&            key,
+                               _In_opt_    bool            keepData,
+                               _Out_opt_   LSTATUS*        statusCode )
+    {
+        HashTree* tree   = new HashTree();
+        tree->m_keepData = keepData;
+
+        LSTATUS status = BuildNode(key, keepData, tree->m_root);
+
+        if(statusCode != nullptr)
+            *statusCode = status;
+
+        if(status != ERROR_SUCCESS)
+        {
+            delete tree;
+            return nullptr;
+        }
+
+        return tree;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool HashTree::DiffNode( _In_    const HashNode&             before,
+                             _In_    const HashNode&             after,
+                             _Inout_ HashString&                 path,
+                             _In_    const ChangeCallback&       callBack )
+    {
+        if(before.hash == after.hash)
+            return true;
+
+        if(before.valuesHash != after.valuesHash)
+        {
+            for(auto& value : after.values)
+            {
+                auto old = before.values.find(value.first);
+                if(old == before.values.end())
+                {
+                    if(!callBack(path.c_str(), value.first.c_str(), ChangeKind::ValueAdded))
+                        return false;
+
+                    continue;
+                }
+
+                const HashValue& a = old->second;
+                const HashValue& b = value.second;
+
+                // Equal hashes are confirmed byte by byte only when both trees kept the data.
+                bool changed = (a.type != b.type || a.dataSize != b.dataSize || a.hash != b.hash);
+                if(!changed && !a.data.empty() && a.data.size() == b.data.size())
+                    changed = !Equal(&a.data[0], &b.data[0], a.data.size());
+
+                if(changed && !callBack(path.c_str(), value.first.c_str(), ChangeKind::ValueChanged))
+                    return false;
+            }
+
+            for(auto& value : before.values)
+            {
+                if( after.values.find(value.first) == after.values.end() &&
+                    !callBack(path.c_str(), value.first.c_str(), ChangeKind::ValueRemoved) )
+                    return false;
+            }
+        }
+
+        size_t pathLen = path.size();
+
+        for(auto& child : after.children)
+        {
+            path.resize(pathLen);
+            if(pathLen != 0)
+                path += _T('\\');
+            path += child.first;
+
+            auto old = before.children.find(child.first);
+            if(old == before.children.end())
+            {
+                // A new subkey is reported once, not value by value.
+                if(!callBack(path.c_str(), nullptr, ChangeKind::KeyAdded))
+                    return false;
+            }
+            else if(!DiffNode(old->second, child.second, path, callBack))
+                return false;
+        }
+
+        for(auto& child : before.children)
+        {
+            if(after.children.find(child.first) != after.children.end())
+                continue;
+
+            path.resize(pathLen);
+            if(pathLen != 0)
+                path += _T('\\');
+            path += child.first;
+
+            if(!callBack(path.c_str(), nullptr, ChangeKind::KeyRemoved))
+                return false;
+        }
+
+        path.resize(pathLen);
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void HashTree::Diff( _In_  const HashTree&         before,
+                         _In_  const HashTree&         after,
+                         _In_  const ChangeCallback&   callBack )
+    {
+        HashString path;
+        DiffNode(before.m_root, after.m_root, path, callBack);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS HashTree::Refresh( _In_ Key& key, _In_ const ChangeCallback& callBack )
+    {
+        HashNode root;
+
+        LSTATUS status = BuildNode(key, m_keepData, root);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        HashString path;
+        DiffNode(m_root, root, path, callBack);
+
+        m_root.values.swap(root.values);
+        m_root.children.swap(root.children);
+        m_root.valuesHash   = root.valuesHash;
+        m_root.hash         = root.hash;
+
+        return ERROR_SUCCESS;
+    }
+}
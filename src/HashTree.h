@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        HashTree.h
+///  Description: Content hashes of the values and Merkle hashes of the subkeys of a registry tree,
+///               used to find what changed without comparing the whole tree.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_HASHTREE_H
+#define INCLUDED_HASHTREE_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The kind of change reported when two trees are compared.
+    enum class ChangeKind
+    {
+        ValueAdded,
+        ValueChanged,
+        ValueRemoved,
+        KeyAdded,
+        KeyRemoved
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct HashValue
+    {
+        DataType                type;
+        DWORD                   dataSize;
+        QWORD                   hash;
+        std::vector<BYTE>       data;           /// Only kept when the tree was built with keepData.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct HashNode
+    {
+        QWORD                                           valuesHash;     /// Hash of the values of this key.
+        QWORD                                           hash;           /// Hash of the values and of all the subkeys.
+        std::map<std::basic_string<TCHAR>, HashValue>   values;
+        std::map<std::basic_string<TCHAR>, HashNode>    children;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// A hashed snapshot of a key and all its subkeys.
+    class HashTree
+    {
+    public:
+
+        typedef std::function <bool (_In_z_ const TCHAR* keyPath, _In_opt_z_ const TCHAR* valueName, _In_ ChangeKind kind)> ChangeCallback;
+
+        /// Reads the whole tree below the key. With keepData, the data of the values is kept too, so
+        /// values with equal hashes can be compared byte by byte.
+        static HashTree* Build( _In_        Key&            key,
+                                _In_opt_    bool            keepData    = false,
+                                _Out_opt_   LSTATUS*        statusCode  = nullptr );
+
+        /// Reports the differences from the tree "before" to the tree "after". Subtrees with the same
+        /// hash are skipped without being visited. The callback can return false to stop.
+        static void Diff( _In_  const HashTree&         before,
+                          _In_  const HashTree&         after,
+                          _In_  const ChangeCallback&   callBack );
+
+        /// Reads the tree again, reports what changed since the last read and keeps the new content.
+        LSTATUS Refresh( _In_ Key& key, _In_ const ChangeCallback& callBack );
+
+        QWORD GetHash() const
+        {
+            return m_root.hash;
+        }
+
+        const HashNode& GetRoot() const
+        {
+            return m_root;
+        }
+
+        void Close()
+        {
+            delete this;
+        }
+
+        /// 64-bit non-cryptographic hash; SSE2 when available, with a scalar fallback giving the same results.
+        static QWORD HashBytes( _In_reads_bytes_(size) const void* data, _In_ size_t size, _In_opt_ QWORD seed = 0 );
+
+        /// Compares two buffers of the same size, 16 bytes at a time when SSE2 is available.
+        static bool Equal( _In_reads_bytes_(size) const void* a, _In_reads_bytes_(size) const void* b, _In_ size_t size );
+
+    private:
+        HashTree() {}
+
+        static LSTATUS BuildNode( _In_ Key& key, _In_ bool keepData, _Out_ HashNode& node );
+
+        static bool DiffNode( _In_    const HashNode&             before,
+                              _In_    const HashNode&             after,
+                              _Inout_ std::basic_string<TCHAR>&   path,
+                              _In_    const ChangeCallback&       callBack );
+
+        HashNode    m_root;
+        bool        m_keepData;
+    };
+}
+
+#endif // INCLUDED_HASHTREE_H
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Hive.cpp
+///  Description: The registry calls made by Registry::Key, so a key can live in the Windows
+///               registry or in a hive kept in memory.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Hive.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class WindowsHive : public Hive
+    {
+    public:
+
+        LSTATUS OpenKeyEx( HKEY hKey, const TCHAR* subKey, DWORD options, REGSAM samDesired, HKEY* result )
+        {
+            return RegOpenKeyEx(hKey, subKey, options, samDesired, result);
+        }
+
+        LSTATUS CreateKeyEx( HKEY hKey, const TCHAR* subKey, DWORD reserved, TCHAR* keyClass, DWORD options,
+                             REGSAM samDesired, const SECURITY_ATTRIBUTES* securityAttributes, HKEY* result,
+                             DWORD* disposition )
+        {
+            return RegCreateKeyEx( hKey, subKey, reserved, keyClass, options, samDesired,
+                                   const_cast<SECURITY_ATTRIBUTES*>(securityAttributes), result, disposition );
+        }
+
+        LSTATUS CloseKey( HKEY hKey )
+        {
+            return RegCloseKey(hKey);
+        }
+
+        LSTATUS DeleteKeyEx( HKEY hKey, const TCHAR* subKey, REGSAM samDesired, DWORD reserved )
+        {
+            return RegDeleteKeyEx(hKey, subKey, samDesired, reserved);
+        }
+
+        LSTATUS DeleteValue( HKEY hKey, const TCHAR* valueName )
+        {
+            return RegDeleteValue(hKey, valueName);
+        }
+
+        LSTATUS SetValueEx( HKEY hKey, const TCHAR* valueName, DWORD reserved, DWORD type, const BYTE* data, DWORD dataSize )
+        {
+            return RegSetValueEx(hKey, valueName, reserved, type, data, dataSize);
+        }
+
+        LSTATUS GetValue( HKEY hKey, const TCHAR* subKey, const TCHAR* valueName, DWORD flags, DWORD* type,
+                          void* data, DWORD* dataSize )
+        {
+            return RegGetValue(hKey, subKey, valueName, flags, type, data, dataSize);
+        }
+
+        LSTATUS QueryValueEx( HKEY hKey, const TCHAR* valueName, DWORD* reserved, DWORD* type, BYTE* data, DWORD* dataSize )
+        {
+            return RegQueryValueEx(hKey, valueName, reserved, type, data, dataSize);
+        }
+
+        LSTATUS QueryMultipleValues( HKEY hKey, VALENT* values, DWORD count, TCHAR* buffer, DWORD* bufferSize )
+        {
+            return RegQueryMultipleValues(hKey, values, count, buffer, bufferSize);
+        }
+
+        LSTATUS QueryInfoKey( HKEY hKey, TCHAR* keyClass, DWORD* keyClassLen, DWORD* reserved, DWORD* subKeys,
+                              DWORD* maxSubKeyLen, DWORD* maxClassLen, DWORD* values, DWORD* maxValueNameLen,
+                              DWORD* maxValueLen, DWORD* securityDescriptor, FILETIME* lastWriteTime )
+        {
+            return RegQueryInfoKey( hKey, keyClass, keyClassLen, reserved, subKeys, maxSubKeyLen, maxClassLen,
+                                    values, maxValueNameLen, maxValueLen, securityDescriptor, lastWriteTime );
+        }
+
+        LSTATUS EnumValue( HKEY hKey, DWORD index, TCHAR* valueName, DWORD* valueNameLen, DWORD* reserved,
+                           DWORD* type, BYTE* data, DWORD* dataSize )
+        {
+            return RegEnumValue(hKey, index, valueName, valueNameLen, reserved, type, data, dataSize);
+        }
+
+        LSTATUS EnumKeyEx( HKEY hKey, DWORD index, TCHAR* name, DWORD* nameLen, DWORD* reserved, TCHAR* keyClass,
+                           DWORD* keyClassLen, FILETIME* lastWriteTime )
+        {
+            return RegEnumKeyEx(hKey, index, name, nameLen, reserved, keyClass, keyClassLen, lastWriteTime);
+        }
+
+        LSTATUS NotifyChangeKeyValue( HKEY hKey, BOOL watchSubtree, DWORD notifyFilter, HANDLE event, BOOL asynchronous )
+        {
+            return RegNotifyChangeKeyValue(hKey, watchSubtree, notifyFilter, event, asynchronous);
+        }
+
+        LSTATUS FlushKey( HKEY hKey )
+        {
+            return RegFlushKey(hKey);
+        }
+    };
+
+    // A namespace scope object, built before main, as the local statics of VS2013 are not thread safe.
+    static WindowsHive windowsHive;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Hive& Hive::GetWindows()
+    {
+        return windowsHive;
+    }
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Hive.h
+///  Description: The registry calls made by Registry::Key, so a key can live in the Windows
+///               registry or in a hive kept in memory.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_HIVE_H
+#define INCLUDED_HIVE_H
+
+#include <windows.h>
+#include <tchar.h>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Every call has the parameters and the results of the Reg* function of the same name, so Key
+    /// reads the same with either backend. The handles are valid only in the hive that opened them;
+    /// the predefined keys (HKEY_CURRENT_USER, ...) are valid in every hive.
+    class Hive
+    {
+    public:
+
+        virtual ~Hive()
+        {
+        }
+
+        /// The Windows registry; the calls go straight to the Reg* functions.
+        static Hive& GetWindows();
+
+        virtual LSTATUS OpenKeyEx( _In_ HKEY hKey, _In_opt_z_ const TCHAR* subKey, _In_ DWORD options,
+                                   _In_ REGSAM samDesired, _Out_ HKEY* result ) = 0;
+
+        virtual LSTATUS CreateKeyEx( _In_ HKEY hKey, _In_z_ const TCHAR* subKey, _In_ DWORD reserved,
+                                     _In_opt_ TCHAR* keyClass, _In_ DWORD options, _In_ REGSAM samDesired,
+                                     _In_opt_ const SECURITY_ATTRIBUTES* securityAttributes,
+                                     _Out_ HKEY* result, _Out_opt_ DWORD* disposition ) = 0;
+
+        virtual LSTATUS CloseKey( _In_ HKEY hKey ) = 0;
+
+        virtual LSTATUS DeleteKeyEx( _In_ HKEY hKey, _In_z_ const TCHAR* subKey, _In_ REGSAM samDesired,
+                                     _In_ DWORD reserved ) = 0;
+
+        virtual LSTATUS DeleteValue( _In_ HKEY hKey, _In_opt_z_ const TCHAR* valueName ) = 0;
+
+        virtual LSTATUS SetValueEx( _In_ HKEY hKey, _In_opt_z_ const TCHAR* valueName, _In_ DWORD reserved,
+                                    _In_ DWORD type, _In_reads_bytes_opt_(dataSize) const BYTE* data,
+                                    _In_ DWORD dataSize ) = 0;
+
+        virtual LSTATUS GetValue( _In_ HKEY hKey, _In_opt_z_ const TCHAR* subKey, _In_opt_z_ const TCHAR* valueName,
+                                  _In_ DWORD flags, _Out_opt_ DWORD* type, _Out_opt_ void* data,
+                                  _Inout_opt_ DWORD* dataSize ) = 0;
+
+        virtual LSTATUS QueryValueEx( _In_ HKEY hKey, _In_opt_z_ const TCHAR* valueName, _Reserved_ DWORD* reserved,
+                                      _Out_opt_ DWORD* type, _Out_opt_ BYTE* data, _Inout_opt_ DWORD* dataSize ) = 0;
+
+        virtual LSTATUS QueryMultipleValues( _In_ HKEY hKey, _Inout_updates_(count) VALENT* values, _In_ DWORD count,
+                                             _Out_opt_ TCHAR* buffer, _Inout_opt_ DWORD* bufferSize ) = 0;
+
+        virtual LSTATUS QueryInfoKey( _In_ HKEY hKey, _Out_opt_ TCHAR* keyClass, _Inout_opt_ DWORD* keyClassLen,
+                                      _Reserved_ DWORD* reserved, _Out_opt_ DWORD* subKeys,
+                                      _Out_opt_ DWORD* maxSubKeyLen, _Out_opt_ DWORD* maxClassLen,
+                                      _Out_opt_ DWORD* values, _Out_opt_ DWORD* maxValueNameLen,
+                                      _Out_opt_ DWORD* maxValueLen, _Out_opt_ DWORD* securityDescriptor,
+                                      _Out_opt_ FILETIME* lastWriteTime ) = 0;
+
+        virtual LSTATUS EnumValue( _In_ HKEY hKey, _In_ DWORD index, _Out_ TCHAR* valueName,
+                                   _Inout_ DWORD* valueNameLen, _Reserved_ DWORD* reserved, _Out_opt_ DWORD* type,
+                                   _Out_opt_ BYTE* data, _Inout_opt_ DWORD* dataSize ) = 0;
+
+        virtual LSTATUS EnumKeyEx( _In_ HKEY hKey, _In_ DWORD index, _Out_ TCHAR* name, _Inout_ DWORD* nameLen,
+                                   _Reserved_ DWORD* reserved, _Out_opt_ TCHAR* keyClass,
+                                   _Inout_opt_ DWORD* keyClassLen, _Out_opt_ FILETIME* lastWriteTime ) = 0;
+
+        virtual LSTATUS NotifyChangeKeyValue( _In_ HKEY hKey, _In_ BOOL watchSubtree, _In_ DWORD notifyFilter,
+                                              _In_opt_ HANDLE event, _In_ BOOL asynchronous ) = 0;
+
+        virtual LSTATUS FlushKey( _In_ HKEY hKey ) = 0;
+    };
+}
+
+#endif // INCLUDED_HIVE_H
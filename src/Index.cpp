@@ -0,0 +1,253 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Index.cpp
+///  Description: In-memory index of the keys and values of a watched registry tree.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Index.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static IndexString ChildPath( _In_ const IndexString& path, _In_ const IndexString& name )
+    {
+        return path.empty() ? name : path + _T('\\') + name;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Index* Index::Build( _In_        PredefinedKey   mainKey,
+                         _In_z_      const TCHAR*    subKeyPath,
+                         _Out_opt_   LSTATUS*        statusCode )
+    {
+        LSTATUS status = ERROR_SUCCESS;
+        Key*    key    = Key::Open(mainKey, subKeyPath, AccessRights::Read, &status);
+
+        Index* index = nullptr;
+        if(key != nullptr)
+        {
+            index        = new Index();
+            index->m_key = key;
+
+            status = index->Update();
+            if(status != ERROR_SUCCESS)
+            {
+                index->Close();
+                index = nullptr;
+            }
+        }
+
+        if(statusCode != nullptr)
+            *statusCode = status;
+
+        return index;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Index::Update()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        m_rescannedKeys = 0;
+
+        return ScanNode(*m_key, IndexString());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Index::Watch()
+    {
+        return m_key->AddNotify( [this] (Key &key, void *userData) -> bool
+            {
+                UNREFERENCED_PARAMETER(userData);
+
+                std::lock_guard<std::mutex> guard(m_lock);
+
+                m_rescannedKeys = 0;
+                ScanNode(key, IndexString());
+
+                return true;
+            },
+            NotifyEvents::Change_Name | NotifyEvents::Change_LastSet,
+            true
+        );
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Reads a key again if its last-write time moved, then visits its subkeys. The last-write time of
+    /// a key changes with its values and its list of subkeys, not with the keys below them, so every
+    /// key is still opened; but only the changed ones have their values and subkeys enumerated.
+    LSTATUS Index::ScanNode( _In_ Key& key, _In_ const IndexString& path )
+    {
+        // Through QueryInfo, which holds the handle in the epoch, as another thread can reopen the key.
+        KeyInfo  info;
+        LSTATUS  status = key.QueryInfo(&info);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        FILETIME lastWrite = info.lastWrite;
+
+        auto found  = m_nodes.find(path);
+        bool isNew  = (found == m_nodes.end());
+
+        IndexNode& node = isNew ? m_nodes[path] : found->second;
+
+        if(isNew || CompareFileTime(&lastWrite, &node.lastWrite) != 0)
+        {
+            m_rescannedKeys++;
+
+            RemoveValues(path, node);
+
+            status = key.EnumValues( [this, &node, &path] (Value &value) -> bool
+                {
+                    IndexValue& entry = node.values[value.GetName()];
+                    entry.type = value.GetType();
+                    entry.data.assign(value.GetData(), value.GetData() + value.GetDataSize());
+
+                    m_keysByValue[value.GetName()].insert(path);
+
+                    return true;
+                }
+            );
+            if(status != ERROR_SUCCESS)
+                return status;
+
+            std::set<IndexString, IndexNameLess> names;
+            status = key.EnumSubKeys( [&names] (Key &subKey) -> bool
+                {
+                    names.insert(subKey.GetSubKeyPath());
+                    return true;
+                }
+            );
+            if(status != ERROR_SUCCESS)
+                return status;
+
+            for(auto& child : node.children)
+            {
+                if(names.find(child) == names.end())
+                    RemoveSubtree(ChildPath(path, child));
+            }
+
+            node.children.assign(names.begin(), names.end());
+            node.lastWrite = lastWrite;
+        }
+
+        // Copied, as the scan of the children can add nodes to the map.
+        std::vector<IndexString> children = node.children;
+
+        for(auto& child : children)
+        {
+            IndexString childPath = ChildPath(path, child);
+
+            // A subkey that was deleted, or cannot be read, leaves the index.
+            Key* subKey = key.OpenSubKey(child.c_str(), AccessRights::Read);
+            if(subKey == nullptr)
+            {
+                RemoveSubtree(childPath);
+                continue;
+            }
+
+            if(ScanNode(*subKey, childPath) != ERROR_SUCCESS)
+                RemoveSubtree(childPath);
+
+            subKey->Close();
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Index::RemoveValues( _In_ const IndexString& path, _Inout_ IndexNode& node )
+    {
+        for(auto& value : node.values)
+        {
+            auto keys = m_keysByValue.find(value.first);
+            if(keys == m_keysByValue.end())
+                continue;
+
+            keys->second.erase(path);
+            if(keys->second.empty())
+                m_keysByValue.erase(keys);
+        }
+
+        node.values.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Index::RemoveSubtree( _In_ const IndexString& path )
+    {
+        auto found = m_nodes.find(path);
+        if(found == m_nodes.end())
+            return;
+
+        for(auto& child : found->second.children)
+            RemoveSubtree(ChildPath(path, child));
+
+        found = m_nodes.find(path);
+        RemoveValues(path, found->second);
+        m_nodes.erase(found);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Index::GetValue( _In_z_ const TCHAR* path, _In_z_ const TCHAR* valueName, _Out_ IndexValue* value ) const
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        auto node = m_nodes.find(path);
+        if(node == m_nodes.end())
+            return false;
+
+        auto found = node->second.values.find(valueName);
+        if(found == node->second.values.end())
+            return false;
+
+        *value = found->second;
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::vector<IndexString> Index::FindKeys( _In_z_ const TCHAR* valueName ) const
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        auto keys = m_keysByValue.find(valueName);
+        if(keys == m_keysByValue.end())
+            return std::vector<IndexString>();
+
+        return std::vector<IndexString>(keys->second.begin(), keys->second.end());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::vector<IndexString> Index::FindKeys( _In_z_ const TCHAR*                                  valueName,
+                                              _In_   const std::function <bool (const IndexValue&)>& predicate ) const
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        std::vector<IndexString> result;
+
+        auto keys = m_keysByValue.find(valueName);
+        if(keys == m_keysByValue.end())
+            return result;
+
+        for(auto& path : keys->second)
+        {
+            const IndexNode& node = m_nodes.find(path)->second;
+
+            auto value = node.values.find(valueName);
+            if(value != node.values.end() && predicate(value->second))
+                result.push_back(path);
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Index.h
+///  Description: In-memory index of the keys and values of a watched registry tree.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_INDEX_H
+#define INCLUDED_INDEX_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    typedef std::basic_string<TCHAR> IndexString;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Registry names are not case sensitive.
+    struct IndexNameLess
+    {
+        bool operator () (const IndexString& a, const IndexString& b) const
+        {
+            return _tcsicmp(a.c_str(), b.c_str()) < 0;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct IndexValue
+    {
+        DataType                type;
+        std::vector<BYTE>       data;
+
+        bool GetDWORD( _Out_ DWORD* value ) const
+        {
+            if(type != DataType::DWord || data.size() != sizeof(DWORD))
+                return false;
+
+            *value = *(const DWORD*)&data[0];
+            return true;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct IndexNode
+    {
+        FILETIME                                                lastWrite;
+        std::map<IndexString, IndexValue, IndexNameLess>        values;
+        std::vector<IndexString>                                children;   /// Names of the subkeys.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Keeps every key and value of a tree in memory. The tree is read once; after that only the keys
+    /// whose last-write time moved are read again. Paths are relative to the root of the index, and
+    /// the root itself has an empty path.
+    class Index
+    {
+    public:
+
+        static Index* Build( _In_        PredefinedKey   mainKey,
+                             _In_z_      const TCHAR*    subKeyPath,
+                             _Out_opt_   LSTATUS*        statusCode  = nullptr );
+
+        /// Brings the index up to date with the registry.
+        LSTATUS Update();
+
+        /// Updates the index on every change notification for the tree.
+        LSTATUS Watch();
+
+        bool GetValue( _In_z_ const TCHAR* path, _In_z_ const TCHAR* valueName, _Out_ IndexValue* value ) const;
+
+        /// Paths of all the keys that have a value with this name.
+        std::vector<IndexString> FindKeys( _In_z_ const TCHAR* valueName ) const;
+
+        /// Paths of all the keys that have a value with this name, for which the predicate is true.
+        std::vector<IndexString> FindKeys( _In_z_ const TCHAR*                                  valueName,
+                                           _In_   const std::function <bool (const IndexValue&)>& predicate ) const;
+
+        size_t GetKeyCount() const
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            return m_nodes.size();
+        }
+
+        /// Number of keys read again by the last update.
+        DWORD GetRescannedKeys() const
+        {
+            return m_rescannedKeys;
+        }
+
+        void Close()
+        {
+            if(m_key != nullptr)
+                m_key->Close();
+
+            delete this;
+        }
+
+    private:
+        Index()
+        {
+            m_key           = nullptr;
+            m_rescannedKeys = 0;
+        }
+
+        LSTATUS ScanNode( _In_ Key& key, _In_ const IndexString& path );
+
+        void RemoveValues( _In_ const IndexString& path, _Inout_ IndexNode& node );
+
+        void RemoveSubtree( _In_ const IndexString& path );
+
+        Key*                                                            m_key;
+        std::map<IndexString, IndexNode, IndexNameLess>                 m_nodes;
+        std::map<IndexString, std::set<IndexString, IndexNameLess>,
+                 IndexNameLess>                                         m_keysByValue;  /// Value name to key paths.
+        DWORD                                                           m_rescannedKeys;
+        mutable std::mutex                                              m_lock;
+    };
+}
+
+#endif // INCLUDED_INDEX_H
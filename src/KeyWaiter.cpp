@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        KeyWaiter.cpp
+///  Description: Waits for a registry key to be created, by watching the nearest of its ancestors
+///               that exists.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./KeyWaiter.h"
+#include "./Metrics.h"
+
+#include <string>
+
+namespace Registry
+{
+    static const DWORD FirstRetryMs = 50;
+    static const DWORD MaxRetryMs   = 5000;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    KeyWaiter::KeyWaiter()
+    {
+        m_mainKey       = PredefinedKey::Local_Machine;
+        m_subKeyPath    = nullptr;
+        m_stopEvent     = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        m_worker        = nullptr;
+        m_depth         = 0;
+        m_found         = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    KeyWaiter::~KeyWaiter()
+    {
+        Stop();
+
+        if(m_stopEvent != nullptr)
+            CloseHandle(m_stopEvent);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS KeyWaiter::Start( _In_     PredefinedKey                       mainKey,
+                              _In_z_   const TCHAR*                        subKeyPath,
+                              _In_     const std::function <void ()>&      onCreated )
+    {
+        Stop();
+
+        if(m_stopEvent == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        size_t length = _tcslen(subKeyPath) + 1;
+
+        m_mainKey       = mainKey;
+        m_subKeyPath    = new TCHAR[length];
+        m_depth         = 0;
+        m_found         = false;
+
+        _tcscpy_s(m_subKeyPath, length, subKeyPath);
+
+        ResetEvent(m_stopEvent);
+        m_worker = new std::thread(&KeyWaiter::Worker, this, onCreated);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void KeyWaiter::Stop()
+    {
+        if(m_worker != nullptr)
+        {
+            SetEvent(m_stopEvent);
+
+            m_worker->join();
+            delete m_worker;
+            m_worker = nullptr;
+        }
+
+        delete [] m_subKeyPath;
+        m_subKeyPath = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void KeyWaiter::Worker( _In_ const std::function <void ()>& onCreated )
+    {
+        HANDLE changed   = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        HANDLE events[2] = { m_stopEvent, changed };
+        DWORD  retryMs   = FirstRetryMs;
+
+        while(changed != nullptr)
+        {
+            Key* nearest = OpenNearest();
+
+            if(m_found)
+            {
+                if(nearest != nullptr)
+                    nearest->Close();
+
+                onCreated();
+                break;
+            }
+
+            // The main key itself can't be opened; nothing will ever show up.
+            if(nearest == nullptr)
+                break;
+
+            LSTATUS status = nearest->GetHive()->NotifyChangeKeyValue( nearest->GetHKEY(),
+                                                                       FALSE,
+                                                                       (DWORD)NotifyEvents::Change_Name,
+                                                                       changed,
+                                                                       TRUE );
+
+            // The next segment may have been created between the walk and the registration, and
+            // would not be notified; walk again before sleeping.
+            DWORD depth = m_depth;
+            if(status == ERROR_SUCCESS)
+            {
+                Key* again = OpenNearest();
+                if(again != nullptr)
+                    again->Close();
+            }
+
+            // Walking again at once is only for a segment that showed up; a failed registration, as
+            // when the key was deleted meanwhile, is tried again later, ever less often.
+            DWORD wait;
+            if(status != ERROR_SUCCESS)
+            {
+                wait    = WaitForSingleObject(m_stopEvent, retryMs);
+                wait    = (wait == WAIT_TIMEOUT) ? WAIT_OBJECT_0 + 1 : WAIT_OBJECT_0;
+                retryMs = (retryMs < MaxRetryMs / 2) ? retryMs * 2 : MaxRetryMs;
+            }
+            else if(!m_found && m_depth == depth)
+            {
+                wait    = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+                retryMs = FirstRetryMs;
+                Metrics::Increment(Counter::KeyWaitWakeups);
+            }
+            else
+            {
+                wait    = WaitForSingleObject(m_stopEvent, 0);
+                wait    = (wait == WAIT_TIMEOUT) ? WAIT_OBJECT_0 + 1 : WAIT_OBJECT_0;
+            }
+
+            nearest->Close();
+
+            if(wait != WAIT_OBJECT_0 + 1)
+                break;
+        }
+
+        if(changed != nullptr)
+            CloseHandle(changed);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Key* KeyWaiter::OpenNearest()
+    {
+        // Every prefix is opened from the main key, so an ancestor deleted and created again is
+        // found as well; the path has only a few segments.
+        Key*        nearest     = Key::Open(m_mainKey, _T(""), AccessRights::Notify);
+        DWORD       depth       = 0;
+        const TCHAR* segment    = m_subKeyPath;
+
+        while(nearest != nullptr && *segment != 0)
+        {
+            const TCHAR* end = _tcschr(segment, _T('\\'));
+            if(end == nullptr)
+                end = segment + _tcslen(segment);
+
+            std::basic_string<TCHAR> prefix(m_subKeyPath, end - m_subKeyPath);
+
+            Key* next = Key::Open(m_mainKey, prefix.c_str(), AccessRights::Notify);
+            if(next == nullptr)
+                break;
+
+            nearest->Close();
+            nearest = next;
+            depth++;
+
+            segment = (*end != 0) ? end + 1 : end;
+        }
+
+        m_depth = depth;
+        m_found = nearest != nullptr && *segment == 0;
+
+        return nearest;
+    }
+}
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        KeyWaiter.h
+///  Description: Waits for a registry key to be created, by watching the nearest of its ancestors
+///               that exists.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_KEYWAITER_H
+#define INCLUDED_KEYWAITER_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <functional>
+#include <thread>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Waits on a thread for a key that doesn't exist yet, as the Stereo3D key before 3D Vision is
+    /// installed. The nearest existing ancestor of the key is watched for subkeys being added
+    /// (NotifyEvents::Change_Name, not the subtree), so the thread sleeps until the path grows; then
+    /// it walks down the segments that appeared and watches the new nearest ancestor. Nothing is
+    /// polled. A deleted ancestor wakes the thread too, and the walk starts over from the main key.
+    /// When the ancestor can't be watched, the walk is tried again after a delay that grows to 5 s.
+    class KeyWaiter
+    {
+    public:
+
+        KeyWaiter();
+
+        ~KeyWaiter();
+
+        /// Starts waiting for mainKey\subKeyPath. onCreated runs once on the waiting thread, when
+        /// the key exists; it runs at once if the key exists already.
+        LSTATUS Start( _In_     PredefinedKey                       mainKey,
+                       _In_z_   const TCHAR*                        subKeyPath,
+                       _In_     const std::function <void ()>&      onCreated );
+
+        void Stop();
+
+        bool IsWaiting() const
+        {
+            return m_worker != nullptr && !m_found;
+        }
+
+        /// Number of path segments that exist; the watched ancestor is the last of them.
+        DWORD GetDepth() const
+        {
+            return m_depth;
+        }
+
+    private:
+        KeyWaiter( const KeyWaiter& );
+        KeyWaiter& operator = ( const KeyWaiter& );
+
+        void Worker( _In_ const std::function <void ()>& onCreated );
+
+        /// Opens the deepest existing prefix of the path, with the Notify right.
+        Key* OpenNearest();
+
+        PredefinedKey           m_mainKey;
+        TCHAR*                  m_subKeyPath;
+        HANDLE                  m_stopEvent;
+        std::thread*            m_worker;
+        volatile DWORD          m_depth;
+        volatile bool           m_found;
+    };
+}
+
+#endif // INCLUDED_KEYWAITER_H
@@ -0,0 +1,706 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        MemoryHive.cpp
+///  Description: A registry hive kept in memory, to drive the enforcer with recorded changes without
+///               touching the registry of the machine.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./MemoryHive.h"
+
+#include <algorithm>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The RRF_RT_* flag that lets RegGetValue return a value of the given type.
+    static DWORD GetTypeFlag( _In_ DWORD type )
+    {
+        switch(type)
+        {
+        case REG_NONE:          return RRF_RT_REG_NONE;
+        case REG_SZ:            return RRF_RT_REG_SZ;
+        case REG_EXPAND_SZ:     return RRF_RT_REG_EXPAND_SZ;
+        case REG_BINARY:        return RRF_RT_REG_BINARY;
+        case REG_DWORD:         return RRF_RT_REG_DWORD;
+        case REG_MULTI_SZ:      return RRF_RT_REG_MULTI_SZ;
+        case REG_QWORD:         return RRF_RT_REG_QWORD;
+        default:                return 0;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryHive::MemoryHive()
+    {
+        m_lastWrite = 0;
+
+        for(DWORD root = 0; root < RootCount; root++)
+        {
+            m_roots[root]           = std::make_shared<Node>();
+            m_roots[root]->parent   = nullptr;
+            m_roots[root]->deleted  = false;
+            Touch(m_roots[root].get());
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryHive::~MemoryHive()
+    {
+        for(Handle* handle : m_handles)
+            delete handle;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryHive::Handle* MemoryHive::FindHandle( _In_ HKEY hKey ) const
+    {
+        for(Handle* handle : m_handles)
+        {
+            if((HKEY)handle == hKey)
+                return handle;
+        }
+
+        return nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryHive::Node* MemoryHive::GetNode( _In_ HKEY hKey, _Out_ LSTATUS* status ) const
+    {
+        *status = ERROR_SUCCESS;
+
+        // The predefined keys are small constants, from HKEY_CLASSES_ROOT up.
+        ULONG_PTR root = (ULONG_PTR)hKey - (ULONG_PTR)HKEY_CLASSES_ROOT;
+        if(root < RootCount)
+            return m_roots[root].get();
+
+        Handle* handle = FindHandle(hKey);
+        if(handle == nullptr)
+        {
+            *status = ERROR_INVALID_HANDLE;
+            return nullptr;
+        }
+
+        if(handle->node->deleted)
+        {
+            *status = ERROR_KEY_DELETED;
+            return nullptr;
+        }
+
+        return handle->node.get();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryHive::Node* MemoryHive::FindSubKey( _In_ const Node* node, _In_z_ const TCHAR* name, _In_ size_t nameLen )
+    {
+        for(auto& subKey : node->subKeys)
+        {
+            if(subKey->name.size() == nameLen && _tcsnicmp(subKey->name.c_str(), name, nameLen) == 0)
+                return subKey.get();
+        }
+
+        return nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryHive::Node* MemoryHive::FindPath( _In_ Node* node, _In_opt_z_ const TCHAR* path )
+    {
+        if(path == nullptr)
+            return node;
+
+        while(node != nullptr && *path != 0)
+        {
+            const TCHAR* end = _tcschr(path, _T('\\'));
+            size_t       len = (end != nullptr) ? (size_t)(end - path) : _tcslen(path);
+
+            if(len != 0)
+                node = FindSubKey(node, path, len);
+
+            path += len;
+            if(*path == _T('\\'))
+                path++;
+        }
+
+        return node;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    MemoryHive::Value* MemoryHive::FindValue( _In_ Node* node, _In_opt_z_ const TCHAR* name )
+    {
+        if(name == nullptr)
+            name = _T("");
+
+        for(auto& value : node->values)
+        {
+            if(_tcsicmp(value.name.c_str(), name) == 0)
+                return &value;
+        }
+
+        return nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::CopyData( _In_ const std::vector<BYTE>& source, _Out_opt_ BYTE* data, _Inout_opt_ DWORD* dataSize )
+    {
+        if(data != nullptr && dataSize == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        if(dataSize == nullptr)
+            return ERROR_SUCCESS;
+
+        DWORD size = (DWORD)source.size();
+        if(data != nullptr && *dataSize < size)
+        {
+            *dataSize = size;
+            return ERROR_MORE_DATA;
+        }
+
+        if(data != nullptr && size != 0)
+            memcpy(data, &source[0], size);
+
+        *dataSize = size;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    HKEY MemoryHive::NewHandle( _In_ Node* node )
+    {
+        Handle* handle = new Handle;
+        handle->node = node->shared_from_this();
+
+        m_handles.push_back(handle);
+
+        return (HKEY)handle;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void MemoryHive::Touch( _In_ Node* node )
+    {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+
+        ULONGLONG time = ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+        if(time <= m_lastWrite)
+            time = m_lastWrite + 1;
+
+        m_lastWrite = time;
+
+        node->lastWrite.dwLowDateTime  = (DWORD)time;
+        node->lastWrite.dwHighDateTime = (DWORD)(time >> 32);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void MemoryHive::OnChanged( _In_ Node* node, _In_ DWORD filter )
+    {
+        for(size_t i = 0; i < m_registrations.size(); )
+        {
+            const Registration& registration = m_registrations[i];
+            const Node*         watched      = registration.handle->node.get();
+
+            bool fire = false;
+            if((registration.filter & filter) != 0)
+            {
+                for(const Node* changed = node; changed != nullptr && !fire; changed = changed->parent)
+                    fire = (changed == watched);
+
+                fire = fire && (watched == node || registration.watchSubtree);
+            }
+
+            if(!fire)
+            {
+                i++;
+                continue;
+            }
+
+            SetEvent(registration.event);
+            m_registrations.erase(m_registrations.begin() + i);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::OpenKeyEx( HKEY hKey, const TCHAR* subKey, DWORD, REGSAM, HKEY* result )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(result == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        node = FindPath(node, subKey);
+        if(node == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        *result = NewHandle(node);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::CreateKeyEx( HKEY hKey, const TCHAR* subKey, DWORD, TCHAR*, DWORD, REGSAM,
+                                     const SECURITY_ATTRIBUTES*, HKEY* result, DWORD* disposition )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(result == nullptr || subKey == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        bool created = false;
+
+        const TCHAR* path = subKey;
+        while(*path != 0)
+        {
+            const TCHAR* end = _tcschr(path, _T('\\'));
+            size_t       len = (end != nullptr) ? (size_t)(end - path) : _tcslen(path);
+
+            if(len != 0)
+            {
+                Node* next = FindSubKey(node, path, len);
+                if(next == nullptr)
+                {
+                    std::shared_ptr<Node> added = std::make_shared<Node>();
+                    added->name.assign(path, len);
+                    added->parent   = node;
+                    added->deleted  = false;
+                    Touch(added.get());
+
+                    node->subKeys.push_back(added);
+                    Touch(node);
+                    OnChanged(node, REG_NOTIFY_CHANGE_NAME);
+
+                    next    = added.get();
+                    created = true;
+                }
+
+                node = next;
+            }
+
+            path += len;
+            if(*path == _T('\\'))
+                path++;
+        }
+
+        *result = NewHandle(node);
+
+        if(disposition != nullptr)
+            *disposition = created ? REG_CREATED_NEW_KEY : REG_OPENED_EXISTING_KEY;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::CloseKey( HKEY hKey )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if((ULONG_PTR)hKey - (ULONG_PTR)HKEY_CLASSES_ROOT < RootCount)
+            return ERROR_SUCCESS;
+
+        Handle* handle = FindHandle(hKey);
+        if(handle == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        // As in the registry, closing the handle signals its pending notifications.
+        for(size_t i = 0; i < m_registrations.size(); )
+        {
+            if(m_registrations[i].handle != handle)
+            {
+                i++;
+                continue;
+            }
+
+            SetEvent(m_registrations[i].event);
+            m_registrations.erase(m_registrations.begin() + i);
+        }
+
+        m_handles.erase(std::find(m_handles.begin(), m_handles.end(), handle));
+        delete handle;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::DeleteKeyEx( HKEY hKey, const TCHAR* subKey, REGSAM, DWORD )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(subKey == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        node = FindPath(node, subKey);
+        if(node == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        if(node->parent == nullptr || !node->subKeys.empty())
+            return ERROR_ACCESS_DENIED;
+
+        // The registrations on the key itself fire, and the next ones fail with ERROR_KEY_DELETED.
+        for(size_t i = 0; i < m_registrations.size(); )
+        {
+            if(m_registrations[i].handle->node.get() != node)
+            {
+                i++;
+                continue;
+            }
+
+            SetEvent(m_registrations[i].event);
+            m_registrations.erase(m_registrations.begin() + i);
+        }
+
+        Node* parent = node->parent;
+        for(auto it = parent->subKeys.begin(); it != parent->subKeys.end(); ++it)
+        {
+            if(it->get() == node)
+            {
+                node->deleted = true;
+                node->parent  = nullptr;
+
+                // The handles still hold the node.
+                parent->subKeys.erase(it);
+                break;
+            }
+        }
+
+        Touch(parent);
+        OnChanged(parent, REG_NOTIFY_CHANGE_NAME);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::DeleteValue( HKEY hKey, const TCHAR* valueName )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        Value* value = FindValue(node, valueName);
+        if(value == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        node->values.erase(node->values.begin() + (value - &node->values[0]));
+
+        Touch(node);
+        OnChanged(node, REG_NOTIFY_CHANGE_LAST_SET);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::SetValueEx( HKEY hKey, const TCHAR* valueName, DWORD, DWORD type, const BYTE* data, DWORD dataSize )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(data == nullptr && dataSize != 0)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        Value* value = FindValue(node, valueName);
+        if(value == nullptr)
+        {
+            node->values.push_back(Value());
+            value = &node->values.back();
+            value->name = (valueName != nullptr) ? valueName : _T("");
+        }
+
+        value->type = type;
+        value->data.assign(data, data + dataSize);
+
+        Touch(node);
+        OnChanged(node, REG_NOTIFY_CHANGE_LAST_SET);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::GetValue( HKEY hKey, const TCHAR* subKey, const TCHAR* valueName, DWORD flags, DWORD* type,
+                                  void* data, DWORD* dataSize )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        node = FindPath(node, subKey);
+        if(node == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        Value* value = FindValue(node, valueName);
+        if(value == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        if((flags & GetTypeFlag(value->type)) == 0)
+            return ERROR_UNSUPPORTED_TYPE;
+
+        if(type != nullptr)
+            *type = value->type;
+
+        // RegGetValue terminates the strings that were stored without a nul.
+        bool isString = value->type == REG_SZ || value->type == REG_EXPAND_SZ || value->type == REG_MULTI_SZ;
+        if( isString && (value->data.size() < sizeof(TCHAR) ||
+            *(const TCHAR*)(&value->data[0] + value->data.size() - sizeof(TCHAR)) != 0) )
+        {
+            std::vector<BYTE> terminated(value->data);
+            terminated.resize(terminated.size() + sizeof(TCHAR), 0);
+
+            return CopyData(terminated, (BYTE*)data, dataSize);
+        }
+
+        return CopyData(value->data, (BYTE*)data, dataSize);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::QueryValueEx( HKEY hKey, const TCHAR* valueName, DWORD*, DWORD* type, BYTE* data, DWORD* dataSize )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        Value* value = FindValue(node, valueName);
+        if(value == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        if(type != nullptr)
+            *type = value->type;
+
+        return CopyData(value->data, data, dataSize);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::QueryMultipleValues( HKEY hKey, VALENT* values, DWORD count, TCHAR* buffer, DWORD* bufferSize )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(values == nullptr || bufferSize == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        DWORD totalSize = 0;
+        for(DWORD i = 0; i < count; i++)
+        {
+            Value* value = FindValue(node, values[i].ve_valuename);
+            if(value == nullptr)
+                return ERROR_FILE_NOT_FOUND;
+
+            totalSize += (DWORD)value->data.size();
+        }
+
+        if(buffer == nullptr || *bufferSize < totalSize)
+        {
+            *bufferSize = totalSize;
+            return ERROR_MORE_DATA;
+        }
+
+        BYTE* data = (BYTE*)buffer;
+        for(DWORD i = 0; i < count; i++)
+        {
+            Value* value = FindValue(node, values[i].ve_valuename);
+
+            values[i].ve_valuelen = (DWORD)value->data.size();
+            values[i].ve_valueptr = (DWORD_PTR)data;
+            values[i].ve_type     = value->type;
+
+            if(!value->data.empty())
+                memcpy(data, &value->data[0], value->data.size());
+
+            data += value->data.size();
+        }
+
+        *bufferSize = totalSize;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::QueryInfoKey( HKEY hKey, TCHAR* keyClass, DWORD* keyClassLen, DWORD*, DWORD* subKeys,
+                                      DWORD* maxSubKeyLen, DWORD* maxClassLen, DWORD* values, DWORD* maxValueNameLen,
+                                      DWORD* maxValueLen, DWORD* securityDescriptor, FILETIME* lastWriteTime )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        DWORD subKeyLen = 0;
+        for(auto& subKey : node->subKeys)
+        {
+            if(subKey->name.size() > subKeyLen)
+                subKeyLen = (DWORD)subKey->name.size();
+        }
+
+        DWORD valueNameLen = 0;
+        DWORD valueLen     = 0;
+        for(auto& value : node->values)
+        {
+            if(value.name.size() > valueNameLen)
+                valueNameLen = (DWORD)value.name.size();
+
+            if(value.data.size() > valueLen)
+                valueLen = (DWORD)value.data.size();
+        }
+
+        // The keys of the hive have no class.
+        if(keyClass != nullptr && keyClassLen != nullptr && *keyClassLen != 0)
+            keyClass[0] = 0;
+
+        if(keyClassLen        != nullptr) *keyClassLen        = 0;
+        if(subKeys            != nullptr) *subKeys            = (DWORD)node->subKeys.size();
+        if(maxSubKeyLen       != nullptr) *maxSubKeyLen       = subKeyLen;
+        if(maxClassLen        != nullptr) *maxClassLen        = 0;
+        if(values             != nullptr) *values             = (DWORD)node->values.size();
+        if(maxValueNameLen    != nullptr) *maxValueNameLen    = valueNameLen;
+        if(maxValueLen        != nullptr) *maxValueLen        = valueLen;
+        if(securityDescriptor != nullptr) *securityDescriptor = 0;
+        if(lastWriteTime      != nullptr) *lastWriteTime      = node->lastWrite;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::EnumValue( HKEY hKey, DWORD index, TCHAR* valueName, DWORD* valueNameLen, DWORD*,
+                                   DWORD* type, BYTE* data, DWORD* dataSize )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(valueName == nullptr || valueNameLen == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        if(index >= node->values.size())
+            return ERROR_NO_MORE_ITEMS;
+
+        const Value& value = node->values[index];
+
+        // The length is in characters, given with the nul and returned without it.
+        DWORD nameLen = (DWORD)value.name.size();
+        if(*valueNameLen <= nameLen)
+            return ERROR_MORE_DATA;
+
+        _tcscpy_s(valueName, *valueNameLen, value.name.c_str());
+        *valueNameLen = nameLen;
+
+        if(type != nullptr)
+            *type = value.type;
+
+        return CopyData(value.data, data, dataSize);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::EnumKeyEx( HKEY hKey, DWORD index, TCHAR* name, DWORD* nameLen, DWORD*, TCHAR* keyClass,
+                                   DWORD* keyClassLen, FILETIME* lastWriteTime )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(name == nullptr || nameLen == nullptr)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        Node*   node = GetNode(hKey, &status);
+        if(node == nullptr)
+            return status;
+
+        if(index >= node->subKeys.size())
+            return ERROR_NO_MORE_ITEMS;
+
+        const Node& subKey = *node->subKeys[index];
+
+        DWORD subKeyLen = (DWORD)subKey.name.size();
+        if(*nameLen <= subKeyLen)
+            return ERROR_MORE_DATA;
+
+        _tcscpy_s(name, *nameLen, subKey.name.c_str());
+        *nameLen = subKeyLen;
+
+        if(keyClass != nullptr && keyClassLen != nullptr && *keyClassLen != 0)
+            keyClass[0] = 0;
+
+        if(keyClassLen   != nullptr) *keyClassLen   = 0;
+        if(lastWriteTime != nullptr) *lastWriteTime = subKey.lastWrite;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::NotifyChangeKeyValue( HKEY hKey, BOOL watchSubtree, DWORD notifyFilter, HANDLE event, BOOL asynchronous )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(event == nullptr || !asynchronous)
+            return ERROR_INVALID_PARAMETER;
+
+        LSTATUS status;
+        if(GetNode(hKey, &status) == nullptr)
+            return status;
+
+        // Only an opened key can be watched, as closing its handle is what ends the registration.
+        Handle* handle = FindHandle(hKey);
+        if(handle == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        Registration registration;
+        registration.handle         = handle;
+        registration.event          = event;
+        registration.watchSubtree   = watchSubtree != FALSE;
+        registration.filter         = notifyFilter;
+
+        m_registrations.push_back(registration);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS MemoryHive::FlushKey( HKEY hKey )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        LSTATUS status;
+        GetNode(hKey, &status);
+
+        return status;
+    }
+}
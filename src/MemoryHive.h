@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        MemoryHive.h
+///  Description: A registry hive kept in memory, to drive the enforcer with recorded changes without
+///               touching the registry of the machine.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_MEMORYHIVE_H
+#define INCLUDED_MEMORYHIVE_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "./Hive.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Starts empty: every predefined key is a root without values or subkeys. The calls behave as
+    /// the Reg* ones for what Key uses: a handle on a deleted key fails with ERROR_KEY_DELETED, a key
+    /// with subkeys can't be deleted, and the change notifications are asynchronous only; they fire
+    /// once, on the change or when their handle is closed. The access rights, the security and the
+    /// WoW64 views are ignored, and REG_EXPAND_SZ values are returned as stored.
+    /// One lock guards the whole hive. It must outlive the keys opened in it.
+    class MemoryHive : public Hive
+    {
+    public:
+
+        MemoryHive();
+
+        ~MemoryHive();
+
+        LSTATUS OpenKeyEx( HKEY hKey, const TCHAR* subKey, DWORD options, REGSAM samDesired, HKEY* result );
+
+        LSTATUS CreateKeyEx( HKEY hKey, const TCHAR* subKey, DWORD reserved, TCHAR* keyClass, DWORD options,
+                             REGSAM samDesired, const SECURITY_ATTRIBUTES* securityAttributes, HKEY* result,
+                             DWORD* disposition );
+
+        LSTATUS CloseKey( HKEY hKey );
+
+        LSTATUS DeleteKeyEx( HKEY hKey, const TCHAR* subKey, REGSAM samDesired, DWORD reserved );
+
+        LSTATUS DeleteValue( HKEY hKey, const TCHAR* valueName );
+
+        LSTATUS SetValueEx( HKEY hKey, const TCHAR* valueName, DWORD reserved, DWORD type, const BYTE* data, DWORD dataSize );
+
+        LSTATUS GetValue( HKEY hKey, const TCHAR* subKey, const TCHAR* valueName, DWORD flags, DWORD* type,
+                          void* data, DWORD* dataSize );
+
+        LSTATUS QueryValueEx( HKEY hKey, const TCHAR* valueName, DWORD* reserved, DWORD* type, BYTE* data, DWORD* dataSize );
+
+        LSTATUS QueryMultipleValues( HKEY hKey, VALENT* values, DWORD count, TCHAR* buffer, DWORD* bufferSize );
+
+        LSTATUS QueryInfoKey( HKEY hKey, TCHAR* keyClass, DWORD* keyClassLen, DWORD* reserved, DWORD* subKeys,
+                              DWORD* maxSubKeyLen, DWORD* maxClassLen, DWORD* values, DWORD* maxValueNameLen,
+                              DWORD* maxValueLen, DWORD* securityDescriptor, FILETIME* lastWriteTime );
+
+        LSTATUS EnumValue( HKEY hKey, DWORD index, TCHAR* valueName, DWORD* valueNameLen, DWORD* reserved,
+                           DWORD* type, BYTE* data, DWORD* dataSize );
+
+        LSTATUS EnumKeyEx( HKEY hKey, DWORD index, TCHAR* name, DWORD* nameLen, DWORD* reserved, TCHAR* keyClass,
+                           DWORD* keyClassLen, FILETIME* lastWriteTime );
+
+        LSTATUS NotifyChangeKeyValue( HKEY hKey, BOOL watchSubtree, DWORD notifyFilter, HANDLE event, BOOL asynchronous );
+
+        LSTATUS FlushKey( HKEY hKey );
+
+    private:
+        MemoryHive( const MemoryHive& );
+        MemoryHive& operator = ( const MemoryHive& );
+
+        struct Value
+        {
+            std::basic_string<TCHAR>    name;
+            DWORD                       type;
+            std::vector<BYTE>           data;
+        };
+
+        struct Node : std::enable_shared_from_this<Node>
+        {
+            std::basic_string<TCHAR>                name;
+            Node*                                   parent;     /// Null for a root and for a deleted key.
+            bool                                    deleted;
+            FILETIME                                lastWrite;
+            std::vector<std::shared_ptr<Node>>      subKeys;
+            std::vector<Value>                      values;
+        };
+
+        /// What an HKEY of the hive points to; the node lives as long as a handle holds it.
+        struct Handle
+        {
+            std::shared_ptr<Node>   node;
+        };
+
+        struct Registration
+        {
+            Handle*     handle;
+            HANDLE      event;
+            bool        watchSubtree;
+            DWORD       filter;
+        };
+
+        static const DWORD RootCount = 8;   /// HKEY_CLASSES_ROOT to HKEY_CURRENT_USER_LOCAL_SETTINGS.
+
+        /// The node of a handle or of a predefined key. Null with ERROR_INVALID_HANDLE for a handle the
+        /// hive doesn't know, and with ERROR_KEY_DELETED for a deleted key.
+        Node*  GetNode( _In_ HKEY hKey, _Out_ LSTATUS* status ) const;
+
+        /// The open handle, not a predefined key; null when the hive doesn't know it.
+        Handle* FindHandle( _In_ HKEY hKey ) const;
+
+        /// Walks a path of subkeys separated by '\'; returns null when one of them is missing.
+        static Node*  FindPath( _In_ Node* node, _In_opt_z_ const TCHAR* path );
+
+        static Node*  FindSubKey( _In_ const Node* node, _In_z_ const TCHAR* name, _In_ size_t nameLen );
+
+        static Value* FindValue( _In_ Node* node, _In_opt_z_ const TCHAR* name );
+
+        /// Copies the data of a value as the Reg* calls do: only the size without a buffer,
+        /// ERROR_MORE_DATA and the size needed when the buffer is too small.
+        static LSTATUS CopyData( _In_ const std::vector<BYTE>& source, _Out_opt_ BYTE* data, _Inout_opt_ DWORD* dataSize );
+
+        HKEY   NewHandle( _In_ Node* node );
+
+        /// Moves the last write time of a key forward, at least one tick, so every write is seen.
+        void   Touch( _In_ Node* node );
+
+        /// Signals and drops the registrations that watch the change of a key.
+        void   OnChanged( _In_ Node* node, _In_ DWORD filter );
+
+        std::mutex                      m_lock;
+        std::shared_ptr<Node>           m_roots[RootCount];
+        std::vector<Handle*>            m_handles;          /// The open handles, freed with the hive.
+        std::vector<Registration>       m_registrations;
+        ULONGLONG                       m_lastWrite;        /// The last time given to a key.
+    };
+}
+
+#endif // INCLUDED_MEMORYHIVE_H
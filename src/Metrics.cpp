@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Metrics.cpp
+///  Description: Counters and latency histograms of the registry layer and of the enforcement,
+///               exported in the Prometheus text format.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Metrics.h"
+
+#include <stdio.h>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::atomic<LONG64>     Metrics::m_counters[(int)Counter::Count];
+    Metrics::HistogramData  Metrics::m_histograms[(int)Histogram::Count];
+    LONGLONG                Metrics::m_frequency            = Metrics::QueryFrequency();
+
+    TCHAR                   Metrics::m_pipeName[MAX_PATH]   = { 0 };
+    HANDLE                  Metrics::m_pipe                 = INVALID_HANDLE_VALUE;
+    HANDLE                  Metrics::m_stopEvent            = nullptr;
+    std::thread*            Metrics::m_server               = nullptr;
+
+    static const char* const counterNames[][2] =
+    {
+        { "eyeswapper_keys_opened_total",           "Registry keys opened or created." },
+        { "eyeswapper_keys_closed_total",           "Registry keys closed." },
+        { "eyeswapper_notifications_total",         "Registry change notifications received." },
+        { "eyeswapper_callbacks_total",             "Notify callbacks run." },
+        { "eyeswapper_values_read_total",           "Registry values read." },
+        { "eyeswapper_values_written_total",        "Registry values written." },
+        { "eyeswapper_values_skipped_total",        "Enforced values already in place, not written." },
+        { "eyeswapper_value_errors_total",          "Registry value reads or writes that failed." },
+        { "eyeswapper_rewrites_total",              "Enforced values found changed by the 3D Vision service." },
+        { "eyeswapper_storms_total",                "Rewrite storms detected." },
+        { "eyeswapper_polls_total",                 "Polls of a watched key." },
+        { "eyeswapper_poll_changes_total",          "Polls that found the watched key changed." },
+        { "eyeswapper_poll_cpu_cycles_total",       "CPU cycles used by the polls." },
+        { "eyeswapper_value_batches_total",         "Calls reading several registry values at once." },
+        { "eyeswapper_value_batch_fallbacks_total", "Batched value reads done one value at a time." },
+        { "eyeswapper_cached_scans_total",          "Key enumerations answered from the cache." },
+        { "eyeswapper_key_wait_wakeups_total",      "Wake-ups while waiting for the Stereo3D key to be created." },
+        { "eyeswapper_keys_reopened_total",         "Registry keys opened again after being deleted." },
+        { "eyeswapper_writes_coalesced_total",      "Queued registry writes replaced by a later write." },
+        { "eyeswapper_flushes_coalesced_total",     "Registry flushes merged into another by a write queue." },
+        { "eyeswapper_notifications_filtered_total", "Notifications dropped because no watched value changed." }
+    };
+
+    static const char* const histogramNames[][2] =
+    {
+        { "eyeswapper_get_value_seconds",           "Latency of registry value reads." },
+        { "eyeswapper_set_value_seconds",           "Latency of registry value writes." },
+        { "eyeswapper_notify_callback_seconds",     "Time spent in notify callbacks." },
+        { "eyeswapper_poll_seconds",                "Duration of the polls of a watched key." }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    const char* Metrics::GetName( _In_ Counter counter )
+    {
+        return counterNames[(int)counter][0];
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LONGLONG Metrics::QueryFrequency()
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Metrics::Format( _Out_writes_(size) char* buffer, _In_ size_t size )
+    {
+        size_t length = 0;
+
+        auto append = [&] (int written)
+        {
+            if(written > 0)
+                length += (size_t)written;
+        };
+
+        for(int i = 0; i < (int)Counter::Count; i++)
+        {
+            append( _snprintf_s(buffer + length, size - length, _TRUNCATE,
+                                "# HELP %s %s\n# TYPE %s counter\n%s %lld\n",
+                                counterNames[i][0], counterNames[i][1], counterNames[i][0], counterNames[i][0],
+                                (long long)m_counters[i].load(std::memory_order_relaxed)) );
+        }
+
+        for(int i = 0; i < (int)Histogram::Count; i++)
+        {
+            const char*     name = histogramNames[i][0];
+            HistogramData&  data = m_histograms[i];
+
+            append( _snprintf_s(buffer + length, size - length, _TRUNCATE,
+                                "# HELP %s %s\n# TYPE %s histogram\n", name, histogramNames[i][1], name) );
+
+            // Prometheus buckets are cumulative.
+            LONG64 count = 0;
+            for(DWORD bucket = 0; bucket < BucketCount; bucket++)
+            {
+                count += data.buckets[bucket].load(std::memory_order_relaxed);
+
+                if(bucket < BucketCount - 1)
+                    append( _snprintf_s(buffer + length, size - length, _TRUNCATE,
+                                        "%s_bucket{le=\"%.6f\"} %lld\n", name, (double)(1LL << bucket) / 1000000.0, (long long)count) );
+                else
+                    append( _snprintf_s(buffer + length, size - length, _TRUNCATE,
+                                        "%s_bucket{le=\"+Inf\"} %lld\n", name, (long long)count) );
+            }
+
+            append( _snprintf_s(buffer + length, size - length, _TRUNCATE,
+                                "%s_sum %.6f\n%s_count %lld\n",
+                                name, (double)data.sumMicros.load(std::memory_order_relaxed) / 1000000.0, name, (long long)count) );
+        }
+
+        return length;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Metrics::Export( _In_z_ const TCHAR* fileName )
+    {
+        static char buffer[16384];
+        static std::atomic<bool> exporting(false);
+
+        if(exporting.exchange(true))
+            return ERROR_BUSY;
+
+        size_t length = Format(buffer, sizeof(buffer));
+
+        TCHAR tempFileName[MAX_PATH];
+        _stprintf_s(tempFileName, MAX_PATH, _T("%s.tmp"), fileName);
+
+        LSTATUS status = ERROR_SUCCESS;
+        HANDLE  file   = CreateFile(tempFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+            status = GetLastError();
+        else
+        {
+            DWORD written = 0;
+            if(!WriteFile(file, buffer, (DWORD)length, &written, nullptr) || written != length)
+                status = GetLastError();
+
+            CloseHandle(file);
+
+            if(status == ERROR_SUCCESS && !MoveFileEx(tempFileName, fileName, MOVEFILE_REPLACE_EXISTING))
+                status = GetLastError();
+        }
+
+        exporting = false;
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Metrics::Serve( _In_z_ const TCHAR* pipeName )
+    {
+        if(m_server != nullptr)
+            return ERROR_ALREADY_EXISTS;
+
+        _tcscpy_s(m_pipeName, MAX_PATH, pipeName);
+
+        // The one instance is created here and kept until StopServing, so no other process can take
+        // the name in between, nor before if it fails here.
+        // Duplex only to see the client close its end; it never sends anything.
+        m_pipe = CreateNamedPipe( m_pipeName,
+                                  PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE | FILE_FLAG_OVERLAPPED,
+                                  PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                  1,
+                                  BufferSize,
+                                  0,
+                                  0,
+                                  nullptr );
+        if(m_pipe == INVALID_HANDLE_VALUE)
+            return GetLastError();
+
+        m_stopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if(m_stopEvent == nullptr)
+        {
+            LSTATUS status = GetLastError();
+            CloseHandle(m_pipe);
+            m_pipe = INVALID_HANDLE_VALUE;
+            return status;
+        }
+
+        m_server = new std::thread(ServeWorker);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Metrics::StopServing()
+    {
+        if(m_server == nullptr)
+            return;
+
+        // Every wait of the worker ends with the stop event, whatever the client does.
+        SetEvent(m_stopEvent);
+
+        m_server->join();
+        delete m_server;
+        m_server = nullptr;
+
+        CloseHandle(m_pipe);
+        CloseHandle(m_stopEvent);
+        m_pipe      = INVALID_HANDLE_VALUE;
+        m_stopEvent = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Metrics::ServeWorker()
+    {
+        static char buffer[BufferSize];
+
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if(overlapped.hEvent == nullptr)
+            return;
+
+        while(WaitForSingleObject(m_stopEvent, 0) == WAIT_TIMEOUT)
+        {
+            DWORD transferred = 0;
+
+            ResetEvent(overlapped.hEvent);
+
+            bool connected = ConnectNamedPipe(m_pipe, &overlapped) != FALSE || GetLastError() == ERROR_PIPE_CONNECTED;
+            if(!connected && GetLastError() == ERROR_IO_PENDING)
+                connected = WaitForPipe(&overlapped, INFINITE, &transferred);
+
+            if(connected)
+            {
+                DWORD size = (DWORD)Format(buffer, sizeof(buffer));
+
+                bool written = WriteFile(m_pipe, buffer, size, nullptr, &overlapped) != FALSE;
+                if(!written && GetLastError() == ERROR_IO_PENDING)
+                    written = WaitForPipe(&overlapped, ClientTimeoutMs, &transferred);
+
+                // Instead of FlushFileBuffers, which waits as long as the client doesn't read: the
+                // client closing its end fails the read, and a client that doesn't is cut off.
+                if(written)
+                {
+                    char none;
+                    if(!ReadFile(m_pipe, &none, 1, nullptr, &overlapped) && GetLastError() == ERROR_IO_PENDING)
+                        WaitForPipe(&overlapped, ClientTimeoutMs, &transferred);
+                }
+            }
+
+            if(!DisconnectNamedPipe(m_pipe))
+                break;
+        }
+
+        CloseHandle(overlapped.hEvent);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Waits for the pending operation on the pipe, the stop event or the timeout; the operation is
+    /// cancelled on the last two. Returns whether it succeeded.
+    bool Metrics::WaitForPipe( _Inout_ OVERLAPPED* overlapped, _In_ DWORD timeoutMs, _Out_ DWORD* transferred )
+    {
+        HANDLE events[2] = { m_stopEvent, overlapped->hEvent };
+
+        if(WaitForMultipleObjects(2, events, FALSE, timeoutMs) != WAIT_OBJECT_0 + 1)
+            CancelIoEx(m_pipe, overlapped);
+
+        // Once cancelled, the operation still has to end before the OVERLAPPED can be used again.
+        return GetOverlappedResult(m_pipe, overlapped, transferred, TRUE) != FALSE;
+    }
+}
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Metrics.h
+///  Description: Counters and latency histograms of the registry layer and of the enforcement,
+///               exported in the Prometheus text format.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_METRICS_H
+#define INCLUDED_METRICS_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <atomic>
+#include <thread>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The exported counters.
+    enum class Counter
+    {
+        KeysOpened,
+        KeysClosed,
+        NotificationsReceived,
+        CallbacksRun,
+        ValuesRead,
+        ValuesWritten,
+        ValuesSkipped,          /// Enforced values that were already in place, so no write was needed.
+        ValueErrors,            /// Failed value reads or writes.
+        Rewrites,               /// Enforced values found changed by someone else.
+        StormsEntered,
+        Polls,
+        PollChanges,            /// Polls that found the key changed.
+        PollCycles,             /// CPU cycles used by the polls.
+        ValueBatches,           /// RegQueryMultipleValues calls.
+        ValueBatchFallbacks,    /// Batched reads done value by value.
+        CachedScans,            /// Key enumerations answered from the cache.
+        KeyWaitWakeups,         /// Wake-ups of a thread waiting for a key to be created.
+        KeysReopened,
+        WritesCoalesced,        /// Queued writes replaced by a later one before they were made.
+        FlushesCoalesced,       /// Flushes asked by the durability of a write queue but merged into another.
+        NotificationsFiltered,  /// Notifications dropped because no value watched by the subscriber changed.
+        Count
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The exported latency histograms.
+    enum class Histogram
+    {
+        GetValue,
+        SetValue,
+        NotifyCallback,
+        Poll,
+        Count
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class Metrics
+    {
+    public:
+        static const DWORD BucketCount = 22;    // Powers of 2 from 1us to ~1s, plus +Inf.
+
+        static void Increment( _In_     Counter counter,
+                               _In_opt_ LONG64  value = 1 )
+        {
+            m_counters[(int)counter].fetch_add(value, std::memory_order_relaxed);
+        }
+
+        /// Returns a time stamp to be passed later to RecordLatency.
+        static LONGLONG Now()
+        {
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            return now.QuadPart;
+        }
+
+        /// Adds the time elapsed since start (see Now) to a histogram.
+        static void RecordLatency( _In_ Histogram   histogram,
+                                   _In_ LONGLONG    start )
+        {
+            LONGLONG elapsed = Now() - start;
+            LONGLONG micros  = (elapsed * 1000000) / m_frequency;
+
+            DWORD bucket = 0;
+            while(bucket < BucketCount - 1 && micros > (1LL << bucket))
+                bucket++;
+
+            HistogramData& data = m_histograms[(int)histogram];
+            data.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            data.sumMicros.fetch_add(micros, std::memory_order_relaxed);
+        }
+
+        static LONG64 Get( _In_ Counter counter )
+        {
+            return m_counters[(int)counter].load(std::memory_order_relaxed);
+        }
+
+        /// The exported name of a counter.
+        static const char* GetName( _In_ Counter counter );
+
+        /// Writes all metrics to a file, replacing it atomically so a scraper never reads a partial file.
+        static LSTATUS Export( _In_z_ const TCHAR* fileName );
+
+        /// Serves the metrics on a local named pipe ("\\.\pipe\<name>"); every client connection gets
+        /// a fresh snapshot, and is cut off when it doesn't read it within ClientTimeoutMs. The server
+        /// stops when StopServing is called, whatever the client does. Fails with ERROR_ACCESS_DENIED
+        /// when another process already created the pipe.
+        static LSTATUS Serve( _In_z_ const TCHAR* pipeName );
+
+        static void StopServing();
+
+    private:
+        struct HistogramData
+        {
+            std::atomic<LONG64> buckets[BucketCount];
+            std::atomic<LONG64> sumMicros;
+        };
+
+        static LONGLONG     QueryFrequency();
+        static size_t       Format( _Out_writes_(size) char* buffer, _In_ size_t size );
+        static void         ServeWorker();
+        static bool         WaitForPipe( _Inout_ OVERLAPPED* overlapped, _In_ DWORD timeoutMs, _Out_ DWORD* transferred );
+
+        static std::atomic<LONG64>  m_counters[(int)Counter::Count];
+        static HistogramData        m_histograms[(int)Histogram::Count];
+        static LONGLONG             m_frequency;
+
+        static const DWORD          BufferSize      = 16384;
+        static const DWORD          ClientTimeoutMs = 1000;     // For a client to take its snapshot.
+
+        static TCHAR                m_pipeName[MAX_PATH];
+        static HANDLE               m_pipe;             /// The one instance of the pipe while serving.
+        static HANDLE               m_stopEvent;
+        static std::thread*         m_server;
+    };
+}
+
+#endif // INCLUDED_METRICS_H
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        NameMatcher.cpp
+///  Description: Matches registry names against a set of names and glob patterns.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./NameMatcher.h"
+
+#include <algorithm>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    NameMatcher::NameMatcher()
+    {
+        m_nodes.resize(1);
+        m_nodes[0].isName   = false;
+        m_nodes[0].isPrefix = false;
+        m_prefixCount       = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void NameMatcher::Add( _In_z_ const TCHAR* pattern )
+    {
+        size_t length   = _tcslen(pattern);
+        size_t wildcard = _tcscspn(pattern, _T("*?"));
+
+        // A glob with wildcards before its end can't be walked in the trie.
+        bool isName   = (wildcard == length);
+        bool isPrefix = (wildcard == length - 1 && pattern[wildcard] == _T('*'));
+
+        if(!isName && !isPrefix)
+        {
+            m_globs.push_back(pattern);
+            return;
+        }
+
+        DWORD node = 0;
+        for(size_t i = 0; i < wildcard; i++)
+        {
+            TCHAR c = Fold(pattern[i]);
+
+            auto& children = m_nodes[node].children;
+            auto  child    = std::lower_bound( children.begin(), children.end(), std::make_pair(c, (DWORD)0) );
+
+            if(child != children.end() && child->first == c)
+            {
+                node = child->second;
+                continue;
+            }
+
+            DWORD next = (DWORD)m_nodes.size();
+            children.insert(child, std::make_pair(c, next));
+
+            // The insertion above is done before the resize, which can move the children.
+            m_nodes.resize(next + 1);
+            m_nodes[next].isName    = false;
+            m_nodes[next].isPrefix  = false;
+
+            node = next;
+        }
+
+        if(isName)
+        {
+            if(!m_nodes[node].isName)
+                m_names.push_back(pattern);
+
+            m_nodes[node].isName = true;
+        }
+        else
+        {
+            if(!m_nodes[node].isPrefix)
+                m_prefixCount++;
+
+            m_nodes[node].isPrefix = true;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool NameMatcher::Matches( _In_z_ const TCHAR* name ) const
+    {
+        DWORD       node = 0;
+        const TCHAR* c   = name;
+
+        for(;;)
+        {
+            const Node& current = m_nodes[node];
+
+            if(current.isPrefix)
+                return true;
+
+            if(*c == 0)
+            {
+                if(current.isName)
+                    return true;
+                break;
+            }
+
+            TCHAR folded = Fold(*c++);
+            auto  child  = std::lower_bound( current.children.begin(), current.children.end(), std::make_pair(folded, (DWORD)0) );
+
+            if(child == current.children.end() || child->first != folded)
+                break;
+
+            node = child->second;
+        }
+
+        for(auto& glob : m_globs)
+        {
+            if(MatchGlob(glob.c_str(), name))
+                return true;
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    TCHAR NameMatcher::Fold( _In_ TCHAR c )
+    {
+        if(c < 0x80)
+            return (c >= _T('a') && c <= _T('z')) ? (TCHAR)(c - _T('a') + _T('A')) : c;
+
+        // CharUpper takes a single character in the low word of the pointer.
+        return (TCHAR)(ULONG_PTR)CharUpper((LPTSTR)(ULONG_PTR)c);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool NameMatcher::MatchGlob( _In_z_ const TCHAR* glob, _In_z_ const TCHAR* name )
+    {
+        // On a mismatch, the last '*' takes one more character and the match goes on from there.
+        const TCHAR* star      = nullptr;
+        const TCHAR* starName  = nullptr;
+
+        while(*name != 0)
+        {
+            if(*glob == _T('*'))
+            {
+                star        = ++glob;
+                starName    = name;
+            }
+            else if(*glob == _T('?') || (*glob != 0 && Fold(*glob) == Fold(*name)))
+            {
+                glob++;
+                name++;
+            }
+            else if(star != nullptr)
+            {
+                glob    = star;
+                name    = ++starName;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        while(*glob == _T('*'))
+            glob++;
+
+        return *glob == 0;
+    }
+}
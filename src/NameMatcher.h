@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        NameMatcher.h
+///  Description: Matches registry names against a set of names and glob patterns.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_NAMEMATCHER_H
+#define INCLUDED_NAMEMATCHER_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <string>
+#include <vector>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// A set of patterns compiled for matching: a pattern is a name, a prefix ending with '*', or a
+    /// glob where '*' matches any run of characters and '?' any one character. Like registry names,
+    /// the matching is not case sensitive.
+    ///
+    /// The names and the prefixes share one trie, walked once per name whatever their count; the
+    /// other globs are tried one after the other.
+    class NameMatcher
+    {
+    public:
+
+        NameMatcher();
+
+        void Add( _In_z_ const TCHAR* pattern );
+
+        bool Matches( _In_z_ const TCHAR* name ) const;
+
+        bool IsEmpty() const
+        {
+            return m_names.empty() && m_prefixCount == 0 && m_globs.empty();
+        }
+
+        /// True when every pattern is a name, so the matching values can be read by name.
+        bool HasOnlyNames() const
+        {
+            return m_prefixCount == 0 && m_globs.empty();
+        }
+
+        /// The patterns that are names, in the order they were added.
+        const std::vector<std::basic_string<TCHAR>>& GetNames() const
+        {
+            return m_names;
+        }
+
+    private:
+        struct Node
+        {
+            std::vector<std::pair<TCHAR, DWORD>>    children;   /// Folded character and node index, sorted.
+            bool                                    isName;     /// A name ends here.
+            bool                                    isPrefix;   /// A prefix ends here; every longer name matches.
+        };
+
+        static TCHAR    Fold( _In_ TCHAR c );
+        static bool     MatchGlob( _In_z_ const TCHAR* glob, _In_z_ const TCHAR* name );
+
+        std::vector<Node>                       m_nodes;        /// The root is the first.
+        std::vector<std::basic_string<TCHAR>>   m_names;
+        DWORD                                   m_prefixCount;
+        std::vector<std::basic_string<TCHAR>>   m_globs;
+    };
+}
+
+#endif // INCLUDED_NAMEMATCHER_H
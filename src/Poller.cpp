@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Poller.cpp
+///  Description: Watches a key by polling, for when change notifications are not available.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Poller.h"
+#include "./HashTree.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Poller::Poller( _In_     Key*                  key,
+                    _In_opt_ const PollOptions&    options )
+    {
+        m_key       = key;
+        m_options   = options;
+        m_interval  = options.minIntervalMs;
+        m_stopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        m_worker    = nullptr;
+
+        memset(&m_fingerprint, 0, sizeof(m_fingerprint));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Poller::~Poller()
+    {
+        Stop();
+
+        if(m_stopEvent != nullptr)
+            CloseHandle(m_stopEvent);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Poller::Start( _In_ const std::function <bool (_In_ Key &)>& callBack )
+    {
+        if(m_key == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        Stop();
+
+        // The first fingerprint is the reference; only the changes made after Start are reported.
+        bool    changed;
+        LSTATUS status = Check(*m_key, &m_fingerprint, &changed);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        ResetEvent(m_stopEvent);
+        m_interval  = m_options.minIntervalMs;
+        m_worker    = new std::thread(&Poller::Worker, this, callBack);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Poller::Stop()
+    {
+        if(m_worker == nullptr)
+            return;
+
+        SetEvent(m_stopEvent);
+
+        m_worker->join();
+        delete m_worker;
+        m_worker = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Poller::Check( _In_     Key&            key,
+                           _Inout_  Fingerprint*    fingerprint,
+                           _Out_    bool*           changed,
+                           _In_opt_ Allocator*      allocator )
+    {
+        *changed = false;
+
+        // Through QueryInfo, which holds the handle in the epoch, as another thread can reopen the key.
+        KeyInfo  info;
+        LSTATUS  status = key.QueryInfo(&info);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        FILETIME lastWrite = info.lastWrite;
+
+        if(CompareFileTime(&lastWrite, &fingerprint->lastWrite) == 0)
+            return ERROR_SUCCESS;
+
+        // The key was written, but possibly with the same data; only a different hash is a change.
+        QWORD valuesHash = 0;
+        status = key.EnumValues( [&valuesHash] (Value &value) -> bool
+            {
+                QWORD nameHash = HashTree::HashBytes(value.GetName(), _tcslen(value.GetName()) * sizeof(TCHAR));
+                valuesHash    ^= HashTree::HashBytes(value.GetData(), value.GetDataSize(), nameHash + (QWORD)value.GetType());
+
+                return true;
+            },
+            allocator
+        );
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        *changed = (valuesHash != fingerprint->valuesHash);
+
+        fingerprint->lastWrite  = lastWrite;
+        fingerprint->valuesHash = valuesHash;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Poller::Worker( _In_ const std::function <bool (_In_ Key &)>& callBack )
+    {
+        DWORD pathId = Trace::RegisterPath((int)m_key->GetMainKey(), m_key->GetSubKeyPath());
+
+        // The buffers of a check live until the next one; after the first check no more heap memory
+        // is taken.
+        Arena arena(4096);
+
+        while(WaitForSingleObject(m_stopEvent, m_interval) == WAIT_TIMEOUT)
+        {
+            LONGLONG start = Metrics::Now();
+
+            ULONG64 cyclesBefore = 0;
+            ULONG64 cyclesAfter  = 0;
+            QueryThreadCycleTime(GetCurrentThread(), &cyclesBefore);
+
+            bool    changed;
+            LSTATUS status = Check(*m_key, &m_fingerprint, &changed, &arena);
+            arena.Reset();
+
+            QueryThreadCycleTime(GetCurrentThread(), &cyclesAfter);
+
+            Trace::Record(TraceOp::Poll, pathId, nullptr, (status == ERROR_SUCCESS) ? (changed ? 1 : 0) : status);
+            Metrics::Increment(Counter::Polls);
+            Metrics::Increment(Counter::PollCycles, (LONG64)(cyclesAfter - cyclesBefore));
+            Metrics::RecordLatency(Histogram::Poll, start);
+
+            if(!changed)
+            {
+                DWORD interval = m_interval * 2;
+                m_interval     = (interval < m_options.maxIntervalMs) ? interval : m_options.maxIntervalMs;
+                continue;
+            }
+
+            Metrics::Increment(Counter::PollChanges);
+            m_interval = m_options.minIntervalMs;
+
+            if(!callBack(*m_key))
+                break;
+        }
+    }
+}
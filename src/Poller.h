@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Poller.h
+///  Description: Watches a key by polling, for when change notifications are not available.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_POLLER_H
+#define INCLUDED_POLLER_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <functional>
+#include <thread>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct PollOptions
+    {
+        DWORD       minIntervalMs;  /// Interval used right after a change.
+        DWORD       maxIntervalMs;  /// Interval reached when the key stays unchanged.
+
+        PollOptions()
+        {
+            minIntervalMs = 20;
+            maxIntervalMs = 1000;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Polls the values of a key and calls back when they change. Only Query_Value rights are needed.
+    /// The interval is reset to the minimum after a change and doubles on every poll that finds
+    /// nothing, up to the maximum. It can run next to AddNotify to catch the notifications that are
+    /// lost while the notify callback runs.
+    class Poller
+    {
+    public:
+
+        Poller( _In_     Key*                  key,
+                _In_opt_ const PollOptions&    options = PollOptions() );
+
+        ~Poller();
+
+        /// Starts the polling thread. The callback runs on it; returning false stops the polling.
+        LSTATUS Start( _In_ const std::function <bool (_In_ Key &)>& callBack );
+
+        void Stop();
+
+        DWORD GetInterval() const
+        {
+            return m_interval;
+        }
+
+        /// The fingerprint of the values: the last-write time of the key, and a hash of the values
+        /// that is only computed when the last-write time moved.
+        struct Fingerprint
+        {
+            FILETIME    lastWrite;
+            QWORD       valuesHash;
+        };
+
+        /// Updates a fingerprint, and tells if the values changed since it was taken.
+        static LSTATUS Check( _In_     Key&            key,
+                              _Inout_  Fingerprint*    fingerprint,
+                              _Out_    bool*           changed,
+                              _In_opt_ Allocator*      allocator = nullptr );
+
+    private:
+        void Worker( _In_ const std::function <bool (_In_ Key &)>& callBack );
+
+        Key*            m_key;
+        PollOptions     m_options;
+        volatile DWORD  m_interval;
+        Fingerprint     m_fingerprint;
+        HANDLE          m_stopEvent;
+        std::thread*    m_worker;
+    };
+}
+
+#endif // INCLUDED_POLLER_H
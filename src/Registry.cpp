@@ -17,9 +17,35 @@
 ///
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 #include "./Registry.h"
+#include "./NameMatcher.h"
+
+#include <algorithm>
+#include <new>
 
 namespace Registry
 {
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    template <typename T>
+    static T* AllocateArray( _In_opt_ Allocator* allocator, _In_ size_t count )
+    {
+        if(allocator == nullptr)
+            return new T[count];
+
+        return (T*)allocator->Allocate(sizeof(T) * count);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    template <typename T>
+    static void FreeArray( _In_opt_ Allocator* allocator, _In_opt_ T* array )
+    {
+        if(allocator == nullptr)
+            delete [] array;
+        else
+            allocator->Deallocate(array);
+    }
+
+    Epoch Key::m_handleEpoch;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     const HKEY Key::m_predefinedKeys[] =
     {
@@ -39,54 +65,73 @@ namespace Registry
     Key* Key::Open( _In_      PredefinedKey         mainKey,
                     _In_z_    const TCHAR*          subKeyPath,
                     _In_opt_  AccessRights          accessRights,
-                    _Out_opt_ LSTATUS*              statusCode )
+                    _Out_opt_ LSTATUS*              statusCode,
+                    _In_opt_  Allocator*            allocator,
+                    _In_opt_  Hive*                 hive )
     {
-        return OpenKey(mainKey, subKeyPath, false, accessRights, statusCode);
+        return OpenKey(mainKey, subKeyPath, false, accessRights, statusCode, allocator, hive);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     Key* Key::Create( _In_      PredefinedKey       mainKey,
                       _In_z_    const TCHAR*        subKeyPath,
                       _In_opt_  AccessRights        accessRights,
-                      _Out_opt_ LSTATUS*            statusCode )
+                      _Out_opt_ LSTATUS*            statusCode,
+                      _In_opt_  Allocator*          allocator,
+                      _In_opt_  Hive*               hive )
     {
-        return OpenKey(mainKey, subKeyPath, true, accessRights, statusCode);
+        return OpenKey(mainKey, subKeyPath, true, accessRights, statusCode, allocator, hive);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     LSTATUS Key::Delete( _In_      PredefinedKey    mainKey,
                          _In_z_    const TCHAR*     subKeyPath,
-                         _In_opt_  AccessRights     accessRights )
+                         _In_opt_  AccessRights     accessRights,
+                         _In_opt_  Hive*            hive )
     {
         if(subKeyPath == nullptr)
             return ERROR_INVALID_PARAMETER;
 
+        if(hive == nullptr)
+            hive = &Hive::GetWindows();
+
         if( accessRights != AccessRights::None &&
             accessRights != (AccessRights::WoW64_32Key | AccessRights::WoW64_64Key) )
             return ERROR_INVALID_PARAMETER;
 
-        return RegDeleteKeyEx( m_predefinedKeys[(int)mainKey],
-                               subKeyPath,
-                               (REGSAM)accessRights,
-                               0 );
+        LSTATUS status = hive->DeleteKeyEx( m_predefinedKeys[(int)mainKey],
+                                            subKeyPath,
+                                            (REGSAM)accessRights,
+                                            0 );
+
+        Trace::Record(TraceOp::Delete, Trace::RegisterPath((int)mainKey, subKeyPath), nullptr, status);
+
+        return status;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     bool Key::Exists( _In_      PredefinedKey     mainKey,
-                      _In_z_    const TCHAR*      subKeyPath )
+                      _In_z_    const TCHAR*      subKeyPath,
+                      _In_opt_  Hive*             hive )
     {
         if(subKeyPath == nullptr)
             return false;
 
+        if(hive == nullptr)
+            hive = &Hive::GetWindows();
+
         HKEY hKey;
-        LSTATUS status = RegOpenKeyEx( m_predefinedKeys[(int)mainKey],
-                                       subKeyPath,
-                                       0,
-                                       (REGSAM)AccessRights::Query_Value,
-                                       &hKey );
+        LSTATUS status = hive->OpenKeyEx( m_predefinedKeys[(int)mainKey],
+                                          subKeyPath,
+                                          0,
+                                          (REGSAM)AccessRights::Query_Value,
+                                          &hKey );
+
+        Trace::Record(TraceOp::Open, Trace::RegisterPath((int)mainKey, subKeyPath), nullptr, status);
+
         if(status == ERROR_SUCCESS)
         {
-            RegCloseKey(hKey);
+            hive->CloseKey(hKey);
             return true;
         }
 
@@ -98,7 +143,9 @@ namespace Registry
                       _In_z_    const TCHAR*      subKeyPath,
                       _In_      bool              createKey,
                       _In_      AccessRights      accessRights,
-                      _Out_     LSTATUS*          statusCode )
+                      _Out_     LSTATUS*          statusCode,
+                      _In_opt_  Allocator*        allocator,
+                      _In_opt_  Hive*             hive )
     {
         if(subKeyPath == nullptr)
         {
@@ -108,70 +155,212 @@ namespace Registry
             return nullptr;
         }
 
+        if(hive == nullptr)
+            hive = &Hive::GetWindows();
+
         HKEY hKey       = nullptr;
         LSTATUS status  = ERROR_SUCCESS;
         bool keyCreated = false;
         
         if(!createKey)
-            status = RegOpenKeyEx( m_predefinedKeys[(int)mainKey],
-                                   subKeyPath,
-                                   0,
-                                   (REGSAM)accessRights,
-                                   &hKey );
+            status = hive->OpenKeyEx( m_predefinedKeys[(int)mainKey],
+                                      subKeyPath,
+                                      0,
+                                      (REGSAM)accessRights,
+                                      &hKey );
         else
         {
             DWORD disposition;
-            status = RegCreateKeyEx( m_predefinedKeys[(int)mainKey],
-                                     subKeyPath,
-                                     0,
-                                     nullptr,
-                                     REG_OPTION_NON_VOLATILE,
-                                     (REGSAM)accessRights,
-                                     nullptr,
-                                     &hKey,
-                                     &disposition);
+            status = hive->CreateKeyEx( m_predefinedKeys[(int)mainKey],
+                                        subKeyPath,
+                                        0,
+                                        nullptr,
+                                        REG_OPTION_NON_VOLATILE,
+                                        (REGSAM)accessRights,
+                                        nullptr,
+                                        &hKey,
+                                        &disposition);
 
             keyCreated = (disposition == REG_CREATED_NEW_KEY);
         }
 
+        DWORD pathId = Trace::RegisterPath((int)mainKey, subKeyPath);
+        Trace::Record(createKey ? TraceOp::Create : TraceOp::Open, pathId, nullptr, status);
+
         if(statusCode != nullptr)
             *statusCode = status;
 
         if(status != ERROR_SUCCESS)
             return nullptr;
 
+        Metrics::Increment(Counter::KeysOpened);
+
         size_t subKeyPathLen    = _tcslen(subKeyPath) + 1;
-        TCHAR *subKeyPathCopy   = new TCHAR[subKeyPathLen];
+        TCHAR *subKeyPathCopy   = AllocateArray<TCHAR>(allocator, subKeyPathLen);
         _tcscpy_s(subKeyPathCopy, subKeyPathLen, subKeyPath);
 
-        return new Key(mainKey, subKeyPathCopy, keyCreated, accessRights, hKey);
+        return NewKey(mainKey, subKeyPathCopy, keyCreated, accessRights, hKey, pathId, allocator, hive);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Key* Key::NewKey( _In_        PredefinedKey     mainKey,
+                      _In_z_      const TCHAR*      subKeyPath,
+                      _In_        bool              hKeyCreated,
+                      _In_        AccessRights      accessRights,
+                      _In_        HKEY              hKey,
+                      _In_        DWORD             pathId,
+                      _In_opt_    Allocator*        allocator,
+                      _In_        Hive*             hive )
+    {
+        if(allocator == nullptr)
+            return new Key(mainKey, subKeyPath, hKeyCreated, accessRights, hKey, pathId, nullptr, hive);
+
+        void* memory = allocator->Allocate(sizeof(Key), __alignof(Key));
+        return new (memory) Key(mainKey, subKeyPath, hKeyCreated, accessRights, hKey, pathId, allocator, hive);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::Reopen()
+    {
+        HKEY    hKey    = nullptr;
+        LSTATUS status  = m_hive->OpenKeyEx( m_predefinedKeys[(int)m_mainKey],
+                                             m_subKeyPath,
+                                             0,
+                                             (REGSAM)m_accessRights,
+                                             &hKey );
+
+        Trace::Record(TraceOp::Reopen, m_pathId, nullptr, status);
+
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        HKEY previous = (HKEY)InterlockedExchangePointer((PVOID volatile*)&m_hKey, hKey);
+
+        m_handleEpoch.Synchronize();
+
+        if(previous != nullptr)
+            m_hive->CloseKey(previous);
+
+        // The registrations on the previous handle fired when it was closed, or failed if the key was
+        // deleted; either way the notify thread arms them again on the new handle.
+        if(m_subscribersChanged != nullptr)
+            SetEvent(m_subscribersChanged);
+
+        Metrics::Increment(Counter::KeysReopened);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Key* Key::OpenSubKey( _In_z_      const TCHAR*      subKeyName,
+                          _In_opt_    AccessRights      accessRights,
+                          _Out_opt_   LSTATUS*          statusCode,
+                          _In_opt_    Allocator*        allocator ) const
+    {
+        Epoch::Reader handle(m_handleEpoch);
+
+        if(subKeyName == nullptr)
+        {
+            if(statusCode != nullptr)
+                *statusCode = ERROR_INVALID_PARAMETER;
+
+            return nullptr;
+        }
+
+        if(allocator == nullptr)
+            allocator = m_allocator;
+
+        size_t subKeyPathLen    = _tcslen(m_subKeyPath) + 1 + _tcslen(subKeyName) + 1;
+        TCHAR *subKeyPath       = AllocateArray<TCHAR>(allocator, subKeyPathLen);
+        _stprintf_s(subKeyPath, subKeyPathLen, _T("%s\\%s"), m_subKeyPath, subKeyName);
+
+        HKEY hKey       = nullptr;
+        LSTATUS status  = m_hive->OpenKeyEx( m_hKey,
+                                             subKeyName,
+                                             0,
+                                             (REGSAM)accessRights,
+                                             &hKey );
+
+        DWORD pathId = Trace::RegisterPath((int)m_mainKey, subKeyPath);
+        Trace::Record(TraceOp::Open, pathId, nullptr, status);
+
+        if(statusCode != nullptr)
+            *statusCode = status;
+
+        if(status != ERROR_SUCCESS)
+        {
+            FreeArray(allocator, subKeyPath);
+            return nullptr;
+        }
+
+        Metrics::Increment(Counter::KeysOpened);
+
+        return NewKey(m_mainKey, subKeyPath, false, accessRights, hKey, pathId, allocator, m_hive);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     LSTATUS Key::DeleteSubkey( _In_z_   const TCHAR*      subKeyPath,
                                _In_opt_ AccessRights      accessRights ) const
     {
+        Epoch::Reader handle(m_handleEpoch);
+
         if( accessRights != AccessRights::None &&
             accessRights != (AccessRights::WoW64_32Key | AccessRights::WoW64_64Key) )
             return ERROR_INVALID_PARAMETER;
 
-        return RegDeleteKeyEx( m_hKey,
-                               subKeyPath,
-                               (REGSAM)m_accessRights,
-                               0 );
+        LSTATUS status = m_hive->DeleteKeyEx( m_hKey,
+                                              subKeyPath,
+                                              (REGSAM)m_accessRights,
+                                              0 );
+
+        Trace::Record(TraceOp::Delete, m_pathId, nullptr, status);
+
+        return status;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     LSTATUS Key::DeleteValue( _In_opt_z_ const TCHAR* valueName ) const
     {
-        return RegDeleteValue( m_hKey,
-                               valueName );
+        Epoch::Reader handle(m_handleEpoch);
+
+        LSTATUS status = m_hive->DeleteValue( m_hKey,
+                                              valueName );
+
+        Trace::Record(TraceOp::DeleteValue, m_pathId, valueName, status);
+
+        return status;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
-    LSTATUS Key::GetValue(const TCHAR *valueName, void **data, DWORD *dataSize, DataType *dataType ) const
+    LSTATUS Key::SetValue(const TCHAR *valueName, const void *data, DWORD dataSize, DataType dataType ) const
     {
-        LSTATUS status = ERROR_SUCCESS;
+        Epoch::Reader handle(m_handleEpoch);
+
+        LONGLONG start  = Metrics::Now();
+        LSTATUS  status = m_hive->SetValueEx( m_hKey, valueName, 0, (DWORD)dataType, (const BYTE*)data, dataSize);
+
+        Trace::Record(TraceOp::SetValue, m_pathId, valueName, status);
+        Metrics::Increment(status == ERROR_SUCCESS ? Counter::ValuesWritten : Counter::ValueErrors);
+        Metrics::RecordLatency(Histogram::SetValue, start);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Key::OnValueRead( _In_opt_ const TCHAR* valueName, _In_ LSTATUS status, _In_ LONGLONG start ) const
+    {
+        Trace::Record(TraceOp::GetValue, m_pathId, valueName, status);
+        Metrics::Increment(status == ERROR_SUCCESS ? Counter::ValuesRead : Counter::ValueErrors);
+        Metrics::RecordLatency(Histogram::GetValue, start);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::GetValue(const TCHAR *valueName, void **data, DWORD *dataSize, DataType *dataType, Allocator *allocator ) const
+    {
+        Epoch::Reader handle(m_handleEpoch);
+
+        LONGLONG start  = Metrics::Now();
+        LSTATUS  status = ERROR_SUCCESS;
 
         if(data == nullptr && dataSize == nullptr && dataType == nullptr)
             return ERROR_INVALID_PARAMETER;
@@ -180,9 +369,12 @@ namespace Registry
         void*   data_ = nullptr;
         DWORD   dataSize_;
 
-        status = RegGetValue(m_hKey, nullptr, valueName, RRF_RT_ANY, &type_, data_, &dataSize_);
+        status = m_hive->GetValue(m_hKey, nullptr, valueName, RRF_RT_ANY, &type_, data_, &dataSize_);
         if(status != ERROR_SUCCESS)
+        {
+            OnValueRead(valueName, status, start);
             return status;
+        }
 
         if(dataType != nullptr)
             *dataType = (DataType)type_;
@@ -193,25 +385,31 @@ namespace Registry
         if(data != nullptr)
         {
             dataSize_ += 2;
-            data_ = new BYTE[dataSize_];
-            status = RegGetValue(m_hKey, nullptr, valueName, RRF_RT_ANY, &type_, data_, &dataSize_);
+            data_ = AllocateArray<BYTE>(allocator, dataSize_);
+            status = m_hive->GetValue(m_hKey, nullptr, valueName, RRF_RT_ANY, &type_, data_, &dataSize_);
             if(status != ERROR_SUCCESS)
             {
+                OnValueRead(valueName, status, start);
                 *data = nullptr;
-                delete [] data_;
+                FreeArray(allocator, (BYTE*)data_);
                 return status;
             }
 
             *data = data_;
         }
 
+        OnValueRead(valueName, ERROR_SUCCESS, start);
+
         return ERROR_SUCCESS;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
-    LSTATUS Key::GetValueString(const TCHAR *valueName, TCHAR **value ) const
+    LSTATUS Key::GetValueString(const TCHAR *valueName, TCHAR **value, Allocator *allocator ) const
     {
-        LSTATUS status = ERROR_SUCCESS;
+        Epoch::Reader handle(m_handleEpoch);
+
+        LONGLONG start  = Metrics::Now();
+        LSTATUS  status = ERROR_SUCCESS;
 
         if(value == nullptr)
             return ERROR_INVALID_PARAMETER;
@@ -219,17 +417,22 @@ namespace Registry
         TCHAR*  data_ = nullptr;
         DWORD   dataSize_;
 
-        status = RegGetValue(m_hKey, nullptr, valueName, RRF_RT_REG_SZ | RRF_RT_REG_MULTI_SZ | RRF_RT_REG_EXPAND_SZ, nullptr, data_, &dataSize_);
+        status = m_hive->GetValue(m_hKey, nullptr, valueName, RRF_RT_REG_SZ | RRF_RT_REG_MULTI_SZ | RRF_RT_REG_EXPAND_SZ, nullptr, data_, &dataSize_);
         if(status != ERROR_SUCCESS)
+        {
+            OnValueRead(valueName, status, start);
             return status;
+        }
 
         dataSize_ += 2;
-        data_ = new TCHAR[dataSize_];
-        status = RegGetValue(m_hKey, nullptr, valueName, RRF_RT_REG_SZ | RRF_RT_REG_MULTI_SZ | RRF_RT_REG_EXPAND_SZ, nullptr, data_, &dataSize_);
+        data_ = AllocateArray<TCHAR>(allocator, dataSize_);
+        status = m_hive->GetValue(m_hKey, nullptr, valueName, RRF_RT_REG_SZ | RRF_RT_REG_MULTI_SZ | RRF_RT_REG_EXPAND_SZ, nullptr, data_, &dataSize_);
+        OnValueRead(valueName, status, start);
+
         if(status != ERROR_SUCCESS)
         {
             *value = nullptr;
-            delete [] data_;
+            FreeArray(allocator, data_);
             return status;
         }
 
@@ -241,14 +444,18 @@ namespace Registry
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     LSTATUS Key::GetValueDWORD(const TCHAR *valueName, DWORD *value ) const
     {
-        LSTATUS status = ERROR_SUCCESS;
+        Epoch::Reader handle(m_handleEpoch);
+
+        LONGLONG start  = Metrics::Now();
+        LSTATUS  status = ERROR_SUCCESS;
 
         if(value == nullptr)
             return ERROR_INVALID_PARAMETER;
 
         DWORD   data_;
         DWORD   dataSize_ = sizeof(DWORD);
-        status = RegGetValue(m_hKey, nullptr, valueName, RRF_RT_DWORD, nullptr, &data_, &dataSize_);
+        status = m_hive->GetValue(m_hKey, nullptr, valueName, RRF_RT_DWORD, nullptr, &data_, &dataSize_);
+        OnValueRead(valueName, status, start);
         if(status != ERROR_SUCCESS)
             return status;
 
@@ -260,14 +467,18 @@ namespace Registry
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     LSTATUS Key::GetValueQWORD(const TCHAR *valueName, QWORD *value ) const
     {
-        LSTATUS status = ERROR_SUCCESS;
+        Epoch::Reader handle(m_handleEpoch);
+
+        LONGLONG start  = Metrics::Now();
+        LSTATUS  status = ERROR_SUCCESS;
 
         if(value == nullptr)
             return ERROR_INVALID_PARAMETER;
 
         QWORD   data_;
         DWORD   dataSize_ = sizeof(QWORD);
-        status = RegGetValue(m_hKey, nullptr, valueName, RRF_RT_QWORD, nullptr, &data_, &dataSize_);
+        status = m_hive->GetValue(m_hKey, nullptr, valueName, RRF_RT_QWORD, nullptr, &data_, &dataSize_);
+        OnValueRead(valueName, status, start);
         if(status != ERROR_SUCCESS)
             return status;
 
@@ -277,8 +488,274 @@ namespace Registry
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
-    LSTATUS Key::EnumValues( _In_ const std::function <bool (_In_ Value &)>& callBack)
+    LSTATUS Key::GetValues( _Inout_updates_(count) ValueQuery*   values,
+                            _In_                   DWORD         count,
+                            _Outptr_               BYTE**        buffer,
+                            _In_opt_               Allocator*    allocator ) const
+    {
+        Epoch::Reader handle(m_handleEpoch);
+
+        LONGLONG start = Metrics::Now();
+
+        if(values == nullptr || buffer == nullptr || count == 0)
+            return ERROR_INVALID_PARAMETER;
+
+        *buffer = nullptr;
+
+        for(DWORD i = 0; i < count; i++)
+        {
+            values[i].status    = ERROR_FILE_NOT_FOUND;
+            values[i].type      = DataType::None;
+            values[i].data      = nullptr;
+            values[i].dataSize  = 0;
+        }
+
+        VALENT* entries = AllocateArray<VALENT>(allocator, count);
+        for(DWORD i = 0; i < count; i++)
+            entries[i].ve_valuename = (TCHAR*)values[i].name;
+
+        // Most batches are a few small values, read in one call on the first try; larger ones take a
+        // second call, with the size returned by the first one.
+        BYTE*   data     = nullptr;
+        DWORD   dataSize = 64 + 16 * count;
+        LSTATUS status   = ERROR_MORE_DATA;
+
+        for(int attempt = 0; attempt < 3 && status == ERROR_MORE_DATA; attempt++)
+        {
+            FreeArray(allocator, data);
+            data = AllocateArray<BYTE>(allocator, dataSize);
+
+            status = m_hive->QueryMultipleValues(m_hKey, entries, count, (TCHAR*)data, &dataSize);
+            Metrics::Increment(Counter::ValueBatches);
+        }
+
+        if(status == ERROR_SUCCESS)
+        {
+            for(DWORD i = 0; i < count; i++)
+            {
+                values[i].status    = ERROR_SUCCESS;
+                values[i].type      = (DataType)entries[i].ve_type;
+                values[i].data      = (const BYTE*)entries[i].ve_valueptr;
+                values[i].dataSize  = entries[i].ve_valuelen;
+            }
+        }
+        else
+        {
+            // A value is missing, or the key does not support the call: size every value, then read
+            // them all in one buffer.
+            Metrics::Increment(Counter::ValueBatchFallbacks);
+
+            DWORD totalSize = 0;
+            for(DWORD i = 0; i < count; i++)
+            {
+                DWORD type;
+                values[i].status = m_hive->QueryValueEx(m_hKey, values[i].name, nullptr, &type, nullptr, &values[i].dataSize);
+                if(values[i].status == ERROR_SUCCESS)
+                    totalSize += values[i].dataSize;
+            }
+
+            FreeArray(allocator, data);
+            data = AllocateArray<BYTE>(allocator, (totalSize != 0) ? totalSize : 1);
+
+            status = ERROR_SUCCESS;
+            DWORD offset = 0;
+            for(DWORD i = 0; i < count; i++)
+            {
+                if(values[i].status == ERROR_SUCCESS)
+                {
+                    DWORD type;
+                    DWORD size = values[i].dataSize;
+                    values[i].status = m_hive->QueryValueEx(m_hKey, values[i].name, nullptr, &type, data + offset, &size);
+
+                    // Grown since it was sized.
+                    if(values[i].status == ERROR_SUCCESS && size > values[i].dataSize)
+                        values[i].status = ERROR_MORE_DATA;
+
+                    if(values[i].status == ERROR_SUCCESS)
+                    {
+                        values[i].type      = (DataType)type;
+                        values[i].data      = data + offset;
+                        values[i].dataSize  = size;
+                    }
+
+                    offset += values[i].dataSize;
+                }
+
+                if(values[i].status != ERROR_SUCCESS)
+                {
+                    values[i].data      = nullptr;
+                    values[i].dataSize  = 0;
+
+                    if(status == ERROR_SUCCESS)
+                        status = values[i].status;
+                }
+            }
+        }
+
+        FreeArray(allocator, entries);
+
+        *buffer = data;
+
+        DWORD read = 0;
+        for(DWORD i = 0; i < count; i++)
+        {
+            if(values[i].status == ERROR_SUCCESS)
+                read++;
+        }
+
+        Trace::Record(TraceOp::GetValues, m_pathId, nullptr, status);
+        Metrics::Increment(Counter::ValuesRead, read);
+        if(read != count)
+            Metrics::Increment(Counter::ValueErrors, count - read);
+        Metrics::RecordLatency(Histogram::GetValue, start);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ValueQuery::Read( _Out_ DWORD& value ) const
+    {
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        if(type != DataType::DWord || dataSize != sizeof(DWORD))
+            return ERROR_UNSUPPORTED_TYPE;
+
+        memcpy(&value, data, sizeof(DWORD));
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ValueQuery::Read( _Out_ QWORD& value ) const
+    {
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        if(type != DataType::QWord || dataSize != sizeof(QWORD))
+            return ERROR_UNSUPPORTED_TYPE;
+
+        memcpy(&value, data, sizeof(QWORD));
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ValueQuery::Read( _Out_ std::basic_string<TCHAR>& value ) const
+    {
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        if(type != DataType::String && type != DataType::Expand_String && type != DataType::Multi_String)
+            return ERROR_UNSUPPORTED_TYPE;
+
+        // The stored data is not always nul terminated.
+        value.assign((const TCHAR*)data, dataSize / sizeof(TCHAR));
+        while(!value.empty() && value.back() == 0)
+            value.pop_back();
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS ValueQuery::Read( _Out_ std::vector<BYTE>& value ) const
+    {
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        value.assign(data, data + dataSize);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// What the last scans of a key read, packed in buffers reused by the next scans.
+    struct Key::Cache
+    {
+        struct Entry
+        {
+            size_t      nameOffset;
+            size_t      dataOffset;
+            DWORD       dataSize;
+            DataType    type;
+        };
+
+        bool                valuesValid;
+        FILETIME            valuesWrite;        /// Last write time of the key when the values were read.
+        std::vector<TCHAR>  valueNames;         /// The names, one after the other, each nul terminated.
+        std::vector<BYTE>   valueData;
+        std::vector<Entry>  values;
+
+        bool                subKeysValid;
+        FILETIME            subKeysWrite;
+        std::vector<TCHAR>  subKeyNames;
+        std::vector<size_t> subKeys;            /// Offsets of the names in subKeyNames.
+
+        std::vector<TCHAR>  nameBuffer;         /// Sized by the largest value name seen so far.
+        std::vector<BYTE>   dataBuffer;
+        std::vector<TCHAR>  subKeyNameBuffer;
+
+        Cache()
+        {
+            valuesValid     = false;
+            subKeysValid    = false;
+        }
+    };
+
+    // The system time moves in ticks of up to 15.6 ms; a write in the tick of a scan could leave the
+    // last write time unchanged, so only scans of keys quiet for longer than this are kept.
+    static const ULONGLONG cacheSettleTime = 320000;    // 32 ms, in 100 ns units.
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool HasSettled( _In_ const FILETIME& lastWrite )
+    {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+
+        ULONGLONG nowTime   = ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+        ULONGLONG writeTime = ((ULONGLONG)lastWrite.dwHighDateTime << 32) | lastWrite.dwLowDateTime;
+
+        return nowTime > writeTime + cacheSettleTime;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Key::EnableCache( _In_ bool enable )
     {
+        if(enable && m_cache == nullptr)
+            m_cache = new Cache;
+
+        if(!enable && m_cache != nullptr)
+        {
+            delete m_cache;
+            m_cache = nullptr;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::QueryInfo( _Out_ KeyInfo* info ) const
+    {
+        Epoch::Reader handle(m_handleEpoch);
+
+        return m_hive->QueryInfoKey( m_hKey,
+                                     nullptr,
+                                     nullptr,
+                                     nullptr,
+                                     &info->subKeyCount,
+                                     &info->maxSubKeyNameLen,
+                                     nullptr,
+                                     &info->valueCount,
+                                     &info->maxValueNameLen,
+                                     &info->maxValueDataSize,
+                                     nullptr,
+                                     &info->lastWrite );
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::EnumValues( _In_ const std::function <bool (_In_ Value &)>& callBack,
+                             _In_opt_ Allocator* allocator )
+    {
+        // The epoch is entered around every registry call, not around the callbacks, which can close keys.
+
         LSTATUS status = ERROR_SUCCESS;
 
         Value   val;
@@ -289,25 +766,21 @@ namespace Registry
         BYTE    *data;
         DWORD   dataSize;
 
-        DWORD   numValues;
-        DWORD   maxValueNameLen;
-        DWORD   maxValueDataSize;
-        status = RegQueryInfoKey( m_hKey,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  &numValues,
-                                  &maxValueNameLen,
-                                  &maxValueDataSize,
-                                  nullptr,
-                                  nullptr );
-
-        maxValueNameLen += 2;
-        name = new TCHAR[maxValueNameLen];
-        data = new BYTE[maxValueDataSize];
+        KeyInfo info;
+        status = QueryInfo(&info);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        if(m_cache != nullptr)
+            return EnumCachedValues(info, callBack);
+
+        if(allocator == nullptr)
+            allocator = m_allocator;
+
+        DWORD maxValueNameLen  = info.maxValueNameLen + 2;
+        DWORD maxValueDataSize = info.maxValueDataSize;
+        name = AllocateArray<TCHAR>(allocator, maxValueNameLen);
+        data = AllocateArray<BYTE>(allocator, maxValueDataSize);
 
         do
         {
@@ -316,14 +789,18 @@ namespace Registry
             nameLen     = maxValueNameLen;
             dataSize    = maxValueDataSize;
 
-            status = RegEnumValue( m_hKey,
-                                   index,
-                                   name,
-                                   &nameLen,
-                                   nullptr,
-                                   &type,
-                                   nullptr,
-                                   &dataSize );
+            {
+                Epoch::Reader handle(m_handleEpoch);
+
+                status = m_hive->EnumValue( m_hKey,
+                                            index,
+                                            name,
+                                            &nameLen,
+                                            nullptr,
+                                            &type,
+                                            data,
+                                            &dataSize );
+            }
 
             if(status == ERROR_SUCCESS)
             {
@@ -340,15 +817,118 @@ namespace Registry
             index++;
         } while (status == ERROR_SUCCESS);
 
-        delete [] name;
-        delete [] data;
-        
-        return (status == ERROR_NO_MORE_ITEMS) ? ERROR_SUCCESS : status;
+        FreeArray(allocator, name);
+        FreeArray(allocator, data);
+
+        status = (status == ERROR_NO_MORE_ITEMS) ? ERROR_SUCCESS : status;
+        Trace::Record(TraceOp::EnumValues, m_pathId, nullptr, status);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::EnumCachedValues( _In_ const KeyInfo& info, _In_ const std::function <bool (_In_ Value &)>& callBack )
+    {
+        Cache&  cache = *m_cache;
+        Value   val;
+
+        val.m_hKey = this;
+
+        if(cache.valuesValid && CompareFileTime(&info.lastWrite, &cache.valuesWrite) == 0)
+        {
+            Metrics::Increment(Counter::CachedScans);
+
+            for(auto& entry : cache.values)
+            {
+                val.m_Name         = &cache.valueNames[entry.nameOffset];
+                val.m_Type         = entry.type;
+                val.m_Data         = cache.valueData.empty() ? nullptr : &cache.valueData[entry.dataOffset];
+                val.m_DataSize     = entry.dataSize;
+
+                if( !callBack(val) )
+                    break;
+            }
+
+            Trace::Record(TraceOp::EnumValues, m_pathId, nullptr, ERROR_SUCCESS);
+            return ERROR_SUCCESS;
+        }
+
+        // The buffers only grow, so after a few scans a changed key is read without allocations.
+        if(cache.nameBuffer.size() < info.maxValueNameLen + 2)
+            cache.nameBuffer.resize(info.maxValueNameLen + 2);
+        if(cache.dataBuffer.size() < info.maxValueDataSize + 1)
+            cache.dataBuffer.resize(info.maxValueDataSize + 1);
+
+        cache.valuesValid = false;
+        cache.valueNames.clear();
+        cache.valueData.clear();
+        cache.values.clear();
+
+        LSTATUS status   = ERROR_SUCCESS;
+        bool    complete = true;
+
+        for(DWORD index = 0; status == ERROR_SUCCESS; index++)
+        {
+            DWORD nameLen  = (DWORD)cache.nameBuffer.size();
+            DWORD dataSize = (DWORD)cache.dataBuffer.size();
+            DWORD type;
+
+            {
+                Epoch::Reader handle(m_handleEpoch);
+
+                status = m_hive->EnumValue( m_hKey,
+                                            index,
+                                            &cache.nameBuffer[0],
+                                            &nameLen,
+                                            nullptr,
+                                            &type,
+                                            &cache.dataBuffer[0],
+                                            &dataSize );
+            }
+            if(status != ERROR_SUCCESS)
+                break;
+
+            Cache::Entry entry;
+            entry.nameOffset   = cache.valueNames.size();
+            entry.dataOffset   = cache.valueData.size();
+            entry.dataSize     = dataSize;
+            entry.type         = (DataType)type;
+
+            cache.valueNames.insert(cache.valueNames.end(), &cache.nameBuffer[0], &cache.nameBuffer[0] + nameLen + 1);
+            cache.valueData.insert(cache.valueData.end(), &cache.dataBuffer[0], &cache.dataBuffer[0] + dataSize);
+            cache.values.push_back(entry);
+
+            val.m_Name         = &cache.nameBuffer[0];
+            val.m_Type         = entry.type;
+            val.m_Data         = &cache.dataBuffer[0];
+            val.m_DataSize     = dataSize;
+
+            if( !callBack(val) )
+            {
+                complete = false;
+                status   = ERROR_NO_MORE_ITEMS;
+            }
+        }
+
+        status = (status == ERROR_NO_MORE_ITEMS) ? ERROR_SUCCESS : status;
+        Trace::Record(TraceOp::EnumValues, m_pathId, nullptr, status);
+
+        // A scan stopped by the callback is not whole; neither is one of a key still being written.
+        if(status == ERROR_SUCCESS && complete && HasSettled(info.lastWrite))
+        {
+            cache.valuesValid = true;
+            cache.valuesWrite = info.lastWrite;
+        }
+
+        return status;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
-    LSTATUS Key::EnumSubKeys( _In_ const std::function <bool (_In_ Key &)>& callBack) const
+    LSTATUS Key::EnumSubKeys( _In_ const std::function <bool (_In_ Key &)>& callBack,
+                              _In_opt_ Allocator* allocator ) const
     {
+        // The epoch is entered around every registry call, not around the callbacks, which can close keys.
+
         LSTATUS status = ERROR_SUCCESS;
 
         Key     key;
@@ -356,45 +936,47 @@ namespace Registry
         TCHAR   *name;
         DWORD   nameLen;
 
-        DWORD   numKeys;
-        DWORD   maxKeyNameLen;
-        status = RegQueryInfoKey( m_hKey,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  &numKeys,
-                                  &maxKeyNameLen,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr,
-                                  nullptr );
-
-        maxKeyNameLen += 2;
-        name = new TCHAR[maxKeyNameLen];
+        KeyInfo info;
+        status = QueryInfo(&info);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        if(m_cache != nullptr)
+            return EnumCachedSubKeys(info, callBack);
+
+        if(allocator == nullptr)
+            allocator = m_allocator;
+
+        DWORD maxKeyNameLen = info.maxSubKeyNameLen + 2;
+        name = AllocateArray<TCHAR>(allocator, maxKeyNameLen);
 
         do
         {
             memset(name, 0, sizeof(TCHAR) * maxKeyNameLen);
             nameLen     = maxKeyNameLen;
 
-            status = RegEnumKeyEx( m_hKey,
-                                   index,
-                                   name,
-                                   &nameLen,
-                                   nullptr,
-                                   nullptr,
-                                   nullptr,
-                                   nullptr );
+            {
+                Epoch::Reader handle(m_handleEpoch);
+
+                status = m_hive->EnumKeyEx( m_hKey,
+                                            index,
+                                            name,
+                                            &nameLen,
+                                            nullptr,
+                                            nullptr,
+                                            nullptr,
+                                            nullptr );
+            }
 
             if(status == ERROR_SUCCESS)
             {
                 key.m_hKey         = this->m_hKey;
+                key.m_hive         = this->m_hive;
                 key.m_mainKey      = this->m_mainKey;
                 key.m_subKeyPath   = name;
                 key.m_accessRights = this->m_accessRights;
                 key.m_hKeyCreated  = false;
+                key.m_pathId       = this->m_pathId;
 
                 if( !callBack(key) )
                     status = ERROR_NO_MORE_ITEMS;
@@ -403,90 +985,506 @@ namespace Registry
             index++;
         } while (status == ERROR_SUCCESS);
 
-        delete [] name;
-        
-        return (status == ERROR_NO_MORE_ITEMS) ? ERROR_SUCCESS : status;
+        FreeArray(allocator, name);
+
+        status = (status == ERROR_NO_MORE_ITEMS) ? ERROR_SUCCESS : status;
+        Trace::Record(TraceOp::EnumSubKeys, m_pathId, nullptr, status);
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::EnumCachedSubKeys( _In_ const KeyInfo& info, _In_ const std::function <bool (_In_ Key &)>& callBack ) const
+    {
+        Cache&  cache = *m_cache;
+        Key     key;
+
+        key.m_hKey         = this->m_hKey;
+        key.m_hive         = this->m_hive;
+        key.m_mainKey      = this->m_mainKey;
+        key.m_accessRights = this->m_accessRights;
+        key.m_hKeyCreated  = false;
+        key.m_pathId       = this->m_pathId;
+
+        if(cache.subKeysValid && CompareFileTime(&info.lastWrite, &cache.subKeysWrite) == 0)
+        {
+            Metrics::Increment(Counter::CachedScans);
+
+            for(size_t offset : cache.subKeys)
+            {
+                key.m_subKeyPath = &cache.subKeyNames[offset];
+
+                if( !callBack(key) )
+                    break;
+            }
+
+            Trace::Record(TraceOp::EnumSubKeys, m_pathId, nullptr, ERROR_SUCCESS);
+            return ERROR_SUCCESS;
+        }
+
+        if(cache.subKeyNameBuffer.size() < info.maxSubKeyNameLen + 2)
+            cache.subKeyNameBuffer.resize(info.maxSubKeyNameLen + 2);
+
+        cache.subKeysValid = false;
+        cache.subKeyNames.clear();
+        cache.subKeys.clear();
+
+        LSTATUS status   = ERROR_SUCCESS;
+        bool    complete = true;
+
+        for(DWORD index = 0; status == ERROR_SUCCESS; index++)
+        {
+            DWORD nameLen = (DWORD)cache.subKeyNameBuffer.size();
+
+            {
+                Epoch::Reader handle(m_handleEpoch);
+
+                status = m_hive->EnumKeyEx( m_hKey,
+                                            index,
+                                            &cache.subKeyNameBuffer[0],
+                                            &nameLen,
+                                            nullptr,
+                                            nullptr,
+                                            nullptr,
+                                            nullptr );
+            }
+            if(status != ERROR_SUCCESS)
+                break;
+
+            cache.subKeys.push_back(cache.subKeyNames.size());
+            cache.subKeyNames.insert(cache.subKeyNames.end(), &cache.subKeyNameBuffer[0], &cache.subKeyNameBuffer[0] + nameLen + 1);
+
+            key.m_subKeyPath = &cache.subKeyNameBuffer[0];
+
+            if( !callBack(key) )
+            {
+                complete = false;
+                status   = ERROR_NO_MORE_ITEMS;
+            }
+        }
+
+        status = (status == ERROR_NO_MORE_ITEMS) ? ERROR_SUCCESS : status;
+        Trace::Record(TraceOp::EnumSubKeys, m_pathId, nullptr, status);
+
+        if(status == ERROR_SUCCESS && complete && HasSettled(info.lastWrite))
+        {
+            cache.subKeysValid = true;
+            cache.subKeysWrite = info.lastWrite;
+        }
+
+        return status;
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     LSTATUS Key::AddNotify( _In_ const std::function <bool (_In_ Key &, _In_opt_ void*)>& callBack,
                             _In_opt_ NotifyEvents events,
                             _In_opt_ bool watchSubtree,
-                            _In_opt_ void *userData )
+                            _In_opt_ void *userData,
+                            _In_opt_ const NotifyOptions& options,
+                            _Out_opt_ NotifyId* notifyId )
     {
-        LSTATUS status = ERROR_SUCCESS;
+        if((events & NotifyEvents::All) == (NotifyEvents)0)
+            return ERROR_INVALID_PARAMETER;
+
+        Subscriber subscriber;
+        subscriber.callBack     = callBack;
+        subscriber.events       = events & NotifyEvents::All;
+        subscriber.watchSubtree = watchSubtree;
+        subscriber.userData     = userData;
 
-        if(m_worker != nullptr)
+        return Subscribe(subscriber, options, notifyId);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The values watched by a subscriber of AddValueNotify, with their type and data at the last
+    /// notification. Only the notify thread uses it once the subscriber is published.
+    struct Key::NotifyFilter
+    {
+        struct Snapshot
         {
-            m_workerShouldClose = true;
+            std::basic_string<TCHAR>    name;
+            DataType                    type;
+            std::vector<BYTE>           data;
+        };
+
+        NameMatcher                 matcher;
+        std::vector<const TCHAR*>   names;      /// The names of the matcher, for GetValues.
+        std::vector<Snapshot>       values;     /// Sorted by name.
+        bool                        unreadable; /// The last read failed.
+
+        /// Reads the matching values; returns true when they differ from the last read, or when they
+        /// can't be read.
+        bool Update( _In_ Key& key )
+        {
+            std::vector<Snapshot> current;
+            LSTATUS               status = ERROR_SUCCESS;
 
-            if(m_hKey != nullptr)
+            if(matcher.HasOnlyNames())
             {
-                RegCloseKey(m_hKey);
-                m_hKey = nullptr;
+                std::vector<ValueQuery> queries(names.size());
+                for(size_t i = 0; i < names.size(); i++)
+                    queries[i].name = names[i];
+
+                BYTE* buffer = nullptr;
+                if(!queries.empty())
+                    key.GetValues(&queries[0], (DWORD)queries.size(), &buffer);
+
+                // A missing value is a state like another; a deleted key is not.
+                for(auto& query : queries)
+                {
+                    if(query.status == ERROR_SUCCESS)
+                    {
+                        Snapshot value = { query.name, query.type, std::vector<BYTE>(query.data, query.data + query.dataSize) };
+                        current.push_back(std::move(value));
+                    }
+                    else if(query.status != ERROR_FILE_NOT_FOUND && status == ERROR_SUCCESS)
+                    {
+                        status = query.status;
+                    }
+                }
+
+                delete [] buffer;
+            }
+            else
+            {
+                status = key.EnumValues( [this, &current] (Value &value) -> bool
+                    {
+                        if(matcher.Matches(value.GetName()))
+                        {
+                            Snapshot snapshot = { value.GetName(), value.GetType(), std::vector<BYTE>(value.GetData(), value.GetData() + value.GetDataSize()) };
+                            current.push_back(std::move(snapshot));
+                        }
+                        return true;
+                    }
+                );
             }
 
-            if(m_worker != nullptr)
+            if(status != ERROR_SUCCESS)
             {
-                m_worker->join();
-                delete m_worker;
-                m_worker = nullptr;
+                unreadable = true;
+                return true;
             }
 
-            status = RegOpenKeyEx( m_predefinedKeys[(int)m_mainKey],
-                                   m_subKeyPath,
-                                   0,
-                                   (REGSAM)m_accessRights,
-                                   &m_hKey );
+            std::sort( current.begin(), current.end(), [] (const Snapshot& a, const Snapshot& b)
+                {
+                    return _tcsicmp(a.name.c_str(), b.name.c_str()) < 0;
+                }
+            );
 
-            if(status != ERROR_SUCCESS)
-                return status;
+            bool changed = unreadable || current.size() != values.size();
+            for(size_t i = 0; i < current.size() && !changed; i++)
+            {
+                changed = _tcsicmp(current[i].name.c_str(), values[i].name.c_str()) != 0 ||
+                          current[i].type != values[i].type ||
+                          current[i].data != values[i].data;
+            }
+
+            unreadable = false;
+            values.swap(current);
+
+            return changed;
         }
+    };
 
-        m_workerShouldClose = false;
-        m_worker = new std::thread(NotifyWorker, this, callBack, events, watchSubtree, userData);
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::AddValueNotify( _In_ const std::function <bool (_In_ Key &, _In_opt_ void*)>& callBack,
+                                 _In_reads_(patternCount) const TCHAR* const* patterns,
+                                 _In_ DWORD patternCount,
+                                 _In_opt_ void *userData,
+                                 _In_opt_ const NotifyOptions& options,
+                                 _Out_opt_ NotifyId* notifyId )
+    {
+        if(patterns == nullptr || patternCount == 0)
+            return ERROR_INVALID_PARAMETER;
 
-        return status;
+        std::shared_ptr<NotifyFilter> filter = std::make_shared<NotifyFilter>();
+        filter->unreadable = false;
+
+        for(DWORD i = 0; i < patternCount; i++)
+            filter->matcher.Add(patterns[i]);
+
+        for(auto& name : filter->matcher.GetNames())
+            filter->names.push_back(name.c_str());
+
+        // The values at the subscription, so the first call is for the first change after it.
+        filter->Update(*this);
+
+        Subscriber subscriber;
+        subscriber.callBack     = callBack;
+        subscriber.events       = NotifyEvents::Change_LastSet;
+        subscriber.watchSubtree = false;
+        subscriber.userData     = userData;
+        subscriber.filter       = filter;
+
+        return Subscribe(subscriber, options, notifyId);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::Subscribe( _Inout_ Subscriber& subscriber, _In_ const NotifyOptions& options, _Out_opt_ NotifyId* notifyId )
+    {
+        subscriber.id = (NotifyId)InterlockedIncrement(&m_nextNotifyId);
+
+        UpdateSubscribers( [&subscriber] (SubscriberList& subscribers)
+            {
+                subscribers.push_back(subscriber);
+            }
+        );
+
+        if(notifyId != nullptr)
+            *notifyId = subscriber.id;
+
+        // The first subscriber starts the notify thread; the next ones only wake it up.
+        if(m_subscribersChanged == nullptr)
+        {
+            HANDLE changed = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+            if(changed == nullptr)
+                return GetLastError();
+
+            if(InterlockedCompareExchangePointer(&m_subscribersChanged, changed, nullptr) == nullptr)
+            {
+                m_workerShouldClose = false;
+                m_worker = new std::thread(NotifyWorker, this, options);
+
+                return ERROR_SUCCESS;
+            }
+
+            CloseHandle(changed);
+        }
+
+        SetEvent(m_subscribersChanged);
+
+        return ERROR_SUCCESS;
     }
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Key::RemoveNotify( _In_ NotifyId notifyId )
+    {
+        bool removed = false;
+
+        UpdateSubscribers( [notifyId, &removed] (SubscriberList& subscribers)
+            {
+                removed = false;
+                for(auto subscriber = subscribers.begin(); subscriber != subscribers.end(); ++subscriber)
+                {
+                    if(subscriber->id == notifyId)
+                    {
+                        subscribers.erase(subscriber);
+                        removed = true;
+                        break;
+                    }
+                }
+            }
+        );
+
+        if(!removed)
+            return ERROR_NOT_FOUND;
+
+        if(m_subscribersChanged != nullptr)
+            SetEvent(m_subscribersChanged);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Key::UpdateSubscribers( _In_ const std::function <void (_Inout_ SubscriberList &)>& update )
+    {
+        std::shared_ptr<const SubscriberList> current = std::atomic_load(&m_subscribers);
+        std::shared_ptr<const SubscriberList> updated;
+
+        // Writers race only with each other; the loser copies the winner's list and tries again.
+        do
+        {
+            std::shared_ptr<SubscriberList> copy = (current != nullptr) ? std::make_shared<SubscriberList>(*current)
+                                                                        : std::make_shared<SubscriberList>();
+            update(*copy);
+            updated = copy;
+        } while(!std::atomic_compare_exchange_weak(&m_subscribers, &current, updated));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Waits for one of the events, polling them first for spinTicks so a change that follows soon
+    /// after the previous one does not pay for the thread wake-up. Returns the index of the event, or
+    /// WAIT_FAILED - WAIT_OBJECT_0 when the wait failed.
+    static DWORD WaitForChange( _In_reads_(count) const HANDLE* events, _In_ DWORD count, _In_ LONGLONG spinTicks, _In_ volatile bool* shouldClose )
+    {
+        if(spinTicks > 0)
+        {
+            LONGLONG end = Metrics::Now() + spinTicks;
+            do
+            {
+                DWORD index = WaitForMultipleObjects(count, events, FALSE, 0) - WAIT_OBJECT_0;
+                if(index < count)
+                    return index;
+
+                YieldProcessor();
+            } while(Metrics::Now() < end && !*shouldClose);
+        }
+
+        return WaitForMultipleObjects(count, events, FALSE, INFINITE) - WAIT_OBJECT_0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The registration used for a subscriber: its events, plus 16 when it watches the subtree.
+    static DWORD GetNotifySlot( _In_ NotifyEvents events, _In_ bool watchSubtree )
+    {
+        return (DWORD)events | (watchSubtree ? 16 : 0);
+    }
+
+    static const DWORD firstWaitRetryMs = 50;
+    static const DWORD maxWaitRetryMs   = 1000;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     void Key::NotifyWorker( _In_ Key *key,
-                            _In_ const std::function <bool (_In_ Key &, _In_opt_ void*)>& callBack,
-                            _In_opt_ NotifyEvents events,
-                            _In_opt_ bool watchSubtree,
-                            _In_opt_ void* userData )
+                            _In_ NotifyOptions options )
     {
-        LSTATUS status = ERROR_SUCCESS;
+        // One registration for every distinct events and subtree flag of the subscribers, each with
+        // its own event, so a subscriber is called only for the changes it asked for.
+        const DWORD slotCount = 32;
+
+        if(options.priority != THREAD_PRIORITY_NORMAL)
+            SetThreadPriority(GetCurrentThread(), options.priority);
+
+        if(options.affinity != 0)
+            SetThreadAffinityMask(GetCurrentThread(), options.affinity);
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        LONGLONG spinTicks  = (LONGLONG)options.spinMicros * frequency.QuadPart / 1000000;
+        bool     notified   = false;
+        DWORD    retryMs    = firstWaitRetryMs;
+
+        // The notifications are asynchronous, so the thread can poll for them. Closing the key signals
+        // the events, which still wakes the thread when the key is closed.
+        HANDLE  changed[slotCount]  = { nullptr };
+        bool    armed[slotCount]    = { false };
 
         while (!key->m_workerShouldClose)
         {
-            status = RegNotifyChangeKeyValue( key->m_hKey, 
-                                              watchSubtree, 
-                                              (DWORD)events, 
-                                              nullptr, 
-                                              FALSE );
+            // A snapshot of the subscribers; it doesn't change while the thread uses it.
+            std::shared_ptr<const SubscriberList> subscribers = std::atomic_load(&key->m_subscribers);
+
+            bool wanted[slotCount] = { false };
+            if(subscribers != nullptr)
+            {
+                for(auto& subscriber : *subscribers)
+                    wanted[GetNotifySlot(subscriber.events, subscriber.watchSubtree)] = true;
+            }
 
-            if(!key->m_workerShouldClose)
+            HANDLE  events[slotCount + 1]   = { key->m_subscribersChanged };
+            DWORD   slots[slotCount + 1]    = { slotCount };
+            DWORD   count                   = 1;
+
+            for(DWORD slot = 0; slot < slotCount; slot++)
             {
-                if(!callBack(*key, userData))
+                if(!wanted[slot])
+                    continue;
+
+                // A registration stays armed until it fires, so changing the subscribers never
+                // drops a notification.
+                if(!armed[slot])
                 {
-                    if(key->m_hKey != nullptr)
+                    if(changed[slot] == nullptr)
+                        changed[slot] = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+                    if(changed[slot] == nullptr)
+                        continue;
+
+                    LSTATUS status;
                     {
-                        RegCloseKey(key->m_hKey);
-                        key->m_hKey = nullptr;
+                        Epoch::Reader handle(m_handleEpoch);
+
+                        status = key->m_hive->NotifyChangeKeyValue( key->m_hKey,
+                                                                    (slot & 16) != 0,
+                                                                    slot & 15,
+                                                                    changed[slot],
+                                                                    TRUE );
                     }
+                    if(status != ERROR_SUCCESS)
+                    {
+                        Trace::Record(TraceOp::Notify, key->m_pathId, nullptr, status);
+                        continue;
+                    }
+
+                    armed[slot] = true;
+                }
+
+                events[count]   = changed[slot];
+                slots[count]    = slot;
+                count++;
+            }
+
+            // One spin per notification: when it times out, or something else wakes the thread, the
+            // next waits block at once until a change comes.
+            DWORD index = WaitForChange(events, count, notified ? spinTicks : 0, &key->m_workerShouldClose);
+            notified    = false;
+
+            // Only a bad handle fails a wait, and it would fail again at once: the events are made and
+            // registered again after a while, which Close cuts short.
+            if(index == WAIT_FAILED - WAIT_OBJECT_0)
+            {
+                Trace::Record(TraceOp::Notify, key->m_pathId, nullptr, (LSTATUS)GetLastError());
+
+                for(DWORD slot = 0; slot < slotCount; slot++)
+                {
+                    if(changed[slot] != nullptr)
+                        CloseHandle(changed[slot]);
+
+                    changed[slot]   = nullptr;
+                    armed[slot]     = false;
+                }
+
+                if(WaitForSingleObject(key->m_subscribersChanged, retryMs) == WAIT_FAILED)
+                    Sleep(retryMs);
 
-                    status = RegOpenKeyEx( m_predefinedKeys[(int)key->m_mainKey],
-                                           key->m_subKeyPath,
-                                           0,
-                                           (REGSAM)key->m_accessRights,
-                                           &key->m_hKey );
+                retryMs = (retryMs < maxWaitRetryMs / 2) ? retryMs * 2 : maxWaitRetryMs;
+                continue;
+            }
+
+            retryMs = firstWaitRetryMs;
+
+            // Woken up to watch for new subscribers.
+            if(index >= count || slots[index] == slotCount)
+                continue;
+
+            DWORD slot  = slots[index];
+            armed[slot] = false;
+            notified    = true;
 
-                    key->m_workerShouldClose = true;
+            Trace::Record(TraceOp::Notify, key->m_pathId, nullptr, ERROR_SUCCESS);
+            Metrics::Increment(Counter::NotificationsReceived);
+
+            if(key->m_workerShouldClose)
+                break;
+
+            for(auto& subscriber : *subscribers)
+            {
+                if(GetNotifySlot(subscriber.events, subscriber.watchSubtree) != slot)
+                    continue;
 
-                    return;
+                // The changes to the other values never reach the callback.
+                if(subscriber.filter != nullptr && !subscriber.filter->Update(*key))
+                {
+                    Metrics::Increment(Counter::NotificationsFiltered);
+                    continue;
                 }
+
+                LONGLONG start        = Metrics::Now();
+                bool     keepWatching = subscriber.callBack(*key, subscriber.userData);
+
+                Trace::Record(TraceOp::NotifyCallback, key->m_pathId, nullptr, keepWatching ? 1 : 0);
+                Metrics::Increment(Counter::CallbacksRun);
+                Metrics::RecordLatency(Histogram::NotifyCallback, start);
+
+                if(!keepWatching)
+                    key->RemoveNotify(subscriber.id);
             }
         }
+
+        for(DWORD slot = 0; slot < slotCount; slot++)
+        {
+            if(changed[slot] != nullptr)
+                CloseHandle(changed[slot]);
+        }
     }
 }
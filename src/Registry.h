@@ -22,7 +22,17 @@
 #include <windows.h>
 #include <tchar.h>
 #include <functional>
+#include <memory>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
+
+#include "./Trace.h"
+#include "./Metrics.h"
+#include "./Allocator.h"
+#include "./Epoch.h"
+#include "./Hive.h"
 
 namespace Registry
 {
@@ -97,6 +107,28 @@ namespace Registry
         return static_cast<NotifyEvents>(~static_cast<int>(a));
     }
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// How the thread waiting for the change notifications of a key runs.
+    struct NotifyOptions
+    {
+        int         priority;       /// Thread priority, one of the THREAD_PRIORITY_* values.
+        DWORD_PTR   affinity;       /// Mask of the CPUs the thread can run on; 0 keeps the process affinity.
+        DWORD       spinMicros;     /// After a notification, polls this long for the next one before blocking.
+                                    /// Every poll is a WaitForMultipleObjects call with a zero timeout, so the
+                                    /// thread keeps a CPU busy in system calls while it spins.
+
+        NotifyOptions()
+        {
+            priority    = THREAD_PRIORITY_NORMAL;
+            affinity    = 0;
+            spinMicros  = 0;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Identifies a subscription made with Key::AddNotify, to remove it with Key::RemoveNotify.
+    typedef DWORD NotifyId;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     /// The type of the data that can be hold by the registry values
     enum class DataType
@@ -152,28 +184,98 @@ namespace Registry
         DWORD       m_DataSize;
     };
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The metadata of a key, as returned by RegQueryInfoKey. The lengths are in characters, without
+    /// the terminating nul.
+    struct KeyInfo
+    {
+        DWORD       subKeyCount;
+        DWORD       maxSubKeyNameLen;
+        DWORD       valueCount;
+        DWORD       maxValueNameLen;
+        DWORD       maxValueDataSize;
+        FILETIME    lastWrite;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// One value of a Key::GetValues call. The name is given; the rest is filled by the call.
+    struct ValueQuery
+    {
+        const TCHAR*    name;
+        LSTATUS         status;     /// ERROR_FILE_NOT_FOUND for a missing value.
+        DataType        type;
+        const BYTE*     data;       /// Points in the buffer returned by GetValues; null on error.
+        DWORD           dataSize;
+
+        /// Typed reads; ERROR_UNSUPPORTED_TYPE when the value has another type.
+        LSTATUS Read( _Out_ DWORD&                        value ) const;
+        LSTATUS Read( _Out_ QWORD&                        value ) const;
+        LSTATUS Read( _Out_ std::basic_string<TCHAR>&     value ) const;
+        LSTATUS Read( _Out_ std::vector<BYTE>&            value ) const;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Reads the first count values of a tuple from queries; stops at the first error.
+    template <size_t count, typename Tuple>
+    struct ValueTupleReader
+    {
+        static LSTATUS Read( _In_reads_(count) const ValueQuery* queries, _Inout_ Tuple& values )
+        {
+            LSTATUS status = ValueTupleReader<count - 1, Tuple>::Read(queries, values);
+            if(status != ERROR_SUCCESS)
+                return status;
+
+            return queries[count - 1].Read(std::get<count - 1>(values));
+        }
+    };
+
+    template <typename Tuple>
+    struct ValueTupleReader<0, Tuple>
+    {
+        static LSTATUS Read( _In_ const ValueQuery*, _Inout_ Tuple& )
+        {
+            return ERROR_SUCCESS;
+        }
+    };
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////
     /// Represents a registry subkey that can be manipulated.
     class Key
     {
     public:
 
+        /// The allocator, when given, holds the key object and its path until Close, and is used by
+        /// EnumValues and EnumSubKeys for their buffers; without one they come from new[].
+        /// The key is in the given hive, which must outlive it, or else in the Windows registry.
         static Key* Open( _In_          PredefinedKey     mainKey,
                           _In_z_        const TCHAR*      subKeyPath,
                           _In_opt_      AccessRights      accessRights  = AccessRights::All_Access,
-                          _Out_opt_     LSTATUS*          statusCode     = nullptr );
+                          _Out_opt_     LSTATUS*          statusCode     = nullptr,
+                          _In_opt_      Allocator*        allocator      = nullptr,
+                          _In_opt_      Hive*             hive           = nullptr );
                              
         static Key* Create( _In_        PredefinedKey     mainKey,
                             _In_z_      const TCHAR*      subKeyPath,
                             _In_opt_    AccessRights      accessRights  = AccessRights::All_Access,
-                            _Out_opt_   LSTATUS*          statusCode     = nullptr );
+                            _Out_opt_   LSTATUS*          statusCode     = nullptr,
+                            _In_opt_    Allocator*        allocator      = nullptr,
+                            _In_opt_    Hive*             hive           = nullptr );
 
         static bool Exists( _In_        PredefinedKey     mainKey,
-                            _In_z_      const TCHAR*      subKeyPath );
+                            _In_z_      const TCHAR*      subKeyPath,
+                            _In_opt_    Hive*             hive           = nullptr );
 
         static LSTATUS Delete( _In_     PredefinedKey     mainKey,
                                _In_z_   const TCHAR*      subKeyPath,
-                               _In_opt_ AccessRights      accessRights  = AccessRights::None );
+                               _In_opt_ AccessRights      accessRights  = AccessRights::None,
+                               _In_opt_ Hive*             hive           = nullptr );
+
+        /// Opens a subkey relative to this key, without parsing the path again from the main key.
+        /// Without an allocator, the subkey uses the one of this key. It is in the hive of this key.
+        Key* OpenSubKey( _In_z_      const TCHAR*      subKeyName,
+                         _In_opt_    AccessRights      accessRights  = AccessRights::Read,
+                         _Out_opt_   LSTATUS*          statusCode     = nullptr,
+                         _In_opt_    Allocator*        allocator      = nullptr ) const;
 
         const TCHAR* GetSubKeyPath() const
         {
@@ -190,50 +292,104 @@ namespace Registry
             return m_accessRights;
         }
 
+        /// The handle can be closed by Reopen; hold an Epoch::Reader on GetHandleEpoch() while using it
+        /// if another thread may reopen the key. It is valid only for the calls of GetHive().
         HKEY GetHKEY() const
         {
             return m_hKey;
         }
 
+        Hive* GetHive() const
+        {
+            return m_hive;
+        }
+
+        static Epoch& GetHandleEpoch()
+        {
+            return m_handleEpoch;
+        }
+
+        /// Opens the key again, for example after it was deleted and created again, and publishes the
+        /// new handle. Threads using the key meanwhile keep the old handle, which is closed once they
+        /// are done with it; this waits for them, so it must not be called from an enumeration callback.
+        LSTATUS Reopen();
+
         bool KeyWasCreated() const
         {
             return m_hKeyCreated;
         }
 
+        Allocator* GetAllocator() const
+        {
+            return m_allocator;
+        }
+
         LSTATUS EnumSubKeys() const;
 
         LSTATUS Flush() const
         {
-            return RegFlushKey(m_hKey);
+            Epoch::Reader handle(m_handleEpoch);
+
+            LSTATUS status = m_hive->FlushKey(m_hKey);
+            Trace::Record(TraceOp::Flush, m_pathId, nullptr, status);
+            return status;
         }
 
-        LSTATUS GetValue(const TCHAR *valueName, void **data, DWORD *dataSize, DataType *dataType ) const;
+        /// The data is allocated with the given allocator, or else with new[] and freed with delete[].
+        LSTATUS GetValue(const TCHAR *valueName, void **data, DWORD *dataSize, DataType *dataType, Allocator *allocator = nullptr ) const;
 
-        LSTATUS GetValueString(const TCHAR *valueName, TCHAR **value ) const;
+        LSTATUS GetValueString(const TCHAR *valueName, TCHAR **value, Allocator *allocator = nullptr ) const;
 
         LSTATUS GetValueDWORD(const TCHAR *valueName, DWORD *value ) const;
 
         LSTATUS GetValueQWORD(const TCHAR *valueName, QWORD *value ) const;
 
-        LSTATUS SetValue(const TCHAR *valueName, const void *data, DWORD dataSize, DataType dataType ) const
+        /// Reads several values with one RegQueryMultipleValues call into one packed buffer, allocated
+        /// as the data of GetValue. When the call is not possible, as when a value is missing, the
+        /// values are read one by one into the same kind of buffer, and every query gets its own
+        /// status. Returns ERROR_SUCCESS when every value was read, else the first error.
+        LSTATUS GetValues( _Inout_updates_(count) ValueQuery*   values,
+                           _In_                   DWORD         count,
+                           _Outptr_               BYTE**        buffer,
+                           _In_opt_               Allocator*    allocator = nullptr ) const;
+
+        /// Typed variant, filling a tuple of references in one call:
+        ///     key->GetValues(names, std::tie(pattern0, pattern1));
+        /// The supported types are DWORD, QWORD, std::basic_string<TCHAR> and std::vector<BYTE>.
+        template <typename... T>
+        LSTATUS GetValues( _In_reads_(sizeof...(T)) const TCHAR* const*   names,
+                           _Inout_                  std::tuple<T&...>     values ) const
         {
-            return RegSetValueEx( m_hKey, valueName, 0, (DWORD)dataType, (const BYTE*)data, dataSize);
+            ValueQuery queries[sizeof...(T)];
+            for(size_t i = 0; i < sizeof...(T); i++)
+                queries[i].name = names[i];
+
+            BYTE*   buffer = nullptr;
+            LSTATUS status = GetValues(queries, sizeof...(T), &buffer);
+            if(status == ERROR_SUCCESS)
+                status = ValueTupleReader<sizeof...(T), std::tuple<T&...>>::Read(queries, values);
+
+            delete [] buffer;
+
+            return status;
         }
 
+        LSTATUS SetValue(const TCHAR *valueName, const void *data, DWORD dataSize, DataType dataType ) const;
+
         LSTATUS SetValueString(const TCHAR *valueName, const TCHAR *value ) const
         {
             DWORD strLen = (value != nullptr) ? (DWORD)_tcslen(value) : 0;
-            return RegSetValueEx( m_hKey, valueName, 0, REG_SZ, (const BYTE*)value, strLen);
+            return SetValue( valueName, value, strLen, DataType::String);
         }
 
         LSTATUS SetValueDWORD(const TCHAR *valueName, DWORD value ) const
         {
-            return RegSetValueEx( m_hKey, valueName, 0, REG_DWORD, (const BYTE*)&value, sizeof(DWORD));
+            return SetValue( valueName, &value, sizeof(DWORD), DataType::DWord);
         }
 
         LSTATUS SetValueQWORD(const TCHAR *valueName, QWORD value ) const
         {
-            return RegSetValueEx( m_hKey, valueName, 0, REG_QWORD, (const BYTE*)&value, sizeof(QWORD));
+            return SetValue( valueName, &value, sizeof(QWORD), DataType::QWord);
         }
 
         LSTATUS DeleteSubkey( _In_z_   const TCHAR* subKeyPath,
@@ -241,28 +397,98 @@ namespace Registry
 
         LSTATUS DeleteValue( _In_opt_z_ const TCHAR* valueName ) const;
 
-        LSTATUS EnumSubKeys( _In_ const std::function <bool (_In_ Key &)>& callBack ) const;
+        /// Without an allocator, the buffers come from the allocator of the key.
+        LSTATUS EnumSubKeys( _In_ const std::function <bool (_In_ Key &)>& callBack,
+                             _In_opt_ Allocator* allocator = nullptr ) const;
+
+        LSTATUS EnumValues( _In_ const std::function <bool (_In_ Value &)>& callBack,
+                            _In_opt_ Allocator* allocator = nullptr );
 
-        LSTATUS EnumValues( _In_ const std::function <bool (_In_ Value &)>& callBack );
+        LSTATUS QueryInfo( _Out_ KeyInfo* info ) const;
 
+        /// With the cache on, EnumValues and EnumSubKeys keep what they read, in buffers reused from
+        /// one scan to the next, and answer from it while the last write time of the key has not
+        /// moved: one RegQueryInfoKey call instead of a walk. Scans of a key written in the last two
+        /// clock ticks are not kept, as a write in the same tick would not move the time.
+        /// The cache is not thread safe; use it on keys scanned by one thread.
+        void EnableCache( _In_ bool enable );
+
+        bool IsCacheEnabled() const
+        {
+            return m_cache != nullptr;
+        }
+
+        /// Subscribes a callback to the changes of the key. A key can have many subscribers, each with
+        /// its own events, subtree flag and userData; they share one notify thread, started by the
+        /// first subscription with its options (the options of later subscriptions are ignored).
+        /// The callback returns false to unsubscribe. Subscribing and unsubscribing never stop the
+        /// notifications of the other subscribers.
         LSTATUS AddNotify( _In_ const std::function <bool (_In_ Key &, _In_opt_ void*)>& callBack,
                            _In_opt_ NotifyEvents events = NotifyEvents::All,
                            _In_opt_ bool watchSubtree = true,
-                           _In_opt_ void *userData = nullptr );
-
+                           _In_opt_ void *userData = nullptr,
+                           _In_opt_ const NotifyOptions& options = NotifyOptions(),
+                           _Out_opt_ NotifyId* notifyId = nullptr );
+
+        /// Subscribes a callback to the values of the key, not of its subkeys, whose names match one of
+        /// the patterns: a name, a prefix ending with '*', or a glob with '*' and '?' (see NameMatcher).
+        /// The matching values are compared on every notification with what they were at the last one,
+        /// so the callback runs only when one of them was added, changed or deleted; the other
+        /// notifications are counted as filtered and dropped. When they can't be read, as when the key
+        /// was deleted, the callback is called. With only names, the values are read with one GetValues
+        /// call; with patterns, the key is enumerated on the notify thread, so its cache must stay off.
+        LSTATUS AddValueNotify( _In_ const std::function <bool (_In_ Key &, _In_opt_ void*)>& callBack,
+                                _In_reads_(patternCount) const TCHAR* const* patterns,
+                                _In_ DWORD patternCount,
+                                _In_opt_ void *userData = nullptr,
+                                _In_opt_ const NotifyOptions& options = NotifyOptions(),
+                                _Out_opt_ NotifyId* notifyId = nullptr );
+
+        /// Removes a subscription. A callback already running on the notify thread finishes, and
+        /// can be called once more if a notification was being dispatched.
+        LSTATUS RemoveNotify( _In_ NotifyId notifyId );
+
+        /// Must not be called from a notify callback of the key, nor from inside an Epoch::Reader.
         void Close()
         {
+            // The notifications are asynchronous, so the notify thread is woken by its event, and is
+            // joined while the handle is still valid.
             m_workerShouldClose = true;
 
-            if(m_hKey != nullptr)
-                RegCloseKey(m_hKey);
-
             if(m_worker != nullptr)
+            {
+                SetEvent(m_subscribersChanged);
                 m_worker->join();
+                delete m_worker;
+            }
+
+            // As in Reopen: the handle is closed only once no other thread can be using it.
+            HKEY hKey = (HKEY)InterlockedExchangePointer((PVOID volatile*)&m_hKey, nullptr);
+            m_handleEpoch.Synchronize();
+
+            if(hKey != nullptr)
+                m_hive->CloseKey(hKey);
+
+            Trace::Record(TraceOp::Close, m_pathId, nullptr, ERROR_SUCCESS);
+            Metrics::Increment(Counter::KeysClosed);
 
-            delete [] m_subKeyPath;
+            if(m_subscribersChanged != nullptr)
+                CloseHandle(m_subscribersChanged);
 
-            delete this;
+            EnableCache(false);
+
+            if(m_allocator == nullptr)
+            {
+                delete [] m_subKeyPath;
+                delete this;
+                return;
+            }
+
+            Allocator* allocator = m_allocator;
+            allocator->Deallocate((void*)m_subKeyPath);
+
+            this->~Key();
+            allocator->Deallocate(this);
         }
 
     private:
@@ -273,49 +499,110 @@ namespace Registry
             m_accessRights      = AccessRights::None;
             m_hKey              = nullptr;
             m_hKeyCreated       = false;
-
-            m_workerShouldClose = false;
-            m_worker            = nullptr;
+            m_pathId            = 0;
+            m_allocator         = nullptr;
+            m_hive              = &Hive::GetWindows();
+            m_cache             = nullptr;
+
+            m_workerShouldClose  = false;
+            m_worker             = nullptr;
+            m_subscribersChanged = nullptr;
+            m_nextNotifyId       = 0;
         };
 
         Key( _In_       PredefinedKey      mainKey,
              _In_z_     const TCHAR*       subKeyPath,
              _In_       bool               hKeyCreated,
              _In_       AccessRights       accessRights,
-             _In_       HKEY               hKey )
+             _In_       HKEY               hKey,
+             _In_       DWORD              pathId,
+             _In_opt_   Allocator*         allocator,
+             _In_       Hive*              hive )
         {
             m_mainKey           = mainKey;
             m_subKeyPath        = subKeyPath;
             m_accessRights      = accessRights;
             m_hKey              = hKey;
             m_hKeyCreated       = hKeyCreated;
-
-            m_workerShouldClose = false;
-            m_worker            = nullptr;
+            m_pathId            = pathId;
+            m_allocator         = allocator;
+            m_hive              = hive;
+            m_cache             = nullptr;
+
+            m_workerShouldClose  = false;
+            m_worker             = nullptr;
+            m_subscribersChanged = nullptr;
+            m_nextNotifyId       = 0;
         }
 
+        void OnValueRead( _In_opt_ const TCHAR* valueName, _In_ LSTATUS status, _In_ LONGLONG start ) const;
+
         static Key* OpenKey(_In_        PredefinedKey     mainKey,
                             _In_z_      const TCHAR*      subKeyPath,
                             _In_        bool              createKey,
                             _In_        AccessRights      accessRights,
-                            _Out_       LSTATUS*          statusCode );
+                            _Out_       LSTATUS*          statusCode,
+                            _In_opt_    Allocator*        allocator,
+                            _In_        Hive*             hive );
+
+        /// Creates the key object in the allocator, or on the heap without one.
+        static Key* NewKey( _In_        PredefinedKey     mainKey,
+                            _In_z_      const TCHAR*      subKeyPath,
+                            _In_        bool              hKeyCreated,
+                            _In_        AccessRights      accessRights,
+                            _In_        HKEY              hKey,
+                            _In_        DWORD             pathId,
+                            _In_opt_    Allocator*        allocator,
+                            _In_        Hive*             hive );
 
         PredefinedKey       m_mainKey;
         const TCHAR*        m_subKeyPath;
         AccessRights        m_accessRights;
-        HKEY                m_hKey;
+        HKEY volatile       m_hKey;         /// Replaced by Reopen; read it inside an Epoch::Reader.
         bool                m_hKeyCreated;
+        DWORD               m_pathId;       /// Id of the key path in the trace.
+        Allocator*          m_allocator;    /// Holds this object and its path; null for the heap.
+        Hive*               m_hive;         /// Makes every call on the handle.
+
+        struct Cache;
+        Cache*              m_cache;        /// Null while the cache is off.
+
+        LSTATUS EnumCachedValues( _In_ const KeyInfo& info, _In_ const std::function <bool (_In_ Value &)>& callBack );
+        LSTATUS EnumCachedSubKeys( _In_ const KeyInfo& info, _In_ const std::function <bool (_In_ Key &)>& callBack ) const;
+
+        struct NotifyFilter;
+
+        struct Subscriber
+        {
+            NotifyId                                            id;
+            std::function <bool (_In_ Key &, _In_opt_ void*)>   callBack;
+            NotifyEvents                                        events;
+            bool                                                watchSubtree;
+            void*                                               userData;
+            std::shared_ptr<NotifyFilter>                       filter;     /// Null to be called for every change.
+        };
+
+        typedef std::vector<Subscriber> SubscriberList;
+
+        /// Publishes a subscriber and starts or wakes up the notify thread.
+        LSTATUS Subscribe( _Inout_ Subscriber& subscriber, _In_ const NotifyOptions& options, _Out_opt_ NotifyId* notifyId );
+
+        /// Replaces the subscriber list with an updated copy. The published lists are never changed,
+        /// so the notify thread reads them without locks.
+        void UpdateSubscribers( _In_ const std::function <void (_Inout_ SubscriberList &)>& update );
 
         volatile bool       m_workerShouldClose;
         std::thread*        m_worker;
+        HANDLE              m_subscribersChanged;   /// Wakes the notify thread to watch for the new subscribers.
+        volatile LONG       m_nextNotifyId;
+
+        std::shared_ptr<const SubscriberList> m_subscribers;   /// Read and replaced with std::atomic_load/store.
 
         static void NotifyWorker( _In_ Key *key,
-                                  _In_ const std::function <bool (_In_ Key &, _In_opt_ void*)>& callBack,
-                                  _In_opt_ NotifyEvents events = NotifyEvents::All,
-                                  _In_opt_ bool watchSubtree = true,
-                                  _In_opt_ void* userData = nullptr );
+                                  _In_ NotifyOptions options );
 
         static const HKEY   m_predefinedKeys[];
+        static Epoch        m_handleEpoch;  /// One epoch for the handles of all the keys; they are rarely reopened.
     };
 }
 
@@ -0,0 +1,466 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Scheduler.cpp
+///  Description: Runs periodic value checks and delayed work on registry keys from one thread.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Scheduler.h"
+
+#include <algorithm>
+
+namespace Registry
+{
+    static const DWORD FirstRetryMs = 50;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Scheduler::Scheduler( _In_opt_ DWORD tickMs )
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        m_tickMs        = (tickMs != 0) ? tickMs : 1;
+        m_start         = Metrics::Now();
+        m_ticksPerTick  = frequency.QuadPart * m_tickMs / 1000;
+        m_nextId        = 0;
+        m_batch         = 0;
+        m_wakeEvent     = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        m_shouldStop    = false;
+        m_worker        = nullptr;
+        m_workerId      = 0;
+
+        if(m_ticksPerTick == 0)
+            m_ticksPerTick = 1;
+
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Scheduler::~Scheduler()
+    {
+        Stop();
+
+        for(auto& timer : m_timers)
+            delete timer.second;
+
+        for(auto& entry : m_keys)
+        {
+            if(entry.second->owned && entry.second->key != nullptr)
+                entry.second->key->Close();
+
+            delete entry.second;
+        }
+
+        if(m_wakeEvent != nullptr)
+            CloseHandle(m_wakeEvent);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Scheduler::Start()
+    {
+        if(m_wakeEvent == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        if(m_worker != nullptr)
+            return ERROR_SUCCESS;
+
+        m_shouldStop    = false;
+        m_worker        = new std::thread(&Scheduler::Worker, this);
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Scheduler::Stop()
+    {
+        if(m_worker == nullptr)
+            return;
+
+        m_shouldStop = true;
+        SetEvent(m_wakeEvent);
+
+        m_worker->join();
+        delete m_worker;
+        m_worker = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    TimerId Scheduler::Pin( _In_     PredefinedKey   mainKey,
+                            _In_z_   const TCHAR*    keyPath,
+                            _In_z_   const TCHAR*    valueName,
+                            _In_     DWORD           value,
+                            _In_     DWORD           periodMs )
+    {
+        Timer* timer = new Timer;
+        timer->valueName    = valueName;
+        timer->value        = value;
+        timer->periodMs     = (periodMs > m_tickMs) ? periodMs : m_tickMs;
+
+        // The first check is at the next tick, so the value is in place at once.
+        return Add(mainKey, keyPath, nullptr, 0, timer);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    TimerId Scheduler::Schedule( _In_     PredefinedKey                               mainKey,
+                                 _In_z_   const TCHAR*                                keyPath,
+                                 _In_     DWORD                                       delayMs,
+                                 _In_     const std::function <DWORD (_In_ Key &)>&   callBack )
+    {
+        Timer* timer = new Timer;
+        timer->callBack     = callBack;
+        timer->value        = 0;
+        timer->periodMs     = (delayMs > FirstRetryMs) ? delayMs : FirstRetryMs;
+
+        return Add(mainKey, keyPath, nullptr, delayMs, timer);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    TimerId Scheduler::Schedule( _In_     Key*                                        key,
+                                 _In_     DWORD                                       delayMs,
+                                 _In_     const std::function <DWORD (_In_ Key &)>&   callBack )
+    {
+        Timer* timer = new Timer;
+        timer->callBack     = callBack;
+        timer->value        = 0;
+        timer->periodMs     = (delayMs > FirstRetryMs) ? delayMs : FirstRetryMs;
+
+        return Add(key->GetMainKey(), key->GetSubKeyPath(), key, delayMs, timer);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    TimerId Scheduler::Add( _In_ PredefinedKey mainKey, _In_z_ const TCHAR* keyPath, _In_opt_ Key* key, _In_ DWORD delayMs, _Inout_ Timer* timer )
+    {
+        bool    isFirst;
+        TimerId id;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            KeyName name(mainKey, keyPath, key);
+            auto    found = m_keys.find(name);
+
+            KeyEntry* entry;
+            if(found != m_keys.end())
+                entry = found->second;
+            else
+            {
+                entry = new KeyEntry;
+                entry->mainKey  = mainKey;
+                entry->path     = keyPath;
+                entry->key      = key;
+                entry->owned    = key == nullptr;
+                entry->timers   = 0;
+
+                m_keys[name] = entry;
+            }
+
+            entry->timers++;
+
+            do
+            {
+                m_nextId++;
+            } while(m_nextId == 0 || m_timers.count(m_nextId) != 0);
+
+            id                  = m_nextId;
+            timer->id           = id;
+            timer->entry        = entry;
+            timer->retryMs      = 0;
+            timer->nextMs       = 0;
+            timer->running      = false;
+            timer->cancelled    = false;
+
+            m_timers[timer->id] = timer;
+
+            // An empty wheel is not advanced while the thread sleeps; bring it to the present first.
+            ULONGLONG now = GetTick();
+            if(m_wheel.GetCount() == 0)
+            {
+                std::vector<TimerNode*> none;
+                m_wheel.Advance(now, none);
+            }
+
+            // The thread sleeps until the first tick of the wheel, so it must hear of an earlier one.
+            ULONGLONG next = m_wheel.GetNextTick();
+
+            m_wheel.Insert(timer, now + (delayMs + m_tickMs - 1) / m_tickMs);
+            isFirst = timer->expiry < next;
+        }
+
+        if(isFirst)
+            SetEvent(m_wakeEvent);
+
+        // The timer can have run and been freed by now.
+        return id;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Scheduler::Cancel( _In_ TimerId timerId )
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        auto found = m_timers.find(timerId);
+        if(found == m_timers.end())
+            return false;
+
+        Timer* timer = found->second;
+
+        // Freed by the thread when its batch is over.
+        if(timer->running)
+        {
+            timer->cancelled = true;
+
+            if(GetCurrentThreadId() != m_workerId)
+            {
+                DWORD batch = m_batch;
+                m_batchDone.wait(lock, [this, batch] () { return m_batch != batch; });
+            }
+
+            return true;
+        }
+
+        m_wheel.Remove(timer);
+        m_timers.erase(found);
+        Release(timer);
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Frees a timer out of the wheel and of the map, and closes its key with the last timer on it.
+    /// Called with the lock held.
+    void Scheduler::Release( _Inout_ Timer* timer )
+    {
+        KeyEntry* entry = timer->entry;
+        delete timer;
+
+        if(--entry->timers != 0)
+            return;
+
+        if(entry->owned && entry->key != nullptr)
+            entry->key->Close();
+
+        m_keys.erase(KeyName(entry->mainKey, entry->path, entry->owned ? nullptr : entry->key));
+        delete entry;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t Scheduler::GetCount()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        return m_timers.size();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    SchedulerStats Scheduler::GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        return m_stats;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ULONGLONG Scheduler::GetTick() const
+    {
+        return (ULONGLONG)((Metrics::Now() - m_start) / m_ticksPerTick);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Scheduler::Worker()
+    {
+        std::vector<TimerNode*> due;
+        std::vector<Timer*>     batch;
+
+        m_workerId = GetCurrentThreadId();
+
+        while(!m_shouldStop)
+        {
+            // Sleeps until the next timer, or the next slot to spread, instead of every tick.
+            DWORD timeout = INFINITE;
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                ULONGLONG next = m_wheel.GetNextTick();
+                ULONGLONG now  = GetTick();
+
+                if(next != ULLONG_MAX)
+                {
+                    ULONGLONG waitMs = (next > now) ? (next - now) * m_tickMs : 0;
+                    timeout = (waitMs < INFINITE) ? (DWORD)waitMs : INFINITE - 1;
+                }
+            }
+
+            WaitForSingleObject(m_wakeEvent, timeout);
+            if(m_shouldStop)
+                break;
+
+            ULONGLONG       now     = GetTick();
+            SchedulerStats  stats   = { 0 };
+
+            due.clear();
+            batch.clear();
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                m_wheel.Advance(now, due);
+                if(due.empty())
+                    continue;
+
+                for(TimerNode* node : due)
+                {
+                    Timer* timer = static_cast<Timer*>(node);
+                    timer->running = true;
+                    stats.lateTicks += now - timer->expiry;
+
+                    batch.push_back(timer);
+                }
+
+            }
+
+            // The timers of a key run together, on one handle.
+            std::stable_sort(batch.begin(), batch.end(), [] (const Timer* a, const Timer* b) -> bool
+                {
+                    return a->entry < b->entry;
+                }
+            );
+
+            for(size_t first = 0; first < batch.size(); )
+            {
+                size_t last = first + 1;
+                while(last < batch.size() && batch[last]->entry == batch[first]->entry)
+                    last++;
+
+                RunKey(batch[first]->entry, &batch[first], last - first, stats);
+                first = last;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                for(Timer* timer : batch)
+                {
+                    timer->running = false;
+
+                    if(timer->cancelled || timer->nextMs == 0)
+                    {
+                        m_timers.erase(timer->id);
+                        Release(timer);
+                    }
+                    else
+                        m_wheel.Insert(timer, now + (timer->nextMs + m_tickMs - 1) / m_tickMs);
+                }
+
+                m_stats.ticks++;
+                m_stats.timersRun       += batch.size();
+                m_stats.keyBatches      += stats.keyBatches;
+                m_stats.valuesChecked   += stats.valuesChecked;
+                m_stats.valuesRewritten += stats.valuesRewritten;
+                m_stats.retries         += stats.retries;
+                m_stats.lateTicks       += stats.lateTicks;
+
+                m_batch++;
+            }
+
+            m_batchDone.notify_all();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs the due timers of one key: its pins with one read of all their values, then its callbacks.
+    void Scheduler::RunKey( _In_ KeyEntry* entry, _In_reads_(count) Timer** timers, _In_ size_t count, _Inout_ SchedulerStats& stats )
+    {
+        stats.keyBatches++;
+
+        if(entry->owned && entry->key == nullptr)
+        {
+            entry->key = Key::Open( entry->mainKey,
+                                    entry->path.c_str(),
+                                    AccessRights::Query_Value | AccessRights::Set_Value );
+        }
+
+        Key*                    key = entry->key;
+        std::vector<ValueQuery> queries;
+        std::vector<Timer*>     pins;
+
+        for(size_t i = 0; i < count; i++)
+        {
+            Timer* timer = timers[i];
+
+            if(timer->cancelled)
+                continue;
+
+            if(timer->callBack)
+            {
+                // Without the key, the callback waits for the next try.
+                timer->nextMs = (key != nullptr) ? timer->callBack(*key) : timer->periodMs;
+                continue;
+            }
+
+            ValueQuery query;
+            query.name = timer->valueName.c_str();
+
+            queries.push_back(query);
+            pins.push_back(timer);
+        }
+
+        if(pins.empty())
+            return;
+
+        BYTE* buffer = nullptr;
+        if(key != nullptr)
+            key->GetValues(&queries[0], (DWORD)queries.size(), &buffer);
+
+        bool deleted = false;
+        for(size_t i = 0; i < pins.size(); i++)
+        {
+            Timer*  timer   = pins[i];
+            DWORD   current = 0;
+            LSTATUS status  = ERROR_INVALID_HANDLE;
+
+            stats.valuesChecked++;
+
+            if(key != nullptr)
+            {
+                bool inPlace = queries[i].status == ERROR_SUCCESS &&
+                               queries[i].Read(current) == ERROR_SUCCESS &&
+                               current == timer->value;
+
+                status = inPlace ? ERROR_SUCCESS : key->SetValueDWORD(timer->valueName.c_str(), timer->value);
+
+                if(!inPlace && status == ERROR_SUCCESS)
+                    stats.valuesRewritten++;
+            }
+
+            if(status == ERROR_SUCCESS)
+            {
+                timer->retryMs  = 0;
+                timer->nextMs   = timer->periodMs;
+                continue;
+            }
+
+            deleted |= (status == ERROR_KEY_DELETED);
+
+            timer->retryMs  = (timer->retryMs != 0) ? timer->retryMs * 2 : FirstRetryMs;
+            timer->retryMs  = (timer->retryMs < timer->periodMs) ? timer->retryMs : timer->periodMs;
+            timer->nextMs   = timer->retryMs;
+
+            stats.retries++;
+        }
+
+        delete [] buffer;
+
+        // The key was deleted and maybe created again; the retries use a fresh handle.
+        if(deleted)
+            key->Reopen();
+    }
+}
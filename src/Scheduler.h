@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Scheduler.h
+///  Description: Runs periodic value checks and delayed work on registry keys from one thread.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_SCHEDULER_H
+#define INCLUDED_SCHEDULER_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "./Registry.h"
+#include "./TimerWheel.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Identifies a timer of a Scheduler, to cancel it; never 0.
+    typedef DWORD TimerId;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct SchedulerStats
+    {
+        LONG64      ticks;              /// Ticks that had timers due.
+        LONG64      timersRun;
+        LONG64      keyBatches;         /// Keys visited by the ticks; every one was read once for all its pins.
+        LONG64      valuesChecked;      /// Pinned values compared.
+        LONG64      valuesRewritten;    /// Pinned values found changed and written back.
+        LONG64      retries;            /// Failed writes scheduled again.
+        LONG64      lateTicks;          /// Sum of the ticks the timers ran after their due tick.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Runs timers on one thread, kept in a TimerWheel so thousands of them cost the same to add and
+    /// cancel as a few. A timer belongs to a key, given by its path: the keys are opened by the
+    /// scheduler once and kept open while they have timers, and the timers due at a tick run grouped
+    /// by key, so one handle and, for the pinned values, one GetValues call serve all of them.
+    ///
+    /// The thread sleeps until the first tick the wheel has a timer due at, or a slot of its upper
+    /// wheels to spread, and while there are no timers. Timers can be added and cancelled from any
+    /// thread, and from the timer callbacks.
+    class Scheduler
+    {
+    public:
+
+        Scheduler( _In_opt_ DWORD tickMs = 10 );
+
+        ~Scheduler();
+
+        LSTATUS Start();
+
+        /// Stops the thread; the timers are kept and run again on the next Start.
+        void Stop();
+
+        /// Checks a DWORD value every periodMs and writes it back when it differs. A write that fails
+        /// is tried again after 50 ms, with the delay doubling up to periodMs.
+        TimerId Pin( _In_     PredefinedKey   mainKey,
+                     _In_z_   const TCHAR*    keyPath,
+                     _In_z_   const TCHAR*    valueName,
+                     _In_     DWORD           value,
+                     _In_     DWORD           periodMs );
+
+        /// Runs callBack on the key after delayMs. The callback returns the delay of its next run in
+        /// ms, or 0 when it is done. It isn't called when the key can't be opened; it is then tried
+        /// again after the same delay, at least 50 ms. The keys are opened with the Query_Value and
+        /// Set_Value rights.
+        TimerId Schedule( _In_     PredefinedKey                               mainKey,
+                          _In_z_   const TCHAR*                                keyPath,
+                          _In_     DWORD                                       delayMs,
+                          _In_     const std::function <DWORD (_In_ Key &)>&   callBack );
+
+        /// The same on a key opened by the caller, which must stay open while the timer exists.
+        TimerId Schedule( _In_     Key*                                        key,
+                          _In_     DWORD                                       delayMs,
+                          _In_     const std::function <DWORD (_In_ Key &)>&   callBack );
+
+        /// Removes a timer. When its callback is running on another thread, waits for it to return,
+        /// so what it uses can be freed after. Returns false for an unknown or finished timer.
+        bool Cancel( _In_ TimerId timerId );
+
+        size_t GetCount();
+
+        SchedulerStats GetStats();
+
+    private:
+        Scheduler( const Scheduler& );
+        Scheduler& operator = ( const Scheduler& );
+
+        struct KeyEntry
+        {
+            PredefinedKey               mainKey;
+            std::basic_string<TCHAR>    path;
+            Key*                        key;        /// Opened by the scheduler thread on first use.
+            bool                        owned;      /// False for a key given by the caller.
+            DWORD                       timers;     /// Timers on the key; it is closed with the last one.
+        };
+
+        typedef std::tuple<PredefinedKey, std::basic_string<TCHAR>, Key*> KeyName;    /// The key is null when owned.
+
+        struct Timer : TimerNode
+        {
+            TimerId                                     id;
+            KeyEntry*                                   entry;
+            std::function <DWORD (_In_ Key &)>          callBack;   /// Empty for a pin.
+            std::basic_string<TCHAR>                    valueName;
+            DWORD                                       value;
+            DWORD                                       periodMs;
+            DWORD                                       retryMs;    /// 0 unless the last write of a pin failed.
+            DWORD                                       nextMs;     /// Set by the run; 0 to remove the timer.
+            bool                                        running;    /// In the batch of the current tick.
+            bool                                        cancelled;
+        };
+
+        TimerId     Add( _In_ PredefinedKey mainKey, _In_z_ const TCHAR* keyPath, _In_opt_ Key* key, _In_ DWORD delayMs, _Inout_ Timer* timer );
+        void        Release( _Inout_ Timer* timer );
+        ULONGLONG   GetTick() const;
+        void        Worker();
+        void        RunKey( _In_ KeyEntry* entry, _In_reads_(count) Timer** timers, _In_ size_t count, _Inout_ SchedulerStats& stats );
+
+        DWORD                                       m_tickMs;
+        LONGLONG                                    m_start;
+        LONGLONG                                    m_ticksPerTick;    /// Performance counter ticks per tick.
+
+        std::mutex                                  m_lock;
+        std::condition_variable                     m_batchDone;
+        TimerWheel                                  m_wheel;
+        std::unordered_map<TimerId, Timer*>         m_timers;
+        std::map<KeyName, KeyEntry*>                m_keys;
+        TimerId                                     m_nextId;
+        DWORD                                       m_batch;            /// Batches run so far; Cancel waits for it to move.
+        SchedulerStats                              m_stats;
+
+        HANDLE                                      m_wakeEvent;
+        volatile bool                               m_shouldStop;
+        std::thread*                                m_worker;
+        DWORD                                       m_workerId;
+    };
+}
+
+#endif // INCLUDED_SCHEDULER_H
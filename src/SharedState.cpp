@@ -0,0 +1,318 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        SharedState.cpp
+///  Description: Named shared memory holding the swap state, the owner of the registry key and the
+///               live counters, shared by all the instances and by monitoring tools.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./SharedState.h"
+#include "./Metrics.h"
+#include <sddl.h>
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    const TCHAR* const SharedState::Name = _T("Local\\3DVisionEyeSwapper.State");
+
+    // Like the control pipe: the tool runs elevated, and the monitoring tools usually do not, so
+    // interactive users can read the segment.
+    static const TCHAR* const sharedStateSecurity = _T("D:(A;;GA;;;SY)(A;;GA;;;BA)(A;;GR;;;IU)");
+
+    static_assert((int)Registry::Counter::Count <= SharedStateData::MaxCounters, "Too many counters for the shared state");
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    SharedState::SharedState()
+    {
+        m_mapping   = nullptr;
+        m_data      = nullptr;
+        m_isOwner   = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    SharedState::~SharedState()
+    {
+        Close();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS SharedState::Create()
+    {
+        Close();
+
+        SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), nullptr, FALSE };
+        ConvertStringSecurityDescriptorToSecurityDescriptor( sharedStateSecurity,
+                                                             SDDL_REVISION_1,
+                                                             &security.lpSecurityDescriptor,
+                                                             nullptr );
+
+        m_mapping = CreateFileMapping(INVALID_HANDLE_VALUE, &security, PAGE_READWRITE, 0, sizeof(SharedStateData), Name);
+        LSTATUS status = (m_mapping == nullptr) ? GetLastError() : ERROR_SUCCESS;
+
+        LocalFree(security.lpSecurityDescriptor);
+
+        if(m_mapping == nullptr)
+            return status;
+
+        m_data = (SharedStateData*)MapViewOfFile(m_mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(SharedStateData));
+        if(m_data == nullptr)
+        {
+            status = GetLastError();
+            Close();
+            return status;
+        }
+
+        // A new segment is zeroed. Two instances starting together may both get here; the fields
+        // written are the same, and magic goes last so readers never see a half written header.
+        if(m_data->magic != Magic)
+        {
+            m_data->version         = Version;
+            m_data->counterCount    = (DWORD)Registry::Counter::Count;
+            MemoryBarrier();
+            m_data->magic           = Magic;
+        }
+
+        if(m_data->version != Version)
+        {
+            Close();
+            return ERROR_REVISION_MISMATCH;
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS SharedState::OpenReadOnly()
+    {
+        Close();
+
+        m_mapping = OpenFileMapping(FILE_MAP_READ, FALSE, Name);
+        if(m_mapping == nullptr)
+            return GetLastError();
+
+        m_data = (SharedStateData*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(SharedStateData));
+        if(m_data == nullptr)
+        {
+            LSTATUS status = GetLastError();
+            Close();
+            return status;
+        }
+
+        if(m_data->magic != Magic || m_data->version != Version)
+        {
+            Close();
+            return ERROR_REVISION_MISMATCH;
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SharedState::Close()
+    {
+        Release();
+
+        if(m_data != nullptr)
+            UnmapViewOfFile(m_data);
+
+        if(m_mapping != nullptr)
+            CloseHandle(m_mapping);
+
+        m_data      = nullptr;
+        m_mapping   = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool SharedState::Acquire()
+    {
+        if(m_data == nullptr)
+            return false;
+
+        LONG self = (LONG)GetCurrentProcessId();
+
+        for(;;)
+        {
+            LONG owner = m_data->ownerProcessId;
+
+            if(owner == self)
+                break;
+
+            if(owner != 0 && HasOwner())
+                return false;
+
+            // The owner is gone; whoever swaps its id out first takes over.
+            if(InterlockedCompareExchange(&m_data->ownerProcessId, self, owner) == owner)
+                break;
+        }
+
+        m_isOwner = true;
+        Renew();
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool SharedState::Renew()
+    {
+        if(!m_isOwner)
+            return false;
+
+        LONG self = (LONG)GetCurrentProcessId();
+
+        // Making sequence odd takes the right to write, so a former owner still in a renewal and the
+        // new one never write together. One that stays odd was left by an owner that crashed there.
+        LONG sequence = m_data->sequence;
+        for(DWORD retry = 0; ; retry++)
+        {
+            if((sequence & 1) != 0)
+            {
+                if(retry >= WriteRetries)
+                    break;
+
+                Sleep(1);
+                sequence = m_data->sequence;
+                continue;
+            }
+
+            LONG found = InterlockedCompareExchange(&m_data->sequence, sequence + 1, sequence);
+            if(found == sequence)
+            {
+                sequence++;
+                break;
+            }
+
+            sequence = found;
+        }
+
+        // The owner is checked with the right to write held: an instance taking the lease over
+        // waits for it before its own first renewal.
+        if(InterlockedCompareExchange(&m_data->ownerProcessId, self, self) != self)
+        {
+            InterlockedExchange(&m_data->sequence, sequence + 1);
+
+            m_isOwner = false;
+            return false;
+        }
+
+        InterlockedExchange64(&m_data->leaseExpiry, (LONG64)(GetTickCount64() + LeaseMs));
+
+        for(int i = 0; i < (int)Registry::Counter::Count; i++)
+            m_data->counters[i] = Registry::Metrics::Get((Registry::Counter)i);
+
+        InterlockedExchange(&m_data->sequence, sequence + 1);
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SharedState::Release()
+    {
+        if(!m_isOwner)
+            return;
+
+        m_isOwner = false;
+
+        InterlockedExchange64(&m_data->leaseExpiry, 0);
+        InterlockedCompareExchange(&m_data->ownerProcessId, 0, (LONG)GetCurrentProcessId());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SharedState::SetEyesSwapped( _In_ bool eyesSwapped )
+    {
+        if(m_isOwner)
+            InterlockedExchange(&m_data->eyesSwapped, eyesSwapped ? 1 : 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void SharedState::SetStorm( _In_ bool inStorm )
+    {
+        if(m_isOwner)
+            InterlockedExchange(&m_data->inStorm, inStorm ? 1 : 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool SharedState::HasOwner() const
+    {
+        if(m_data == nullptr)
+            return false;
+
+        DWORD owner = (DWORD)m_data->ownerProcessId;
+        if(owner == 0)
+            return false;
+
+        // Read-only views can't use interlocked reads, so the lease is read under the sequence.
+        LONG64 leaseExpiry  = 0;
+        bool   consistent   = false;
+        for(DWORD retry = 0; retry < ReadRetries && !consistent; retry++)
+        {
+            LONG sequence = m_data->sequence;
+            MemoryBarrier();
+            leaseExpiry = m_data->leaseExpiry;
+            MemoryBarrier();
+
+            consistent = ((sequence & 1) == 0 && sequence == m_data->sequence);
+            if(!consistent)
+                YieldProcessor();
+        }
+
+        // Without a lease to trust, only the process tells: a crash while renewing left sequence odd,
+        // while a live owner was only stopped in the middle of a renewal.
+        if(consistent && (ULONGLONG)leaseExpiry <= GetTickCount64())
+            return false;
+
+        return owner == GetCurrentProcessId() || IsProcessAlive(owner);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    DWORD SharedState::ReadCounters( _Out_writes_(count) LONG64* counters, _In_ DWORD count ) const
+    {
+        if(m_data == nullptr)
+            return 0;
+
+        if(count > m_data->counterCount)
+            count = m_data->counterCount;
+
+        for(DWORD retry = 0; retry < ReadRetries; retry++)
+        {
+            LONG sequence = m_data->sequence;
+            MemoryBarrier();
+
+            for(DWORD i = 0; i < count; i++)
+                counters[i] = m_data->counters[i];
+
+            MemoryBarrier();
+            if((sequence & 1) == 0 && sequence == m_data->sequence)
+                return count;
+
+            YieldProcessor();
+        }
+
+        return 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool SharedState::IsProcessAlive( _In_ DWORD processId )
+    {
+        HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, processId);
+
+        // An elevated owner can't be opened by a normal process; trust its lease then.
+        if(process == nullptr)
+            return GetLastError() != ERROR_INVALID_PARAMETER;
+
+        bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+        CloseHandle(process);
+
+        return alive;
+    }
+}
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        SharedState.h
+///  Description: Named shared memory holding the swap state, the owner of the registry key and the
+///               live counters, shared by all the instances and by monitoring tools.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_SHAREDSTATE_H
+#define INCLUDED_SHAREDSTATE_H
+
+#include <windows.h>
+#include <tchar.h>
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Layout of the shared segment. It has only fixed size fields, so 32 and 64 bit processes see
+    /// the same layout; tools map it read-only and read it in place.
+    ///
+    /// The counters are copied from Registry::Metrics, in the order of Registry::Counter, every time
+    /// the owner renews its lease. sequence is odd while they are written: a reader takes it before
+    /// and after reading them, and reads again when it changed or was odd, up to ReadRetries times.
+    struct SharedStateData
+    {
+        static const DWORD  MaxCounters = 32;
+
+        DWORD               magic;              /// SharedState::Magic once the segment is initialized.
+        DWORD               version;
+        volatile LONG       ownerProcessId;     /// 0 when no instance owns the registry key.
+        volatile LONG       eyesSwapped;
+        volatile LONG64     leaseExpiry;        /// GetTickCount64 time when the owner is considered gone.
+        volatile LONG       inStorm;
+        volatile LONG       sequence;
+        DWORD               counterCount;
+        DWORD               reserved;
+        volatile LONG64     counters[MaxCounters];
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// One instance owns the registry key: it holds a lease in the segment and renews it well before
+    /// it runs out. Another instance that finds a live owner does not touch the key. A crashed owner
+    /// is replaced as soon as its process is gone, or when its lease runs out.
+    class SharedState
+    {
+    public:
+        static const DWORD          Magic           = 0x33445653;      // "SVD3"
+        static const DWORD          Version         = 1;
+        static const DWORD          LeaseMs         = 5000;
+        static const DWORD          RenewMs         = 1000;
+        static const DWORD          ReadRetries     = 1000;            // Then sequence is taken as left odd by a crash.
+        static const DWORD          WriteRetries    = 100;             // Of 1 ms, for a former owner to end its renewal.
+
+        static const TCHAR* const   Name;
+
+        SharedState();
+
+        /// Releases the lease when this instance owns it.
+        ~SharedState();
+
+        /// Creates the segment, or opens it for writing when another instance did.
+        LSTATUS Create();
+
+        /// Opens the segment of a running instance for reading.
+        LSTATUS OpenReadOnly();
+
+        void Close();
+
+        /// Takes the lease, unless another instance holds a live one.
+        bool Acquire();
+
+        /// Extends the lease and publishes the counters. Returns false when another instance took the
+        /// lease over, after this one missed renewing it; nothing is written then.
+        bool Renew();
+
+        void Release();
+
+        void SetEyesSwapped( _In_ bool eyesSwapped );
+
+        void SetStorm( _In_ bool inStorm );
+
+        /// Whether a live instance holds the lease.
+        bool HasOwner() const;
+
+        bool IsOwner() const
+        {
+            return m_isOwner;
+        }
+
+        /// Reads a consistent copy of the published counters; returns how many were copied, 0 when the
+        /// owner died while writing them.
+        DWORD ReadCounters( _Out_writes_(count) LONG64* counters, _In_ DWORD count ) const;
+
+        /// The segment, read in place; nullptr when it is not open.
+        const SharedStateData* GetData() const
+        {
+            return m_data;
+        }
+
+    private:
+        SharedState( const SharedState& );
+        SharedState& operator = ( const SharedState& );
+
+        static bool IsProcessAlive( _In_ DWORD processId );
+
+        HANDLE              m_mapping;
+        SharedStateData*    m_data;
+        bool                m_isOwner;
+    };
+}
+
+#endif // INCLUDED_SHAREDSTATE_H
@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        StereoAnalyzer.cpp
+///  Description: Tells from a captured row interleaved frame whether the eyes are swapped, by
+///               matching the blocks of the two eye fields.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./StereoAnalyzer.h"
+#include "./StereoCompositor.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STEREOANALYZER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Enforcement
+{
+    // The blocks are taken on a grid; the frame is not scanned whole, which keeps a 1080p frame
+    // under a millisecond.
+    static const DWORD  blockStepX          = 32;
+    static const DWORD  blockStepRows       = 16;
+
+    // A block with less texture than this, per byte, cannot be matched reliably.
+    static const DWORD  minTexture          = 4;
+
+    // The share of the blocks with depth that must agree on a side, in percent.
+    static const DWORD  minAgreement        = 65;
+    static const DWORD  minBlocks           = 16;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    DWORD StereoAnalyzer::BlockSad( _In_reads_(rows) const BYTE* const*    a,
+                                    _In_reads_(rows) const BYTE* const*    b,
+                                    _In_             int                   offsetA,
+                                    _In_             int                   offsetB,
+                                    _In_             DWORD                 rows )
+    {
+#ifdef STEREOANALYZER_SSE2
+        __m128i sum = _mm_setzero_si128();
+
+        for(DWORD row = 0; row < rows; row++)
+        {
+            __m128i blockA = _mm_loadu_si128((const __m128i*)(a[row] + offsetA));
+            __m128i blockB = _mm_loadu_si128((const __m128i*)(b[row] + offsetB));
+
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(blockA, blockB));
+        }
+
+        // The two halves hold the sums of the low and high 8 bytes.
+        return (DWORD)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#else
+        DWORD sum = 0;
+
+        for(DWORD row = 0; row < rows; row++)
+        {
+            const BYTE* blockA = a[row] + offsetA;
+            const BYTE* blockB = b[row] + offsetB;
+
+            for(DWORD i = 0; i < BlockWidth; i++)
+                sum += (blockA[i] > blockB[i]) ? blockA[i] - blockB[i] : blockB[i] - blockA[i];
+        }
+
+        return sum;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    StereoResult StereoAnalyzer::Analyze( _In_ const StereoFrame&   frame,
+                                          _In_ DWORD                pattern0,
+                                          _In_ DWORD                pattern1 )
+    {
+        StereoResult result = { Parallax::Unknown, 0, 0, 0, 0 };
+
+        // The fields are kept as row pointers in the frame; nothing is copied.
+        std::vector<const BYTE*> left;
+        std::vector<const BYTE*> right;
+
+        for(DWORD row = 0; row < frame.height; row++)
+        {
+            const BYTE* rowData = &frame.luma[(size_t)row * frame.width];
+
+            if(IsLeftRow(row, pattern0, pattern1))
+                left.push_back(rowData);
+            else
+                right.push_back(rowData);
+        }
+
+        DWORD fieldRows = (DWORD)((left.size() < right.size()) ? left.size() : right.size());
+        if(fieldRows < BlockRows || frame.width < BlockWidth + 2 * MaxDisparity)
+            return result;
+
+        DWORD histogram[2 * MaxDisparity + 1] = { 0 };
+
+        for(DWORD row = 0; row + BlockRows <= fieldRows; row += blockStepRows)
+        {
+            const BYTE* const* leftRows  = &left[row];
+            const BYTE* const* rightRows = &right[row];
+
+            for(DWORD x = MaxDisparity; x + BlockWidth + MaxDisparity <= frame.width; x += blockStepX)
+            {
+                // The block against itself moved by one pixel tells how much texture it has.
+                if(BlockSad(leftRows, leftRows, x, x + 1, BlockRows) < minTexture * BlockWidth * BlockRows)
+                    continue;
+
+                DWORD bestSad       = MAXDWORD;
+                int   bestDisparity = 0;
+                DWORD sadSum        = 0;
+
+                for(int disparity = -MaxDisparity; disparity <= MaxDisparity; disparity++)
+                {
+                    DWORD sad = BlockSad(leftRows, rightRows, x, x + disparity, BlockRows);
+                    sadSum   += sad;
+
+                    if(sad < bestSad)
+                    {
+                        bestSad       = sad;
+                        bestDisparity = disparity;
+                    }
+                }
+
+                // A repetitive texture matches about everywhere; keep only clear minimums.
+                if((ULONGLONG)bestSad * 2 * (2 * MaxDisparity + 1) > sadSum)
+                    continue;
+
+                histogram[bestDisparity + MaxDisparity]++;
+                result.blocks++;
+
+                if(bestDisparity > 0)
+                    result.behind++;
+                else if(bestDisparity < 0)
+                    result.front++;
+            }
+        }
+
+        if(result.blocks == 0)
+            return result;
+
+        DWORD seen = 0;
+        for(int i = 0; i <= 2 * MaxDisparity; i++)
+        {
+            seen += histogram[i];
+            if(seen * 2 >= result.blocks)
+            {
+                result.medianDisparity = i - MaxDisparity;
+                break;
+            }
+        }
+
+        // Blocks at the depth of the screen, like the HUD, tell nothing about the order of the eyes.
+        DWORD withDepth = result.behind + result.front;
+        if(withDepth < minBlocks)
+            return result;
+
+        if(result.behind * 100 >= withDepth * minAgreement)
+            result.parallax = Parallax::Normal;
+        else if(result.front * 100 >= withDepth * minAgreement)
+            result.parallax = Parallax::Inverted;
+
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StereoAnalyzer::LoadFrame( _In_z_ const TCHAR*   fileName,
+                                       _Out_  StereoFrame*   frame )
+    {
+        frame->width  = 0;
+        frame->height = 0;
+        frame->luma.clear();
+
+        StereoImage image;
+
+        LSTATUS status = image.Load(fileName);
+        if(status != ERROR_SUCCESS)
+            return status;
+
+        frame->width  = image.width;
+        frame->height = image.height;
+        frame->luma.resize(image.pixels.size());
+
+        // Rec. 601 weights, in 8 bit fixed point; the pixels are BGRA.
+        for(size_t i = 0; i < image.pixels.size(); i++)
+        {
+            DWORD pixel = image.pixels[i];
+            frame->luma[i] = (BYTE)((((pixel >> 16) & 0xFF) * 77 + ((pixel >> 8) & 0xFF) * 150 + (pixel & 0xFF) * 29) >> 8);
+        }
+
+        return ERROR_SUCCESS;
+    }
+}
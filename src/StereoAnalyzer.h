@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        StereoAnalyzer.h
+///  Description: Tells from a captured row interleaved frame whether the eyes are swapped, by
+///               matching the blocks of the two eye fields.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_STEREOANALYZER_H
+#define INCLUDED_STEREOANALYZER_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <vector>
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// A captured frame, as 8 bit luma.
+    struct StereoFrame
+    {
+        DWORD               width;
+        DWORD               height;
+        std::vector<BYTE>   luma;           /// width * height bytes, the top row first.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    enum class Parallax
+    {
+        Unknown,        /// Too little texture, or no clear depth.
+        Normal,         /// Most of the scene is behind the screen, as expected.
+        Inverted        /// Most of the scene comes out of the screen: the eyes are swapped.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct StereoResult
+    {
+        Parallax    parallax;
+        int         medianDisparity;    /// In pixels, of the right eye field against the left one.
+        DWORD       blocks;             /// Textured blocks matched.
+        DWORD       behind;             /// Blocks found behind the screen (positive disparity).
+        DWORD       front;              /// Blocks found in front of the screen (negative disparity).
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Splits a row interleaved frame in its two eye fields and measures the horizontal disparity
+    /// between them with block matching (SSE2 sums of absolute differences).
+    ///
+    /// The two InterleavePattern values give the eye of every row, 8 rows at a time: byte i of
+    /// pattern0 for row i, byte i of pattern1 for row 4 + i. A byte of 0xFF shows the left eye.
+    /// In a game most of the scene is behind the screen, so the right eye sees it shifted to the
+    /// right; with the eyes swapped, the disparities change their sign.
+    class StereoAnalyzer
+    {
+    public:
+        static const int    MaxDisparity    = 32;   /// The search range, in pixels, both ways.
+        static const DWORD  BlockWidth      = 16;
+        static const DWORD  BlockRows       = 4;    /// Rows of a field in a block.
+
+        /// Loads a 24 or 32 bit BMP file with StereoImage::Load, as luma.
+        static LSTATUS LoadFrame( _In_z_ const TCHAR*   fileName,
+                                  _Out_  StereoFrame*   frame );
+
+        static StereoResult Analyze( _In_ const StereoFrame&   frame,
+                                     _In_ DWORD                pattern0,
+                                     _In_ DWORD                pattern1 );
+
+        static bool IsLeftRow( _In_ DWORD row, _In_ DWORD pattern0, _In_ DWORD pattern1 )
+        {
+            DWORD pattern = ((row & 7) < 4) ? pattern0 : pattern1;
+            return ((pattern >> ((row & 3) * 8)) & 0xFF) == 0xFF;
+        }
+
+        /// Sum of the absolute differences of two blocks of BlockWidth bytes by rows, given by the
+        /// pointers to the first byte of every row.
+        static DWORD BlockSad( _In_reads_(rows) const BYTE* const*    a,
+                               _In_reads_(rows) const BYTE* const*    b,
+                               _In_             int                   offsetA,
+                               _In_             int                   offsetB,
+                               _In_             DWORD                 rows );
+    };
+}
+
+#endif // INCLUDED_STEREOANALYZER_H
@@ -0,0 +1,410 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        StereoCompositor.cpp
+///  Description: Builds the row interleaved frame the driver shows for a pair of InterleavePattern
+///               values, from the pictures of the two eyes.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./StereoCompositor.h"
+
+#include <stdio.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STEREOCOMPOSITOR_SIMD
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void ComposeRowScalar( _Out_writes_(count) DWORD*          output,
+                                  _In_reads_(count)   const DWORD*    left,
+                                  _In_reads_(count)   const DWORD*    right,
+                                  _In_                DWORD           count,
+                                  _In_                BYTE            mask )
+    {
+        DWORD mask32 = mask * 0x01010101;
+
+        for(DWORD i = 0; i < count; i++)
+            output[i] = (left[i] & mask32) | (right[i] & ~mask32);
+    }
+
+#ifdef STEREOCOMPOSITOR_SIMD
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void ComposeRowSSE2( _Out_writes_(count) DWORD*          output,
+                                _In_reads_(count)   const DWORD*    left,
+                                _In_reads_(count)   const DWORD*    right,
+                                _In_                DWORD           count,
+                                _In_                BYTE            mask )
+    {
+        __m128i mask128 = _mm_set1_epi8((char)mask);
+        DWORD   i       = 0;
+
+        for(; i + 4 <= count; i += 4)
+        {
+            __m128i l = _mm_loadu_si128((const __m128i*)(left + i));
+            __m128i r = _mm_loadu_si128((const __m128i*)(right + i));
+
+            _mm_storeu_si128((__m128i*)(output + i), _mm_or_si128(_mm_and_si128(mask128, l), _mm_andnot_si128(mask128, r)));
+        }
+
+        ComposeRowScalar(output + i, left + i, right + i, count - i, mask);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static void ComposeRowAVX2( _Out_writes_(count) DWORD*          output,
+                                _In_reads_(count)   const DWORD*    left,
+                                _In_reads_(count)   const DWORD*    right,
+                                _In_                DWORD           count,
+                                _In_                BYTE            mask )
+    {
+        __m256i mask256 = _mm256_set1_epi8((char)mask);
+        DWORD   i       = 0;
+
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256i l = _mm256_loadu_si256((const __m256i*)(left + i));
+            __m256i r = _mm256_loadu_si256((const __m256i*)(right + i));
+
+            _mm256_storeu_si256((__m256i*)(output + i), _mm256_or_si256(_mm256_and_si256(mask256, l), _mm256_andnot_si256(mask256, r)));
+        }
+
+        // Leave the AVX state before running SSE code again.
+        _mm256_zeroupper();
+
+        ComposeRowSSE2(output + i, left + i, right + i, count - i, mask);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    static bool HasAVX2()
+    {
+        int info[4];
+
+        __cpuid(info, 0);
+        if(info[0] < 7)
+            return false;
+
+        // AVX2 needs the OS to save the YMM registers.
+        __cpuid(info, 1);
+        if((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+            return false;
+
+        if((_xgetbv(0) & 6) != 6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool StereoCompositor::IsSupported( _In_ ComposeKernel kernel )
+    {
+        switch(kernel)
+        {
+        case ComposeKernel::Auto:
+        case ComposeKernel::Scalar:
+            return true;
+
+#ifdef STEREOCOMPOSITOR_SIMD
+        case ComposeKernel::SSE2:
+            return true;
+
+        case ComposeKernel::AVX2:
+            {
+                static const bool hasAVX2 = HasAVX2();
+                return hasAVX2;
+            }
+#endif
+
+        default:
+            return false;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    StereoCompositor::StereoCompositor( _In_opt_ DWORD threads )
+    {
+        if(threads == 0)
+        {
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            threads = systemInfo.dwNumberOfProcessors;
+        }
+
+        m_threads       = threads;
+        m_work          = nullptr;
+        m_left          = nullptr;
+        m_right         = nullptr;
+        m_output        = nullptr;
+        m_width         = 0;
+        m_height        = 0;
+        m_pattern0      = 0;
+        m_pattern1      = 0;
+        m_kernel        = ComposeKernel::Scalar;
+        m_tileCount     = 0;
+        m_nextTile      = 0;
+
+        InitializeThreadpoolEnvironment(&m_environment);
+
+        m_pool = CreateThreadpool(nullptr);
+        if(m_pool != nullptr)
+        {
+            SetThreadpoolThreadMaximum(m_pool, threads);
+            SetThreadpoolCallbackPool(&m_environment, m_pool);
+
+            m_work = CreateThreadpoolWork(WorkCallback, this, &m_environment);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    StereoCompositor::~StereoCompositor()
+    {
+        if(m_work != nullptr)
+        {
+            WaitForThreadpoolWorkCallbacks(m_work, FALSE);
+            CloseThreadpoolWork(m_work);
+        }
+
+        if(m_pool != nullptr)
+            CloseThreadpool(m_pool);
+
+        DestroyThreadpoolEnvironment(&m_environment);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StereoCompositor::Compose( _In_    const StereoImage&  left,
+                                       _In_    const StereoImage&  right,
+                                       _In_    DWORD               pattern0,
+                                       _In_    DWORD               pattern1,
+                                       _Out_   StereoImage*        output,
+                                       _In_opt_ ComposeKernel      kernel )
+    {
+        if(left.width != right.width || left.height != right.height || left.pixels.empty())
+            return ERROR_INVALID_PARAMETER;
+
+        if(!IsSupported(kernel))
+            return ERROR_NOT_SUPPORTED;
+
+        if(kernel == ComposeKernel::Auto)
+        {
+            if(IsSupported(ComposeKernel::AVX2))
+                kernel = ComposeKernel::AVX2;
+            else if(IsSupported(ComposeKernel::SSE2))
+                kernel = ComposeKernel::SSE2;
+            else
+                kernel = ComposeKernel::Scalar;
+        }
+
+        std::lock_guard<std::mutex> guard(m_composeLock);
+
+        output->width   = left.width;
+        output->height  = left.height;
+        output->pixels.resize(left.pixels.size());
+
+        m_left          = &left.pixels[0];
+        m_right         = &right.pixels[0];
+        m_output        = &output->pixels[0];
+        m_width         = left.width;
+        m_height        = left.height;
+        m_pattern0      = pattern0;
+        m_pattern1      = pattern1;
+        m_kernel        = kernel;
+        m_tileCount     = (m_height + TileRows - 1) / TileRows;
+        m_nextTile      = 0;
+
+        if(m_work != nullptr)
+        {
+            // Every work item takes tiles until none is left.
+            DWORD items = (m_tileCount < m_threads) ? m_tileCount : m_threads;
+            for(DWORD i = 0; i < items; i++)
+                SubmitThreadpoolWork(m_work);
+
+            WaitForThreadpoolWorkCallbacks(m_work, FALSE);
+        }
+        else
+        {
+            for(DWORD tile = 0; tile < m_tileCount; tile++)
+                ComposeTile(tile);
+        }
+
+        m_left      = nullptr;
+        m_right     = nullptr;
+        m_output    = nullptr;
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void CALLBACK StereoCompositor::WorkCallback( _Inout_     PTP_CALLBACK_INSTANCE   instance,
+                                                  _Inout_opt_ PVOID                   context,
+                                                  _Inout_     PTP_WORK                work )
+    {
+        UNREFERENCED_PARAMETER(instance);
+        UNREFERENCED_PARAMETER(work);
+
+        StereoCompositor* compositor = (StereoCompositor*)context;
+
+        for(;;)
+        {
+            DWORD tile = compositor->m_nextTile.fetch_add(1);
+            if(tile >= compositor->m_tileCount)
+                break;
+
+            compositor->ComposeTile(tile);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void StereoCompositor::ComposeTile( _In_ DWORD tile )
+    {
+        DWORD firstRow  = tile * TileRows;
+        DWORD lastRow   = (firstRow + TileRows < m_height) ? firstRow + TileRows : m_height;
+
+        for(DWORD row = firstRow; row < lastRow; row++)
+        {
+            size_t  offset  = (size_t)row * m_width;
+            BYTE    mask    = GetRowMask(row, m_pattern0, m_pattern1);
+
+            switch(m_kernel)
+            {
+#ifdef STEREOCOMPOSITOR_SIMD
+            case ComposeKernel::AVX2:
+                ComposeRowAVX2(m_output + offset, m_left + offset, m_right + offset, m_width, mask);
+                break;
+
+            case ComposeKernel::SSE2:
+                ComposeRowSSE2(m_output + offset, m_left + offset, m_right + offset, m_width, mask);
+                break;
+#endif
+
+            default:
+                ComposeRowScalar(m_output + offset, m_left + offset, m_right + offset, m_width, mask);
+                break;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StereoImage::Load( _In_z_ const TCHAR* fileName )
+    {
+        width   = 0;
+        height  = 0;
+        pixels.clear();
+
+        FILE* file = nullptr;
+        if(_tfopen_s(&file, fileName, _T("rb")) != 0 || file == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        BITMAPFILEHEADER fileHeader;
+        BITMAPINFOHEADER infoHeader;
+
+        LSTATUS status = ERROR_SUCCESS;
+
+        if( fread(&fileHeader, sizeof(fileHeader), 1, file) != 1 ||
+            fread(&infoHeader, sizeof(infoHeader), 1, file) != 1 ||
+            fileHeader.bfType != 0x4D42 )
+            status = ERROR_BAD_FORMAT;
+        else if( (infoHeader.biBitCount != 24 && infoHeader.biBitCount != 32) ||
+                 (infoHeader.biCompression != BI_RGB && infoHeader.biCompression != BI_BITFIELDS) ||
+                 infoHeader.biWidth <= 0 || infoHeader.biHeight == 0 )
+            status = ERROR_UNSUPPORTED_TYPE;
+
+        if(status == ERROR_SUCCESS)
+        {
+            // A negative height is a top-down bitmap.
+            bool  topDown       = infoHeader.biHeight < 0;
+            DWORD pixelSize     = infoHeader.biBitCount / 8;
+
+            width  = (DWORD)infoHeader.biWidth;
+            height = (DWORD)(topDown ? -infoHeader.biHeight : infoHeader.biHeight);
+
+            DWORD             stride = (width * pixelSize + 3) & ~3;
+            std::vector<BYTE> row(stride);
+
+            pixels.resize((size_t)width * height);
+
+            fseek(file, fileHeader.bfOffBits, SEEK_SET);
+
+            for(DWORD y = 0; y < height; y++)
+            {
+                if(fread(&row[0], stride, 1, file) != 1)
+                {
+                    status = ERROR_BAD_FORMAT;
+                    break;
+                }
+
+                DWORD* line = &pixels[(size_t)(topDown ? y : height - 1 - y) * width];
+
+                for(DWORD x = 0; x < width; x++)
+                {
+                    const BYTE* pixel = &row[x * pixelSize];
+                    line[x] = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16) | ((pixelSize == 4) ? (pixel[3] << 24) : 0xFF000000);
+                }
+            }
+        }
+
+        fclose(file);
+
+        if(status != ERROR_SUCCESS)
+        {
+            width   = 0;
+            height  = 0;
+            pixels.clear();
+        }
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS StereoImage::Save( _In_z_ const TCHAR* fileName ) const
+    {
+        if(pixels.empty())
+            return ERROR_INVALID_PARAMETER;
+
+        BITMAPFILEHEADER fileHeader;
+        BITMAPINFOHEADER infoHeader;
+
+        memset(&fileHeader, 0, sizeof(fileHeader));
+        memset(&infoHeader, 0, sizeof(infoHeader));
+
+        DWORD imageSize = (DWORD)(pixels.size() * sizeof(DWORD));
+
+        fileHeader.bfType       = 0x4D42;
+        fileHeader.bfOffBits    = sizeof(fileHeader) + sizeof(infoHeader);
+        fileHeader.bfSize       = fileHeader.bfOffBits + imageSize;
+
+        infoHeader.biSize       = sizeof(infoHeader);
+        infoHeader.biWidth      = (LONG)width;
+        infoHeader.biHeight     = -(LONG)height;
+        infoHeader.biPlanes     = 1;
+        infoHeader.biBitCount   = 32;
+        infoHeader.biCompression= BI_RGB;
+        infoHeader.biSizeImage  = imageSize;
+
+        FILE* file = nullptr;
+        if(_tfopen_s(&file, fileName, _T("wb")) != 0 || file == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        bool written = fwrite(&fileHeader, sizeof(fileHeader), 1, file) == 1 &&
+                       fwrite(&infoHeader, sizeof(infoHeader), 1, file) == 1 &&
+                       fwrite(&pixels[0], imageSize, 1, file) == 1;
+
+        fclose(file);
+
+        return written ? ERROR_SUCCESS : ERROR_WRITE_FAULT;
+    }
+}
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        StereoCompositor.h
+///  Description: Builds the row interleaved frame the driver shows for a pair of InterleavePattern
+///               values, from the pictures of the two eyes.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_STEREOCOMPOSITOR_H
+#define INCLUDED_STEREOCOMPOSITOR_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Enforcement
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// A 32 bit picture.
+    struct StereoImage
+    {
+        DWORD               width;
+        DWORD               height;
+        std::vector<DWORD>  pixels;         /// BGRA, width * height, the top row first.
+
+        StereoImage()
+        {
+            width   = 0;
+            height  = 0;
+        }
+
+        /// Loads a 24 or 32 bit BMP file.
+        LSTATUS Load( _In_z_ const TCHAR* fileName );
+
+        /// Saves a 32 bit top-down BMP file.
+        LSTATUS Save( _In_z_ const TCHAR* fileName ) const;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    enum class ComposeKernel
+    {
+        Auto,           /// The fastest one the CPU supports.
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Interleaves the pictures of the two eyes the way the InterleavePattern values describe it:
+    /// byte i of pattern0 is the mask of row i, byte i of pattern1 the mask of row 4 + i, repeated
+    /// every 8 rows. Every byte of an output row is (left & mask) | (right & ~mask), so 0xFF shows
+    /// the left eye and 0x00 the right one. This is the same reading as StereoAnalyzer.
+    ///
+    /// The rows are split in tiles, composed in parallel on a private thread pool kept between the
+    /// calls. Calls to Compose are serialized.
+    class StereoCompositor
+    {
+    public:
+        static const DWORD TileRows = 32;
+
+        /// threads is the most tiles composed at the same time; 0 takes the number of CPUs.
+        StereoCompositor( _In_opt_ DWORD threads = 0 );
+
+        ~StereoCompositor();
+
+        /// The two pictures must have the same size; the output takes it.
+        LSTATUS Compose( _In_    const StereoImage&  left,
+                         _In_    const StereoImage&  right,
+                         _In_    DWORD               pattern0,
+                         _In_    DWORD               pattern1,
+                         _Out_   StereoImage*        output,
+                         _In_opt_ ComposeKernel      kernel = ComposeKernel::Auto );
+
+        static bool IsSupported( _In_ ComposeKernel kernel );
+
+        static BYTE GetRowMask( _In_ DWORD row, _In_ DWORD pattern0, _In_ DWORD pattern1 )
+        {
+            DWORD pattern = ((row & 7) < 4) ? pattern0 : pattern1;
+            return (BYTE)(pattern >> ((row & 3) * 8));
+        }
+
+        DWORD GetThreads() const
+        {
+            return m_threads;
+        }
+
+    private:
+        StereoCompositor( const StereoCompositor& );
+        StereoCompositor& operator = ( const StereoCompositor& );
+
+        static void CALLBACK WorkCallback( _Inout_     PTP_CALLBACK_INSTANCE   instance,
+                                           _Inout_opt_ PVOID                   context,
+                                           _Inout_     PTP_WORK                work );
+
+        void ComposeTile( _In_ DWORD tile );
+
+        DWORD                   m_threads;
+        PTP_POOL                m_pool;
+        TP_CALLBACK_ENVIRON     m_environment;
+        PTP_WORK                m_work;
+
+        std::mutex              m_composeLock;
+
+        // The call in progress.
+        const DWORD*            m_left;
+        const DWORD*            m_right;
+        DWORD*                  m_output;
+        DWORD                   m_width;
+        DWORD                   m_height;
+        DWORD                   m_pattern0;
+        DWORD                   m_pattern1;
+        ComposeKernel           m_kernel;
+        DWORD                   m_tileCount;
+        std::atomic<DWORD>      m_nextTile;
+    };
+}
+
+#endif // INCLUDED_STEREOCOMPOSITOR_H
@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        TimerWheel.cpp
+///  Description: Hierarchical timing wheel, with constant time insertion and removal of timers.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./TimerWheel.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    TimerWheel::TimerWheel( _In_opt_ ULONGLONG now )
+    {
+        m_current   = now;
+        m_count     = 0;
+
+        for(DWORD level = 0; level < Levels; level++)
+        {
+            for(DWORD slot = 0; slot < Slots; slot++)
+            {
+                m_slots[level][slot].next = &m_slots[level][slot];
+                m_slots[level][slot].prev = &m_slots[level][slot];
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TimerWheel::Insert( _Inout_ TimerNode* node, _In_ ULONGLONG expiry )
+    {
+        // The slot of the current tick was already run.
+        node->expiry = (expiry > m_current) ? expiry : m_current + 1;
+
+        Place(node);
+        m_count++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TimerWheel::Remove( _Inout_ TimerNode* node )
+    {
+        if(!node->IsLinked())
+            return;
+
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->next       = nullptr;
+        node->prev       = nullptr;
+
+        m_count--;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TimerWheel::Place( _Inout_ TimerNode* node )
+    {
+        ULONGLONG expiry = node->expiry;
+        ULONGLONG delta  = (expiry > m_current) ? expiry - m_current : 0;
+
+        DWORD level = 0;
+        while(level < Levels - 1 && delta >= (1ULL << (SlotBits * (level + 1))))
+            level++;
+
+        // Too far for the last wheel: parked in its slot that turns last, and placed again from there.
+        if(delta >= (1ULL << (SlotBits * Levels)))
+            expiry = m_current + (1ULL << (SlotBits * Levels)) - 1;
+
+        TimerNode* head = &m_slots[level][(expiry >> (SlotBits * level)) & (Slots - 1)];
+
+        node->next       = head;
+        node->prev       = head->prev;
+        head->prev->next = node;
+        head->prev       = node;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TimerWheel::Cascade( _In_ DWORD level, _In_ DWORD slot )
+    {
+        TimerNode* head = &m_slots[level][slot];
+        TimerNode* node = head->next;
+
+        head->next = head;
+        head->prev = head;
+
+        while(node != head)
+        {
+            TimerNode* next = node->next;
+            Place(node);
+            node = next;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    ULONGLONG TimerWheel::GetNextTick() const
+    {
+        if(m_count == 0)
+            return ULLONG_MAX;
+
+        ULONGLONG next = ULLONG_MAX;
+
+        // The first wheel holds one tick per slot; the ones above only matter when they turn.
+        for(DWORD level = 0; level < Levels; level++)
+        {
+            DWORD     shift = SlotBits * level;
+            ULONGLONG turn  = m_current >> shift;
+
+            for(DWORD i = 1; i <= Slots; i++)
+            {
+                const TimerNode* head = &m_slots[level][(turn + i) & (Slots - 1)];
+                if(head->next == head)
+                    continue;
+
+                ULONGLONG tick = (turn + i) << shift;
+                if(tick < next)
+                    next = tick;
+                break;
+            }
+        }
+
+        return next;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void TimerWheel::Advance( _In_ ULONGLONG now, _Inout_ std::vector<TimerNode*>& due )
+    {
+        while(m_current < now)
+        {
+            // Nothing to run on the way.
+            if(m_count == 0)
+            {
+                m_current = now;
+                break;
+            }
+
+            m_current++;
+
+            // When a wheel completes a turn, the next slot of the one above comes down, before the
+            // slot of this tick is run; its timers due now land in that slot.
+            for(DWORD level = 1; level < Levels; level++)
+            {
+                if((m_current & ((1ULL << (SlotBits * level)) - 1)) != 0)
+                    break;
+
+                Cascade(level, (m_current >> (SlotBits * level)) & (Slots - 1));
+            }
+
+            TimerNode* head = &m_slots[0][m_current & (Slots - 1)];
+            while(head->next != head)
+            {
+                TimerNode* node = head->next;
+                Remove(node);
+                due.push_back(node);
+            }
+        }
+    }
+}
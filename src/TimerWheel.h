@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        TimerWheel.h
+///  Description: Hierarchical timing wheel, with constant time insertion and removal of timers.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_TIMERWHEEL_H
+#define INCLUDED_TIMERWHEEL_H
+
+#include <windows.h>
+#include <limits.h>
+#include <vector>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// A timer in a TimerWheel; the owner embeds it (or derives from it) and keeps it alive while it is
+    /// in the wheel.
+    struct TimerNode
+    {
+        TimerNode*  next;
+        TimerNode*  prev;
+        ULONGLONG   expiry;     /// Tick the timer is due at.
+
+        TimerNode()
+        {
+            next    = nullptr;
+            prev    = nullptr;
+            expiry  = 0;
+        }
+
+        bool IsLinked() const
+        {
+            return next != nullptr;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Four wheels of 64 slots: the first holds the timers due in the next 64 ticks, one slot per tick,
+    /// and every next one covers 64 times more, one slot per turn of the previous wheel. A timer goes
+    /// in a slot by its expiry with a few shifts, and is removed by unlinking it, so both are constant
+    /// time whatever the number of timers. When a wheel turns, the next slot of the wheel above is
+    /// spread over the wheel below. Timers beyond 2^24 ticks wait in the last wheel and are spread
+    /// again until they are due.
+    ///
+    /// The wheel has no lock and no thread; its owner serializes the calls.
+    class TimerWheel
+    {
+    public:
+        static const DWORD SlotBits = 6;
+        static const DWORD Slots    = 1 << SlotBits;
+        static const DWORD Levels   = 4;
+
+        explicit TimerWheel( _In_opt_ ULONGLONG now = 0 );
+
+        /// Adds a timer; one due at or before the current tick is due at the next one.
+        void Insert( _Inout_ TimerNode* node, _In_ ULONGLONG expiry );
+
+        void Remove( _Inout_ TimerNode* node );
+
+        /// Moves the wheel to now, one tick at a time, and appends the timers that became due to due,
+        /// in the order of their ticks. They are out of the wheel when it returns.
+        void Advance( _In_ ULONGLONG now, _Inout_ std::vector<TimerNode*>& due );
+
+        /// The first tick Advance has something to do at: a timer due, or a slot of a wheel above the
+        /// first to spread. No timer is due before it. ULLONG_MAX when the wheel is empty.
+        ULONGLONG GetNextTick() const;
+
+        ULONGLONG GetCurrent() const
+        {
+            return m_current;
+        }
+
+        size_t GetCount() const
+        {
+            return m_count;
+        }
+
+    private:
+        TimerWheel( const TimerWheel& );
+        TimerWheel& operator = ( const TimerWheel& );
+
+        /// Links a timer in the slot of its expiry, seen from the current tick.
+        void Place( _Inout_ TimerNode* node );
+
+        /// Spreads one slot of a wheel over the wheels below it.
+        void Cascade( _In_ DWORD level, _In_ DWORD slot );
+
+        TimerNode   m_slots[Levels][Slots];     /// Heads of circular lists.
+        ULONGLONG   m_current;
+        size_t      m_count;
+    };
+}
+
+#endif // INCLUDED_TIMERWHEEL_H
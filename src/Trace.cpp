@@ -0,0 +1,294 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Trace.cpp
+///  Description: Always-on binary trace of the registry operations.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Trace.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Registry
+{
+    typedef std::basic_string<TCHAR> TraceString;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Layout of the trace file: header, paths (id, main key, length, characters), events.
+    struct TraceFileHeader
+    {
+        static const DWORD  Magic   = 0x43525452;   // "RTRC"
+        static const DWORD  Version = 1;
+
+        DWORD               magic;
+        DWORD               version;
+        unsigned long long  tscFrequency;
+        unsigned long long  tscAtDump;
+        FILETIME            timeAtDump;
+        DWORD               pathCount;
+        DWORD               eventCount;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    volatile bool                   Trace::m_enabled    = true;
+    std::atomic<TraceRing*>         Trace::m_rings(nullptr);
+    __declspec(thread) TraceRing*   Trace::m_threadRing = nullptr;
+
+    static std::mutex                                   traceRingsLock;
+    static std::mutex                                   tracePathsLock;
+    static std::map<std::pair<int, TraceString>, DWORD> tracePaths;
+
+    static const TCHAR* const traceMainKeys[] =
+    {
+        _T("HKCR"), _T("HKCU"), _T("HKLM"), _T("HKU"), _T("HKPD"),
+        _T("HKCC"), _T("HKPT"), _T("HKPN"), _T("HKDD"), _T("HKCULS")
+    };
+
+    static const TCHAR* const traceOps[] =
+    {
+        _T("None"), _T("Open"), _T("Create"), _T("Close"), _T("Delete"), _T("GetValue"), _T("SetValue"),
+        _T("DeleteValue"), _T("EnumValues"), _T("EnumSubKeys"), _T("Notify"), _T("NotifyCallback"), _T("Flush"),
+        _T("Poll"), _T("GetValues"), _T("Reopen")
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    TraceRing* Trace::CreateRing()
+    {
+        std::lock_guard<std::mutex> lock(traceRingsLock);
+
+        HANDLE ownerThread = OpenThread(SYNCHRONIZE, FALSE, GetCurrentThreadId());
+
+        // A ring of an ended thread is taken over. Its head goes on from where it was, so Dump can't
+        // mistake the new events for the old ones, which are kept until they are overwritten.
+        for(TraceRing* ring = m_rings.load(); ring != nullptr; ring = ring->next)
+        {
+            if(ring->ownerThread == nullptr || WaitForSingleObject(ring->ownerThread, 0) != WAIT_OBJECT_0)
+                continue;
+
+            CloseHandle(ring->ownerThread);
+            ring->ownerThread   = ownerThread;
+            ring->threadId      = GetCurrentThreadId();
+
+            m_threadRing = ring;
+
+            return ring;
+        }
+
+        TraceRing* ring = new (std::nothrow) TraceRing;
+        if(ring == nullptr)
+        {
+            if(ownerThread != nullptr)
+                CloseHandle(ownerThread);
+            return nullptr;
+        }
+
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->threadId      = GetCurrentThreadId();
+        ring->ownerThread   = ownerThread;
+        memset(ring->events, 0, sizeof(ring->events));
+
+        // Rings are never freed, so the list only grows and can be walked without a lock.
+        TraceRing* head = m_rings.load();
+        do
+        {
+            ring->next = head;
+        } while(!m_rings.compare_exchange_weak(head, ring));
+
+        m_threadRing = ring;
+
+        return ring;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    DWORD Trace::RegisterPath( _In_     int             mainKey,
+                               _In_z_   const TCHAR*    subKeyPath )
+    {
+        std::lock_guard<std::mutex> lock(tracePathsLock);
+
+        std::pair<int, TraceString> path(mainKey, subKeyPath);
+
+        auto it = tracePaths.find(path);
+        if(it != tracePaths.end())
+            return it->second;
+
+        DWORD id = (DWORD)tracePaths.size() + 1;
+        tracePaths[path] = id;
+
+        return id;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Trace::Dump( _In_z_ const TCHAR* fileName )
+    {
+        // Calibrate the time stamp counter against the performance counter.
+        LARGE_INTEGER qpcFrequency, qpcStart, qpcEnd;
+        QueryPerformanceFrequency(&qpcFrequency);
+        QueryPerformanceCounter(&qpcStart);
+        unsigned long long tscStart = __rdtsc();
+        Sleep(20);
+        QueryPerformanceCounter(&qpcEnd);
+        unsigned long long tscEnd = __rdtsc();
+
+        TraceFileHeader header;
+        header.magic        = TraceFileHeader::Magic;
+        header.version      = TraceFileHeader::Version;
+        header.tscFrequency = (unsigned long long)((double)(tscEnd - tscStart) * qpcFrequency.QuadPart / (double)(qpcEnd.QuadPart - qpcStart.QuadPart));
+        header.tscAtDump    = tscEnd;
+        GetSystemTimeAsFileTime(&header.timeAtDump);
+
+        // Copy the events first, so the file is written without racing with the recording threads.
+        std::vector<TraceEvent> events;
+        for(TraceRing* ring = m_rings.load(); ring != nullptr; ring = ring->next)
+        {
+            DWORD head  = ring->head.load(std::memory_order_acquire);
+            DWORD count = (head < TraceRing::Capacity) ? head : TraceRing::Capacity;
+            size_t first = events.size();
+
+            for(DWORD index = head - count; index != head; index++)
+            {
+                TraceEvent event = ring->events[index & (TraceRing::Capacity - 1)];
+                if(event.sequence == index)
+                    events.push_back(event);
+            }
+
+            // The owner thread kept recording meanwhile: a slot it was writing while it was copied is
+            // the one of an event at least Capacity older than the new head, so those are dropped.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            DWORD newHead = ring->head.load(std::memory_order_relaxed);
+
+            events.erase( std::remove_if( events.begin() + first, events.end(), [newHead] (const TraceEvent& event)
+                              {
+                                  return newHead - event.sequence >= TraceRing::Capacity;
+                              }
+                          ),
+                          events.end() );
+        }
+
+        std::vector<std::pair<std::pair<int, TraceString>, DWORD>> paths;
+        {
+            std::lock_guard<std::mutex> lock(tracePathsLock);
+            paths.assign(tracePaths.begin(), tracePaths.end());
+        }
+
+        header.pathCount    = (DWORD)paths.size();
+        header.eventCount   = (DWORD)events.size();
+
+        FILE* file = nullptr;
+        if(_tfopen_s(&file, fileName, _T("wb")) != 0 || file == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        fwrite(&header, sizeof(header), 1, file);
+
+        for(auto& path : paths)
+        {
+            DWORD record[3] = { path.second, (DWORD)path.first.first, (DWORD)path.first.second.size() };
+            fwrite(record, sizeof(record), 1, file);
+            fwrite(path.first.second.c_str(), sizeof(TCHAR), path.first.second.size(), file);
+        }
+
+        if(!events.empty())
+            fwrite(&events[0], sizeof(TraceEvent), events.size(), file);
+
+        bool failed = (ferror(file) != 0);
+        fclose(file);
+
+        return failed ? ERROR_WRITE_FAULT : ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS Trace::Decode( _In_z_ const TCHAR* traceFileName,
+                           _In_z_ const TCHAR* timelineFileName )
+    {
+        FILE* file = nullptr;
+        if(_tfopen_s(&file, traceFileName, _T("rb")) != 0 || file == nullptr)
+            return ERROR_FILE_NOT_FOUND;
+
+        TraceFileHeader header;
+        if( fread(&header, sizeof(header), 1, file) != 1 ||
+            header.magic != TraceFileHeader::Magic ||
+            header.version != TraceFileHeader::Version )
+        {
+            fclose(file);
+            return ERROR_BAD_FORMAT;
+        }
+
+        std::map<DWORD, TraceString> paths;
+        for(DWORD i = 0; i < header.pathCount; i++)
+        {
+            DWORD record[3];
+            if(fread(record, sizeof(record), 1, file) != 1 || record[2] > 32767)
+            {
+                fclose(file);
+                return ERROR_BAD_FORMAT;
+            }
+
+            TraceString path(record[2], 0);
+            if(record[2] != 0 && fread(&path[0], sizeof(TCHAR), record[2], file) != record[2])
+            {
+                fclose(file);
+                return ERROR_BAD_FORMAT;
+            }
+
+            const TCHAR* mainKey = (record[1] < _countof(traceMainKeys)) ? traceMainKeys[record[1]] : _T("?");
+            paths[record[0]] = TraceString(mainKey) + _T("\\") + path;
+        }
+
+        std::vector<TraceEvent> events(header.eventCount);
+        if(header.eventCount != 0 && fread(&events[0], sizeof(TraceEvent), header.eventCount, file) != header.eventCount)
+        {
+            fclose(file);
+            return ERROR_BAD_FORMAT;
+        }
+
+        fclose(file);
+
+        std::stable_sort(events.begin(), events.end(), [] (const TraceEvent& a, const TraceEvent& b)
+            {
+                return a.timestamp < b.timestamp;
+            }
+        );
+
+        if(_tfopen_s(&file, timelineFileName, _T("w, ccs=UTF-8")) != 0 || file == nullptr)
+            return ERROR_ACCESS_DENIED;
+
+        SYSTEMTIME dumpTime;
+        FileTimeToSystemTime(&header.timeAtDump, &dumpTime);
+        _ftprintf(file, _T("Trace dumped at %04u-%02u-%02u %02u:%02u:%02u UTC, %u events, times in ms before the dump.\n\n"),
+                  dumpTime.wYear, dumpTime.wMonth, dumpTime.wDay, dumpTime.wHour, dumpTime.wMinute, dumpTime.wSecond,
+                  header.eventCount);
+
+        double msPerTick = (header.tscFrequency != 0) ? 1000.0 / (double)header.tscFrequency : 0.0;
+
+        for(auto& event : events)
+        {
+            double       time   = -(double)(long long)(header.tscAtDump - event.timestamp) * msPerTick;
+            const TCHAR* op     = (event.op < _countof(traceOps)) ? traceOps[event.op] : _T("?");
+            auto         path   = paths.find(event.keyPathId);
+
+            _ftprintf(file, _T("%14.4f  thread %6u  %-14s  status %6d  value %08X  %s\n"),
+                      time, event.threadId, op, event.status, event.valueNameHash,
+                      (path != paths.end()) ? path->second.c_str() : _T("-"));
+        }
+
+        bool failed = (ferror(file) != 0);
+        fclose(file);
+
+        return failed ? ERROR_WRITE_FAULT : ERROR_SUCCESS;
+    }
+}
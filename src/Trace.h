@@ -0,0 +1,160 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Trace.h
+///  Description: Always-on binary trace of the registry operations.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_TRACE_H
+#define INCLUDED_TRACE_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <intrin.h>
+#include <atomic>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// The traced registry operations.
+    enum class TraceOp : WORD
+    {
+        None            = 0,
+        Open            = 1,
+        Create          = 2,
+        Close           = 3,
+        Delete          = 4,
+        GetValue        = 5,
+        SetValue        = 6,
+        DeleteValue     = 7,
+        EnumValues      = 8,
+        EnumSubKeys     = 9,
+        Notify          = 10,   /// A change notification was received.
+        NotifyCallback  = 11,   /// The notify callback returned; status is 0 when it asked to stop.
+        Flush           = 12,
+        Poll            = 13,   /// The key was polled; status is 1 when it had changed.
+        GetValues       = 14,   /// Several values were read at once.
+        Reopen          = 15    /// The key was opened again and its handle replaced.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// One fixed-size trace record (32 bytes).
+    struct TraceEvent
+    {
+        unsigned long long  timestamp;      /// CPU time stamp counter.
+        DWORD               threadId;
+        WORD                op;             /// TraceOp
+        WORD                reserved;
+        DWORD               keyPathId;      /// Id of the key path, see Trace::RegisterPath.
+        DWORD               valueNameHash;  /// Trace::HashName of the value name, 0 if none.
+        LONG                status;
+        DWORD               sequence;       /// Index of the event in its ring, used to drop stale records on dump.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Per-thread trace ring. Only its owner thread writes, so recording needs no lock or interlocked op.
+    /// Once the owner ended, the ring is given to the next thread that records, events included.
+    struct TraceRing
+    {
+        static const DWORD      Capacity = 4096;    // Must be a power of 2.
+
+        std::atomic<DWORD>      head;
+        DWORD                   threadId;
+        HANDLE                  ownerThread;        /// Signaled when the owner ended; null if it could not be opened.
+        TraceRing*              next;
+        TraceEvent              events[Capacity];
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    class Trace
+    {
+    public:
+
+        /// Records an event in the ring of the calling thread.
+        static void Record( _In_     TraceOp        op,
+                            _In_     DWORD          keyPathId,
+                            _In_opt_ const TCHAR*   valueName,
+                            _In_     LSTATUS        status )
+        {
+            if(!m_enabled)
+                return;
+
+            TraceRing* ring = m_threadRing;
+            if(ring == nullptr)
+            {
+                ring = CreateRing();
+                if(ring == nullptr)
+                    return;
+            }
+
+            DWORD       index = ring->head.load(std::memory_order_relaxed);
+            TraceEvent& event = ring->events[index & (TraceRing::Capacity - 1)];
+
+            // The last head stored must be seen before the slot changes; see Trace::Dump.
+            std::atomic_thread_fence(std::memory_order_release);
+
+            event.timestamp     = __rdtsc();
+            event.threadId      = ring->threadId;
+            event.op            = (WORD)op;
+            event.reserved      = 0;
+            event.keyPathId     = keyPathId;
+            event.valueNameHash = (valueName != nullptr) ? HashName(valueName) : 0;
+            event.status        = status;
+            event.sequence      = index;
+
+            ring->head.store(index + 1, std::memory_order_release);
+        }
+
+        /// FNV-1a hash of a registry name; names are case insensitive, so ASCII letters are folded.
+        static DWORD HashName( _In_z_ const TCHAR* name )
+        {
+            DWORD hash = 2166136261u;
+            for(; *name != 0; name++)
+            {
+                TCHAR c = *name;
+                if(c >= 'A' && c <= 'Z')
+                    c += 'a' - 'A';
+
+                hash = (hash ^ (DWORD)c) * 16777619u;
+            }
+
+            return (hash != 0) ? hash : 1;
+        }
+
+        /// Returns the id of a key path, and remembers the path so the decoder can print it.
+        static DWORD RegisterPath( _In_     int             mainKey,
+                                   _In_z_   const TCHAR*    subKeyPath );
+
+        static void Enable( _In_ bool enabled )
+        {
+            m_enabled = enabled;
+        }
+
+        /// Writes the content of all rings to a binary trace file.
+        static LSTATUS Dump( _In_z_ const TCHAR* fileName );
+
+        /// Converts a binary trace file to a text timeline, ordered by time.
+        static LSTATUS Decode( _In_z_ const TCHAR* traceFileName,
+                               _In_z_ const TCHAR* timelineFileName );
+
+    private:
+        static TraceRing* CreateRing();
+
+        static volatile bool                    m_enabled;
+        static std::atomic<TraceRing*>          m_rings;
+        static __declspec(thread) TraceRing*    m_threadRing;
+    };
+}
+
+#endif // INCLUDED_TRACE_H
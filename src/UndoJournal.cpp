@@ -0,0 +1,399 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        UndoJournal.cpp
+///  Description: Write-ahead journal of the registry values overwritten by the tool, so they can be
+///               put back on exit, or on the next start after a crash.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./UndoJournal.h"
+
+#include <string>
+#include <vector>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    UndoJournal::UndoJournal()
+    {
+        m_file      = INVALID_HANDLE_VALUE;
+        m_mapping   = nullptr;
+        m_view      = nullptr;
+        m_header    = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    UndoJournal::~UndoJournal()
+    {
+        Close();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS UndoJournal::Open( _In_z_ const TCHAR* fileName )
+    {
+        Close();
+
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_file = CreateFile(fileName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(m_file == INVALID_HANDLE_VALUE)
+            return GetLastError();
+
+        // The mapping grows a new or older file to its full size, filled with zeros.
+        m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READWRITE, 0, FileSize, nullptr);
+        if(m_mapping != nullptr)
+            m_view = (BYTE*)MapViewOfFile(m_mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, FileSize);
+
+        if(m_view == nullptr)
+        {
+            LSTATUS status = GetLastError();
+
+            if(m_mapping != nullptr)
+                CloseHandle(m_mapping);
+            CloseHandle(m_file);
+
+            m_mapping   = nullptr;
+            m_file      = INVALID_HANDLE_VALUE;
+
+            return status;
+        }
+
+        m_header = (Header*)m_view;
+
+        // A file of another version, or not a journal at all, can't be trusted; start over.
+        if( m_header->magic != Magic || m_header->version != Version ||
+            (m_header->activeSlot != 0 && m_header->activeSlot != 1) ||
+            m_header->used[0] > SlotSize || m_header->used[1] > SlotSize )
+        {
+            m_header->magic         = Magic;
+            m_header->version       = Version;
+            m_header->activeSlot    = 0;
+            m_header->used[0]       = 0;
+            m_header->used[1]       = 0;
+
+            Flush(m_header, sizeof(Header));
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void UndoJournal::Close()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(m_view != nullptr)
+        {
+            FlushViewOfFile(m_view, 0);
+            UnmapViewOfFile(m_view);
+        }
+
+        if(m_mapping != nullptr)
+            CloseHandle(m_mapping);
+
+        if(m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+
+        m_file      = INVALID_HANDLE_VALUE;
+        m_mapping   = nullptr;
+        m_view      = nullptr;
+        m_header    = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS UndoJournal::Record( _In_ const Key& key, _In_z_ const TCHAR* valueName )
+    {
+        if(m_header == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        void*       data        = nullptr;
+        DWORD       dataSize    = 0;
+        DataType    type        = DataType::None;
+
+        LSTATUS status = key.GetValue(valueName, &data, &dataSize, &type);
+        if(status != ERROR_SUCCESS && status != ERROR_FILE_NOT_FOUND)
+            return status;
+
+        bool    missing         = status == ERROR_FILE_NOT_FOUND;
+        size_t  keyPathLength   = _tcslen(key.GetSubKeyPath());
+        size_t  valueNameLength = _tcslen(valueName);
+
+        if(missing)
+            dataSize = 0;
+
+        DWORD size = (DWORD)(sizeof(RecordHeader) + (keyPathLength + valueNameLength) * sizeof(TCHAR) + dataSize);
+        size = (size + 3) & ~3;
+
+        status = ERROR_SUCCESS;
+
+        if(keyPathLength > MAXWORD || valueNameLength > MAXWORD || size > SlotSize)
+            status = ERROR_INVALID_PARAMETER;
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            LONG slot = m_header->activeSlot;
+
+            if(m_header->used[slot] + size > SlotSize)
+            {
+                // Only the oldest record of every value is needed; drop the others.
+                if(Compact())
+                    slot = m_header->activeSlot;
+            }
+
+            if(m_header->used[slot] + size > SlotSize)
+                status = ERROR_DISK_FULL;
+            else
+            {
+                RecordHeader* record = (RecordHeader*)(GetSlot(slot) + m_header->used[slot]);
+
+                record->size            = size;
+                record->mainKey         = (WORD)key.GetMainKey();
+                record->keyPathLength   = (WORD)keyPathLength;
+                record->valueNameLength = (WORD)valueNameLength;
+                record->reserved        = 0;
+                record->type            = missing ? MissingValue : (DWORD)type;
+                record->dataSize        = dataSize;
+
+                memcpy((void*)GetKeyPath(*record), key.GetSubKeyPath(), keyPathLength * sizeof(TCHAR));
+                memcpy((void*)GetValueName(*record), valueName, valueNameLength * sizeof(TCHAR));
+                if(dataSize != 0)
+                    memcpy((void*)GetData(*record), data, dataSize);
+
+                // The record first, then the size that makes it count.
+                Flush(record, size);
+
+                m_header->used[slot] += size;
+                Flush(m_header, sizeof(Header));
+            }
+        }
+
+        delete [] (BYTE*)data;
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS UndoJournal::Restore( _Out_opt_ DWORD* written )
+    {
+        if(written != nullptr)
+            *written = 0;
+
+        if(m_header == nullptr)
+            return ERROR_INVALID_HANDLE;
+
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(m_header->used[m_header->activeSlot] == 0)
+            return ERROR_SUCCESS;
+
+        LSTATUS                             result = ERROR_SUCCESS;
+        std::vector<const RecordHeader*>    failed;
+
+        ForEachOldest( [&] (const RecordHeader& record) -> bool
+            {
+                bool    valueWritten = false;
+                LSTATUS status       = RestoreRecord(record, &valueWritten);
+
+                if(valueWritten && written != nullptr)
+                    (*written)++;
+
+                if(status != ERROR_SUCCESS)
+                {
+                    if(result == ERROR_SUCCESS)
+                        result = status;
+
+                    failed.push_back(&record);
+                }
+
+                return true;
+            }
+        );
+
+        LONG  slot  = m_header->activeSlot;
+        LONG  other = slot ^ 1;
+        DWORD used  = 0;
+
+        // The records that failed go to the other slot, which becomes the active one.
+        for(size_t i = 0; i < failed.size(); i++)
+        {
+            memcpy(GetSlot(other) + used, failed[i], failed[i]->size);
+            used += failed[i]->size;
+        }
+
+        Flush(GetSlot(other), used);
+
+        m_header->used[other] = used;
+        Flush(m_header, sizeof(Header));
+
+        m_header->activeSlot  = other;
+        Flush(m_header, sizeof(Header));
+
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    DWORD UndoJournal::GetRecordCount() const
+    {
+        if(m_header == nullptr)
+            return 0;
+
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        LONG  slot  = m_header->activeSlot;
+        DWORD count = 0;
+
+        for(DWORD offset = 0; offset < m_header->used[slot]; count++)
+        {
+            const RecordHeader* record = (const RecordHeader*)(GetSlot(slot) + offset);
+            if(record->size < sizeof(RecordHeader))
+                break;
+
+            offset += record->size;
+        }
+
+        return count;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void UndoJournal::ForEachOldest( _In_ const std::function <bool (_In_ const RecordHeader&)>& callBack ) const
+    {
+        LONG                                slot = m_header->activeSlot;
+        std::vector<const RecordHeader*>    records;
+
+        for(DWORD offset = 0; offset < m_header->used[slot]; )
+        {
+            const RecordHeader* record = (const RecordHeader*)(GetSlot(slot) + offset);
+            if(record->size < sizeof(RecordHeader) || offset + record->size > m_header->used[slot])
+                break;
+
+            offset += record->size;
+
+            // A value has only a few records before they are compacted, so a plain search will do.
+            bool isOldest = true;
+            for(size_t i = 0; i < records.size() && isOldest; i++)
+                isOldest = !IsSameValue(*records[i], *record);
+
+            if(!isOldest)
+                continue;
+
+            records.push_back(record);
+
+            if(!callBack(*record))
+                break;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool UndoJournal::IsSameValue( _In_ const RecordHeader& a, _In_ const RecordHeader& b )
+    {
+        return a.mainKey         == b.mainKey         &&
+               a.keyPathLength   == b.keyPathLength   &&
+               a.valueNameLength == b.valueNameLength &&
+               _tcsnicmp(GetKeyPath(a),   GetKeyPath(b),   a.keyPathLength)   == 0 &&
+               _tcsnicmp(GetValueName(a), GetValueName(b), a.valueNameLength) == 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool UndoJournal::Compact()
+    {
+        LONG  slot  = m_header->activeSlot;
+        LONG  other = slot ^ 1;
+        DWORD used  = 0;
+
+        ForEachOldest( [&] (const RecordHeader& record) -> bool
+            {
+                memcpy(GetSlot(other) + used, &record, record.size);
+                used += record.size;
+                return true;
+            }
+        );
+
+        if(used == m_header->used[slot])
+            return false;
+
+        Flush(GetSlot(other), used);
+
+        m_header->used[other] = used;
+        Flush(m_header, sizeof(Header));
+
+        // The switch is a single aligned write; before it the old slot is still the valid one.
+        m_header->activeSlot  = other;
+        Flush(m_header, sizeof(Header));
+
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS UndoJournal::RestoreRecord( _In_ const RecordHeader& record, _Out_ bool* written )
+    {
+        *written = false;
+
+        std::basic_string<TCHAR> keyPath(GetKeyPath(record), record.keyPathLength);
+        std::basic_string<TCHAR> valueName(GetValueName(record), record.valueNameLength);
+
+        LSTATUS status = ERROR_SUCCESS;
+        Key*    key    = Key::Open( (PredefinedKey)record.mainKey,
+                                    keyPath.c_str(),
+                                    AccessRights::Query_Value | AccessRights::Set_Value,
+                                    &status );
+
+        if(key == nullptr)
+        {
+            // Nothing to remove from a key that is gone.
+            return (record.type == MissingValue && status == ERROR_FILE_NOT_FOUND) ? ERROR_SUCCESS : status;
+        }
+
+        void*       data        = nullptr;
+        DWORD       dataSize    = 0;
+        DataType    type        = DataType::None;
+
+        status = key->GetValue(valueName.c_str(), &data, &dataSize, &type);
+
+        if(record.type == MissingValue)
+        {
+            if(status == ERROR_SUCCESS)
+            {
+                status   = key->DeleteValue(valueName.c_str());
+                *written = status == ERROR_SUCCESS;
+            }
+            else if(status == ERROR_FILE_NOT_FOUND)
+                status = ERROR_SUCCESS;
+        }
+        else if( status == ERROR_SUCCESS && (DWORD)type == record.type && dataSize == record.dataSize &&
+                 memcmp(data, GetData(record), dataSize) == 0 )
+        {
+            // Already as it was.
+        }
+        else if(status == ERROR_SUCCESS || status == ERROR_FILE_NOT_FOUND)
+        {
+            status   = key->SetValue(valueName.c_str(), GetData(record), record.dataSize, (DataType)record.type);
+            *written = status == ERROR_SUCCESS;
+        }
+
+        delete [] (BYTE*)data;
+        key->Close();
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void UndoJournal::Flush( _In_ const void* address, _In_ size_t size ) const
+    {
+        // The view is written back by the system even if the process crashes; flushing only starts
+        // the write to the disk earlier, in case the machine goes down with it.
+        if(size != 0)
+            FlushViewOfFile(address, size);
+    }
+}
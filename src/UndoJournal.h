@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        UndoJournal.h
+///  Description: Write-ahead journal of the registry values overwritten by the tool, so they can be
+///               put back on exit, or on the next start after a crash.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_UNDOJOURNAL_H
+#define INCLUDED_UNDOJOURNAL_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <functional>
+#include <mutex>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Before a value is overwritten, Record appends its current content to a memory-mapped file.
+    /// Restore replays the records backwards, which leaves every value as its oldest record has it,
+    /// so it writes each value at most once, and not at all when it already holds that content.
+    ///
+    /// The file holds a header and two slots of records. When the active slot is full, the oldest
+    /// record of every value is copied to the other slot, which then becomes the active one with a
+    /// single write of the header; a crash at any point leaves one complete slot. A record counts
+    /// only once the used size of its slot covers it, and that size is updated after the record is
+    /// written, so a crash in the middle of an append loses only a record whose value was not
+    /// written yet.
+    ///
+    /// The keys are recorded by their main key and path, so they must have been opened from a main
+    /// key, not as subkeys of another key.
+    class UndoJournal
+    {
+    public:
+        static const DWORD  Magic           = 0x4C4A5545;      // "EUJL"
+        static const DWORD  Version         = 1;
+        static const DWORD  SlotSize        = 32 * 1024;
+
+        UndoJournal();
+
+        ~UndoJournal();
+
+        /// Opens the journal file, creating it when needed. The file is not shared: no other journal
+        /// can open it until this one is closed.
+        LSTATUS Open( _In_z_ const TCHAR* fileName );
+
+        void Close();
+
+        /// Appends the current content of a value of the key, or the fact that it doesn't exist.
+        LSTATUS Record( _In_ const Key& key, _In_z_ const TCHAR* valueName );
+
+        /// Puts back the oldest recorded content of every value, then empties the journal. Records
+        /// that can't be restored are kept for the next time. written receives the number of values
+        /// written or deleted.
+        LSTATUS Restore( _Out_opt_ DWORD* written = nullptr );
+
+        DWORD GetRecordCount() const;
+
+        bool IsEmpty() const
+        {
+            return GetRecordCount() == 0;
+        }
+
+    private:
+        struct Header
+        {
+            DWORD           magic;
+            DWORD           version;
+            volatile LONG   activeSlot;
+            DWORD           used[2];            /// Bytes of records in each slot.
+        };
+
+        struct RecordHeader
+        {
+            DWORD           size;               /// The whole record, rounded up to 4 bytes.
+            WORD            mainKey;            /// PredefinedKey.
+            WORD            keyPathLength;      /// In characters, without the terminator.
+            WORD            valueNameLength;
+            WORD            reserved;
+            DWORD           type;               /// DataType, or MissingValue.
+            DWORD           dataSize;
+            // Followed by the key path, the value name and the data.
+        };
+
+        static const DWORD  MissingValue    = 0xFFFFFFFF;
+        static const DWORD  HeaderSize      = 4096;
+        static const DWORD  FileSize        = HeaderSize + 2 * SlotSize;
+
+        UndoJournal( const UndoJournal& );
+        UndoJournal& operator = ( const UndoJournal& );
+
+        BYTE*       GetSlot( _In_ LONG slot ) const
+        {
+            return m_view + HeaderSize + slot * SlotSize;
+        }
+
+        static const TCHAR* GetKeyPath( _In_ const RecordHeader& record )
+        {
+            return (const TCHAR*)(&record + 1);
+        }
+
+        static const TCHAR* GetValueName( _In_ const RecordHeader& record )
+        {
+            return GetKeyPath(record) + record.keyPathLength;
+        }
+
+        static const BYTE*  GetData( _In_ const RecordHeader& record )
+        {
+            return (const BYTE*)(GetValueName(record) + record.valueNameLength);
+        }
+
+        /// Calls callBack for the oldest record of every value in the active slot.
+        void        ForEachOldest( _In_ const std::function <bool (_In_ const RecordHeader&)>& callBack ) const;
+
+        static bool IsSameValue( _In_ const RecordHeader& a, _In_ const RecordHeader& b );
+
+        bool        Compact();
+
+        static LSTATUS RestoreRecord( _In_ const RecordHeader& record, _Out_ bool* written );
+
+        void        Flush( _In_ const void* address, _In_ size_t size ) const;
+
+        HANDLE              m_file;
+        HANDLE              m_mapping;
+        BYTE*               m_view;
+        Header*             m_header;
+        mutable std::mutex  m_lock;
+    };
+}
+
+#endif // INCLUDED_UNDOJOURNAL_H
@@ -0,0 +1,325 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        WriteBehind.cpp
+///  Description: Queues the writes to a registry key, merges them and makes them in batches.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./WriteBehind.h"
+
+#include <chrono>
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    WriteBehind::WriteBehind( _In_     Key*        key,
+                              _In_opt_ DWORD       windowMs,
+                              _In_opt_ Durability  durability,
+                              _In_opt_ DWORD       idleMs )
+    {
+        m_key           = key;
+        m_windowMs      = windowMs;
+        m_idleMs        = idleMs;
+        m_durability    = durability;
+        m_batchStart    = 0;
+        m_batchWrites   = 0;
+        m_unflushed     = 0;
+        m_drainsAsked   = 0;
+        m_drainsDone    = 0;
+        m_status        = ERROR_SUCCESS;
+        m_shouldStop    = false;
+
+        memset(&m_stats, 0, sizeof(m_stats));
+
+        m_worker        = new std::thread(&WriteBehind::Worker, this);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    WriteBehind::~WriteBehind()
+    {
+        Drain();
+
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_shouldStop = true;
+        }
+        m_queued.notify_all();
+
+        m_worker->join();
+        delete m_worker;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS WriteBehind::Write( _In_z_                     const TCHAR*    valueName,
+                                _In_reads_bytes_(dataSize) const void*     data,
+                                _In_                       DWORD           dataSize,
+                                _In_                       DataType        dataType )
+    {
+        if(valueName == nullptr || (data == nullptr && dataSize != 0))
+            return ERROR_INVALID_PARAMETER;
+
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(m_shouldStop)
+            return ERROR_INVALID_HANDLE;
+
+        const BYTE* bytes = (const BYTE*)data;
+        bool        first = m_pending.empty();
+
+        auto found = m_pendingIndex.find(valueName);
+        if(found != m_pendingIndex.end())
+        {
+            // Only the last data of a value is written.
+            PendingWrite& write = m_pending[found->second];
+            write.type = dataType;
+            write.data.assign(bytes, bytes + dataSize);
+
+            m_stats.writesCoalesced++;
+            Metrics::Increment(Counter::WritesCoalesced);
+        }
+        else
+        {
+            PendingWrite write;
+            write.valueName = valueName;
+            write.type      = dataType;
+            write.data.assign(bytes, bytes + dataSize);
+
+            m_pendingIndex[write.valueName] = m_pending.size();
+            m_pending.push_back(std::move(write));
+        }
+
+        m_stats.writesQueued++;
+        m_batchWrites++;
+
+        if(first)
+        {
+            m_batchStart = GetTickCount64();
+            m_queued.notify_one();
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS WriteBehind::Drain()
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        DWORD drain = ++m_drainsAsked;
+        m_queued.notify_one();
+
+        m_drained.wait(lock, [this, drain] () { return (LONG)(m_drainsDone - drain) >= 0; });
+
+        LSTATUS status = m_status;
+        m_status = ERROR_SUCCESS;
+
+        return status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void WriteBehind::SetDurability( _In_ Durability durability )
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_durability = durability;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Durability WriteBehind::GetDurability()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_durability;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    size_t WriteBehind::GetPending()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_pending.size();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    WriteBehindStats WriteBehind::GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_stats;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void WriteBehind::Worker()
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        auto woken = [this] () { return !m_pending.empty() || m_drainsDone != m_drainsAsked || m_shouldStop; };
+
+        for(;;)
+        {
+            if(m_pending.empty())
+            {
+                bool idle = false;
+
+                if(m_drainsDone == m_drainsAsked)
+                {
+                    if(m_shouldStop)
+                        break;
+
+                    if(m_unflushed == 0 || m_durability != Durability::OnIdle)
+                    {
+                        m_queued.wait(lock, woken);
+                        continue;
+                    }
+
+                    // A write or a Drain within the idle time delays the flush.
+                    if(m_queued.wait_for(lock, std::chrono::milliseconds(m_idleMs), woken))
+                        continue;
+
+                    idle = true;
+                }
+
+                // Idle, or a Drain found nothing left to write: flush the batches kept by OnIdle.
+                DWORD drains = m_drainsAsked;
+
+                if(m_durability != Durability::None)
+                    FlushUnflushed(lock);
+
+                if(!idle)
+                {
+                    m_drainsDone = drains;
+                    m_drained.notify_all();
+                }
+                continue;
+            }
+
+            // The writes wait for the end of the window, unless a Drain or the stop want them now.
+            ULONGLONG elapsed = GetTickCount64() - m_batchStart;
+            if(elapsed < m_windowMs && m_drainsDone == m_drainsAsked && !m_shouldStop)
+            {
+                m_queued.wait_for( lock,
+                                   std::chrono::milliseconds(m_windowMs - elapsed),
+                                   [this] () { return m_drainsDone != m_drainsAsked || m_shouldStop; } );
+            }
+
+            std::vector<PendingWrite> batch;
+            batch.swap(m_pending);
+            m_pendingIndex.clear();
+
+            Durability  durability  = m_durability;
+            DWORD       queued      = m_batchWrites;
+            DWORD       drains      = m_drainsAsked;
+
+            m_batchWrites   = 0;
+
+            lock.unlock();
+
+            WriteBehindStats made;
+            memset(&made, 0, sizeof(made));
+
+            LSTATUS status = WriteBatch(batch, durability, made);
+
+            lock.lock();
+
+            m_stats.batches++;
+            m_stats.writesMade      += made.writesMade;
+            m_stats.writeErrors     += made.writeErrors;
+            m_stats.flushesMade     += made.flushesMade;
+            m_stats.flushesAsked    += (durability == Durability::PerWrite) ? queued :
+                                       (durability == Durability::None)     ? 0 : 1;
+
+            // Every write queued asked for a flush, but the replaced ones were not made.
+            if(durability == Durability::PerWrite)
+                Metrics::Increment(Counter::FlushesCoalesced, queued - (DWORD)batch.size());
+
+            if(durability == Durability::OnIdle)
+                m_unflushed++;
+
+            if(status != ERROR_SUCCESS && m_status == ERROR_SUCCESS)
+                m_status = status;
+
+            // The Drain calls made before the batch was taken are answered once it is flushed too.
+            if(drains != m_drainsDone)
+            {
+                if(durability != Durability::None)
+                    FlushUnflushed(lock);
+
+                m_drainsDone = drains;
+                m_drained.notify_all();
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void WriteBehind::FlushUnflushed( _Inout_ std::unique_lock<std::mutex>& lock )
+    {
+        if(m_unflushed == 0)
+            return;
+
+        // One flush writes every batch made since the last one.
+        DWORD batches = m_unflushed;
+        m_unflushed = 0;
+
+        lock.unlock();
+        LSTATUS status = m_key->Flush();
+        lock.lock();
+
+        m_stats.flushesMade++;
+        Metrics::Increment(Counter::FlushesCoalesced, batches - 1);
+
+        if(status != ERROR_SUCCESS && m_status == ERROR_SUCCESS)
+            m_status = status;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    LSTATUS WriteBehind::WriteBatch( _In_    const std::vector<PendingWrite>&    batch,
+                                     _In_    Durability                          durability,
+                                     _Inout_ WriteBehindStats&                   made )
+    {
+        LSTATUS result = ERROR_SUCCESS;
+
+        for(const PendingWrite& write : batch)
+        {
+            LSTATUS status = m_key->SetValue( write.valueName.c_str(),
+                                              write.data.empty() ? nullptr : &write.data[0],
+                                              (DWORD)write.data.size(),
+                                              write.type );
+
+            if(status == ERROR_SUCCESS)
+            {
+                made.writesMade++;
+
+                if(durability == Durability::PerWrite)
+                {
+                    status = m_key->Flush();
+                    made.flushesMade++;
+                }
+            }
+            else
+            {
+                made.writeErrors++;
+            }
+
+            if(status != ERROR_SUCCESS && result == ERROR_SUCCESS)
+                result = status;
+        }
+
+        if(durability == Durability::PerBatch && made.writesMade != 0)
+        {
+            LSTATUS status = m_key->Flush();
+            made.flushesMade++;
+
+            if(status != ERROR_SUCCESS && result == ERROR_SUCCESS)
+                result = status;
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        WriteBehind.h
+///  Description: Queues the writes to a registry key, merges them and makes them in batches.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_WRITEBEHIND_H
+#define INCLUDED_WRITEBEHIND_H
+
+#include <windows.h>
+#include <tchar.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./Registry.h"
+
+namespace Registry
+{
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// When the writes of a WriteBehind queue are flushed to disk with RegFlushKey, which writes the
+    /// whole hive and can take tens of ms.
+    enum class Durability
+    {
+        None,           /// Never; the system writes the hive by itself within a few seconds.
+        OnIdle,         /// Once no write was queued for the idle time, and by Drain.
+        PerBatch,       /// After every batch of writes.
+        PerWrite        /// After every value written.
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    struct WriteBehindStats
+    {
+        LONG64      writesQueued;
+        LONG64      writesCoalesced;    /// Queued writes replaced by a later one to the same value.
+        LONG64      writesMade;
+        LONG64      writeErrors;
+        LONG64      batches;
+        LONG64      flushesAsked;       /// One per write for PerWrite, else one per batch.
+        LONG64      flushesMade;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Makes the writes to a key on a private thread. A batch starts with the first write queued and
+    /// is written windowMs later: a value written again meanwhile, from any thread, is written once
+    /// with its last data, and the values are written in the order they were first queued. The
+    /// durability decides how many of the batches are flushed.
+    ///
+    /// The writes that fail are counted, and the first one is returned by the next Drain.
+    class WriteBehind
+    {
+    public:
+
+        /// The key must stay open while the queue exists.
+        WriteBehind( _In_     Key*        key,
+                     _In_opt_ DWORD       windowMs    = 20,
+                     _In_opt_ Durability  durability  = Durability::OnIdle,
+                     _In_opt_ DWORD       idleMs      = 1000 );
+
+        /// Makes the queued writes, as Drain does.
+        ~WriteBehind();
+
+        LSTATUS Write( _In_z_                   const TCHAR*    valueName,
+                       _In_reads_bytes_(dataSize) const void*   data,
+                       _In_                     DWORD           dataSize,
+                       _In_                     DataType        dataType );
+
+        LSTATUS WriteString( _In_z_ const TCHAR* valueName, _In_z_ const TCHAR* value )
+        {
+            DWORD strLen = (DWORD)((_tcslen(value) + 1) * sizeof(TCHAR));
+            return Write(valueName, value, strLen, DataType::String);
+        }
+
+        LSTATUS WriteDWORD( _In_z_ const TCHAR* valueName, _In_ DWORD value )
+        {
+            return Write(valueName, &value, sizeof(DWORD), DataType::DWord);
+        }
+
+        LSTATUS WriteQWORD( _In_z_ const TCHAR* valueName, _In_ QWORD value )
+        {
+            return Write(valueName, &value, sizeof(QWORD), DataType::QWord);
+        }
+
+        /// Makes the queued writes without waiting for the window, flushes them unless the
+        /// durability is None, and returns when they are done. Returns the status of the first write
+        /// or flush that failed since the last Drain.
+        LSTATUS Drain();
+
+        /// Applies from the next batch.
+        void SetDurability( _In_ Durability durability );
+
+        Durability GetDurability();
+
+        size_t GetPending();
+
+        WriteBehindStats GetStats();
+
+        Key* GetKey() const
+        {
+            return m_key;
+        }
+
+    private:
+        WriteBehind( const WriteBehind& );
+        WriteBehind& operator = ( const WriteBehind& );
+
+        struct PendingWrite
+        {
+            std::basic_string<TCHAR>    valueName;
+            DataType                    type;
+            std::vector<BYTE>           data;
+        };
+
+        /// Registry names are not case sensitive.
+        struct NameLess
+        {
+            bool operator () (const std::basic_string<TCHAR>& a, const std::basic_string<TCHAR>& b) const
+            {
+                return _tcsicmp(a.c_str(), b.c_str()) < 0;
+            }
+        };
+
+        void    Worker();
+        void    FlushUnflushed( _Inout_ std::unique_lock<std::mutex>& lock );
+        LSTATUS WriteBatch( _In_ const std::vector<PendingWrite>& batch, _In_ Durability durability, _Inout_ WriteBehindStats& made );
+
+        Key*                                                    m_key;
+        DWORD                                                   m_windowMs;
+        DWORD                                                   m_idleMs;
+        Durability                                              m_durability;
+
+        std::mutex                                              m_lock;
+        std::condition_variable                                 m_queued;       /// A write, a Drain or the stop.
+        std::condition_variable                                 m_drained;
+        std::vector<PendingWrite>                               m_pending;      /// In the order of the first write.
+        std::map<std::basic_string<TCHAR>, size_t, NameLess>    m_pendingIndex; /// Index in m_pending of every value.
+        ULONGLONG                                               m_batchStart;   /// Tick count of the first write of the batch.
+        DWORD                                                   m_batchWrites;  /// Writes queued in the batch, with the replaced ones.
+        DWORD                                                   m_unflushed;    /// Batches written since the last flush, for OnIdle.
+        DWORD                                                   m_drainsAsked;
+        DWORD                                                   m_drainsDone;
+        LSTATUS                                                 m_status;       /// The first failure since the last Drain.
+        WriteBehindStats                                        m_stats;
+
+        volatile bool                                           m_shouldStop;
+        std::thread*                                            m_worker;
+    };
+}
+
+#endif // INCLUDED_WRITEBEHIND_H
@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        NameMatcherTests.cpp
+///  Description: Unit tests of Registry::NameMatcher.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Test.h"
+#include "./NameMatcher.h"
+
+using namespace Registry;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(NameMatcher_Empty)
+{
+    NameMatcher matcher;
+
+    CHECK(matcher.IsEmpty());
+    CHECK(matcher.HasOnlyNames());
+    CHECK(!matcher.Matches(_T("")));
+    CHECK(!matcher.Matches(_T("InterleavePattern0")));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(NameMatcher_Names)
+{
+    NameMatcher matcher;
+    matcher.Add(_T("InterleavePattern0"));
+    matcher.Add(_T("InterleavePattern1"));
+    matcher.Add(_T("interleavepattern0"));     // The same name; kept once.
+
+    CHECK(!matcher.IsEmpty());
+    CHECK(matcher.HasOnlyNames());
+    CHECK(matcher.GetNames().size() == 2);
+
+    CHECK(matcher.Matches(_T("InterleavePattern0")));
+    CHECK(matcher.Matches(_T("INTERLEAVEPATTERN1")));
+    CHECK(!matcher.Matches(_T("InterleavePattern")));
+    CHECK(!matcher.Matches(_T("InterleavePattern2")));
+    CHECK(!matcher.Matches(_T("InterleavePattern00")));
+    CHECK(!matcher.Matches(_T("")));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(NameMatcher_Prefixes)
+{
+    NameMatcher matcher;
+    matcher.Add(_T("Stereo*"));
+    matcher.Add(_T("LaserSight"));
+
+    CHECK(!matcher.HasOnlyNames());
+    CHECK(matcher.GetNames().size() == 1);
+
+    CHECK(matcher.Matches(_T("Stereo")));
+    CHECK(matcher.Matches(_T("StereoSeparation")));
+    CHECK(matcher.Matches(_T("stereoconvergence")));
+    CHECK(matcher.Matches(_T("LaserSight")));
+    CHECK(!matcher.Matches(_T("Stere")));
+    CHECK(!matcher.Matches(_T("3DStereo")));
+    CHECK(!matcher.Matches(_T("LaserSightEnabled")));
+
+    // A lone '*' is the empty prefix: it matches every name, the empty one too.
+    NameMatcher all;
+    all.Add(_T("*"));
+
+    CHECK(all.Matches(_T("")));
+    CHECK(all.Matches(_T("Anything")));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(NameMatcher_Globs)
+{
+    NameMatcher matcher;
+    matcher.Add(_T("Interleave*Pattern?"));
+    matcher.Add(_T("*Hotkey"));
+    matcher.Add(_T("a*b*c"));
+
+    CHECK(!matcher.HasOnlyNames());
+    CHECK(matcher.GetNames().empty());
+
+    CHECK(matcher.Matches(_T("InterleavePattern0")));
+    CHECK(matcher.Matches(_T("InterleaveCustomPattern1")));
+    CHECK(matcher.Matches(_T("interleave_PATTERN9")));
+    CHECK(!matcher.Matches(_T("InterleavePattern")));
+    CHECK(!matcher.Matches(_T("InterleavePattern10")));
+
+    CHECK(matcher.Matches(_T("Hotkey")));
+    CHECK(matcher.Matches(_T("ToggleHotkey")));
+    CHECK(!matcher.Matches(_T("HotkeyToggle")));
+
+    // The '*' has to backtrack over the first 'b' and 'c' it meets.
+    CHECK(matcher.Matches(_T("abc")));
+    CHECK(matcher.Matches(_T("abcbc")));
+    CHECK(matcher.Matches(_T("aXbYbZc")));
+    CHECK(!matcher.Matches(_T("acb")));
+    CHECK(!matcher.Matches(_T("abcd")));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(NameMatcher_QuestionMarkIsOneCharacter)
+{
+    NameMatcher matcher;
+    matcher.Add(_T("Pattern?"));
+
+    CHECK(matcher.Matches(_T("Pattern0")));
+    CHECK(!matcher.Matches(_T("Pattern")));
+    CHECK(!matcher.Matches(_T("Pattern01")));
+}
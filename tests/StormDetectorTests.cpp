@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        StormDetectorTests.cpp
+///  Description: Unit tests of Enforcement::StormDetector.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Test.h"
+#include "./Enforcer.h"
+
+using namespace Enforcement;
+
+// The defaults: a window of 1000 ms in buckets of 100 ms, entered at 8 rewrites and left at 2, with
+// delays from 50 ms to 2000 ms.
+static const ULONGLONG Start = 10000;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(StormDetector_BelowEnterRate)
+{
+    StormDetector detector;
+
+    for(DWORD i = 0; i < 7; i++)
+        CHECK(detector.OnRewrite(Start + i * 10) == 0);
+
+    CHECK(!detector.IsStorm());
+    CHECK(detector.GetBackoff() == 0);
+
+    // Spread over more than the window, any number of rewrites stays below the rate.
+    for(DWORD i = 0; i < 100; i++)
+        CHECK(detector.OnRewrite(Start + 1000 + i * 200) == 0);
+
+    CHECK(!detector.IsStorm());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(StormDetector_EnterRateAndBackoff)
+{
+    StormDetector detector;
+
+    for(DWORD i = 0; i < 7; i++)
+        detector.OnRewrite(Start);
+
+    // The eighth rewrite in the window starts the storm; every next one doubles the delay, up to the maximum.
+    const DWORD delays[] = { 50, 100, 200, 400, 800, 1600, 2000, 2000, 2000 };
+
+    for(size_t i = 0; i < _countof(delays); i++)
+    {
+        DWORD delay = detector.OnRewrite(Start + 50);
+
+        CHECK(delay == delays[i]);
+        CHECK(detector.GetBackoff() == delays[i]);
+        CHECK(detector.IsStorm());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(StormDetector_LeaveRate)
+{
+    StormDetector detector;
+
+    for(DWORD i = 0; i < 8; i++)
+        detector.OnRewrite(Start);
+
+    // Three rewrites half a window later keep the rate above the leave rate once the first ones expire.
+    for(DWORD i = 0; i < 3; i++)
+        detector.OnRewrite(Start + 500);
+
+    CHECK(detector.IsStorm());
+    CHECK(detector.Update(Start + 900));
+    CHECK(detector.Update(Start + 1050));
+    CHECK(detector.IsStorm());
+    CHECK(detector.GetBackoff() != 0);
+
+    // Once the three are out of the window too, the storm is over and the delay starts again from the base.
+    CHECK(!detector.Update(Start + 1550));
+    CHECK(!detector.IsStorm());
+    CHECK(detector.GetBackoff() == 0);
+
+    for(DWORD i = 0; i < 7; i++)
+        CHECK(detector.OnRewrite(Start + 2000) == 0);
+
+    CHECK(detector.OnRewrite(Start + 2000) == 50);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(StormDetector_Hysteresis)
+{
+    StormDetector detector(1000, 8, 2, 50, 2000);
+
+    for(DWORD i = 0; i < 8; i++)
+        detector.OnRewrite(Start);
+
+    // Three rewrites are too few to enter a storm, but enough to stay in one.
+    for(DWORD i = 0; i < 3; i++)
+        detector.OnRewrite(Start + 1100);
+
+    CHECK(detector.Update(Start + 1100));
+
+    // Two are not.
+    StormDetector other(1000, 8, 2, 50, 2000);
+
+    for(DWORD i = 0; i < 8; i++)
+        other.OnRewrite(Start);
+
+    for(DWORD i = 0; i < 2; i++)
+        other.OnRewrite(Start + 1100);
+
+    CHECK(!other.Update(Start + 1100));
+}
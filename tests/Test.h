@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Test.h
+///  Description: The few macros the unit tests are written with.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED_TEST_H
+#define INCLUDED_TEST_H
+
+#include <windows.h>
+#include <tchar.h>
+
+namespace Tests
+{
+    typedef void (*TestFunction)();
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    /// Adds a test to the ones run by main, in the order they are built; TEST makes one per test.
+    class Registration
+    {
+    public:
+        Registration( _In_z_ const char* name, _In_ TestFunction function );
+    };
+
+    /// Reports a check that failed; the test goes on with its next checks.
+    void Fail( _In_z_ const char* file, _In_ int line, _In_z_ const char* expression );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Defines a test: TEST(TimerWheel_Remove) { CHECK(...); }
+#define TEST(name)                                                          \
+    static void name();                                                     \
+    static Tests::Registration name##Registration(#name, name);             \
+    static void name()
+
+/// Written as an expression, so /W4 sees no constant condition.
+#define CHECK(expression)                                                   \
+    ((expression) ? (void)0 : Tests::Fail(__FILE__, __LINE__, #expression))
+
+#endif // INCLUDED_TEST_H
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        Tests.cpp
+///  Description: Runs the unit tests, and exits with the number of tests that failed.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace Tests
+{
+    struct TestCase
+    {
+        const char*     name;
+        TestFunction    function;
+    };
+
+    // Built on the first registration: the registrations of the other files run before main, in an
+    // order of their own, and may come before the constructors of this file.
+    static std::vector<TestCase>*   testCases       = nullptr;
+    static DWORD                    failedChecks    = 0;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    Registration::Registration( _In_z_ const char* name, _In_ TestFunction function )
+    {
+        if(testCases == nullptr)
+            testCases = new std::vector<TestCase>();
+
+        TestCase testCase = { name, function };
+        testCases->push_back(testCase);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////
+    void Fail( _In_z_ const char* file, _In_ int line, _In_z_ const char* expression )
+    {
+        printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+        failedChecks++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Runs every test, or the ones whose name starts with the first argument.
+int main( int argc, char** argv )
+{
+    const char* filter = (argc > 1) ? argv[1] : "";
+    int         failed = 0;
+    int         run    = 0;
+
+    if(Tests::testCases == nullptr)
+        return 0;
+
+    for(size_t i = 0; i < Tests::testCases->size(); i++)
+    {
+        const Tests::TestCase& testCase = (*Tests::testCases)[i];
+
+        if(strncmp(testCase.name, filter, strlen(filter)) != 0)
+            continue;
+
+        DWORD failedBefore = Tests::failedChecks;
+
+        testCase.function();
+        run++;
+
+        bool passed = Tests::failedChecks == failedBefore;
+        if(!passed)
+            failed++;
+
+        printf("%-50s %s\n", testCase.name, passed ? "passed" : "FAILED");
+    }
+
+    printf("%d of %d tests failed\n", failed, run);
+
+    return failed;
+}
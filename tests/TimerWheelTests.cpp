@@ -0,0 +1,190 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        TimerWheelTests.cpp
+///  Description: Unit tests of Registry::TimerWheel.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Test.h"
+#include "./TimerWheel.h"
+
+using namespace Registry;
+
+// The first tick of every wheel, and of the ticks parked in the last one.
+static const ULONGLONG Level1 = 1ULL << (TimerWheel::SlotBits * 1);
+static const ULONGLONG Level2 = 1ULL << (TimerWheel::SlotBits * 2);
+static const ULONGLONG Level3 = 1ULL << (TimerWheel::SlotBits * 3);
+static const ULONGLONG Parked = 1ULL << (TimerWheel::SlotBits * 4);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(TimerWheel_DueInTickOrderAcrossLevels)
+{
+    // Inserted out of order, on every wheel, with ticks that cascade into the same slot of the first.
+    const ULONGLONG expiries[] = { Parked + 5, Level3 + 1, Level1 + 1, 3, Level2 * 3 + 7, Level1, Level2 + Level1 + 1, 1, Level1 - 1 };
+
+    TimerWheel  wheel;
+    TimerNode   nodes[_countof(expiries)];
+
+    for(size_t i = 0; i < _countof(expiries); i++)
+        wheel.Insert(&nodes[i], expiries[i]);
+
+    CHECK(wheel.GetCount() == _countof(expiries));
+
+    std::vector<TimerNode*> due;
+    wheel.Advance(Parked + Level1, due);
+
+    CHECK(due.size() == _countof(expiries));
+    CHECK(wheel.GetCount() == 0);
+
+    for(size_t i = 1; i < due.size(); i++)
+        CHECK(due[i - 1]->expiry < due[i]->expiry);
+
+    for(size_t i = 0; i < due.size(); i++)
+        CHECK(!due[i]->IsLinked());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(TimerWheel_DueAtTheirTick)
+{
+    // Stepping from one GetNextTick to the next, every timer must come out at its own tick, not one
+    // early or late, whatever the wheel it went through.
+    const DWORD count = 2000;
+
+    TimerWheel  wheel(12345);
+    TimerNode*  nodes = new TimerNode[count];
+    ULONGLONG   seed  = 1;
+
+    for(DWORD i = 0; i < count; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        // Mostly near, some far, a few beyond the last wheel.
+        ULONGLONG range = (i % 100 == 0) ? Parked * 2 : (i % 10 == 0) ? Level3 : Level1 * 4;
+        wheel.Insert(&nodes[i], wheel.GetCurrent() + 1 + (seed >> 33) % range);
+    }
+
+    std::vector<TimerNode*> due;
+    DWORD                   fired = 0;
+    bool                    onTime = true;
+
+    while(wheel.GetCount() != 0)
+    {
+        ULONGLONG next = wheel.GetNextTick();
+
+        due.clear();
+        wheel.Advance(next, due);
+
+        for(size_t i = 0; i < due.size(); i++)
+            onTime = onTime && due[i]->expiry == next;
+
+        fired += (DWORD)due.size();
+    }
+
+    CHECK(onTime);
+    CHECK(fired == count);
+    CHECK(wheel.GetNextTick() == ULLONG_MAX);
+
+    delete [] nodes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(TimerWheel_CascadeKeepsInsertOrder)
+{
+    TimerWheel  wheel;
+    TimerNode   first;
+    TimerNode   second;
+    TimerNode   third;
+
+    // Due at the same tick, they come down two wheels together.
+    wheel.Insert(&first,  Level2 + 2);
+    wheel.Insert(&second, Level2 + 2);
+    wheel.Insert(&third,  Level2 + 2);
+
+    std::vector<TimerNode*> due;
+    wheel.Advance(Level2 + 2, due);
+
+    CHECK(due.size() == 3);
+    CHECK(due.size() == 3 && due[0] == &first && due[1] == &second && due[2] == &third);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(TimerWheel_Remove)
+{
+    TimerWheel  wheel;
+    TimerNode   kept;
+    TimerNode   removed;
+    TimerNode   farRemoved;
+
+    wheel.Insert(&kept,       10);
+    wheel.Insert(&removed,    10);
+    wheel.Insert(&farRemoved, Level2 + 10);
+
+    wheel.Remove(&removed);
+    wheel.Remove(&farRemoved);
+
+    // Removing a timer that is not in the wheel does nothing.
+    wheel.Remove(&removed);
+
+    CHECK(!removed.IsLinked());
+    CHECK(wheel.GetCount() == 1);
+
+    std::vector<TimerNode*> due;
+    wheel.Advance(Level2 * 2, due);
+
+    CHECK(due.size() == 1 && due[0] == &kept);
+    CHECK(wheel.GetCount() == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(TimerWheel_PastExpiryIsDueNextTick)
+{
+    TimerWheel  wheel(100);
+    TimerNode   late;
+    TimerNode   current;
+
+    wheel.Insert(&late,    40);
+    wheel.Insert(&current, 100);
+
+    CHECK(late.expiry == 101 && current.expiry == 101);
+    CHECK(wheel.GetNextTick() == 101);
+
+    std::vector<TimerNode*> due;
+    wheel.Advance(100, due);
+    CHECK(due.empty());
+
+    wheel.Advance(101, due);
+    CHECK(due.size() == 2);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(TimerWheel_NextTick)
+{
+    TimerWheel  wheel;
+    TimerNode   nearTimer;
+    TimerNode   farTimer;
+
+    CHECK(wheel.GetNextTick() == ULLONG_MAX);
+
+    // A timer of the second wheel is seen at the turn that cascades it, never after its tick.
+    wheel.Insert(&farTimer, Level1 * 3 + 5);
+    CHECK(wheel.GetNextTick() == Level1 * 3);
+
+    wheel.Insert(&nearTimer, 7);
+    CHECK(wheel.GetNextTick() == 7);
+
+    std::vector<TimerNode*> due;
+    wheel.Advance(Level1 * 3, due);
+    CHECK(due.size() == 1 && due[0] == &nearTimer);
+    CHECK(wheel.GetNextTick() == Level1 * 3 + 5);
+}
@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+///  File:        UndoJournalTests.cpp
+///  Description: Unit tests of Registry::UndoJournal, on a scratch key under HKCU.
+///  Author:      Chiuta Adrian Marius
+///  Created:     18-10-2026
+///
+///  Licensed under the Apache License, Version 2.0 (the "License");
+///  you may not use this file except in compliance with the License.
+///  You may obtain a copy of the License at
+///  http://www.apache.org/licenses/LICENSE-2.0
+///  Unless required by applicable law or agreed to in writing, software
+///  distributed under the License is distributed on an "AS IS" BASIS,
+///  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+///  See the License for the specific language governing permissions and
+///  limitations under the License.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "./Test.h"
+#include "./UndoJournal.h"
+
+using namespace Registry;
+
+// Restore opens the keys again by their path, so the journal can't be tested on a MemoryHive.
+static const TCHAR* const ScratchKeyPath = _T("SOFTWARE\\3DVisionEyeSwapper\\Tests");
+static const TCHAR* const Pattern        = _T("InterleavePattern0");
+static const TCHAR* const Missing        = _T("InterleavePattern1");
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+/// A new scratch key holding Pattern = 0x00FF00FF and no Missing, and a new journal file.
+class Scratch
+{
+public:
+    Key*    key;
+    TCHAR   journalFile[MAX_PATH];
+
+    Scratch()
+    {
+        Key::Delete(PredefinedKey::Current_User, ScratchKeyPath);
+
+        key = Key::Create(PredefinedKey::Current_User, ScratchKeyPath);
+        if(key != nullptr)
+            key->SetValueDWORD(Pattern, 0x00FF00FF);
+
+        DWORD length = GetTempPath(MAX_PATH, journalFile);
+        if(length == 0 || length >= MAX_PATH || _tcscat_s(journalFile, _T("3DVisionEyeSwapperTests.journal")) != 0)
+            journalFile[0] = 0;
+
+        DeleteFile(journalFile);
+    }
+
+    ~Scratch()
+    {
+        if(key != nullptr)
+            key->Close();
+
+        Key::Delete(PredefinedKey::Current_User, ScratchKeyPath);
+        DeleteFile(journalFile);
+    }
+
+    bool IsReady() const
+    {
+        return key != nullptr && journalFile[0] != 0;
+    }
+
+private:
+    Scratch( const Scratch& );
+    Scratch& operator = ( const Scratch& );
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(UndoJournal_RestoreOldest)
+{
+    Scratch     scratch;
+    UndoJournal journal;
+
+    CHECK(scratch.IsReady());
+    if(!scratch.IsReady())
+        return;
+
+    CHECK(journal.Restore() == ERROR_INVALID_HANDLE);
+    CHECK(journal.Open(scratch.journalFile) == ERROR_SUCCESS);
+    CHECK(journal.IsEmpty());
+
+    CHECK(journal.Record(*scratch.key, Pattern) == ERROR_SUCCESS);
+    CHECK(journal.Record(*scratch.key, Missing) == ERROR_SUCCESS);
+
+    scratch.key->SetValueDWORD(Pattern, 0xFF00FF00);
+    scratch.key->SetValueDWORD(Missing, 0xFF00FF00);
+
+    // Newer records of the same values don't change what is put back.
+    CHECK(journal.Record(*scratch.key, Pattern) == ERROR_SUCCESS);
+    CHECK(journal.Record(*scratch.key, Missing) == ERROR_SUCCESS);
+    CHECK(journal.GetRecordCount() == 4);
+
+    scratch.key->SetValueDWORD(Pattern, 0x12345678);
+
+    DWORD written = 0;
+    CHECK(journal.Restore(&written) == ERROR_SUCCESS);
+    CHECK(written == 2);
+    CHECK(journal.IsEmpty());
+
+    DWORD value = 0;
+    CHECK(scratch.key->GetValueDWORD(Pattern, &value) == ERROR_SUCCESS && value == 0x00FF00FF);
+    CHECK(scratch.key->GetValueDWORD(Missing, &value) == ERROR_FILE_NOT_FOUND);
+
+    // Nothing left to put back.
+    CHECK(journal.Restore(&written) == ERROR_SUCCESS);
+    CHECK(written == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(UndoJournal_RestoreSkipsUnchanged)
+{
+    Scratch     scratch;
+    UndoJournal journal;
+
+    CHECK(scratch.IsReady());
+    if(!scratch.IsReady() || journal.Open(scratch.journalFile) != ERROR_SUCCESS)
+        return;
+
+    journal.Record(*scratch.key, Pattern);
+    journal.Record(*scratch.key, Missing);
+
+    // Both are already as they were recorded.
+    scratch.key->SetValueDWORD(Pattern, 0xFF00FF00);
+    scratch.key->SetValueDWORD(Pattern, 0x00FF00FF);
+
+    DWORD written = 1;
+    CHECK(journal.Restore(&written) == ERROR_SUCCESS);
+    CHECK(written == 0);
+    CHECK(journal.IsEmpty());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+TEST(UndoJournal_Compaction)
+{
+    Scratch     scratch;
+    UndoJournal journal;
+
+    CHECK(scratch.IsReady());
+    if(!scratch.IsReady() || journal.Open(scratch.journalFile) != ERROR_SUCCESS)
+        return;
+
+    // Far more records than a slot holds: only the compaction keeps them from filling the file.
+    const DWORD rewrites = 4 * UndoJournal::SlotSize / 64;
+
+    CHECK(journal.Record(*scratch.key, Missing) == ERROR_SUCCESS);
+
+    bool recorded = true;
+    for(DWORD i = 0; i < rewrites; i++)
+    {
+        recorded = recorded && journal.Record(*scratch.key, Pattern) == ERROR_SUCCESS;
+        scratch.key->SetValueDWORD(Pattern, i);
+        scratch.key->SetValueDWORD(Missing, i);
+    }
+
+    CHECK(recorded);
+
+    DWORD count = journal.GetRecordCount();
+    CHECK(count >= 2 && count < rewrites);
+
+    // The records outlive the journal that wrote them.
+    journal.Close();
+    CHECK(journal.Open(scratch.journalFile) == ERROR_SUCCESS);
+    CHECK(journal.GetRecordCount() == count);
+
+    DWORD written = 0;
+    CHECK(journal.Restore(&written) == ERROR_SUCCESS);
+    CHECK(written == 2);
+
+    DWORD value = 0;
+    CHECK(scratch.key->GetValueDWORD(Pattern, &value) == ERROR_SUCCESS && value == 0x00FF00FF);
+    CHECK(scratch.key->GetValueDWORD(Missing, &value) == ERROR_FILE_NOT_FOUND);
+
+    journal.Close();
+    CHECK(journal.Open(scratch.journalFile) == ERROR_SUCCESS);
+    CHECK(journal.IsEmpty());
+}